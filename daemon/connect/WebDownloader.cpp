@@ -49,6 +49,9 @@
 #include "Options.h"
 #include "Util.h"
 
+// limit for responses kept in memory, larger responses are written into output file
+static const int MAX_MEMORY_OUTPUT = 32 * 1024 * 1024;
+
 WebDownloader::WebDownloader()
 {
 	debug("Creating WebDownloader");
@@ -62,6 +65,10 @@ WebDownloader::WebDownloader()
 	m_szOriginalFilename = NULL;
 	m_bForce = false;
 	m_bRetry = true;
+	m_bMemoryOutput = false;
+	m_pOutBuffer = NULL;
+	m_iOutBufferLen = 0;
+	m_iOutBufferSize = 0;
 	SetLastUpdateTimeNow();
 }
 
@@ -73,6 +80,7 @@ WebDownloader::~WebDownloader()
 	free(m_szInfoName);
 	free(m_szOutputFilename);
 	free(m_szOriginalFilename);
+	free(m_pOutBuffer);
 }
 
 void WebDownloader::SetOutputFilename(const char* v)
@@ -238,7 +246,14 @@ WebDownloader::EStatus WebDownloader::Download()
 	if (Status != adFinished)
 	{
 		// Download failed, delete broken output file
-		remove(m_szOutputFilename);
+		if (m_bMemoryOutput)
+		{
+			m_iOutBufferLen = 0;
+		}
+		else
+		{
+			remove(m_szOutputFilename);
+		}
 	}
 
 	return Status;
@@ -387,6 +402,7 @@ WebDownloader::EStatus WebDownloader::DownloadBody()
 	EStatus Status = adRunning;
 
 	m_pOutFile = NULL;
+	m_iOutBufferLen = 0;
 	bool bEnd = false;
 	const int LineBufSize = 1024*10;
 	char* szLineBuf = (char*)malloc(LineBufSize);
@@ -608,7 +624,7 @@ void WebDownloader::ParseRedirect(const char* szLocation)
 
 bool WebDownloader::Write(void* pBuffer, int iLen)
 {
-	if (!m_pOutFile && !PrepareFile())
+	if (!m_bMemoryOutput && !m_pOutFile && !PrepareFile())
 	{
 		return false;
 	}
@@ -629,7 +645,7 @@ bool WebDownloader::Write(void* pBuffer, int iLen)
 				return false;
 			}
 
-			if (iOutLen > 0 && fwrite(pOutBuf, 1, iOutLen, m_pOutFile) <= 0)
+			if (iOutLen > 0 && !WriteOutput(pOutBuf, iOutLen))
 			{
 				return false;
 			}
@@ -645,7 +661,50 @@ bool WebDownloader::Write(void* pBuffer, int iLen)
 	else
 #endif
 
-	return fwrite(pBuffer, 1, iLen, m_pOutFile) > 0;
+	return WriteOutput(pBuffer, iLen);
+}
+
+/*
+ * Writes into output file or, in memory output mode, appends to output
+ * buffer. The buffer is always terminated with '\0'. Responses larger than
+ * MAX_MEMORY_OUTPUT switch to the output file, see GetMemoryOutput.
+ */
+bool WebDownloader::WriteOutput(const void* pBuffer, int iLen)
+{
+	if (m_bMemoryOutput && m_iOutBufferLen + iLen > MAX_MEMORY_OUTPUT)
+	{
+		debug("URL %s: response too large for memory, writing to %s", m_szInfoName, m_szOutputFilename);
+		if (!PrepareFile() ||
+			(m_iOutBufferLen > 0 && fwrite(m_pOutBuffer, 1, m_iOutBufferLen, m_pOutFile) <= 0))
+		{
+			return false;
+		}
+		free(m_pOutBuffer);
+		m_pOutBuffer = NULL;
+		m_iOutBufferLen = 0;
+		m_iOutBufferSize = 0;
+		m_bMemoryOutput = false;
+	}
+
+	if (!m_bMemoryOutput)
+	{
+		return fwrite(pBuffer, 1, iLen, m_pOutFile) > 0;
+	}
+
+	if (m_iOutBufferLen + iLen + 1 > m_iOutBufferSize)
+	{
+		m_iOutBufferSize = (m_iOutBufferLen + iLen + 1) * 2;
+		if (m_iOutBufferSize < 64 * 1024)
+		{
+			m_iOutBufferSize = 64 * 1024;
+		}
+		m_pOutBuffer = (char*)realloc(m_pOutBuffer, m_iOutBufferSize);
+	}
+	memcpy(m_pOutBuffer + m_iOutBufferLen, pBuffer, iLen);
+	m_iOutBufferLen += iLen;
+	m_pOutBuffer[m_iOutBufferLen] = '\0';
+
+	return true;
 }
 
 bool WebDownloader::PrepareFile()
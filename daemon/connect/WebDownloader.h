@@ -58,6 +58,10 @@ private:
 	time_t				m_tLastUpdateTime;
 	char*				m_szInfoName;
 	FILE*				m_pOutFile;
+	bool				m_bMemoryOutput;
+	char*				m_pOutBuffer;
+	int					m_iOutBufferLen;
+	int					m_iOutBufferSize;
 	int					m_iContentLen;
 	bool				m_bConfirmedLength;
 	char*				m_szOriginalFilename;
@@ -73,6 +77,7 @@ private:
 
 	void				SetStatus(EStatus eStatus);
 	bool				Write(void* pBuffer, int iLen);
+	bool				WriteOutput(const void* pBuffer, int iLen);
 	bool				PrepareFile();
 	void				FreeConnection();
 	EStatus				CheckResponse(const char* szResponse);
@@ -99,6 +104,10 @@ public:
 	void 				SetURL(const char* szURL);
 	const char*			GetOutputFilename() { return m_szOutputFilename; }
 	void 				SetOutputFilename(const char* v);
+	void				SetMemoryOutput(bool bMemoryOutput) { m_bMemoryOutput = bMemoryOutput; }
+	bool				GetMemoryOutput() { return m_bMemoryOutput; }
+	const char*			GetOutputBuffer() { return m_pOutBuffer; }
+	int					GetOutputBufferLen() { return m_iOutBufferLen; }
 	time_t				GetLastUpdateTime() { return m_tLastUpdateTime; }
 	void				SetLastUpdateTimeNow() { m_tLastUpdateTime = ::time(NULL); }
 	bool				GetConfirmedLength() { return m_bConfirmedLength; }
@@ -84,6 +84,7 @@ void PostScriptController::Run()
 		}
 	}
 	m_pPostInfo->GetNZBInfo()->GetScriptStatuses()->Clear();
+	m_pPostInfo->GetNZBInfo()->SetChanged(true);
 	DownloadQueue::Unlock();
 
 	ExecuteScriptList(scriptCommaList.GetBuffer());
@@ -133,6 +134,7 @@ void PostScriptController::ExecuteScript(ScriptConfig::Script* pScript)
 	// the locking is needed for accessing the members of NZBInfo
 	DownloadQueue::Lock();
 	m_pPostInfo->GetNZBInfo()->GetScriptStatuses()->Add(pScript->GetName(), eStatus);
+	m_pPostInfo->GetNZBInfo()->SetChanged(true);
 	DownloadQueue::Unlock();
 }
 
@@ -279,6 +281,7 @@ void PostScriptController::AddMessage(Message::EKind eKind, const char* szText)
 				*szValue = '\0';
 				DownloadQueue::Lock();
 				m_pPostInfo->GetNZBInfo()->GetParameters()->SetParameter(szParam, szValue + 1);
+				m_pPostInfo->GetNZBInfo()->SetChanged(true);
 				DownloadQueue::Unlock();
 			}
 			else
@@ -188,6 +188,7 @@ void QueueScriptController::AddMessage(Message::EKind eKind, const char* szText)
 				if (pNZBInfo)
 				{
 					pNZBInfo->GetParameters()->SetParameter(szParam, szValue + 1);
+					pNZBInfo->SetChanged(true);
 				}
 				DownloadQueue::Unlock();
 			}
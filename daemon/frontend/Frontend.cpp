@@ -98,7 +98,7 @@ bool Frontend::PrepareData()
 			m_iThreadCount = Thread::GetThreadCount();
 			g_pStatMeter->CalcTotalStat(&m_iUpTimeSec, &m_iDnTimeSec, &m_iAllBytes, &m_bStandBy);
 
-			DownloadQueue *pDownloadQueue = DownloadQueue::Lock();
+			DownloadQueue *pDownloadQueue = DownloadQueue::LockShared();
 			m_iPostJobCount = 0;
 			for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
 			{
@@ -106,7 +106,7 @@ bool Frontend::PrepareData()
 				m_iPostJobCount += pNZBInfo->GetPostInfo() ? 1 : 0;
 			}
 			pDownloadQueue->CalcRemainingSize(&m_lRemainingSize, NULL);
-			DownloadQueue::Unlock();
+			DownloadQueue::UnlockShared();
 
 		}
 	}
@@ -133,16 +133,14 @@ MessageList* Frontend::LockMessages()
 	}
 	else
 	{
-		return g_pLog->LockMessages();
+		m_LocalMessages.Clear();
+		g_pLog->GetMessages(&m_LocalMessages, 0, 0);
+		return &m_LocalMessages;
 	}
 }
 
 void Frontend::UnlockMessages()
 {
-	if (!IsRemoteMode())
-	{
-		g_pLog->UnlockMessages();
-	}
 }
 
 DownloadQueue* Frontend::LockQueue()
@@ -155,6 +153,16 @@ void Frontend::UnlockQueue()
 	DownloadQueue::Unlock();
 }
 
+DownloadQueue* Frontend::LockQueueShared()
+{
+	return DownloadQueue::LockShared();
+}
+
+void Frontend::UnlockQueueShared()
+{
+	DownloadQueue::UnlockShared();
+}
+
 bool Frontend::IsRemoteMode()
 {
 	return g_pOptions->GetRemoteClientMode();
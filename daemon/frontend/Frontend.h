@@ -37,6 +37,7 @@ class Frontend : public Thread
 {
 private:
 	MessageList			m_RemoteMessages;
+	MessageList			m_LocalMessages;
 
 	bool				RequestMessages();
 	bool				RequestFileList();
@@ -66,6 +67,8 @@ protected:
 	void				UnlockMessages();
 	DownloadQueue*		LockQueue();
 	void				UnlockQueue();
+	DownloadQueue*		LockQueueShared();
+	void				UnlockQueueShared();
 	bool				IsRemoteMode();
 	void				InitMessageBase(SNZBRequestBase* pMessageBase, int iRequest, int iSize);
 	void				ServerPauseUnpause(bool bPause);
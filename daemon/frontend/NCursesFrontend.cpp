@@ -385,7 +385,7 @@ void NCursesFrontend::CalcWindowSizes()
 int NCursesFrontend::CalcQueueSize()
 {
 	int iQueueSize = 0;
-	DownloadQueue* pDownloadQueue = LockQueue();
+	DownloadQueue* pDownloadQueue = LockQueueShared();
 	if (m_bGroupFiles)
 	{
 		iQueueSize = pDownloadQueue->GetQueue()->size();
@@ -398,7 +398,7 @@ int NCursesFrontend::CalcQueueSize()
 			iQueueSize += pNZBInfo->GetFileList()->size();
 		}
 	}
-	UnlockQueue();
+	UnlockQueueShared();
 	return iQueueSize;
 }
 
@@ -746,7 +746,7 @@ void NCursesFrontend::PrintQueue()
 
 void NCursesFrontend::PrintFileQueue()
 {
-    DownloadQueue* pDownloadQueue = LockQueue();
+    DownloadQueue* pDownloadQueue = LockQueueShared();
 
 	int iLineNr = m_iQueueWinTop + 1;
 	long long lRemaining = 0;
@@ -798,7 +798,7 @@ void NCursesFrontend::PrintFileQueue()
         PlotLine("Ready to receive nzb-job", iLineNr++, 0, NCURSES_COLORPAIR_TEXT);
 	}
 
-    UnlockQueue();
+    UnlockQueueShared();
 }
 
 void NCursesFrontend::PrintFilename(FileInfo * pFileInfo, int iRow, bool bSelected)
@@ -928,7 +928,7 @@ void NCursesFrontend::PrintGroupQueue()
 {
 	int iLineNr = m_iQueueWinTop;
 
-    DownloadQueue* pDownloadQueue = LockQueue();
+    DownloadQueue* pDownloadQueue = LockQueueShared();
 	if (pDownloadQueue->GetQueue()->empty())
     {
 		char szBuffer[MAX_SCREEN_WIDTH];
@@ -979,7 +979,7 @@ void NCursesFrontend::PrintGroupQueue()
 		szBuffer[MAX_SCREEN_WIDTH - 1] = '\0';
 		PrintTopHeader(szBuffer, m_iQueueWinTop, false);
     }
-    UnlockQueue();
+    UnlockQueueShared();
 }
 
 void NCursesFrontend::ResetColWidths()
@@ -1114,7 +1114,7 @@ bool NCursesFrontend::EditQueue(DownloadQueue::EEditAction eAction, int iOffset)
 
 	if (m_bGroupFiles)
 	{
-		DownloadQueue* pDownloadQueue = LockQueue();
+		DownloadQueue* pDownloadQueue = LockQueueShared();
 		if (m_iSelectedQueueEntry >= 0 && m_iSelectedQueueEntry < (int)pDownloadQueue->GetQueue()->size())
 		{
 			NZBInfo* pNZBInfo = pDownloadQueue->GetQueue()->at(m_iSelectedQueueEntry);
@@ -1138,7 +1138,7 @@ bool NCursesFrontend::EditQueue(DownloadQueue::EEditAction eAction, int iOffset)
 				}
 			}
 		}
-		UnlockQueue();
+		UnlockQueueShared();
 
 		// map file-edit-actions to group-edit-actions
 		 DownloadQueue::EEditAction FileToGroupMap[] = {
@@ -1155,7 +1155,7 @@ bool NCursesFrontend::EditQueue(DownloadQueue::EEditAction eAction, int iOffset)
 	}
 	else
 	{
-		DownloadQueue* pDownloadQueue = LockQueue();
+		DownloadQueue* pDownloadQueue = LockQueueShared();
 
 		int iFileNum = 0;
 		for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
@@ -1175,7 +1175,7 @@ bool NCursesFrontend::EditQueue(DownloadQueue::EEditAction eAction, int iOffset)
 			}
 		}
 
-		UnlockQueue();
+		UnlockQueueShared();
 	}
 
 	m_iLastEditEntry = m_iSelectedQueueEntry;
@@ -99,6 +99,8 @@ static const char* OPTION_RETRIES				= "Retries";
 static const char* OPTION_RETRYINTERVAL			= "RetryInterval";
 static const char* OPTION_TERMINATETIMEOUT		= "TerminateTimeout";
 static const char* OPTION_CONTINUEPARTIAL		= "ContinuePartial";
+static const char* OPTION_PARTIALSTATEINTERVAL	= "PartialStateInterval";
+static const char* OPTION_FLUSHQUEUE			= "FlushQueue";
 static const char* OPTION_URLCONNECTIONS		= "UrlConnections";
 static const char* OPTION_LOGBUFFERSIZE			= "LogBufferSize";
 static const char* OPTION_INFOTARGET			= "InfoTarget";
@@ -110,6 +112,7 @@ static const char* OPTION_PARCHECK				= "ParCheck";
 static const char* OPTION_PARREPAIR				= "ParRepair";
 static const char* OPTION_PARSCAN				= "ParScan";
 static const char* OPTION_PARQUICK				= "ParQuick";
+static const char* OPTION_PARBLOCKHASH			= "ParBlockHash";
 static const char* OPTION_PARRENAME				= "ParRename";
 static const char* OPTION_PARBUFFER				= "ParBuffer";
 static const char* OPTION_PARTHREADS			= "ParThreads";
@@ -126,6 +129,7 @@ static const char* OPTION_DIRECTWRITE			= "DirectWrite";
 static const char* OPTION_WRITEBUFFER			= "WriteBuffer";
 static const char* OPTION_NZBDIRINTERVAL		= "NzbDirInterval";
 static const char* OPTION_NZBDIRFILEAGE			= "NzbDirFileAge";
+static const char* OPTION_NZBDIRWATCH			= "NzbDirWatch";
 static const char* OPTION_PARCLEANUPQUEUE		= "ParCleanupQueue";
 static const char* OPTION_DISKSPACE				= "DiskSpace";
 static const char* OPTION_DUMPCORE				= "DumpCore";
@@ -135,6 +139,7 @@ static const char* OPTION_NZBCLEANUPDISK		= "NzbCleanupDisk";
 static const char* OPTION_DELETECLEANUPDISK		= "DeleteCleanupDisk";
 static const char* OPTION_PARTIMELIMIT			= "ParTimeLimit";
 static const char* OPTION_KEEPHISTORY			= "KeepHistory";
+static const char* OPTION_ARCHIVEHISTORY		= "ArchiveHistory";
 static const char* OPTION_ACCURATERATE			= "AccurateRate";
 static const char* OPTION_UNPACK				= "Unpack";
 static const char* OPTION_UNPACKCLEANUPDISK		= "UnpackCleanupDisk";
@@ -151,6 +156,7 @@ static const char* OPTION_URLFORCE				= "UrlForce";
 static const char* OPTION_TIMECORRECTION		= "TimeCorrection";
 static const char* OPTION_PROPAGATIONDELAY		= "PropagationDelay";
 static const char* OPTION_ARTICLECACHE			= "ArticleCache";
+static const char* OPTION_ARTICLELISTLIMIT		= "ArticleListLimit";
 static const char* OPTION_EVENTINTERVAL			= "EventInterval";
 
 // obsolete options
@@ -400,6 +406,8 @@ void Options::Init(const char* szExeName, const char* szConfigFilename, bool bNo
 	m_iTerminateTimeout		= 0;
 	m_bAppendCategoryDir	= false;
 	m_bContinuePartial		= false;
+	m_iPartialStateInterval	= 0;
+	m_bFlushQueue			= false;
 	m_bSaveQueue			= false;
 	m_bDupeCheck			= false;
 	m_iRetries				= 0;
@@ -430,6 +438,7 @@ void Options::Init(const char* szExeName, const char* szConfigFilename, bool bNo
 	m_bParRepair			= false;
 	m_eParScan				= psLimited;
 	m_bParQuick				= true;
+	m_bParBlockHash			= false;
 	m_bParRename			= false;
 	m_iParBuffer			= 0;
 	m_iParThreads			= 0;
@@ -448,6 +457,7 @@ void Options::Init(const char* szExeName, const char* szConfigFilename, bool bNo
 	m_iWriteBuffer			= 0;
 	m_iNzbDirInterval		= 0;
 	m_iNzbDirFileAge		= 0;
+	m_bNzbDirWatch			= false;
 	m_bParCleanupQueue		= false;
 	m_iDiskSpace			= 0;
 	m_bTLS					= false;
@@ -458,6 +468,7 @@ void Options::Init(const char* szExeName, const char* szConfigFilename, bool bNo
 	m_bDeleteCleanupDisk	= false;
 	m_iParTimeLimit			= 0;
 	m_iKeepHistory			= 0;
+	m_iArchiveHistory		= 0;
 	m_bAccurateRate			= false;
 	m_tResumeTime			= 0;
 	m_bUnpack				= false;
@@ -474,6 +485,7 @@ void Options::Init(const char* szExeName, const char* szConfigFilename, bool bNo
 	m_iLocalTimeOffset		= 0;
 	m_iPropagationDelay		= 0;
 	m_iArticleCache			= 0;
+	m_iArticleListLimit		= 0;
 	m_iEventInterval		= 0;
 
 	m_bNoDiskAccess = bNoDiskAccess;
@@ -677,6 +689,8 @@ void Options::InitDefaults()
 	SetOption(OPTION_RETRYINTERVAL, "10");
 	SetOption(OPTION_TERMINATETIMEOUT, "600");
 	SetOption(OPTION_CONTINUEPARTIAL, "no");
+	SetOption(OPTION_PARTIALSTATEINTERVAL, "1");
+	SetOption(OPTION_FLUSHQUEUE, "no");
 	SetOption(OPTION_URLCONNECTIONS, "4");
 	SetOption(OPTION_LOGBUFFERSIZE, "1000");
 	SetOption(OPTION_INFOTARGET, "both");
@@ -688,6 +702,7 @@ void Options::InitDefaults()
 	SetOption(OPTION_PARREPAIR, "yes");
 	SetOption(OPTION_PARSCAN, "limited");
 	SetOption(OPTION_PARQUICK, "yes");
+	SetOption(OPTION_PARBLOCKHASH, "no");
 	SetOption(OPTION_PARRENAME, "yes");
 	SetOption(OPTION_PARBUFFER, "16");
 	SetOption(OPTION_PARTHREADS, "1");
@@ -707,6 +722,7 @@ void Options::InitDefaults()
 	SetOption(OPTION_WRITEBUFFER, "0");
 	SetOption(OPTION_NZBDIRINTERVAL, "5");
 	SetOption(OPTION_NZBDIRFILEAGE, "60");
+	SetOption(OPTION_NZBDIRWATCH, "yes");
 	SetOption(OPTION_PARCLEANUPQUEUE, "yes");
 	SetOption(OPTION_DISKSPACE, "250");
 	SetOption(OPTION_DUMPCORE, "no");
@@ -716,6 +732,7 @@ void Options::InitDefaults()
 	SetOption(OPTION_DELETECLEANUPDISK, "no");
 	SetOption(OPTION_PARTIMELIMIT, "0");
 	SetOption(OPTION_KEEPHISTORY, "7");
+	SetOption(OPTION_ARCHIVEHISTORY, "0");
 	SetOption(OPTION_ACCURATERATE, "no");
 	SetOption(OPTION_UNPACK, "no");
 	SetOption(OPTION_UNPACKCLEANUPDISK, "no");
@@ -735,6 +752,7 @@ void Options::InitDefaults()
 	SetOption(OPTION_TIMECORRECTION, "0");
 	SetOption(OPTION_PROPAGATIONDELAY, "0");
 	SetOption(OPTION_ARTICLECACHE, "0");
+	SetOption(OPTION_ARTICLELISTLIMIT, "100");
 	SetOption(OPTION_EVENTINTERVAL, "0");
 }
 
@@ -944,6 +962,7 @@ void Options::InitOptions()
 	m_iDiskSpace			= ParseIntValue(OPTION_DISKSPACE, 10);
 	m_iParTimeLimit			= ParseIntValue(OPTION_PARTIMELIMIT, 10);
 	m_iKeepHistory			= ParseIntValue(OPTION_KEEPHISTORY, 10);
+	m_iArchiveHistory		= ParseIntValue(OPTION_ARCHIVEHISTORY, 10);
 	m_iFeedHistory			= ParseIntValue(OPTION_FEEDHISTORY, 10);
 	m_iTimeCorrection		= ParseIntValue(OPTION_TIMECORRECTION, 10);
 	if (-24 <= m_iTimeCorrection && m_iTimeCorrection <= 24)
@@ -953,9 +972,11 @@ void Options::InitOptions()
 	m_iTimeCorrection *= 60;
 	m_iPropagationDelay		= ParseIntValue(OPTION_PROPAGATIONDELAY, 10) * 60;
 	m_iArticleCache			= ParseIntValue(OPTION_ARTICLECACHE, 10);
+	m_iArticleListLimit		= ParseIntValue(OPTION_ARTICLELISTLIMIT, 10);
 	m_iEventInterval		= ParseIntValue(OPTION_EVENTINTERVAL, 10);
 	m_iParBuffer			= ParseIntValue(OPTION_PARBUFFER, 10);
 	m_iParThreads			= ParseIntValue(OPTION_PARTHREADS, 10);
+	m_iPartialStateInterval	= ParseIntValue(OPTION_PARTIALSTATEINTERVAL, 10);
 
 	CheckDir(&m_szNzbDir, OPTION_NZBDIR, szMainDir, m_iNzbDirInterval == 0, true);
 
@@ -963,10 +984,13 @@ void Options::InitOptions()
 	m_bNzbLog				= (bool)ParseEnumValue(OPTION_NZBLOG, BoolCount, BoolNames, BoolValues);
 	m_bAppendCategoryDir	= (bool)ParseEnumValue(OPTION_APPENDCATEGORYDIR, BoolCount, BoolNames, BoolValues);
 	m_bContinuePartial		= (bool)ParseEnumValue(OPTION_CONTINUEPARTIAL, BoolCount, BoolNames, BoolValues);
+	m_bFlushQueue			= (bool)ParseEnumValue(OPTION_FLUSHQUEUE, BoolCount, BoolNames, BoolValues);
 	m_bSaveQueue			= (bool)ParseEnumValue(OPTION_SAVEQUEUE, BoolCount, BoolNames, BoolValues);
 	m_bDupeCheck			= (bool)ParseEnumValue(OPTION_DUPECHECK, BoolCount, BoolNames, BoolValues);
+	m_bNzbDirWatch			= (bool)ParseEnumValue(OPTION_NZBDIRWATCH, BoolCount, BoolNames, BoolValues);
 	m_bParRepair			= (bool)ParseEnumValue(OPTION_PARREPAIR, BoolCount, BoolNames, BoolValues);
 	m_bParQuick				= (bool)ParseEnumValue(OPTION_PARQUICK, BoolCount, BoolNames, BoolValues);
+	m_bParBlockHash			= (bool)ParseEnumValue(OPTION_PARBLOCKHASH, BoolCount, BoolNames, BoolValues);
 	m_bParRename			= (bool)ParseEnumValue(OPTION_PARRENAME, BoolCount, BoolNames, BoolValues);
 	m_bReloadQueue			= (bool)ParseEnumValue(OPTION_RELOADQUEUE, BoolCount, BoolNames, BoolValues);
 	m_bCursesNZBName		= (bool)ParseEnumValue(OPTION_CURSESNZBNAME, BoolCount, BoolNames, BoolValues);
@@ -2048,6 +2072,22 @@ void Options::CheckOptions()
 		m_iParBuffer = 400;
 	}
 
+	if (m_iArticleListLimit < 0)
+	{
+		m_iArticleListLimit = 0;
+	}
+
+	if (m_iArchiveHistory < 0)
+	{
+		m_iArchiveHistory = 0;
+	}
+
+	if (m_iPartialStateInterval < 1)
+	{
+		ConfigError("Invalid value for option \"%s\": %i. Changed to 1", OPTION_PARTIALSTATEINTERVAL, m_iPartialStateInterval);
+		m_iPartialStateInterval = 1;
+	}
+
 	if (!Util::EmptyStr(m_szUnpackPassFile) && !Util::FileExists(m_szUnpackPassFile))
 	{
 		ConfigError("Invalid value for option \"UnpackPassFile\": %s. File not found", m_szUnpackPassFile);
@@ -205,6 +205,8 @@ private:
 	int					m_iTerminateTimeout;
 	bool				m_bAppendCategoryDir;
 	bool				m_bContinuePartial;
+	int					m_iPartialStateInterval;
+	bool				m_bFlushQueue;
 	int					m_iRetries;
 	int					m_iRetryInterval;
 	bool				m_bSaveQueue;
@@ -235,6 +237,7 @@ private:
 	bool				m_bParRepair;
 	EParScan			m_eParScan;
 	bool				m_bParQuick;
+	bool				m_bParBlockHash;
 	bool				m_bParRename;
 	int					m_iParBuffer;
 	int					m_iParThreads;
@@ -254,6 +257,7 @@ private:
 	int					m_iWriteBuffer;
 	int					m_iNzbDirInterval;
 	int					m_iNzbDirFileAge;
+	bool				m_bNzbDirWatch;
 	bool				m_bParCleanupQueue;
 	int					m_iDiskSpace;
 	bool				m_bTLS;
@@ -264,6 +268,7 @@ private:
 	bool				m_bDeleteCleanupDisk;
 	int					m_iParTimeLimit;
 	int					m_iKeepHistory;
+	int					m_iArchiveHistory;
 	bool				m_bAccurateRate;
 	bool				m_bUnpack;
 	bool				m_bUnpackCleanupDisk;
@@ -278,6 +283,7 @@ private:
 	int					m_iTimeCorrection;
 	int					m_iPropagationDelay;
 	int					m_iArticleCache;
+	int					m_iArticleListLimit;
 	int					m_iEventInterval;
 
 	// Current state
@@ -356,6 +362,8 @@ public:
 	bool				GetDecode() { return m_bDecode; };
 	bool				GetAppendCategoryDir() { return m_bAppendCategoryDir; }
 	bool				GetContinuePartial() { return m_bContinuePartial; }
+	int					GetPartialStateInterval() { return m_iPartialStateInterval; }
+	bool				GetFlushQueue() { return m_bFlushQueue; }
 	int					GetRetries() { return m_iRetries; }
 	int					GetRetryInterval() { return m_iRetryInterval; }
 	bool				GetSaveQueue() { return m_bSaveQueue; }
@@ -386,6 +394,7 @@ public:
 	bool				GetParRepair() { return m_bParRepair; }
 	EParScan			GetParScan() { return m_eParScan; }
 	bool				GetParQuick() { return m_bParQuick; }
+	bool				GetParBlockHash() { return m_bParBlockHash; }
 	bool				GetParRename() { return m_bParRename; }
 	int					GetParBuffer() { return m_iParBuffer; }
 	int					GetParThreads() { return m_iParThreads; }
@@ -404,6 +413,7 @@ public:
 	int					GetWriteBuffer() { return m_iWriteBuffer; }
 	int					GetNzbDirInterval() { return m_iNzbDirInterval; }
 	int					GetNzbDirFileAge() { return m_iNzbDirFileAge; }
+	bool				GetNzbDirWatch() { return m_bNzbDirWatch; }
 	bool				GetParCleanupQueue() { return m_bParCleanupQueue; }
 	int					GetDiskSpace() { return m_iDiskSpace; }
 	bool				GetTLS() { return m_bTLS; }
@@ -414,6 +424,7 @@ public:
 	bool				GetDeleteCleanupDisk() { return m_bDeleteCleanupDisk; }
 	int					GetParTimeLimit() { return m_iParTimeLimit; }
 	int					GetKeepHistory() { return m_iKeepHistory; }
+	int					GetArchiveHistory() { return m_iArchiveHistory; }
 	bool				GetAccurateRate() { return m_bAccurateRate; }
 	bool				GetUnpack() { return m_bUnpack; }
 	bool				GetUnpackCleanupDisk() { return m_bUnpackCleanupDisk; }
@@ -428,6 +439,7 @@ public:
 	int					GetTimeCorrection() { return m_iTimeCorrection; }
 	int					GetPropagationDelay() { return m_iPropagationDelay; }
 	int					GetArticleCache() { return m_iArticleCache; }
+	int					GetArticleListLimit() { return m_iArticleListLimit; }
 	int					GetEventInterval() { return m_iEventInterval; }
 
 	Categories*			GetCategories() { return &m_Categories; }
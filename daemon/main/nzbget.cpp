@@ -44,6 +44,7 @@
 #include <sys/prctl.h>
 #endif
 #include <signal.h>
+#include <libxml/parser.h>
 #endif
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -151,6 +152,12 @@ int main(int argc, char *argv[], char *argp[])
 
 	Util::InitVersionRevision();
 
+#ifndef WIN32
+	// nzb-files and feeds are parsed in several threads at once,
+	// libxml2 requires its global initialization to be done beforehand
+	xmlInitParser();
+#endif
+
 	if (argc > 1 && (!strcmp(argv[1], "-tests") || !strcmp(argv[1], "--tests")))
 	{
 #ifdef ENABLE_TESTS
@@ -275,6 +282,11 @@ void Run(bool bReload)
 		info("nzbget %s remote-mode", Util::VersionRevision());
 	}
 
+	if (g_pOptions->GetServerMode())
+	{
+		g_pLog->StartWriter();
+	}
+
 	if (!bReload)
 	{
 		Connection::Init();
@@ -368,6 +380,7 @@ void Run(bool bReload)
 		if (g_pOptions->GetSaveQueue() && g_pOptions->GetServerMode())
 		{
 			g_pDiskState = new DiskState();
+			g_pDiskState->StartQueueWriter();
 		}
 
 #ifdef WIN32
@@ -428,6 +441,12 @@ void Run(bool bReload)
 		debug("PrePostProcessor stopped");
 		debug("FeedCoordinator stopped");
 		debug("ArticleCache stopped");
+
+		if (g_pDiskState)
+		{
+			// write queue changes made during shutdown
+			g_pDiskState->StopQueueWriter();
+		}
 	}
 
 	ScriptController::TerminateAll();
@@ -841,6 +860,9 @@ void Cleanup()
 	g_pStatMeter = NULL;
 	debug("StatMeter deleted");
 
+	debug("Stopping LogWriter");
+	g_pLog->StopWriter();
+
 	if (!g_bReloading)
 	{
 		Connection::Final();
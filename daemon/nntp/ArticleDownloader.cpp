@@ -65,6 +65,12 @@ ArticleDownloader::ArticleDownloader()
 	m_eFormat = Decoder::efUnknown;
 	m_szArticleFilename = NULL;
 	m_iDownloadedSize = 0;
+	m_lRequestTicks = 0;
+	m_lFirstByteTicks = 0;
+	m_lLastByteTicks = 0;
+	m_iDecodeUSec = 0;
+	m_iWriteUSec = 0;
+	m_iStreamUSec = 0;
 	m_ArticleWriter.SetOwner(this);
 	SetLastUpdateTimeNow();
 }
@@ -128,6 +134,7 @@ void ArticleDownloader::Run()
 	while (!IsStopped())
 	{
 		Status = adFailed;
+		long long lConnectTicks = Util::CurrentTicks();
 
 		SetStatus(adWaiting);
 		while (!m_pConnection && !(IsStopped() || iServerConfigGeneration != g_pServerPool->GetGeneration()))
@@ -177,6 +184,7 @@ void ArticleDownloader::Run()
 		if (bConnected && !IsStopped())
 		{
 			NewsServer* pNewsServer = m_pConnection->GetNewsServer();
+			int iConnectUSec = (int)(Util::CurrentTicks() - lConnectTicks);
 
 			// Download article
 			Status = Download();
@@ -184,6 +192,12 @@ void ArticleDownloader::Run()
 			if (Status == adFinished || Status == adFailed || Status == adNotFound || Status == adCrcError)
 			{
 				m_ServerStats.StatOp(pNewsServer->GetID(), Status == adFinished ? 1 : 0, Status == adFinished ? 0 : 1, ServerStatList::soSet);
+				g_pStatMeter->AddArticleResult(pNewsServer->GetID(), Status == adFinished);
+			}
+
+			if (Status == adFinished)
+			{
+				AddArticleTiming(pNewsServer->GetID(), iConnectUSec);
 			}
 		}
 
@@ -314,6 +328,11 @@ void ArticleDownloader::Run()
 		detail("Download %s failed", m_szInfoName);
 	}
 
+	if (Status != adRetry && !m_ArticleWriter.GetDuplicate())
+	{
+		m_ArticleWriter.UpdateBlockHashes(Status == adFinished);
+	}
+
 	SetStatus(Status);
 	Notify(NULL);
 
@@ -326,6 +345,12 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 	EStatus Status = adRunning;
 	m_bWritingStarted = false;
 	m_pArticleInfo->SetCrc(0);
+	m_lRequestTicks = Util::CurrentTicks();
+	m_lFirstByteTicks = 0;
+	m_lLastByteTicks = 0;
+	m_iDecodeUSec = 0;
+	m_iWriteUSec = 0;
+	m_iStreamUSec = 0;
 
 	if (m_pConnection->GetNewsServer()->GetJoinGroup())
 	{
@@ -366,6 +391,8 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 		return Status;
 	}
 
+	m_lFirstByteTicks = Util::CurrentTicks();
+
 	if (g_pOptions->GetDecode())
 	{
 		m_YDecoder.Clear();
@@ -467,6 +494,9 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 
 	free(szLineBuf);
 
+	m_lLastByteTicks = Util::CurrentTicks();
+	m_iStreamUSec = m_iDecodeUSec + m_iWriteUSec;
+
 	if (!bEnd && Status == adRunning && !IsStopped())
 	{
 		detail("Article %s @ %s failed: article incomplete", m_szInfoName, m_szConnectionName);
@@ -481,12 +511,16 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 	if (Status == adRunning)
 	{
 		FreeConnection(true);
+		long long lDecodeTicks = Util::CurrentTicks();
 		Status = DecodeCheck();
+		m_iDecodeUSec += (int)(Util::CurrentTicks() - lDecodeTicks);
 	}
 
 	if (m_bWritingStarted)
 	{
+		long long lWriteTicks = Util::CurrentTicks();
 		m_ArticleWriter.Finish(Status == adFinished);
+		m_iWriteUSec += (int)(Util::CurrentTicks() - lWriteTicks);
 	}
 
 	if (Status == adFinished)
@@ -537,6 +571,7 @@ bool ArticleDownloader::Write(char* szLine, int iLen)
 	long long iArticleFileSize = 0;
 	long long iArticleOffset = 0;
 	int iArticleSize = 0;
+	long long lDecodeTicks = Util::CurrentTicks();
 
 	if (g_pOptions->GetDecode())
 	{
@@ -568,6 +603,9 @@ bool ArticleDownloader::Write(char* szLine, int iLen)
 		}
 	}
 
+	long long lWriteTicks = Util::CurrentTicks();
+	m_iDecodeUSec += (int)(lWriteTicks - lDecodeTicks);
+
 	if (!m_bWritingStarted && iLen > 0)
 	{
 		if (!m_ArticleWriter.Start(m_eFormat, szArticleFilename, iArticleFileSize, iArticleOffset, iArticleSize))
@@ -579,6 +617,8 @@ bool ArticleDownloader::Write(char* szLine, int iLen)
 
 	bool bOK = iLen == 0 || m_ArticleWriter.Write(szLine, iLen);
 
+	m_iWriteUSec += (int)(Util::CurrentTicks() - lWriteTicks);
+
 	return bOK;
 }
 
@@ -709,6 +749,24 @@ void ArticleDownloader::FreeConnection(bool bKeepConnected)
 	}
 }
 
+/*
+ * Splits the time spent on the article into phases and passes them to StatMeter.
+ * Decoding and writing are partially performed while the article is being received,
+ * only that part (m_iStreamUSec) is subtracted from the transfer time; the final
+ * decode check and the finishing of the output happen after the last byte.
+ */
+void ArticleDownloader::AddArticleTiming(int iServerID, int iConnectUSec)
+{
+	int iPhaseUSec[ServerTiming::PHASES];
+	iPhaseUSec[ServerTiming::tpConnect] = iConnectUSec;
+	iPhaseUSec[ServerTiming::tpRequest] = (int)(m_lFirstByteTicks - m_lRequestTicks);
+	iPhaseUSec[ServerTiming::tpTransfer] = (int)(m_lLastByteTicks - m_lFirstByteTicks) - m_iStreamUSec;
+	iPhaseUSec[ServerTiming::tpDecode] = m_iDecodeUSec;
+	iPhaseUSec[ServerTiming::tpWrite] = m_iWriteUSec;
+
+	g_pStatMeter->AddArticleTiming(iServerID, iPhaseUSec);
+}
+
 void ArticleDownloader::AddServerData()
 {
 	int iBytesRead = m_pConnection->FetchTotalBytesRead();
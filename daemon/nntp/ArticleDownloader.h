@@ -80,6 +80,12 @@ private:
 	ServerStatList		m_ServerStats;
 	bool				m_bWritingStarted;
 	int					m_iDownloadedSize;
+	long long			m_lRequestTicks;
+	long long			m_lFirstByteTicks;
+	long long			m_lLastByteTicks;
+	int					m_iDecodeUSec;
+	int					m_iWriteUSec;
+	int					m_iStreamUSec;
 
 	EStatus				Download();
 	EStatus				DecodeCheck();
@@ -88,6 +94,7 @@ private:
 	void				SetStatus(EStatus eStatus) { m_eStatus = eStatus; }
 	bool				Write(char* szLine, int iLen);
 	void				AddServerData();
+	void				AddArticleTiming(int iServerID, int iConnectUSec);
 
 public:
 						ArticleDownloader();
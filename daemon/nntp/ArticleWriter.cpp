@@ -46,6 +46,7 @@
 
 #include "nzbget.h"
 #include "ArticleWriter.h"
+#include "BlockHasher.h"
 #include "DiskState.h"
 #include "Options.h"
 #include "Log.h"
@@ -593,6 +594,13 @@ void ArticleWriter::CompleteFileParts()
 		}
 	}
 
+#ifndef DISABLE_PARCHECK
+	if (g_pOptions->GetParBlockHash() && g_pOptions->GetDecode())
+	{
+		CompleteBlockHashes(ofn);
+	}
+#endif
+
 	if (m_pFileInfo->GetMissedArticles() == 0 && m_pFileInfo->GetFailedArticles() == 0)
 	{
 		m_pFileInfo->GetNZBInfo()->PrintMessage(Message::mkInfo, "Successfully downloaded %s", szInfoFilename);
@@ -633,6 +641,7 @@ void ArticleWriter::CompleteFileParts()
 	DownloadQueue::Lock();
 	m_pFileInfo->GetNZBInfo()->GetCompletedFiles()->push_back(new CompletedFile(
 		m_pFileInfo->GetID(), Util::BaseFileName(ofn), eFileStatus, lCrc));
+	m_pFileInfo->GetNZBInfo()->SetChanged(true);
 	if (strcmp(m_pFileInfo->GetNZBInfo()->GetDestDir(), szNZBDestDir))
 	{
 		// destination directory was changed during completion, need to move the file
@@ -641,6 +650,77 @@ void ArticleWriter::CompleteFileParts()
 	DownloadQueue::Unlock();
 }
 
+/*
+ * Passes the completed article to the block hasher of the file. The hasher is created
+ * once the block size of the par-set is known from a completed par2-file.
+ */
+void ArticleWriter::UpdateBlockHashes(bool bSuccess)
+{
+#ifndef DISABLE_PARCHECK
+	if (!g_pOptions->GetParBlockHash() || !g_pOptions->GetDecode() || m_pFileInfo->GetParFile())
+	{
+		return;
+	}
+
+	DownloadQueue::Lock();
+	BlockHasher* pBlockHasher = m_pFileInfo->GetBlockHasher();
+	long long lBlockSize = m_pFileInfo->GetNZBInfo()->GetParBlockSize();
+	// the hasher processes articles in order and can't be started once articles
+	// were completed without it (the counters don't include the current article yet)
+	if (!pBlockHasher && lBlockSize > 0 &&
+		m_pFileInfo->GetSuccessArticles() + m_pFileInfo->GetFailedArticles() == 0)
+	{
+		pBlockHasher = new BlockHasher(m_pFileInfo, lBlockSize);
+		pBlockHasher->SetDirectWrite(g_pOptions->GetDirectWrite());
+		m_pFileInfo->SetBlockHasher(pBlockHasher);
+	}
+	DownloadQueue::Unlock();
+
+	if (pBlockHasher)
+	{
+		pBlockHasher->ArticleCompleted(m_pArticleInfo, bSuccess);
+	}
+#endif
+}
+
+#ifndef DISABLE_PARCHECK
+/*
+ * A completed par2-file provides the block size of the par-set; for other files
+ * the block hashes computed during download are saved for the par-checker.
+ */
+void ArticleWriter::CompleteBlockHashes(const char* szFilename)
+{
+	if (m_pFileInfo->GetParFile())
+	{
+		DownloadQueue::Lock();
+		bool bKnown = m_pFileInfo->GetNZBInfo()->GetParBlockSize() > 0;
+		DownloadQueue::Unlock();
+
+		long long lBlockSize = bKnown ? 0 : BlockHasher::ReadParBlockSize(szFilename);
+		if (lBlockSize > 0)
+		{
+			DownloadQueue::Lock();
+			m_pFileInfo->GetNZBInfo()->SetParBlockSize(lBlockSize);
+			DownloadQueue::Unlock();
+			debug("Par-block size from %s: %lli", szFilename, lBlockSize);
+		}
+		return;
+	}
+
+	BlockHasher* pBlockHasher = m_pFileInfo->GetBlockHasher();
+	if (pBlockHasher && m_pFileInfo->GetSuccessArticles() > 0 &&
+		pBlockHasher->Finish(Util::FileSize(szFilename)) &&
+		g_pOptions->GetSaveQueue() && g_pOptions->GetServerMode())
+	{
+		g_pDiskState->SaveBlockHashes(m_pFileInfo->GetID(), pBlockHasher);
+	}
+
+	DownloadQueue::Lock();
+	m_pFileInfo->SetBlockHasher(NULL);
+	DownloadQueue::Unlock();
+}
+#endif
+
 void ArticleWriter::FlushCache()
 {
 	detail("Flushing cache for %s", m_szInfoName);
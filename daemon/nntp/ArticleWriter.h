@@ -52,6 +52,7 @@ private:
 	void				BuildOutputFilename();
 	bool				IsFileCached();
 	void				SetWriteBuffer(FILE* pOutFile, int iRecSize);
+	void				CompleteBlockHashes(const char* szFilename);
 
 protected:
 	virtual void		SetLastUpdateTimeNow() {}
@@ -67,6 +68,7 @@ public:
 	bool				Write(char* szBufffer, int iLen);
 	void				Finish(bool bSuccess);
 	bool				GetDuplicate() { return m_bDuplicate; }
+	void				UpdateBlockHashes(bool bSuccess);
 	void				CompleteFileParts();
 	static bool			MoveCompletedFiles(NZBInfo* pNZBInfo, const char* szOldDestDir);
 	void				FlushCache();
@@ -0,0 +1,319 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#include "win32.h"
+#endif
+
+#ifndef DISABLE_PARCHECK
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "par2cmdline.h"
+#include "md5.h"
+
+#include "nzbget.h"
+#include "BlockHasher.h"
+#include "ArticleWriter.h"
+#include "Log.h"
+#include "Util.h"
+
+BlockHasher::BlockHasher(FileInfo* pFileInfo, long long lBlockSize)
+{
+	debug("Creating BlockHasher");
+
+	m_pFileInfo = pFileInfo;
+	m_lBlockSize = lBlockSize;
+	m_bDirectWrite = false;
+	m_bBusy = false;
+	m_iArticleIndex = 0;
+	m_bFailed = false;
+	m_lFileSize = 0;
+	m_lBlockFill = 0;
+	m_iBlockCrc = ~0;
+	m_pBlockContext = new MD5Context();
+	m_pFileContext = new MD5Context();
+	memset(m_FileMd5, 0, sizeof(m_FileMd5));
+}
+
+BlockHasher::~BlockHasher()
+{
+	debug("Destroying BlockHasher");
+
+	delete (MD5Context*)m_pBlockContext;
+	delete (MD5Context*)m_pFileContext;
+}
+
+/*
+ * Called by the downloader threads for every completed article (but not for articles
+ * which will be retried). The thread which completes the article at the hashing position
+ * hashes it and all following already completed articles; other threads don't wait.
+ */
+void BlockHasher::ArticleCompleted(ArticleInfo* pArticleInfo, bool bSuccess)
+{
+	m_mutexArticles.Lock();
+	m_CompletedArticles[pArticleInfo] = bSuccess;
+
+	if (m_bBusy)
+	{
+		m_mutexArticles.Unlock();
+		return;
+	}
+
+	m_bBusy = true;
+
+	while (!m_bFailed && m_iArticleIndex < (int)m_pFileInfo->GetArticles()->size())
+	{
+		ArticleInfo* pa = m_pFileInfo->GetArticles()->at(m_iArticleIndex);
+		CompletedArticles::iterator it = m_CompletedArticles.find(pa);
+		if (it == m_CompletedArticles.end())
+		{
+			break;
+		}
+
+		bool bArticleSuccess = it->second;
+		m_CompletedArticles.erase(it);
+		m_mutexArticles.Unlock();
+
+		if (bArticleSuccess)
+		{
+			HashArticle(pa);
+		}
+
+		m_mutexArticles.Lock();
+		m_iArticleIndex++;
+	}
+
+	m_bBusy = false;
+	m_mutexArticles.Unlock();
+}
+
+void BlockHasher::HashArticle(ArticleInfo* pArticleInfo)
+{
+	if (pArticleInfo->GetSegmentOffset() < m_lFileSize)
+	{
+		// segments overlap or don't have offsets (non-yEnc articles)
+		debug("Cannot hash blocks of %s: unexpected segment offset", m_pFileInfo->GetFilename());
+		m_bFailed = true;
+		return;
+	}
+
+	// the range of failed articles is filled with zeros in the output file
+	HashZeros(pArticleInfo->GetSegmentOffset() - m_lFileSize);
+
+	// the cached segment may be flushed to disk at any time unless the flush-lock is held
+	g_pArticleCache->LockFlush();
+
+	if (pArticleInfo->GetSegmentContent())
+	{
+		HashData(pArticleInfo->GetSegmentContent(), pArticleInfo->GetSegmentSize());
+	}
+	else
+	{
+		// in direct write mode only yEnc-articles are written into the output file
+		char szFilename[1024];
+		bool bOutputFile = false;
+		strncpy(szFilename, pArticleInfo->GetResultFilename(), sizeof(szFilename) - 1);
+		if (m_bDirectWrite)
+		{
+			m_pFileInfo->LockOutputFile();
+			bOutputFile = m_pFileInfo->GetOutputFilename() != NULL;
+			if (bOutputFile)
+			{
+				strncpy(szFilename, m_pFileInfo->GetOutputFilename(), sizeof(szFilename) - 1);
+			}
+			m_pFileInfo->UnlockOutputFile();
+		}
+		szFilename[1024-1] = '\0';
+
+		FILE* pFile = fopen(szFilename, FOPEN_RB);
+		if (pFile && bOutputFile)
+		{
+			fseek(pFile, pArticleInfo->GetSegmentOffset(), SEEK_SET);
+		}
+
+		static const int BUFFER_SIZE = 1024 * 64;
+		char* pBuffer = pFile ? (char*)malloc(BUFFER_SIZE) : NULL;
+		int iRemaining = pArticleInfo->GetSegmentSize();
+		while (pFile && iRemaining > 0)
+		{
+			int iLen = (int)fread(pBuffer, 1, iRemaining < BUFFER_SIZE ? iRemaining : BUFFER_SIZE, pFile);
+			if (iLen <= 0)
+			{
+				break;
+			}
+			HashData(pBuffer, iLen);
+			iRemaining -= iLen;
+		}
+
+		if (iRemaining > 0)
+		{
+			debug("Cannot hash blocks of %s: could not read %s", m_pFileInfo->GetFilename(), szFilename);
+			m_bFailed = true;
+		}
+
+		free(pBuffer);
+		if (pFile)
+		{
+			fclose(pFile);
+		}
+	}
+
+	g_pArticleCache->UnlockFlush();
+}
+
+void BlockHasher::HashData(const char* pData, int iSize)
+{
+	((MD5Context*)m_pFileContext)->Update(pData, iSize);
+	m_lFileSize += iSize;
+
+	while (iSize > 0)
+	{
+		int iLen = m_lBlockSize - m_lBlockFill < iSize ? (int)(m_lBlockSize - m_lBlockFill) : iSize;
+		m_iBlockCrc = CRCUpdateBlock(m_iBlockCrc, iLen, pData);
+		((MD5Context*)m_pBlockContext)->Update(pData, iLen);
+		m_lBlockFill += iLen;
+		pData += iLen;
+		iSize -= iLen;
+
+		if (m_lBlockFill == m_lBlockSize)
+		{
+			FinishBlock();
+		}
+	}
+}
+
+void BlockHasher::HashZeros(long long lSize)
+{
+	((MD5Context*)m_pFileContext)->Update((size_t)lSize);
+	m_lFileSize += lSize;
+
+	while (lSize > 0)
+	{
+		long long lLen = m_lBlockSize - m_lBlockFill < lSize ? m_lBlockSize - m_lBlockFill : lSize;
+		m_iBlockCrc = CRCUpdateBlock(m_iBlockCrc, (size_t)lLen);
+		((MD5Context*)m_pBlockContext)->Update((size_t)lLen);
+		m_lBlockFill += lLen;
+		lSize -= lLen;
+
+		if (m_lBlockFill == m_lBlockSize)
+		{
+			FinishBlock();
+		}
+	}
+}
+
+void BlockHasher::FinishBlock()
+{
+	MD5Context* pContext = (MD5Context*)m_pBlockContext;
+
+	// the last block of a file is padded with zeros to the block size
+	if (m_lBlockFill < m_lBlockSize)
+	{
+		m_iBlockCrc = CRCUpdateBlock(m_iBlockCrc, (size_t)(m_lBlockSize - m_lBlockFill));
+		pContext->Update((size_t)(m_lBlockSize - m_lBlockFill));
+	}
+
+	BlockHash blockHash;
+	blockHash.iCrc = ~0 ^ m_iBlockCrc;
+	MD5Hash hash;
+	pContext->Final(hash);
+	memcpy(blockHash.Md5, hash.hash, sizeof(blockHash.Md5));
+	m_BlockHashes.push_back(blockHash);
+
+	pContext->Reset();
+	m_iBlockCrc = ~0;
+	m_lBlockFill = 0;
+}
+
+/*
+ * Called after all articles are completed and the output file is closed. Failed articles
+ * at the end of the file are hashed as zeros up to the size of the output file.
+ */
+bool BlockHasher::Finish(long long lFileSize)
+{
+	if (m_bFailed || m_iArticleIndex < (int)m_pFileInfo->GetArticles()->size() || lFileSize < m_lFileSize)
+	{
+		return false;
+	}
+
+	HashZeros(lFileSize - m_lFileSize);
+
+	if (m_lBlockFill > 0)
+	{
+		FinishBlock();
+	}
+
+	MD5Hash hash;
+	((MD5Context*)m_pFileContext)->Final(hash);
+	memcpy(m_FileMd5, hash.hash, sizeof(m_FileMd5));
+
+	return true;
+}
+
+/*
+ * Finds the main packet in a par2-file and returns the block size of the par-set,
+ * or 0 if the file has no main packet. Only the packet headers are read.
+ */
+long long BlockHasher::ReadParBlockSize(const char* szParFilename)
+{
+	FILE* pFile = fopen(szParFilename, FOPEN_RB);
+	if (!pFile)
+	{
+		return 0;
+	}
+
+	long long lBlockSize = 0;
+	long long lOffset = 0;
+	MAINPACKET packet;
+	while (fseek(pFile, lOffset, SEEK_SET) == 0 &&
+		fread(&packet, 1, sizeof(packet), pFile) == sizeof(packet) &&
+		packet.header.magic == packet_magic &&
+		packet.header.length >= sizeof(PACKET_HEADER) && packet.header.length % 4 == 0)
+	{
+		if (packet.header.type == mainpacket_type)
+		{
+			lBlockSize = packet.blocksize;
+			break;
+		}
+		lOffset += packet.header.length;
+	}
+
+	fclose(pFile);
+
+	return lBlockSize;
+}
+
+#endif
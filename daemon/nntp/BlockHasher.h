@@ -0,0 +1,98 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+
+#ifndef BLOCKHASHER_H
+#define BLOCKHASHER_H
+
+#ifndef DISABLE_PARCHECK
+
+#include <vector>
+#include <map>
+
+#include "DownloadInfo.h"
+#include "Thread.h"
+
+/*
+ * Computes CRC32 and MD5 of par-blocks of a file while its articles are written,
+ * so that the par-checker doesn't need to read the file from disk again.
+ * The data is hashed in the order of file offsets; an article completed out of order
+ * is hashed once all preceding articles are completed. Its data is then taken from
+ * the article cache or read back from disk. Failed articles are hashed as zeros,
+ * exactly as they are written into the output file.
+ */
+class BlockHasher
+{
+public:
+	struct BlockHash
+	{
+		unsigned int		iCrc;
+		unsigned char		Md5[16];
+	};
+
+	typedef std::vector<BlockHash>	BlockHashes;
+
+private:
+	typedef std::map<ArticleInfo*, bool>	CompletedArticles;
+
+	FileInfo*			m_pFileInfo;
+	long long			m_lBlockSize;
+	bool				m_bDirectWrite;
+	Mutex				m_mutexArticles;
+	CompletedArticles	m_CompletedArticles;
+	bool				m_bBusy;
+	int					m_iArticleIndex;
+	bool				m_bFailed;
+	long long			m_lFileSize;
+	long long			m_lBlockFill;
+	unsigned int		m_iBlockCrc;
+	// declared as void* to prevent the including of libpar2-headers into this header-file
+	void*				m_pBlockContext;
+	void*				m_pFileContext;
+	BlockHashes			m_BlockHashes;
+	unsigned char		m_FileMd5[16];
+
+	void				HashArticle(ArticleInfo* pArticleInfo);
+	void				HashData(const char* pData, int iSize);
+	void				HashZeros(long long lSize);
+	void				FinishBlock();
+
+public:
+						BlockHasher(FileInfo* pFileInfo, long long lBlockSize);
+						~BlockHasher();
+	void				SetDirectWrite(bool bDirectWrite) { m_bDirectWrite = bDirectWrite; }
+	void				ArticleCompleted(ArticleInfo* pArticleInfo, bool bSuccess);
+	bool				Finish(long long lFileSize);
+	long long			GetBlockSize() { return m_lBlockSize; }
+	long long			GetFileSize() { return m_lFileSize; }
+	void				SetFileSize(long long lFileSize) { m_lFileSize = lFileSize; }
+	BlockHashes*		GetBlockHashes() { return &m_BlockHashes; }
+	unsigned char*		GetFileMd5() { return m_FileMd5; }
+	static long long	ReadParBlockSize(const char* szParFilename);
+};
+
+#endif
+
+#endif
@@ -206,6 +206,120 @@ void ServerVolume::LogDebugInfo()
 	info("Days: %s", msg.GetBuffer());
 }
 
+const int TimeHistogram::m_iBucketLimits[TimeHistogram::BUCKETS - 1] =
+	{ 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000 };
+
+TimeHistogram::TimeHistogram()
+{
+	Reset();
+}
+
+void TimeHistogram::Reset()
+{
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		m_iBuckets[i] = 0;
+	}
+	m_iCount = 0;
+	m_lTotalUSec = 0;
+	m_iMaxUSec = 0;
+}
+
+void TimeHistogram::AddValue(int iUSec)
+{
+	if (iUSec < 0)
+	{
+		// system clock was changed
+		return;
+	}
+
+	int iBucket = 0;
+	while (iBucket < BUCKETS - 1 && iUSec >= m_iBucketLimits[iBucket] * 1000)
+	{
+		iBucket++;
+	}
+
+	m_iBuckets[iBucket]++;
+	m_iCount++;
+	m_lTotalUSec += iUSec;
+	if (iUSec > m_iMaxUSec)
+	{
+		m_iMaxUSec = iUSec;
+	}
+}
+
+ServerTiming::ServerTiming()
+{
+	m_lSuccessArticles = 0;
+	m_lFailedArticles = 0;
+}
+
+void ServerTiming::AddTiming(int* pPhaseUSec)
+{
+	for (int i = 0; i < PHASES; i++)
+	{
+		m_Histograms[i].AddValue(pPhaseUSec[i]);
+	}
+}
+
+void ServerTiming::AddResult(bool bSuccess)
+{
+	if (bSuccess)
+	{
+		m_lSuccessArticles++;
+	}
+	else
+	{
+		m_lFailedArticles++;
+	}
+}
+
+void ServerTiming::Reset()
+{
+	for (int i = 0; i < PHASES; i++)
+	{
+		m_Histograms[i].Reset();
+	}
+	m_lSuccessArticles = 0;
+	m_lFailedArticles = 0;
+}
+
+const char* ServerTiming::GetPhaseName(EPhase ePhase)
+{
+	const char* szPhaseNames[] = { "Connect", "Request", "Transfer", "Decode", "Write" };
+	return szPhaseNames[ePhase];
+}
+
+void ServerTiming::LogDebugInfo()
+{
+	info("   ---------- ServerTiming");
+	info("      Articles: success=%lli, failed=%lli", m_lSuccessArticles, m_lFailedArticles);
+
+	for (int i = 0; i < PHASES; i++)
+	{
+		TimeHistogram* pHistogram = &m_Histograms[i];
+
+		StringBuilder msg;
+		for (int j = 0; j < TimeHistogram::BUCKETS; j++)
+		{
+			char szNum[30];
+			if (j < TimeHistogram::BUCKETS - 1)
+			{
+				snprintf(szNum, 30, "[<%ims]=%i ", TimeHistogram::GetBucketLimit(j), pHistogram->GetBucket(j));
+			}
+			else
+			{
+				snprintf(szNum, 30, "[>=%ims]=%i", TimeHistogram::GetBucketLimit(j - 1), pHistogram->GetBucket(j));
+			}
+			msg.Append(szNum);
+		}
+
+		info("%s: Count=%i, AvgUSec=%i, MaxUSec=%i, %s", GetPhaseName((EPhase)i), pHistogram->GetCount(),
+			pHistogram->GetCount() > 0 ? (int)(pHistogram->GetTotalUSec() / pHistogram->GetCount()) : 0,
+			pHistogram->GetMaxUSec(), msg.GetBuffer());
+	}
+}
+
 StatMeter::StatMeter()
 {
 	debug("Creating StatMeter");
@@ -236,6 +350,11 @@ StatMeter::~StatMeter()
 		delete *it;
 	}
 
+	for (ServerTimings::iterator it = m_ServerTimings.begin(); it != m_ServerTimings.end(); it++)
+	{
+		delete *it;
+	}
+
 	debug("StatMeter destroyed");
 }
 
@@ -252,6 +371,12 @@ void StatMeter::Init()
 		NewsServer* pServer = *it;
 		m_ServerVolumes[pServer->GetID()] = new ServerVolume();
 	}
+
+	m_ServerTimings.resize(1 + g_pServerPool->GetServers()->size());
+	for (ServerTimings::iterator it = m_ServerTimings.begin(); it != m_ServerTimings.end(); it++)
+	{
+		*it = new ServerTiming();
+	}
 }
 
 void StatMeter::AdjustTimeOffset()
@@ -491,6 +616,16 @@ void StatMeter::LogDebugInfo()
 		pServerVolume->LogDebugInfo();
 	}
 	m_mutexVolume.Unlock();
+
+	m_mutexTiming.Lock();
+	index = 0;
+	for (ServerTimings::iterator it = m_ServerTimings.begin(); it != m_ServerTimings.end(); it++, index++)
+	{
+		ServerTiming* pServerTiming = *it;
+		info("      ServerTiming %i", index);
+		pServerTiming->LogDebugInfo();
+	}
+	m_mutexTiming.Unlock();
 }
 
 void StatMeter::AddServerData(int iBytes, int iServerID)
@@ -526,6 +661,33 @@ void StatMeter::UnlockServerVolumes()
 	m_mutexVolume.Unlock();
 }
 
+void StatMeter::AddArticleTiming(int iServerID, int* pPhaseUSec)
+{
+	m_mutexTiming.Lock();
+	m_ServerTimings[0]->AddTiming(pPhaseUSec);
+	m_ServerTimings[iServerID]->AddTiming(pPhaseUSec);
+	m_mutexTiming.Unlock();
+}
+
+void StatMeter::AddArticleResult(int iServerID, bool bSuccess)
+{
+	m_mutexTiming.Lock();
+	m_ServerTimings[0]->AddResult(bSuccess);
+	m_ServerTimings[iServerID]->AddResult(bSuccess);
+	m_mutexTiming.Unlock();
+}
+
+ServerTimings* StatMeter::LockServerTimings()
+{
+	m_mutexTiming.Lock();
+	return &m_ServerTimings;
+}
+
+void StatMeter::UnlockServerTimings()
+{
+	m_mutexTiming.Unlock();
+}
+
 void StatMeter::Save()
 {
 	if (!g_pOptions->GetServerMode())
@@ -81,6 +81,62 @@ public:
 
 typedef std::vector<ServerVolume*>	ServerVolumes;
 
+class TimeHistogram
+{
+public:
+	static const int	BUCKETS = 14;
+
+private:
+	static const int	m_iBucketLimits[BUCKETS - 1];	// in milliseconds
+	int					m_iBuckets[BUCKETS];
+	int					m_iCount;
+	long long			m_lTotalUSec;
+	int					m_iMaxUSec;
+
+public:
+						TimeHistogram();
+	void				AddValue(int iUSec);
+	void				Reset();
+	int					GetCount() { return m_iCount; }
+	long long			GetTotalUSec() { return m_lTotalUSec; }
+	int					GetMaxUSec() { return m_iMaxUSec; }
+	int					GetBucket(int iIndex) { return m_iBuckets[iIndex]; }
+	static int			GetBucketLimit(int iIndex) { return iIndex < BUCKETS - 1 ? m_iBucketLimits[iIndex] : -1; }
+};
+
+class ServerTiming
+{
+public:
+	enum EPhase
+	{
+		tpConnect,		// waiting for a free connection and connecting
+		tpRequest,		// from sending of request until the response line is received
+		tpTransfer,		// receiving of article body, excluding time spent in decoder and writer
+		tpDecode,		// decoding and crc check
+		tpWrite			// writing into cache or output file
+	};
+
+	static const int	PHASES = 5;
+
+private:
+	TimeHistogram		m_Histograms[PHASES];
+	long long			m_lSuccessArticles;
+	long long			m_lFailedArticles;
+
+public:
+						ServerTiming();
+	TimeHistogram*		GetHistogram(EPhase ePhase) { return &m_Histograms[ePhase]; }
+	long long			GetSuccessArticles() { return m_lSuccessArticles; }
+	long long			GetFailedArticles() { return m_lFailedArticles; }
+	void				AddTiming(int* pPhaseUSec);
+	void				AddResult(bool bSuccess);
+	void				Reset();
+	static const char*	GetPhaseName(EPhase ePhase);
+	void				LogDebugInfo();
+};
+
+typedef std::vector<ServerTiming*>	ServerTimings;
+
 class StatMeter : public Debuggable
 {
 private:
@@ -116,6 +172,10 @@ private:
 	ServerVolumes		m_ServerVolumes;
 	Mutex				m_mutexVolume;
 
+	// article timings
+	ServerTimings		m_ServerTimings;
+	Mutex				m_mutexTiming;
+
 	void				ResetSpeedStat();
 	void				AdjustTimeOffset();
 
@@ -136,6 +196,10 @@ public:
 	void				EnterLeaveStandBy(bool bEnter);
 	ServerVolumes*		LockServerVolumes();
 	void				UnlockServerVolumes();
+	void				AddArticleTiming(int iServerID, int* pPhaseUSec);
+	void				AddArticleResult(int iServerID, bool bSuccess);
+	ServerTimings*		LockServerTimings();
+	void				UnlockServerTimings();
 	void				Save();
 	bool				Load(bool* pPerfectServerMatch);
 };
@@ -29,7 +29,6 @@
 
 #ifdef WIN32
 #include "win32.h"
-#include "Mmsystem.h"
 #endif
 
 #ifndef DISABLE_PARCHECK
@@ -42,6 +41,7 @@
 #include <unistd.h>
 #endif
 #include <vector>
+#include <map>
 #include <algorithm>
 
 #include "par2cmdline.h"
@@ -51,6 +51,7 @@
 #include "Thread.h"
 #include "ParChecker.h"
 #include "ParParser.h"
+#include "BlockHasher.h"
 #include "Log.h"
 #include "Options.h"
 #include "Util.h"
@@ -65,25 +66,27 @@ const char* Par2CmdLineErrStr[] = { "OK",
 	"internal error occurred",
 	"out of memory" };
 
-// Sleep interval for synchronisation (microseconds)
-#ifdef WIN32
-// Windows doesn't allow sleep intervals less than one millisecond
-#define SYNC_SLEEP_INTERVAL 1000
-#else
-#define SYNC_SLEEP_INTERVAL 100
-#endif
+// The repair is split into tiles of this size of an output block; a tile
+// stays in the CPU cache while all input blocks of a batch are added to it
+#define REPAIR_TILE_SIZE (64 * 1024)
+// Number of input blocks read into memory before they are processed
+#define REPAIR_INPUT_BATCH 16
 
-class RepairThread;
-
-class Repairer : public Par2Repairer
+class Repairer : public Par2Repairer, public ParallelJob
 {
 private:
-	typedef vector<Thread*> Threads;
+	typedef std::map<DiskFile*, int> ScanProgress;
 
 	CommandLine		commandLine;
 	ParChecker*		m_pOwner;
-	Threads			m_Threads;
-	bool			m_bParallel;
+	WorkerPool*		m_pWorkerPool;
+	u32				m_iBatchInput;
+	u32				m_iBatchInputCount;
+	size_t			m_iBatchLength;
+	int				m_iBatchTiles;
+	Mutex			m_mutexVerify;
+	Mutex			m_mutexSignal;
+	ScanProgress	m_ScanProgress;
 
 #ifdef HAVE_SPINLOCK
 	SpinLock		progresslock;
@@ -91,44 +94,43 @@ private:
 	Mutex			progresslock;
 #endif
 
+	int				GetMaxThreads();
 	virtual void	BeginRepair();
 	virtual void	EndRepair();
-	void			RepairBlock(u32 inputindex, u32 outputindex, size_t blocklength);
 
 protected:
-	virtual void	sig_filename(std::string filename) { m_pOwner->signal_filename(filename); }
-	virtual void	sig_progress(int progress) { m_pOwner->signal_progress(progress); }
-	virtual void	sig_done(std::string filename, int available, int total) { m_pOwner->signal_done(filename, available, total); }
+	virtual void	sig_filename(std::string filename);
+	virtual void	sig_progress(int progress);
+	virtual void	sig_scanprogress(DiskFile *diskfile, int progress);
+	virtual void	sig_done(std::string filename, int available, int total);
 
 	virtual bool	ScanDataFile(DiskFile *diskfile, Par2RepairerSourceFile* &sourcefile,
 		MatchType &matchtype, MD5Hash &hashfull, MD5Hash &hash16k, u32 &count);
-	virtual bool	RepairData(u32 inputindex, size_t blocklength);
+	virtual void	VerifyDataFiles(vector<Par2RepairerVerifyJob> &jobs);
+	virtual void	LockVerification() { m_mutexVerify.Lock(); }
+	virtual void	UnlockVerification() { m_mutexVerify.Unlock(); }
+	virtual bool	RepairData(u32 inputindex, u32 inputcount, size_t blocklength);
+	virtual void	ProcessItem(int iItem);
 
 public:
-					Repairer(ParChecker* pOwner) { m_pOwner = pOwner; }
+					Repairer(ParChecker* pOwner) { m_pOwner = pOwner; m_pWorkerPool = NULL; }
 	Result			PreProcess(const char *szParFilename);
 	Result			Process(bool dorepair);
 
 	friend class ParChecker;
-	friend class RepairThread;
+	friend class VerifyFilesJob;
 };
 
-class RepairThread : public Thread
+class VerifyFilesJob : public ParallelJob
 {
 private:
 	Repairer*		m_pOwner;
-	u32				m_inputindex;
-	u32				m_outputindex;
-	size_t			m_blocklength;
-	volatile bool	m_bWorking;
-
-protected:
-	virtual void	Run();
+	vector<Par2RepairerVerifyJob>&	m_Jobs;
 
 public:
-					RepairThread(Repairer* pOwner) { this->m_pOwner = pOwner; m_bWorking = false; }
-	void			RepairBlock(u32 inputindex, u32 outputindex, size_t blocklength);
-	bool			IsWorking() { return m_bWorking; }
+					VerifyFilesJob(Repairer* pOwner, vector<Par2RepairerVerifyJob>& jobs) :
+						m_pOwner(pOwner), m_Jobs(jobs) {}
+	virtual void	ProcessItem(int iItem) { m_pOwner->VerifyDataFileJob(m_Jobs[iItem]); }
 };
 
 Result Repairer::PreProcess(const char *szParFilename)
@@ -164,6 +166,8 @@ Result Repairer::PreProcess(const char *szParFilename)
 		}
 	}
 
+	inputbatchsize = REPAIR_INPUT_BATCH;
+
 	return Par2Repairer::PreProcess(commandLine);
 }
 
@@ -176,7 +180,8 @@ Result Repairer::Process(bool dorepair)
 bool Repairer::ScanDataFile(DiskFile *diskfile, Par2RepairerSourceFile* &sourcefile,
 	MatchType &matchtype, MD5Hash &hashfull, MD5Hash &hash16k, u32 &count)
 {
-	if (m_pOwner->GetParQuick() && sourcefile)
+	if ((m_pOwner->GetParQuick() ||
+		(m_pOwner->GetParBlockHash() && m_pOwner->GetStage() == ParChecker::ptVerifyingSources)) && sourcefile)
 	{
 		string path;
 		string name;
@@ -191,7 +196,7 @@ bool Repairer::ScanDataFile(DiskFile *diskfile, Par2RepairerSourceFile* &sourcef
 			if (eFileStatus != ParChecker::fsUnknown)
 			{
 				sig_done(name, iAvailableBlocks, sourcefile->BlockCount());
-				sig_progress(1000.0);
+				sig_scanprogress(diskfile, 1000);
 				matchtype = eFileStatus == ParChecker::fsSuccess ? eFullMatch :
 					eFileStatus == ParChecker::fsPartial ? ePartialMatch : eNoMatch;
 				m_pOwner->SetParFull(false);
@@ -203,117 +208,141 @@ bool Repairer::ScanDataFile(DiskFile *diskfile, Par2RepairerSourceFile* &sourcef
 	return Par2Repairer::ScanDataFile(diskfile, sourcefile, matchtype, hashfull, hash16k, count);
 }
 
-void Repairer::BeginRepair()
+void Repairer::VerifyDataFiles(vector<Par2RepairerVerifyJob> &jobs)
 {
-	int iMaxThreads = g_pOptions->GetParThreads() > 0 ? g_pOptions->GetParThreads() : Util::NumberOfCpuCores();
-	iMaxThreads = iMaxThreads > 0 ? iMaxThreads : 1;
+	int iMaxThreads = GetMaxThreads();
+	int iThreads = iMaxThreads > (int)jobs.size() ? (int)jobs.size() : iMaxThreads;
 
-	int iThreads = iMaxThreads > (int)missingblockcount ? (int)missingblockcount : iMaxThreads;
+	if (iThreads > 1)
+	{
+		m_pOwner->PrintMessage(Message::mkInfo, "Using %i of max %i thread(s) to verify %i file(s) for %s",
+			iThreads, iMaxThreads, (int)jobs.size(), m_pOwner->m_szNZBName);
+	}
 
-	m_pOwner->PrintMessage(Message::mkInfo, "Using %i of max %i thread(s) to repair %i block(s) for %s",
-		iThreads, iMaxThreads, (int)missingblockcount, m_pOwner->m_szNZBName);
+	// the calling thread verifies files too
+	WorkerPool workerPool(iThreads - 1);
+	VerifyFilesJob verifyJob(this, jobs);
+	workerPool.Execute(&verifyJob, (int)jobs.size());
+}
 
-	m_bParallel = iThreads > 1;
+/*
+ * The signals can come from several threads verifying files or repairing data.
+ * The progress of the files being verified is merged into one stage progress.
+ */
+void Repairer::sig_filename(std::string filename)
+{
+	m_mutexSignal.Lock();
+	m_pOwner->signal_filename(filename);
+	m_mutexSignal.Unlock();
+}
 
-	if (m_bParallel)
+void Repairer::sig_progress(int progress)
+{
+	m_mutexSignal.Lock();
+	m_pOwner->signal_progress(progress);
+	m_mutexSignal.Unlock();
+}
+
+void Repairer::sig_scanprogress(DiskFile *diskfile, int progress)
+{
+	m_mutexSignal.Lock();
+
+	if (progress < 1000)
 	{
-		for (int i = 0; i < iThreads; i++)
-		{
-			RepairThread* pRepairThread = new RepairThread(this);
-			m_Threads.push_back(pRepairThread);
-			pRepairThread->SetAutoDestroy(true);
-			pRepairThread->Start();
-		}
+		m_ScanProgress[diskfile] = progress;
+	}
+	else
+	{
+		m_ScanProgress.erase(diskfile);
+	}
 
-#ifdef WIN32
-		timeBeginPeriod(1);
-#endif
+	int iActiveProgress = 0;
+	for (ScanProgress::iterator it = m_ScanProgress.begin(); it != m_ScanProgress.end(); it++)
+	{
+		iActiveProgress += it->second;
 	}
+
+	int iFileProgress = m_ScanProgress.empty() ? progress : iActiveProgress / (int)m_ScanProgress.size();
+	m_pOwner->signal_progress(iFileProgress, iActiveProgress);
+
+	m_mutexSignal.Unlock();
 }
 
-void Repairer::EndRepair()
+void Repairer::sig_done(std::string filename, int available, int total)
 {
-	if (m_bParallel)
-	{
-		for (Threads::iterator it = m_Threads.begin(); it != m_Threads.end(); it++)
-		{
-			RepairThread* pRepairThread = (RepairThread*)*it;
-			pRepairThread->Stop();
-		}
+	m_mutexSignal.Lock();
+	m_pOwner->signal_done(filename, available, total);
+	m_mutexSignal.Unlock();
+}
 
-#ifdef WIN32
-		timeEndPeriod(1);
-#endif
-	}
+int Repairer::GetMaxThreads()
+{
+	int iMaxThreads = g_pOptions->GetParThreads() > 0 ? g_pOptions->GetParThreads() : Util::NumberOfCpuCores();
+	return iMaxThreads > 0 ? iMaxThreads : 1;
 }
 
-bool Repairer::RepairData(u32 inputindex, size_t blocklength)
+void Repairer::BeginRepair()
 {
-	if (!m_bParallel)
-	{
-		return false;
-	}
+	int iMaxThreads = GetMaxThreads();
 
-	for (u32 outputindex = 0; outputindex < missingblockcount; )
-	{
-		bool bJobAdded = false;
-		for (Threads::iterator it = m_Threads.begin(); it != m_Threads.end(); it++)
-		{
-			RepairThread* pRepairThread = (RepairThread*)*it;
-			if (!pRepairThread->IsWorking())
-			{
-				pRepairThread->RepairBlock(inputindex, outputindex, blocklength);
-				outputindex++;
-				bJobAdded = true;
-				break;
-			}
-		}
+	int iTiles = (int)missingblockcount * (int)((chunksize + REPAIR_TILE_SIZE - 1) / REPAIR_TILE_SIZE);
+	int iThreads = iMaxThreads > iTiles ? iTiles : iMaxThreads;
 
-		if (cancelled)
-		{
-			break;
-		}
+	m_pOwner->PrintMessage(Message::mkInfo, "Using %i of max %i thread(s) to repair %i block(s) for %s",
+		iThreads, iMaxThreads, (int)missingblockcount, m_pOwner->m_szNZBName);
 
-		if (!bJobAdded)
-		{
-			usleep(SYNC_SLEEP_INTERVAL);
-		}
-	}
+	// the calling thread works on the tiles too
+	m_pWorkerPool = new WorkerPool(iThreads - 1);
+}
 
-	// Wait until all m_Threads complete their jobs
-	bool bWorking = true;
-	while (bWorking)
-	{
-		bWorking = false;
-		for (Threads::iterator it = m_Threads.begin(); it != m_Threads.end(); it++)
-		{
-			RepairThread* pRepairThread = (RepairThread*)*it;
-			if (pRepairThread->IsWorking())
-			{
-				bWorking = true;
-				usleep(SYNC_SLEEP_INTERVAL);
-				break;
-			}
-		}
-	}
+void Repairer::EndRepair()
+{
+	delete m_pWorkerPool;
+	m_pWorkerPool = NULL;
+}
+
+bool Repairer::RepairData(u32 inputindex, u32 inputcount, size_t blocklength)
+{
+	m_iBatchInput = inputindex;
+	m_iBatchInputCount = inputcount;
+	m_iBatchLength = blocklength;
+
+	// consecutive items belong to the same region of the blocks, the threads
+	// working on them at the same time share the input data in the cache
+	int iSlices = (int)((blocklength + REPAIR_TILE_SIZE - 1) / REPAIR_TILE_SIZE);
+	m_iBatchTiles = iSlices * (int)missingblockcount;
+
+	m_pWorkerPool->Execute(this, m_iBatchTiles);
 
 	return true;
 }
 
-void Repairer::RepairBlock(u32 inputindex, u32 outputindex, size_t blocklength)
+void Repairer::ProcessItem(int iItem)
 {
+	if (cancelled)
+	{
+		return;
+	}
+
+	u32 outputindex = (u32)iItem % missingblockcount;
+	size_t offset = (size_t)(iItem / missingblockcount) * REPAIR_TILE_SIZE;
+	size_t length = m_iBatchLength - offset < REPAIR_TILE_SIZE ? m_iBatchLength - offset : REPAIR_TILE_SIZE;
+
 	// Select the appropriate part of the output buffer
-	void *outbuf = &((u8*)outputbuffer)[chunksize * outputindex];
+	void *outbuf = &((u8*)outputbuffer)[chunksize * outputindex + offset];
 
-	// Process the data
-	rs.Process(blocklength, inputindex, inputbuffer, outputindex, outbuf);
+	for (u32 i = 0; i < m_iBatchInputCount; i++)
+	{
+		void *inbuf = &((u8*)inputbuffer)[chunksize * i + offset];
+		rs.Process(length, m_iBatchInput + i, inbuf, outputindex, outbuf);
+	}
 
 	if (noiselevel > CommandLine::nlQuiet)
 	{
 		// Update a progress indicator
 		progresslock.Lock();
 		u32 oldfraction = (u32)(1000 * progress / totaldata);
-		progress += blocklength;
+		progress += length * m_iBatchInputCount;
 		u32 newfraction = (u32)(1000 * progress / totaldata);
 		progresslock.Unlock();
 
@@ -324,30 +353,6 @@ void Repairer::RepairBlock(u32 inputindex, u32 outputindex, size_t blocklength)
 	}
 }
 
-void RepairThread::Run()
-{
-	while (!IsStopped())
-	{
-		if (m_bWorking)
-		{
-			m_pOwner->RepairBlock(m_inputindex, m_outputindex, m_blocklength);
-			m_bWorking = false;
-		}
-		else
-		{
-			usleep(SYNC_SLEEP_INTERVAL);
-		}
-	}
-}
-
-void RepairThread::RepairBlock(u32 inputindex, u32 outputindex, size_t blocklength)
-{
-	m_inputindex = inputindex;
-	m_outputindex = outputindex;
-	m_blocklength = blocklength;
-	m_bWorking = true;
-}
-
 
 class MissingFilesComparator
 {
@@ -416,6 +421,7 @@ ParChecker::ParChecker()
 	m_bCancelled = false;
 	m_eStage = ptLoadingPars;
 	m_bParQuick = false;
+	m_bParBlockHash = false;
 	m_bForceRepair = false;
 	m_bParFull = false;
 }
@@ -481,6 +487,7 @@ void ParChecker::Run()
 	{
 		PrintMessage(Message::mkInfo, "Performing full par-check for %s", m_szNZBName);
 		m_bParQuick = false;
+		m_bParBlockHash = false;
 		m_eStatus = RunParCheckAll();
 	}
 
@@ -1108,6 +1115,15 @@ void ParChecker::signal_filename(std::string str)
 }
 
 void ParChecker::signal_progress(int progress)
+{
+	signal_progress(progress, progress < 1000 ? progress : 0);
+}
+
+/*
+ * iActiveProgress is the sum of the progress of all files being verified,
+ * which may be more than one file at a time.
+ */
+void ParChecker::signal_progress(int progress, int iActiveProgress)
 {
 	m_iFileProgress = (int)progress;
 
@@ -1134,14 +1150,7 @@ void ParChecker::signal_progress(int progress)
 
 		if (iTotalFiles > 0)
 		{
-			if (m_iFileProgress < 1000)
-			{
-				m_iStageProgress = (m_iProcessedFiles * 1000 + m_iFileProgress) / iTotalFiles;
-			}
-			else
-			{
-				m_iStageProgress = m_iProcessedFiles * 1000 / iTotalFiles;
-			}
+			m_iStageProgress = (m_iProcessedFiles * 1000 + iActiveProgress) / iTotalFiles;
 		}
 		else
 		{
@@ -1338,6 +1347,8 @@ void ParChecker::DeleteLeftovers()
  * - for partially downloaded files the CRCs of articles are compared with block-CRCs stored
  *   in PAR2-file;
  * - for completely failed files (not a single successful article) no verification is needed at all.
+ * If block hashes were computed during download (option ParBlockHash) they are compared with
+ * block checksums stored in PAR2-file instead, even if the quick verification is disabled.
  *
  * Limitation of the function:
  * This function requires every block in the file to have an unique CRC (across all blocks
@@ -1377,27 +1388,40 @@ ParChecker::EFileStatus ParChecker::VerifyDataFile(void* pDiskfile, void* pSourc
 		return fsFailure;
 	}
 
-	// find file status and CRC computed during download
-	unsigned long lDownloadCrc;
-	SegmentList segments;
-	EFileStatus	eFileStatus = FindFileCrc(Util::BaseFileName(szFilename), &lDownloadCrc, &segments);
+	// compare with block hashes computed during download, if available
 	ValidBlocks validBlocks;
+	EFileStatus eFileStatus = VerifyHashedDataFile(pSourcefile, &validBlocks);
 
-	if (eFileStatus == fsFailure || eFileStatus == fsUnknown)
-	{
-		return eFileStatus;
-	}
-	else if ((eFileStatus == fsSuccess && !VerifySuccessDataFile(pDiskfile, pSourcefile, lDownloadCrc)) ||
-		(eFileStatus == fsPartial && !VerifyPartialDataFile(pDiskfile, pSourcefile, &segments, &validBlocks)))
+	if (eFileStatus == fsUnknown)
 	{
-		PrintMessage(Message::mkWarning, "Quick verification failed for %s file %s, performing full verification instead",
-			eFileStatus == fsSuccess ? "good" : "damaged", Util::BaseFileName(szFilename));
-		return fsUnknown; // let libpar2 do the full verification of the file
+		if (!m_bParQuick)
+		{
+			return fsUnknown;
+		}
+
+		// find file status and CRC computed during download
+		unsigned long lDownloadCrc;
+		SegmentList segments;
+		eFileStatus = FindFileCrc(Util::BaseFileName(szFilename), &lDownloadCrc, &segments);
+
+		if (eFileStatus == fsFailure || eFileStatus == fsUnknown)
+		{
+			return eFileStatus;
+		}
+		else if ((eFileStatus == fsSuccess && !VerifySuccessDataFile(pDiskfile, pSourcefile, lDownloadCrc)) ||
+			(eFileStatus == fsPartial && !VerifyPartialDataFile(pDiskfile, pSourcefile, &segments, &validBlocks)))
+		{
+			PrintMessage(Message::mkWarning, "Quick verification failed for %s file %s, performing full verification instead",
+				eFileStatus == fsSuccess ? "good" : "damaged", Util::BaseFileName(szFilename));
+			return fsUnknown; // let libpar2 do the full verification of the file
+		}
 	}
 
-	// attach verification blocks to the file
+	// attach verification blocks to the file; other files may be verified at the same time
+	Repairer* pRepairer = (Repairer*)m_pRepairer;
+	pRepairer->LockVerification();
 	*pAvailableBlocks = 0;
-	u64 blocksize = ((Repairer*)m_pRepairer)->mainpacket->BlockSize();
+	u64 blocksize = pRepairer->mainpacket->BlockSize();
 	std::deque<const VerificationHashEntry*> undoList;
 	for (unsigned int i = 0; i < packet->BlockCount(); i++)
 	{
@@ -1407,7 +1431,7 @@ ParChecker::EFileStatus ParChecker::VerifyDataFile(void* pDiskfile, void* pSourc
 			u32 blockCrc = entry->crc;
 
 			// Look for a match
-			const VerificationHashEntry* pHashEntry = ((Repairer*)m_pRepairer)->verificationhashtable.Lookup(blockCrc);
+			const VerificationHashEntry* pHashEntry = pRepairer->verificationhashtable.Lookup(blockCrc);
 			if (!pHashEntry || pHashEntry->SourceFile() != pSourceFile || pHashEntry->IsSet())
 			{
 				// no match found, revert back the changes made by "pHashEntry->SetBlock"
@@ -1416,6 +1440,7 @@ ParChecker::EFileStatus ParChecker::VerifyDataFile(void* pDiskfile, void* pSourc
 					const VerificationHashEntry* pUndoEntry = *it;
 					pUndoEntry->SetBlock(NULL, 0);
 				}
+				pRepairer->UnlockVerification();
 				return fsUnknown;
 			}
 
@@ -1424,6 +1449,7 @@ ParChecker::EFileStatus ParChecker::VerifyDataFile(void* pDiskfile, void* pSourc
 			(*pAvailableBlocks)++;
 		}
 	}
+	pRepairer->UnlockVerification();
 
 	PrintMessage(Message::mkDetail, "Quickly verified %s file %s",
 		eFileStatus == fsSuccess ? "good" : "damaged", Util::BaseFileName(szFilename));
@@ -1563,6 +1589,54 @@ bool ParChecker::VerifyPartialDataFile(void* pDiskfile, void* pSourcefile, Segme
 	return true;
 }
 
+/*
+ * Determine valid blocks by comparing block hashes computed during download (option ParBlockHash)
+ * with checksums stored in the par-file; no data is read from disk. Blocks beyond the hashed
+ * part of the file are invalid. If the hashes don't fit the file or not a single block matches
+ * the file is verified as usual.
+ */
+ParChecker::EFileStatus ParChecker::VerifyHashedDataFile(void* pSourcefile, ValidBlocks* pValidBlocks)
+{
+	if (!m_bParBlockHash)
+	{
+		return fsUnknown;
+	}
+
+	Par2RepairerSourceFile* pSourceFile = (Par2RepairerSourceFile*)pSourcefile;
+	VerificationPacket* packet = pSourceFile->GetVerificationPacket();
+	std::string filename = pSourceFile->GetTargetFile()->FileName();
+	const char* szFilename = filename.c_str();
+
+	BlockHasher blockHasher(NULL, ((Repairer*)m_pRepairer)->mainpacket->BlockSize());
+	if (!FindBlockHashes(Util::BaseFileName(szFilename), &blockHasher) ||
+		blockHasher.GetFileSize() != (long long)pSourceFile->GetTargetFile()->FileSize())
+	{
+		return fsUnknown;
+	}
+
+	BlockHasher::BlockHashes* pBlockHashes = blockHasher.GetBlockHashes();
+	int iValidBlocks = 0;
+	pValidBlocks->resize(packet->BlockCount(), false);
+	for (int i = 0; i < (int)pValidBlocks->size() && i < (int)pBlockHashes->size(); i++)
+	{
+		const FILEVERIFICATIONENTRY* entry = packet->VerificationEntry(i);
+		BlockHasher::BlockHash& blockHash = pBlockHashes->at(i);
+		bool bBlockOK = blockHash.iCrc == entry->crc && !memcmp(blockHash.Md5, entry->hash.hash, sizeof(blockHash.Md5));
+		pValidBlocks->at(i) = bBlockOK;
+		iValidBlocks += bBlockOK ? 1 : 0;
+	}
+
+	debug("Block hashes for %s: %i of %i blocks valid", Util::BaseFileName(szFilename), iValidBlocks, (int)pValidBlocks->size());
+
+	if (iValidBlocks == (int)pValidBlocks->size() &&
+		!memcmp(blockHasher.GetFileMd5(), pSourceFile->GetDescriptionPacket()->HashFull().hash, 16))
+	{
+		return fsSuccess;
+	}
+
+	return iValidBlocks > 0 && iValidBlocks < (int)pValidBlocks->size() ? fsPartial : fsUnknown;
+}
+
 /*
  * Compute CRC of bytes range of file using CRCs of segments and reading some data directly
  * from file if necessary
@@ -35,6 +35,8 @@
 #include "Thread.h"
 #include "Log.h"
 
+class BlockHasher;
+
 class ParChecker : public Thread
 {
 public:
@@ -118,6 +120,7 @@ private:
 	std::string			m_lastFilename;
 	bool				m_bHasDamagedFiles;
 	bool				m_bParQuick;
+	bool				m_bParBlockHash;
 	bool				m_bForceRepair;
 	bool				m_bParFull;
 
@@ -136,12 +139,14 @@ private:
 	void				DeleteLeftovers();
 	void				signal_filename(std::string str);
 	void				signal_progress(int progress);
+	void				signal_progress(int progress, int iActiveProgress);
 	void				signal_done(std::string str, int available, int total);
 	// declared as void* to prevent the including of libpar2-headers into this header-file
 	// DiskFile* pDiskfile, Par2RepairerSourceFile* pSourcefile
 	EFileStatus			VerifyDataFile(void* pDiskfile, void* pSourcefile, int* pAvailableBlocks);
 	bool				VerifySuccessDataFile(void* pDiskfile, void* pSourcefile, unsigned long lDownloadCrc);
 	bool				VerifyPartialDataFile(void* pDiskfile, void* pSourcefile, SegmentList* pSegments, ValidBlocks* pValidBlocks);
+	EFileStatus			VerifyHashedDataFile(void* pSourcefile, ValidBlocks* pValidBlocks);
 	bool				SmartCalcFileRangeCrc(FILE* pFile, long long lStart, long long lEnd, SegmentList* pSegments,
 							unsigned long* pDownloadCrc);
 	bool				DumbCalcFileRangeCrc(FILE* pFile, long long lStart, long long lEnd, unsigned long* pDownloadCrc);
@@ -160,6 +165,7 @@ protected:
 	virtual void		RegisterParredFile(const char* szFilename) {}
 	virtual bool		IsParredFile(const char* szFilename) { return false; }
 	virtual EFileStatus	FindFileCrc(const char* szFilename, unsigned long* lCrc, SegmentList* pSegments) { return fsUnknown; }
+	virtual bool		FindBlockHashes(const char* szFilename, BlockHasher* pBlockHasher) { return false; }
 	EStage				GetStage() { return m_eStage; }
 	const char*			GetProgressLabel() { return m_szProgressLabel; }
 	int					GetFileProgress() { return m_iFileProgress; }
@@ -176,6 +182,8 @@ public:
 	void				SetNZBName(const char* szNZBName);
 	void				SetParQuick(bool bParQuick) { m_bParQuick = bParQuick; }
 	bool				GetParQuick() { return m_bParQuick; }
+	void				SetParBlockHash(bool bParBlockHash) { m_bParBlockHash = bParBlockHash; }
+	bool				GetParBlockHash() { return m_bParBlockHash; }
 	void				SetForceRepair(bool bForceRepair) { m_bForceRepair = bForceRepair; }
 	bool				GetForceRepair() { return m_bForceRepair; }
 	void				SetParFull(bool bParFull) { m_bParFull = bParFull; }
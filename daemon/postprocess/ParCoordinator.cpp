@@ -91,20 +91,23 @@ bool ParCoordinator::PostParChecker::IsParredFile(const char* szFilename)
 	return false;
 }
 
-ParChecker::EFileStatus ParCoordinator::PostParChecker::FindFileCrc(const char* szFilename,
-	unsigned long* lCrc, SegmentList* pSegments)
+CompletedFile* ParCoordinator::PostParChecker::FindCompletedFile(const char* szFilename)
 {
-	CompletedFile* pCompletedFile = NULL;
-
 	for (CompletedFiles::iterator it = m_pPostInfo->GetNZBInfo()->GetCompletedFiles()->begin(); it != m_pPostInfo->GetNZBInfo()->GetCompletedFiles()->end(); it++)
 	{
-		CompletedFile* pCompletedFile2 = *it;
-		if (!strcasecmp(pCompletedFile2->GetFileName(), szFilename))
+		CompletedFile* pCompletedFile = *it;
+		if (!strcasecmp(pCompletedFile->GetFileName(), szFilename))
 		{
-			pCompletedFile = pCompletedFile2;
-			break;
+			return pCompletedFile;
 		}
 	}
+	return NULL;
+}
+
+ParChecker::EFileStatus ParCoordinator::PostParChecker::FindFileCrc(const char* szFilename,
+	unsigned long* lCrc, SegmentList* pSegments)
+{
+	CompletedFile* pCompletedFile = FindCompletedFile(szFilename);
 	if (!pCompletedFile)
 	{
 		return ParChecker::fsUnknown;
@@ -144,6 +147,15 @@ ParChecker::EFileStatus ParCoordinator::PostParChecker::FindFileCrc(const char*
 		ParChecker::fsUnknown;
 }
 
+bool ParCoordinator::PostParChecker::FindBlockHashes(const char* szFilename, BlockHasher* pBlockHasher)
+{
+	CompletedFile* pCompletedFile = FindCompletedFile(szFilename);
+
+	return pCompletedFile && pCompletedFile->GetID() > 0 &&
+		!m_pPostInfo->GetNZBInfo()->GetReprocess() &&
+		g_pDiskState->LoadBlockHashes(pCompletedFile->GetID(), pBlockHasher);
+}
+
 void ParCoordinator::PostParRenamer::UpdateProgress()
 {
 	m_pOwner->UpdateParRenameProgress();
@@ -247,6 +259,7 @@ void ParCoordinator::StartParCheckJob(PostInfo* pPostInfo)
 	m_ParChecker.SetParTime(time(NULL));
 	m_ParChecker.SetDownloadSec(pPostInfo->GetNZBInfo()->GetDownloadSec());
 	m_ParChecker.SetParQuick(g_pOptions->GetParQuick() && !pPostInfo->GetForceParFull());
+	m_ParChecker.SetParBlockHash(g_pOptions->GetParBlockHash() && !pPostInfo->GetForceParFull());
 	m_ParChecker.SetForceRepair(pPostInfo->GetForceRepair());
 	m_ParChecker.PrintMessage(Message::mkInfo, "Checking pars for %s", pPostInfo->GetNZBInfo()->GetName());
 	pPostInfo->SetWorking(true);
@@ -48,6 +48,8 @@ private:
 		time_t			m_tParTime;
 		time_t			m_tRepairTime;
 		int				m_iDownloadSec;
+
+		CompletedFile*	FindCompletedFile(const char* szFilename);
 	protected:
 		virtual bool	RequestMorePars(int iBlockNeeded, int* pBlockFound);
 		virtual void	UpdateProgress();
@@ -56,6 +58,7 @@ private:
 		virtual void	RegisterParredFile(const char* szFilename);
 		virtual bool	IsParredFile(const char* szFilename);
 		virtual EFileStatus	FindFileCrc(const char* szFilename, unsigned long* lCrc, SegmentList* pSegments);
+		virtual bool	FindBlockHashes(const char* szFilename, BlockHasher* pBlockHasher);
 	public:
 		PostInfo*		GetPostInfo() { return m_pPostInfo; }
 		void			SetPostInfo(PostInfo* pPostInfo) { m_pPostInfo = pPostInfo; }
@@ -273,6 +273,10 @@ void ParRenamer::LoadParFile(const char* szParFilename)
 
 void ParRenamer::CheckFiles(const char* szDestDir, bool bRenamePars)
 {
+	// regular files are checked in groups, whose hashes are computed at once
+	FileList regularFiles;
+	unsigned int iGroupSize = md5lanes(md5method);
+
 	DirBrowser dir(szDestDir);
 	while (const char* filename = dir.Next())
 	{
@@ -296,11 +300,17 @@ void ParRenamer::CheckFiles(const char* szDestDir, bool bRenamePars)
 				}
 				else
 				{
-					CheckRegularFile(szDestDir, szFullFilename);
+					regularFiles.push_back(strdup(szFullFilename));
+					if (regularFiles.size() >= iGroupSize)
+					{
+						CheckRegularFiles(szDestDir, &regularFiles);
+					}
 				}
 			}
 		}
 	}
+
+	CheckRegularFiles(szDestDir, &regularFiles);
 }
 
 void ParRenamer::CheckMissing()
@@ -344,46 +354,84 @@ bool ParRenamer::IsSplittedFragment(const char* szFilename, const char* szCorrec
 	return bSplittedFragement;
 }
 
-void ParRenamer::CheckRegularFile(const char* szDestDir, const char* szFilename)
+/*
+* Computes the hashes of the first 16K of the files in the list and checks
+* them against the hashes from par-files. The files are removed from the list.
+*/
+void ParRenamer::CheckRegularFiles(const char* szDestDir, FileList* pFileList)
 {
-	debug("Computing hash for %s", szFilename);
-
 	const int iBlockSize = 16*1024;
-	
-	FILE* pFile = fopen(szFilename, FOPEN_RB);
-	if (!pFile)
+	int iFileCount = (int)pFileList->size();
+	if (iFileCount == 0)
 	{
-		PrintMessage(Message::mkError, "Could not open file %s", szFilename);
 		return;
 	}
 
-	// load first 16K of the file into buffer
-	
-	void* pBuffer = malloc(iBlockSize);
-	
-	int iReadBytes = fread(pBuffer, 1, iBlockSize, pFile);
-	int iError = ferror(pFile);
-	if (iReadBytes != iBlockSize && iError)
+	char* pBuffer = (char*)malloc(iBlockSize * iFileCount);
+	const void** pBuffers = new const void*[iFileCount];
+	size_t* pLengths = new size_t[iFileCount];
+	char** szFilenames = new char*[iFileCount];
+	int iLoaded = 0;
+
+	// load first 16K of each file into buffer
+	for (FileList::iterator it = pFileList->begin(); it != pFileList->end(); it++)
 	{
-		PrintMessage(Message::mkError, "Could not read file %s", szFilename);
-		return;
+		char* szFilename = *it;
+		debug("Computing hash for %s", szFilename);
+
+		FILE* pFile = fopen(szFilename, FOPEN_RB);
+		if (!pFile)
+		{
+			PrintMessage(Message::mkError, "Could not open file %s", szFilename);
+			continue;
+		}
+
+		char* pFileBuffer = pBuffer + iLoaded * iBlockSize;
+		int iReadBytes = fread(pFileBuffer, 1, iBlockSize, pFile);
+		int iError = ferror(pFile);
+		fclose(pFile);
+
+		if (iReadBytes != iBlockSize && iError)
+		{
+			PrintMessage(Message::mkError, "Could not read file %s", szFilename);
+			continue;
+		}
+
+		pBuffers[iLoaded] = pFileBuffer;
+		pLengths[iLoaded] = iReadBytes;
+		szFilenames[iLoaded] = szFilename;
+		iLoaded++;
 	}
-	
-	fclose(pFile);
-	
-	MD5Hash hash16k;
-	MD5Context context;
-	context.Update(pBuffer, iReadBytes);
-	context.Final(hash16k);
-	
+
+	MD5Hash* pHashes = new MD5Hash[iFileCount];
+	MD5MultiHash(md5method, iLoaded, pBuffers, pLengths, pHashes);
+
+	for (int i = 0; i < iLoaded; i++)
+	{
+		CheckRegularFile(szDestDir, szFilenames[i], pHashes[i].print().c_str());
+	}
+
+	delete[] pHashes;
+	delete[] szFilenames;
+	delete[] pLengths;
+	delete[] pBuffers;
 	free(pBuffer);
-	
-	debug("file: %s; hash16k: %s", Util::BaseFileName(szFilename), hash16k.print().c_str());
-	
+
+	for (FileList::iterator it = pFileList->begin(); it != pFileList->end(); it++)
+	{
+		free(*it);
+	}
+	pFileList->clear();
+}
+
+void ParRenamer::CheckRegularFile(const char* szDestDir, const char* szFilename, const char* szHash16k)
+{
+	debug("file: %s; hash16k: %s", Util::BaseFileName(szFilename), szHash16k);
+
 	for (FileHashList::iterator it = m_FileHashList.begin(); it != m_FileHashList.end(); it++)
 	{
 		FileHash* pFileHash = *it;
-		if (!strcmp(pFileHash->GetHash(), hash16k.print().c_str()))
+		if (!strcmp(pFileHash->GetHash(), szHash16k))
 		{
 			debug("Found correct filename: %s", pFileHash->GetFilename());
 			pFileHash->SetFileExists(true);
@@ -60,6 +60,7 @@ public:
 
 	typedef std::deque<FileHash*>		FileHashList;
 	typedef std::deque<char*>			DirList;
+	typedef std::deque<char*>			FileList;
 	
 private:
 	char*				m_szInfoName;
@@ -83,7 +84,8 @@ private:
 	void				LoadParFiles(const char* szDestDir);
 	void				LoadParFile(const char* szParFilename);
 	void				CheckFiles(const char* szDestDir, bool bRenamePars);
-	void				CheckRegularFile(const char* szDestDir, const char* szFilename);
+	void				CheckRegularFiles(const char* szDestDir, FileList* pFileList);
+	void				CheckRegularFile(const char* szDestDir, const char* szFilename, const char* szHash16k);
 	void				CheckParFile(const char* szDestDir, const char* szFilename);
 	bool				IsSplittedFragment(const char* szFilename, const char* szCorrectName);
 	void				CheckMissing();
@@ -333,6 +333,7 @@ void PrePostProcessor::NZBCompleted(DownloadQueue* pDownloadQueue, NZBInfo* pNZB
 
 	if (!bAddToHistory)
 	{
+		pDownloadQueue->RemoveFromIndex(pNZBInfo);
 		g_pHistoryCoordinator->DeleteDiskFiles(pNZBInfo);
 		pDownloadQueue->GetQueue()->Remove(pNZBInfo);
 		delete pNZBInfo;
@@ -42,15 +42,21 @@
 #include <stdarg.h>
 #include <ctype.h>
 #include <deque>
+#include <vector>
+#include <map>
+#include <set>
 #include <algorithm>
 
 #include "nzbget.h"
 #include "DiskState.h"
+#include "BlockHasher.h"
 #include "Options.h"
 #include "Log.h"
 #include "Util.h"
 
 static const char* FORMATVERSION_SIGNATURE = "nzbget diskstate file version ";
+// format version of queue, journal and history archive
+static const int QUEUE_FORMAT_VERSION = 54;
 
 #ifdef WIN32
 // Windows doesn't have standard "vsscanf"
@@ -87,6 +93,47 @@ int DiskState::fscanf(FILE* infile, const char* Format, ...)
 	return res;
 }
 
+int DiskState::fprintf(FILE* outfile, const char* Format, ...)
+{
+	va_list ap;
+	va_start(ap, Format);
+	int res = vfprintf(outfile, Format, ap);
+	va_end(ap);
+
+	return res;
+}
+
+/*
+ * Formatting into memory buffer, used to build records of queue file and journal.
+ */
+int DiskState::fprintf(StringBuilder* outfile, const char* Format, ...)
+{
+	char szLine[10240];
+
+	va_list ap;
+	va_start(ap, Format);
+	int res = vsnprintf(szLine, sizeof(szLine), Format, ap);
+	va_end(ap);
+
+	if (res >= 0 && res < (int)sizeof(szLine))
+	{
+		outfile->Append(szLine);
+		return res;
+	}
+
+	// long line (for example post-processing parameters), format it once again into a larger buffer
+	int iSize = res >= 0 ? res + 1 : 1024 * 1024;
+	char* szLongLine = (char*)malloc(iSize);
+	va_start(ap, Format);
+	res = vsnprintf(szLongLine, iSize, Format, ap);
+	va_end(ap);
+	szLongLine[iSize-1] = '\0';
+	outfile->Append(szLongLine);
+	free(szLongLine);
+
+	return res;
+}
+
 /* Parse signature and return format version number
 */
 int DiskState::ParseFormatVersion(const char* szFormatSignature)
@@ -99,672 +146,1797 @@ int DiskState::ParseFormatVersion(const char* szFormatSignature)
 	return atoi(szFormatSignature + strlen(FORMATVERSION_SIGNATURE));
 }
 
-/* Save Download Queue to Disk.
- * The Disk State consists of file "queue", which contains the order of files,
- * and of one diskstate-file for each file in download queue.
- * This function saves file "queue" and files with NZB-info. It does not
- * save file-infos.
- *
- * For safety:
- * - first save to temp-file (queue.new)
- * - then delete queue
- * - then rename queue.new to queue
+/*
+ * Binary diskstate files start with a fixed size header:
+ * signature, byte order mark, kind of file and format version.
+ * Multibyte values are stored in native byte order; files written
+ * on a machine with different byte order are rejected.
  */
-bool DiskState::SaveDownloadQueue(DownloadQueue* pDownloadQueue)
+static const char BINARY_SIGNATURE[12] = "nzbget-bin";
+static const int BINARY_BYTEORDER = 0x01020304;
+static const int BINARY_KIND_FILEINFO = 1;
+static const int BINARY_KIND_FILESTATE = 2;
+static const int BINARY_KIND_PARTIALSTATE = 3;
+static const int BINARY_KIND_BLOCKHASHES = 4;
+static const int BINARY_FILEINFO_VERSION = 1;
+static const int BINARY_FILESTATE_VERSION = 1;
+static const int BINARY_PARTIALSTATE_VERSION = 1;
+static const int BINARY_BLOCKHASHES_VERSION = 1;
+
+class BinaryWriter
 {
-	debug("Saving queue to disk");
-
-	char destFilename[1024];
-	snprintf(destFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), "queue");
-	destFilename[1024-1] = '\0';
+private:
+	FILE*				m_pFile;
+	char				m_szBuffer[64 * 1024];
+	int					m_iBufferUsed;
+	bool				m_bOK;
 
-	char tempFilename[1024];
-	snprintf(tempFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), "queue.new");
-	tempFilename[1024-1] = '\0';
+public:
+						BinaryWriter(FILE* pFile) : m_pFile(pFile), m_iBufferUsed(0), m_bOK(true) {}
+	void				Write(const void* pData, int iSize);
+	void				WriteInt(int iValue) { Write(&iValue, sizeof(iValue)); }
+	void				WriteInt64(long long lValue) { Write(&lValue, sizeof(lValue)); }
+	void				WriteStr(const char* szValue);
+	void				WriteHeader(int iKind, int iFormatVersion);
+	bool				Flush();
+};
 
-	if (pDownloadQueue->GetQueue()->empty() && 
-		pDownloadQueue->GetHistory()->empty())
+void BinaryWriter::Write(const void* pData, int iSize)
+{
+	if (m_iBufferUsed + iSize > (int)sizeof(m_szBuffer))
 	{
-		remove(destFilename);
-		return true;
+		Flush();
 	}
 
-	FILE* outfile = fopen(tempFilename, FOPEN_WB);
-
-	if (!outfile)
+	if (iSize > (int)sizeof(m_szBuffer))
 	{
-		error("Error saving diskstate: Could not create file %s", tempFilename);
-		return false;
+		m_bOK = m_bOK && fwrite(pData, 1, iSize, m_pFile) == (size_t)iSize;
+		return;
 	}
 
-	fprintf(outfile, "%s%i\n", FORMATVERSION_SIGNATURE, 53);
-
-	// save nzb-infos
-	SaveNZBQueue(pDownloadQueue, outfile);
+	memcpy(m_szBuffer + m_iBufferUsed, pData, iSize);
+	m_iBufferUsed += iSize;
+}
 
-	// save history
-	SaveHistory(pDownloadQueue, outfile);
+/*
+ * Strings are stored with length prefix and terminating null character,
+ * this allows to use them directly from a memory mapped file.
+ */
+void BinaryWriter::WriteStr(const char* szValue)
+{
+	int iLen = strlen(szValue);
+	WriteInt(iLen);
+	Write(szValue, iLen + 1);
+}
 
-	fclose(outfile);
+void BinaryWriter::WriteHeader(int iKind, int iFormatVersion)
+{
+	Write(BINARY_SIGNATURE, sizeof(BINARY_SIGNATURE));
+	WriteInt(BINARY_BYTEORDER);
+	WriteInt(iKind);
+	WriteInt(iFormatVersion);
+}
 
-	// now rename to dest file name
-	remove(destFilename);
-	if (rename(tempFilename, destFilename))
+bool BinaryWriter::Flush()
+{
+	if (m_iBufferUsed > 0)
 	{
-		error("Error saving diskstate: Could not rename file %s to %s", tempFilename, destFilename);
-		return false;
+		m_bOK = m_bOK && fwrite(m_szBuffer, 1, m_iBufferUsed, m_pFile) == (size_t)m_iBufferUsed;
+		m_iBufferUsed = 0;
 	}
-
-	return true;
+	return m_bOK;
 }
 
-bool DiskState::LoadDownloadQueue(DownloadQueue* pDownloadQueue, Servers* pServers)
+/*
+ * Decodes values from a memory buffer (usually a memory mapped file)
+ * checking that all reads stay within the buffer.
+ */
+class BinaryReader
 {
-	debug("Loading queue from disk");
+private:
+	const char*			m_pCur;
+	const char*			m_pEnd;
 
-	bool bOK = false;
-	int iFormatVersion = 0;
-
-	char fileName[1024];
-	snprintf(fileName, 1024, "%s%s", g_pOptions->GetQueueDir(), "queue");
-	fileName[1024-1] = '\0';
-
-	FILE* infile = fopen(fileName, FOPEN_RB);
+public:
+						BinaryReader(const char* pData, long long lSize) : m_pCur(pData), m_pEnd(pData + lSize) {}
+	bool				Read(void* pData, int iSize);
+	bool				ReadInt(int* pValue) { return Read(pValue, sizeof(*pValue)); }
+	bool				ReadInt64(long long* pValue) { return Read(pValue, sizeof(*pValue)); }
+	bool				ReadStr(const char** pValue);
+	bool				ReadHeader(int iKind, int* pFormatVersion);
+	const char*			GetPos() { return m_pCur; }
+	void				Skip(int iSize) { m_pCur += iSize; }
+	long long			GetRemaining() { return m_pEnd - m_pCur; }
+	static bool			IsBinary(const char* pData, long long lSize);
+};
 
-	if (!infile)
+bool BinaryReader::Read(void* pData, int iSize)
+{
+	if (iSize < 0 || m_pEnd - m_pCur < iSize)
 	{
-		error("Error reading diskstate: could not open file %s", fileName);
 		return false;
 	}
+	// copying is necessary since the data in buffer may be not aligned
+	memcpy(pData, m_pCur, iSize);
+	m_pCur += iSize;
+	return true;
+}
 
-	char FileSignatur[128];
-	fgets(FileSignatur, sizeof(FileSignatur), infile);
-	iFormatVersion = ParseFormatVersion(FileSignatur);
-	if (iFormatVersion < 3 || iFormatVersion > 53)
+bool BinaryReader::ReadStr(const char** pValue)
+{
+	int iLen;
+	if (!ReadInt(&iLen) || iLen < 0 || m_pEnd - m_pCur < iLen + 1 || m_pCur[iLen] != '\0')
 	{
-		error("Could not load diskstate due to file version mismatch");
-		fclose(infile);
 		return false;
 	}
+	*pValue = m_pCur;
+	m_pCur += iLen + 1;
+	return true;
+}
 
-	NZBList nzbList(false);
-	NZBList sortList(false);
+bool BinaryReader::ReadHeader(int iKind, int* pFormatVersion)
+{
+	char szSignature[sizeof(BINARY_SIGNATURE)];
+	int iByteOrder, iFileKind;
+	return Read(szSignature, sizeof(szSignature)) &&
+		!memcmp(szSignature, BINARY_SIGNATURE, sizeof(szSignature)) &&
+		ReadInt(&iByteOrder) && iByteOrder == BINARY_BYTEORDER &&
+		ReadInt(&iFileKind) && iFileKind == iKind &&
+		ReadInt(pFormatVersion);
+}
 
-	if (iFormatVersion < 43)
-	{
-		// load nzb-infos
-		if (!LoadNZBList(&nzbList, pServers, infile, iFormatVersion)) goto error;
+bool BinaryReader::IsBinary(const char* pData, long long lSize)
+{
+	return lSize >= (long long)sizeof(BINARY_SIGNATURE) && !memcmp(pData, BINARY_SIGNATURE, sizeof(BINARY_SIGNATURE));
+}
 
-		// load file-infos
-		if (!LoadFileQueue12(&nzbList, &sortList, infile, iFormatVersion)) goto error;
-	}
-	else
+/*
+ * Index of committed journal transactions built by ScanJournal.
+ * For every record only the position of its latest version is kept.
+ */
+class JournalIndex
+{
+public:
+	struct Record
 	{
-		if (!LoadNZBList(pDownloadQueue->GetQueue(), pServers, infile, iFormatVersion)) goto error;
-	}
+		char			cKind;		// 'Q' - queue item, 'H' - history item, 'X' - item removed
+		long			lOffset;	// position of record data in journal file
+	};
 
-	if (iFormatVersion >= 7 && iFormatVersion < 45)
-	{
-		// load post-queue from v12
-		if (!LoadPostQueue12(pDownloadQueue, &nzbList, infile, iFormatVersion)) goto error;
-	}
-	else if (iFormatVersion < 7)
-	{
-		// load post-queue from v5
-		LoadPostQueue5(pDownloadQueue, &nzbList);
-	}
+	typedef std::map<int, Record>	Records;
 
-	if (iFormatVersion >= 15 && iFormatVersion < 46)
-	{
-		// load url-queue
-		if (!LoadUrlQueue12(pDownloadQueue, infile, iFormatVersion)) goto error;
-	}
+	int					iFormatVersion;
+	Records				records;
+	bool				bQueueOrder;
+	IDList				queueOrder;
+	bool				bHistoryOrder;
+	IDList				historyOrder;
 
-	if (iFormatVersion >= 9)
-	{
-		// load history
-		if (!LoadHistory(pDownloadQueue, &nzbList, pServers, infile, iFormatVersion)) goto error;
-	}
+						JournalIndex() : iFormatVersion(0), bQueueOrder(false), bHistoryOrder(false) {}
+};
 
-	if (iFormatVersion >= 9 && iFormatVersion < 43)
-	{
-		// load parked file-infos
-		if (!LoadFileQueue12(&nzbList, NULL, infile, iFormatVersion)) goto error;
-	}
+static const char* JOURNAL_FILENAME = "journal";
+static const char* ARCHIVE_FILENAME = "archive";
+static const int PARTIALSTATE_BLOCKEND = 0x4B434843;
+static const long long PARTIALSTATE_COMPACTSIZE = 4 * 1024 * 1024;
+static const int ARTICLESTATE_SIZE = 4 + 4 + 8 + 4;
 
-	if (iFormatVersion < 29)
-	{
-		CalcCriticalHealth(&nzbList);
-	}
+/*
+ * Changes of queue records collected by one save. Prepared while the download
+ * queue is locked; formatted and written by writer thread after unlocking.
+ */
+class QueueTransaction
+{
+public:
+	struct Record
+	{
+		char			cKind;		// 'Q' - queue item, 'H' - history item
+		int				iID;
+		char*			szData;		// owned by transaction until applied to written records
+	};
+
+	typedef std::vector<Record>	Records;
+
+	bool				bReset;		// written records are discarded, transaction contains all items
+	bool				bSnapshot;	// file "queue" is rewritten instead of appending to journal
+	Records				records;
+	IDList				removed;
+	bool				bQueueOrder;
+	IDList				queueOrder;
+	bool				bHistoryOrder;
+	IDList				historyOrder;
+
+						QueueTransaction(bool bReset, bool bSnapshot) : bReset(bReset), bSnapshot(bSnapshot),
+							bQueueOrder(false), bHistoryOrder(false) {}
+						~QueueTransaction();
+	bool				IsEmpty() { return records.empty() && removed.empty() && !bQueueOrder && !bHistoryOrder; }
+	long long			CalcJournalSize();
+};
 
-	if (iFormatVersion < 43)
+QueueTransaction::~QueueTransaction()
+{
+	for (Records::iterator it = records.begin(); it != records.end(); it++)
 	{
-		// finalize queue reading
-		CompleteNZBList12(pDownloadQueue, &sortList, iFormatVersion);
+		free(it->szData);
 	}
+}
 
-	if (iFormatVersion < 47)
+/*
+ * Approximate size of the transaction in the journal.
+ */
+long long QueueTransaction::CalcJournalSize()
+{
+	long long lSize = 2 + removed.size() * 8 + (queueOrder.size() + historyOrder.size()) * 8;
+	for (Records::iterator it = records.begin(); it != records.end(); it++)
 	{
-		CompleteDupList12(pDownloadQueue, iFormatVersion);
+		lSize += 16 + strlen(it->szData);
 	}
+	return lSize;
+}
 
-	if (!LoadAllFileStates(pDownloadQueue, pServers)) goto error;
-
-	bOK = true;
+/*
+ * Writes queue files prepared by DiskState in background, see DiskState::WriteQueueFiles.
+ */
+class QueueWriter : public Thread
+{
+private:
+	DiskState*			m_pOwner;
 
-error:
+protected:
+	virtual void		Run();
 
-	fclose(infile);
-	if (!bOK)
-	{
-		error("Error reading diskstate for file %s", fileName);
-	}
+public:
+						QueueWriter(DiskState* pOwner) : m_pOwner(pOwner) {}
+	virtual void		Stop();
+};
 
-	NZBInfo::ResetGenID(true);
-	FileInfo::ResetGenID(true);
+void QueueWriter::Run()
+{
+	debug("Entering QueueWriter-loop");
 
-	if (iFormatVersion > 0)
+	while (!IsStopped())
 	{
-		CalcFileStats(pDownloadQueue, iFormatVersion);
+		// save requests arriving while the files are written are written together
+		m_pOwner->WaitQueueWrite();
+		m_pOwner->WriteQueueFiles();
 	}
 
-	return bOK;
+	// write everything which was saved before the program stopped
+	m_pOwner->WriteQueueFiles();
+
+	debug("Exiting QueueWriter-loop");
 }
 
-void DiskState::CompleteNZBList12(DownloadQueue* pDownloadQueue, NZBList* pNZBList, int iFormatVersion)
+void QueueWriter::Stop()
 {
-	// put all NZBs referenced from file queue into pDownloadQueue->GetQueue()
-	for (NZBList::iterator it = pNZBList->begin(); it != pNZBList->end(); it++)
-	{
-		NZBInfo* pNZBInfo = *it;
-		pDownloadQueue->GetQueue()->push_back(pNZBInfo);
-	}
-
-	if (31 <= iFormatVersion && iFormatVersion < 42)
-	{
-		// due to a bug in r811 (v12-testing) new NZBIDs were generated on each refresh of web-ui
-		// this resulted in very high numbers for NZBIDs
-		// here we renumber NZBIDs in order to keep them low.
-		NZBInfo::ResetGenID(false);
-		int iID = 1;
-		for (NZBList::iterator it = pNZBList->begin(); it != pNZBList->end(); it++)
-		{
-			NZBInfo* pNZBInfo = *it;
-			pNZBInfo->SetID(iID++);
-		}
-	}
+	Thread::Stop();
+	m_pOwner->WakeQueueWriter();
 }
 
-void DiskState::CompleteDupList12(DownloadQueue* pDownloadQueue, int iFormatVersion)
+/*
+ * Loads summaries of file-infos in parallel at startup, see DiskState::LoadFileSummaries.
+ */
+class SummaryLoader : public ParallelJob
 {
-	NZBInfo::ResetGenID(true);
+private:
+	DiskState*			m_pOwner;
+	FileList*			m_pFileList;
+	std::vector<char>	m_Failed;
 
-	for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
-	{
-		HistoryInfo* pHistoryInfo = *it;
+public:
+						SummaryLoader(DiskState* pOwner, FileList* pFileList) :
+							m_pOwner(pOwner), m_pFileList(pFileList), m_Failed(pFileList->size(), 0) {}
+	virtual void		ProcessItem(int iItem) { m_Failed[iItem] = !m_pOwner->LoadFileSummary(m_pFileList->at(iItem)); }
+	bool				GetFailed(int iIndex) { return m_Failed[iIndex] != 0; }
+};
 
-		if (pHistoryInfo->GetKind() == HistoryInfo::hkDup)
-		{
-			pHistoryInfo->GetDupInfo()->SetID(NZBInfo::GenerateID());
-		}
-	}
+DiskState::DiskState()
+{
+	m_bJournalReady = false;
+	m_iGeneration = 0;
+	m_lSnapshotSize = 0;
+	m_lJournalSize = 0;
+	m_pJournalIndex = NULL;
+	m_lPartialSize = 0;
+	m_lPartialCompactSize = 0;
+	m_pQueueWriter = NULL;
+	m_bWriteFailed = false;
+	m_bJournalStarted = false;
+	m_pSummaryList = NULL;
+	m_iHistoryGeneration = 0;
+	m_bArchiveLoaded = false;
+	m_iArchiveVersion = 0;
 }
 
-void DiskState::SaveNZBQueue(DownloadQueue* pDownloadQueue, FILE* outfile)
+DiskState::~DiskState()
 {
-	debug("Saving nzb list to disk");
+	StopQueueWriter();
 
-	fprintf(outfile, "%i\n", (int)pDownloadQueue->GetQueue()->size());
-	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
+	ClearTransactions(&m_PendingTransactions);
+	ClearWrittenRecords();
+
+	for (DeferredStates::iterator it = m_DeferredStates.begin(); it != m_DeferredStates.end(); it++)
 	{
-		NZBInfo* pNZBInfo = *it;
-		SaveNZBInfo(pNZBInfo, outfile);
+		free(it->second.pData);
 	}
+
+	ClearArchiveIndex();
 }
 
-bool DiskState::LoadNZBList(NZBList* pNZBList, Servers* pServers, FILE* infile, int iFormatVersion)
+void DiskState::StartQueueWriter()
 {
-	debug("Loading nzb list from disk");
+	m_pQueueWriter = new QueueWriter(this);
+	m_pQueueWriter->Start();
+}
 
-	// load nzb-infos
-	int size;
-	if (fscanf(infile, "%i\n", &size) != 1) goto error;
-	for (int i = 0; i < size; i++)
+/*
+ * Stops the writer thread after it has written all pending changes.
+ * Queue files are written directly by SaveDownloadQueue after that.
+ */
+void DiskState::StopQueueWriter()
+{
+	if (!m_pQueueWriter)
 	{
-		NZBInfo* pNZBInfo = new NZBInfo();
-		pNZBList->push_back(pNZBInfo);
-		if (!LoadNZBInfo(pNZBInfo, pServers, infile, iFormatVersion)) goto error;
+		return;
 	}
 
-	return true;
+	debug("Stopping QueueWriter");
+	m_pQueueWriter->Stop();
+	while (m_pQueueWriter->IsRunning())
+	{
+		usleep(20 * 1000);
+	}
 
-error:
-	error("Error reading nzb list from disk");
-	return false;
+	delete m_pQueueWriter;
+	m_pQueueWriter = NULL;
 }
 
-void DiskState::SaveNZBInfo(NZBInfo* pNZBInfo, FILE* outfile)
-{
-	fprintf(outfile, "%i\n", pNZBInfo->GetID());
-	fprintf(outfile, "%i\n", (int)pNZBInfo->GetKind());
-	fprintf(outfile, "%s\n", pNZBInfo->GetURL());
-	fprintf(outfile, "%s\n", pNZBInfo->GetFilename());
-	fprintf(outfile, "%s\n", pNZBInfo->GetDestDir());
-	fprintf(outfile, "%s\n", pNZBInfo->GetFinalDir());
-	fprintf(outfile, "%s\n", pNZBInfo->GetQueuedFilename());
-	fprintf(outfile, "%s\n", pNZBInfo->GetName());
-	fprintf(outfile, "%s\n", pNZBInfo->GetCategory());
-	fprintf(outfile, "%i,%i,%i,%i\n", (int)pNZBInfo->GetPriority(), 
-		pNZBInfo->GetPostInfo() ? (int)pNZBInfo->GetPostInfo()->GetStage() + 1 : 0,
-		(int)pNZBInfo->GetDeletePaused(), (int)pNZBInfo->GetManyDupeFiles());
-	fprintf(outfile, "%i,%i,%i,%i,%i,%i,%i\n", (int)pNZBInfo->GetParStatus(), (int)pNZBInfo->GetUnpackStatus(),
-		(int)pNZBInfo->GetMoveStatus(), (int)pNZBInfo->GetRenameStatus(), (int)pNZBInfo->GetDeleteStatus(),
-		(int)pNZBInfo->GetMarkStatus(), (int)pNZBInfo->GetUrlStatus());
-	fprintf(outfile, "%i,%i,%i\n", (int)pNZBInfo->GetUnpackCleanedUpDisk(), (int)pNZBInfo->GetHealthPaused(),
-		(int)pNZBInfo->GetAddUrlPaused());
-	fprintf(outfile, "%i,%i,%i\n", pNZBInfo->GetFileCount(), pNZBInfo->GetParkedFileCount(), pNZBInfo->GetMessageCount());
-	fprintf(outfile, "%i,%i\n", (int)pNZBInfo->GetMinTime(), (int)pNZBInfo->GetMaxTime());
-	fprintf(outfile, "%i,%i,%i\n", (int)pNZBInfo->GetParFull(), 
-		pNZBInfo->GetPostInfo() ? (int)pNZBInfo->GetPostInfo()->GetForceParFull() : 0,
-		pNZBInfo->GetPostInfo() ? (int)pNZBInfo->GetPostInfo()->GetForceRepair() : 0);
-
-	fprintf(outfile, "%u,%u\n", pNZBInfo->GetFullContentHash(), pNZBInfo->GetFilteredContentHash());
-
-	unsigned long High1, Low1, High2, Low2, High3, Low3;
-	Util::SplitInt64(pNZBInfo->GetSize(), &High1, &Low1);
-	Util::SplitInt64(pNZBInfo->GetSuccessSize(), &High2, &Low2);
-	Util::SplitInt64(pNZBInfo->GetFailedSize(), &High3, &Low3);
-	fprintf(outfile, "%lu,%lu,%lu,%lu,%lu,%lu\n", High1, Low1, High2, Low2, High3, Low3);
-
-	Util::SplitInt64(pNZBInfo->GetParSize(), &High1, &Low1);
-	Util::SplitInt64(pNZBInfo->GetParSuccessSize(), &High2, &Low2);
-	Util::SplitInt64(pNZBInfo->GetParFailedSize(), &High3, &Low3);
-	fprintf(outfile, "%lu,%lu,%lu,%lu,%lu,%lu\n", High1, Low1, High2, Low2, High3, Low3);
-
-	fprintf(outfile, "%i,%i,%i\n", pNZBInfo->GetTotalArticles(), pNZBInfo->GetSuccessArticles(), pNZBInfo->GetFailedArticles());
-
-	fprintf(outfile, "%s\n", pNZBInfo->GetDupeKey());
-	fprintf(outfile, "%i,%i\n", (int)pNZBInfo->GetDupeMode(), pNZBInfo->GetDupeScore());
-
-	Util::SplitInt64(pNZBInfo->GetDownloadedSize(), &High1, &Low1);
-	fprintf(outfile, "%lu,%lu,%i,%i,%i,%i,%i\n", High1, Low1, pNZBInfo->GetDownloadSec(), pNZBInfo->GetPostTotalSec(),
-		pNZBInfo->GetParSec(), pNZBInfo->GetRepairSec(), pNZBInfo->GetUnpackSec());
+/* Save Download Queue to Disk.
+ * The Disk State consists of file "queue", which contains the order of files,
+ * and of one diskstate-file for each file in download queue.
+ * This function saves file "queue" and files with NZB-info. It does not
+ * save file-infos.
+ *
+ * To avoid rewriting of the whole file on every change only the changed
+ * records are appended to file "journal". The journal is merged into
+ * file "queue" (compacted) once it grows larger than the queue file.
+ *
+ * The function is called with locked download queue; it only serializes
+ * changed records. The files are formatted and written by writer thread
+ * after the queue is unlocked, the writer keeps the records written to disk
+ * to compact the journal without serializing the whole queue again.
+ */
+bool DiskState::SaveDownloadQueue(DownloadQueue* pDownloadQueue)
+{
+	debug("Saving queue to disk");
 
-	fprintf(outfile, "%i\n", (int)pNZBInfo->GetCompletedFiles()->size());
-	for (CompletedFiles::iterator it = pNZBInfo->GetCompletedFiles()->begin(); it != pNZBInfo->GetCompletedFiles()->end(); it++)
+	m_mutexPending.Lock();
+	if (m_bWriteFailed)
 	{
-		CompletedFile* pCompletedFile = *it;
-		fprintf(outfile, "%i,%i,%lu,%s\n", pCompletedFile->GetID(), (int)pCompletedFile->GetStatus(),
-			pCompletedFile->GetCrc(), pCompletedFile->GetFileName());
+		// start over with a new snapshot
+		m_bWriteFailed = false;
+		ResetJournal();
 	}
+	m_mutexPending.Unlock();
 
-	fprintf(outfile, "%i\n", (int)pNZBInfo->GetParameters()->size());
-	for (NZBParameterList::iterator it = pNZBInfo->GetParameters()->begin(); it != pNZBInfo->GetParameters()->end(); it++)
+	if (pDownloadQueue->GetQueue()->empty() && 
+		pDownloadQueue->GetHistory()->empty())
 	{
-		NZBParameter* pParameter = *it;
-		fprintf(outfile, "%s=%s\n", pParameter->GetName(), pParameter->GetValue());
+		// empty snapshot means deletion of queue files
+		ResetJournal();
+		QueueWrite(new QueueTransaction(true, true));
+		return true;
 	}
 
-	fprintf(outfile, "%i\n", (int)pNZBInfo->GetScriptStatuses()->size());
-	for (ScriptStatusList::iterator it = pNZBInfo->GetScriptStatuses()->begin(); it != pNZBInfo->GetScriptStatuses()->end(); it++)
+	if (!m_bJournalReady)
 	{
-		ScriptStatus* pScriptStatus = *it;
-		fprintf(outfile, "%i,%s\n", pScriptStatus->GetStatus(), pScriptStatus->GetName());
+		// all items are serialized into a new snapshot
+		ResetJournal();
+		SaveJournal(pDownloadQueue, true);
+		m_bJournalReady = true;
+		return true;
 	}
 
-	SaveServerStats(pNZBInfo->GetServerStats(), outfile);
+	SaveJournal(pDownloadQueue, false);
+	return true;
+}
 
-	// save file-infos
-	int iSize = 0;
-	for (FileList::iterator it = pNZBInfo->GetFileList()->begin(); it != pNZBInfo->GetFileList()->end(); it++)
+void DiskState::ResetJournal()
+{
+	m_bJournalReady = false;
+	m_lSnapshotSize = 0;
+	m_lJournalSize = 0;
+	m_QueueHashes.clear();
+	m_HistoryHashes.clear();
+	m_QueueOrder.clear();
+	m_HistoryOrder.clear();
+}
+
+/*
+ * Prepares one transaction with changed records for the journal.
+ * Only items marked as changed (see NZBInfo::GetChanged) and items not yet
+ * recorded in the list are serialized; the mark is cleared before serializing
+ * so that a change made meanwhile by another thread is saved next time.
+ * History is checked only if it was changed since the last save, history
+ * items don't change as often as queue items.
+ *
+ * After a reset the transaction contains all items and is written as new snapshot.
+ * Once the journal grows larger than the snapshot the transaction is marked
+ * for compaction; the writer thread then builds the snapshot from the records
+ * it has written before.
+ */
+void DiskState::SaveJournal(DownloadQueue* pDownloadQueue, bool bReset)
+{
+	bool bSnapshot = bReset || m_lJournalSize > m_lSnapshotSize;
+	QueueTransaction* pTransaction = new QueueTransaction(bReset, bSnapshot);
+	IDList queueOrder;
+	IDList historyOrder;
+
+	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
 	{
-		FileInfo* pFileInfo = *it;
-		if (!pFileInfo->GetDeleted())
+		NZBInfo* pNZBInfo = *it;
+		queueOrder.push_back(pNZBInfo->GetID());
+
+		// items added or returned from history have no queue record yet
+		if (pNZBInfo->GetChanged() || m_QueueHashes.find(pNZBInfo->GetID()) == m_QueueHashes.end())
 		{
-			iSize++;
+			pNZBInfo->SetChanged(false);
+			StringBuilder record;
+			SaveNZBInfo(pNZBInfo, &record, true);
+			AppendJournalRecord(pTransaction, 'Q', pNZBInfo->GetID(), &record, &m_QueueHashes);
 		}
 	}
-	fprintf(outfile, "%i\n", iSize);
-	for (FileList::iterator it = pNZBInfo->GetFileList()->begin(); it != pNZBInfo->GetFileList()->end(); it++)
+
+	bool bHistoryChanged = bReset || m_iHistoryGeneration != DownloadQueue::GetHistoryGeneration();
+	if (bHistoryChanged)
 	{
-		FileInfo* pFileInfo = *it;
-		if (!pFileInfo->GetDeleted())
+		for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
 		{
-			fprintf(outfile, "%i,%i,%i,%i\n", pFileInfo->GetID(), (int)pFileInfo->GetPaused(), 
-				(int)pFileInfo->GetTime(), (int)pFileInfo->GetExtraPriority());
+			HistoryInfo* pHistoryInfo = *it;
+			historyOrder.push_back(pHistoryInfo->GetID());
+
+			if (pHistoryInfo->GetChanged() || m_HistoryHashes.find(pHistoryInfo->GetID()) == m_HistoryHashes.end())
+			{
+				pHistoryInfo->SetChanged(false);
+				StringBuilder record;
+				SaveHistoryInfo(pHistoryInfo, &record, true);
+				AppendJournalRecord(pTransaction, 'H', pHistoryInfo->GetID(), &record, &m_HistoryHashes);
+			}
 		}
+		m_iHistoryGeneration = DownloadQueue::GetHistoryGeneration();
+	}
+
+	// items can be removed or moved between queue and history only if the order was changed
+	bool bQueueOrderChanged = queueOrder != m_QueueOrder;
+	bool bHistoryOrderChanged = bHistoryChanged && historyOrder != m_HistoryOrder;
+	if (bQueueOrderChanged || bHistoryOrderChanged)
+	{
+		AppendJournalRemoved(pTransaction, &queueOrder, bHistoryChanged ? &historyOrder : &m_HistoryOrder);
+	}
+	if (bQueueOrderChanged)
+	{
+		pTransaction->bQueueOrder = true;
+		pTransaction->queueOrder = queueOrder;
+		m_QueueOrder.swap(queueOrder);
+	}
+	if (bHistoryOrderChanged)
+	{
+		pTransaction->bHistoryOrder = true;
+		pTransaction->historyOrder = historyOrder;
+		m_HistoryOrder.swap(historyOrder);
 	}
+
+	if (pTransaction->IsEmpty() && !bSnapshot)
+	{
+		// nothing changed
+		delete pTransaction;
+		return;
+	}
+
+	m_lJournalSize = bSnapshot ? 0 : m_lJournalSize + pTransaction->CalcJournalSize();
+
+	QueueWrite(pTransaction);
 }
 
-bool DiskState::LoadNZBInfo(NZBInfo* pNZBInfo, Servers* pServers, FILE* infile, int iFormatVersion)
+/*
+ * Passes the transaction to writer thread. A reset transaction replaces
+ * pending transactions since it contains all items.
+ * If the writer thread isn't running the files are written immediately.
+ */
+void DiskState::QueueWrite(QueueTransaction* pTransaction)
 {
-	char buf[10240];
+	m_mutexPending.Lock();
 
-	if (iFormatVersion >= 24)
+	if (pTransaction->bReset)
 	{
-		int iID;
-		if (fscanf(infile, "%i\n", &iID) != 1) goto error;
-		pNZBInfo->SetID(iID);
+		ClearTransactions(&m_PendingTransactions);
 	}
+	m_PendingTransactions.push_back(pTransaction);
 
-	if (iFormatVersion >= 46)
+	bool bBackground = m_pQueueWriter && !m_pQueueWriter->IsStopped();
+	if (bBackground)
 	{
-		int iKind;
-		if (fscanf(infile, "%i\n", &iKind) != 1) goto error;
-		pNZBInfo->SetKind((NZBInfo::EKind)iKind);
+		m_condPending.Signal();
+	}
 
-		if (!fgets(buf, sizeof(buf), infile)) goto error;
-		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-		pNZBInfo->SetURL(buf);
+	m_mutexPending.Unlock();
+
+	if (!bBackground)
+	{
+		WriteQueueFiles();
 	}
+}
 
-	if (!fgets(buf, sizeof(buf), infile)) goto error;
-	if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-	pNZBInfo->SetFilename(buf);
+/*
+ * Waits in writer thread until a transaction is queued or the writer is stopped.
+ */
+void DiskState::WaitQueueWrite()
+{
+	m_mutexPending.Lock();
+	while (m_PendingTransactions.empty() && !m_pQueueWriter->IsStopped())
+	{
+		m_condPending.Wait(&m_mutexPending);
+	}
+	m_mutexPending.Unlock();
+}
 
-	if (!fgets(buf, sizeof(buf), infile)) goto error;
-	if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-	pNZBInfo->SetDestDir(buf);
+void DiskState::WakeQueueWriter()
+{
+	m_mutexPending.Lock();
+	m_condPending.Signal();
+	m_mutexPending.Unlock();
+}
 
-	if (iFormatVersion >= 27)
+void DiskState::ClearTransactions(Transactions* pTransactions)
+{
+	for (Transactions::iterator it = pTransactions->begin(); it != pTransactions->end(); it++)
 	{
-		if (!fgets(buf, sizeof(buf), infile)) goto error;
-		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-		pNZBInfo->SetFinalDir(buf);
+		delete *it;
 	}
+	pTransactions->clear();
+}
 
-	if (iFormatVersion >= 5)
+/*
+ * Writes pending transactions. Called from writer thread or directly
+ * from QueueWrite; the download queue is not locked.
+ */
+void DiskState::WriteQueueFiles()
+{
+	m_mutexWrite.Lock();
+
+	Transactions transactions;
+	m_mutexPending.Lock();
+	transactions.swap(m_PendingTransactions);
+	m_mutexPending.Unlock();
+
+	bool bSnapshot = false;
+	for (Transactions::iterator it = transactions.begin(); it != transactions.end(); it++)
 	{
-		if (!fgets(buf, sizeof(buf), infile)) goto error;
-		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-		pNZBInfo->SetQueuedFilename(buf);
+		bSnapshot |= (*it)->bSnapshot;
 	}
 
-	if (iFormatVersion >= 13)
+	// journal isn't needed if the transactions are merged into a new snapshot
+	StringBuilder journal;
+	for (Transactions::iterator it = transactions.begin(); it != transactions.end(); it++)
 	{
-		if (!fgets(buf, sizeof(buf), infile)) goto error;
-		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-		if (strlen(buf) > 0)
-		{
-			pNZBInfo->SetName(buf);
-		}
+		ApplyTransaction(*it, bSnapshot ? NULL : &journal);
 	}
 
-	if (iFormatVersion >= 4)
+	bool bOK = true;
+
+	if (bSnapshot)
 	{
-		if (!fgets(buf, sizeof(buf), infile)) goto error;
-		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-		pNZBInfo->SetCategory(buf);
+		bOK = WriteSnapshot();
+	}
+	else if (journal.GetBuffer())
+	{
+		bOK = WriteJournal(&journal);
 	}
 
-	if (true) // clang requires a block for goto to work
+	if (!bOK)
 	{
-		int iPriority = 0, iPostProcess = 0, iPostStage = 0, iDeletePaused = 0, iManyDupeFiles = 0;
-		if (iFormatVersion >= 45)
-		{
-			if (fscanf(infile, "%i,%i,%i,%i\n", &iPriority, &iPostStage, &iDeletePaused, &iManyDupeFiles) != 4) goto error;
-		}
-		else if (iFormatVersion >= 44)
+		m_mutexPending.Lock();
+		m_bWriteFailed = true;
+		m_mutexPending.Unlock();
+	}
+
+	ClearTransactions(&transactions);
+
+	m_mutexWrite.Unlock();
+}
+
+/*
+ * Updates records written to disk and formats the transaction for the journal:
+ *   "Q <id> <length>" followed by queue record (same as in file "queue");
+ *   "H <id> <length>" followed by history record;
+ *   "X <id>" - item was removed from queue and history;
+ *   "QO <count>" or "HO <count>" followed by new order of IDs;
+ *   "C" - commit mark, incomplete transactions are ignored on loading.
+ */
+void DiskState::ApplyTransaction(QueueTransaction* pTransaction, StringBuilder* pJournal)
+{
+	if (pTransaction->bReset)
+	{
+		ClearWrittenRecords();
+	}
+
+	for (QueueTransaction::Records::iterator it = pTransaction->records.begin(); it != pTransaction->records.end(); it++)
+	{
+		QueueTransaction::Record& record = *it;
+		if (pJournal)
 		{
-			if (fscanf(infile, "%i,%i,%i,%i\n", &iPriority, &iPostProcess, &iDeletePaused, &iManyDupeFiles) != 4) goto error;
+			fprintf(pJournal, "%c %i %i\n", record.cKind, record.iID, (int)strlen(record.szData));
+			pJournal->Append(record.szData);
 		}
-		else if (iFormatVersion >= 41)
+
+		char*& szWritten = m_WrittenRecords[record.iID];
+		free(szWritten);
+		szWritten = record.szData;
+		record.szData = NULL;
+	}
+
+	for (IDList::iterator it = pTransaction->removed.begin(); it != pTransaction->removed.end(); it++)
+	{
+		int iID = *it;
+		if (pJournal)
 		{
-			if (fscanf(infile, "%i,%i,%i\n", &iPostProcess, &iDeletePaused, &iManyDupeFiles) != 3) goto error;
+			fprintf(pJournal, "X %i\n", iID);
 		}
-		else if (iFormatVersion >= 40)
+
+		WrittenRecords::iterator it2 = m_WrittenRecords.find(iID);
+		if (it2 != m_WrittenRecords.end())
 		{
-			if (fscanf(infile, "%i,%i\n", &iPostProcess, &iDeletePaused) != 2) goto error;
+			free(it2->second);
+			m_WrittenRecords.erase(it2);
 		}
-		else if (iFormatVersion >= 4)
+	}
+
+	if (pTransaction->bQueueOrder)
+	{
+		if (pJournal)
 		{
-			if (fscanf(infile, "%i\n", &iPostProcess) != 1) goto error;
+			AppendJournalOrder(pJournal, "QO", &pTransaction->queueOrder);
 		}
-		pNZBInfo->SetPriority(iPriority);
-		pNZBInfo->SetDeletePaused((bool)iDeletePaused);
-		pNZBInfo->SetManyDupeFiles((bool)iManyDupeFiles);
-		if (iPostStage > 0)
+		m_WrittenQueueOrder.swap(pTransaction->queueOrder);
+	}
+
+	if (pTransaction->bHistoryOrder)
+	{
+		if (pJournal)
 		{
-			pNZBInfo->EnterPostProcess();
-			pNZBInfo->GetPostInfo()->SetStage((PostInfo::EStage)iPostStage);
+			AppendJournalOrder(pJournal, "HO", &pTransaction->historyOrder);
 		}
+		m_WrittenHistoryOrder.swap(pTransaction->historyOrder);
 	}
 
-	if (iFormatVersion >= 8 && iFormatVersion < 18)
+	if (pJournal)
 	{
-		int iParStatus;
-		if (fscanf(infile, "%i\n", &iParStatus) != 1) goto error;
-		pNZBInfo->SetParStatus((NZBInfo::EParStatus)iParStatus);
+		fprintf(pJournal, "C\n");
 	}
+}
 
-	if (iFormatVersion >= 9 && iFormatVersion < 18)
+void DiskState::ClearWrittenRecords()
+{
+	for (WrittenRecords::iterator it = m_WrittenRecords.begin(); it != m_WrittenRecords.end(); it++)
 	{
-		int iScriptStatus;
-		if (fscanf(infile, "%i\n", &iScriptStatus) != 1) goto error;
-		if (iScriptStatus > 1) iScriptStatus--;
-		pNZBInfo->GetScriptStatuses()->Add("SCRIPT", (ScriptStatus::EStatus)iScriptStatus);
+		free(it->second);
 	}
+	m_WrittenRecords.clear();
+	m_WrittenQueueOrder.clear();
+	m_WrittenHistoryOrder.clear();
+}
 
-	if (iFormatVersion >= 18)
+/*
+ * Writes file "queue" from written records and deletes the journal;
+ * empty queue and history delete both files.
+ *
+ * The snapshot gets a new generation number; a journal left from the
+ * previous generation (if the program was interrupted before it could
+ * be deleted) is not applied to the new snapshot.
+ *
+ * For safety:
+ * - first save to temp-file (queue.new)
+ * - then delete queue
+ * - then rename queue.new to queue
+ */
+bool DiskState::WriteSnapshot()
+{
+	char destFilename[1024];
+	snprintf(destFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), "queue");
+	destFilename[1024-1] = '\0';
+
+	char tempFilename[1024];
+	snprintf(tempFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), "queue.new");
+	tempFilename[1024-1] = '\0';
+
+	char journalFilename[1024];
+	snprintf(journalFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), JOURNAL_FILENAME);
+	journalFilename[1024-1] = '\0';
+
+	m_bJournalStarted = false;
+
+	if (m_WrittenQueueOrder.empty() && m_WrittenHistoryOrder.empty())
 	{
-		int iParStatus, iUnpackStatus, iScriptStatus, iMoveStatus = 0,
-			iRenameStatus = 0, iDeleteStatus = 0, iMarkStatus = 0, iUrlStatus = 0;
-		if (iFormatVersion >= 46)
-		{
-			if (fscanf(infile, "%i,%i,%i,%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus, &iMoveStatus,
-				&iRenameStatus, &iDeleteStatus, &iMarkStatus, &iUrlStatus) != 7) goto error;
-		}
-		else if (iFormatVersion >= 37)
-		{
-			if (fscanf(infile, "%i,%i,%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus,
-				&iMoveStatus, &iRenameStatus, &iDeleteStatus, &iMarkStatus) != 6) goto error;
-		}
-		else if (iFormatVersion >= 35)
-		{
-			if (fscanf(infile, "%i,%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus,
-				&iMoveStatus, &iRenameStatus, &iDeleteStatus) != 5) goto error;
-		}
-		else if (iFormatVersion >= 23)
-		{
-			if (fscanf(infile, "%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus,
-				&iMoveStatus, &iRenameStatus) != 4) goto error;
-		}
-		else if (iFormatVersion >= 21)
-		{
-			if (fscanf(infile, "%i,%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus,
-				&iScriptStatus, &iMoveStatus, &iRenameStatus) != 5) goto error;
-		}
-		else if (iFormatVersion >= 20)
-		{
-			if (fscanf(infile, "%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus,
-				&iScriptStatus, &iMoveStatus) != 4) goto error;
-		}
-		else
-		{
-			if (fscanf(infile, "%i,%i,%i\n", &iParStatus, &iUnpackStatus, &iScriptStatus) != 3) goto error;
-		}
-		pNZBInfo->SetParStatus((NZBInfo::EParStatus)iParStatus);
-		pNZBInfo->SetUnpackStatus((NZBInfo::EUnpackStatus)iUnpackStatus);
-		pNZBInfo->SetMoveStatus((NZBInfo::EMoveStatus)iMoveStatus);
-		pNZBInfo->SetRenameStatus((NZBInfo::ERenameStatus)iRenameStatus);
-		pNZBInfo->SetDeleteStatus((NZBInfo::EDeleteStatus)iDeleteStatus);
-		pNZBInfo->SetMarkStatus((NZBInfo::EMarkStatus)iMarkStatus);
-		if (pNZBInfo->GetKind() == NZBInfo::nkNzb ||
-			(NZBInfo::EUrlStatus)iUrlStatus >= NZBInfo::lsScanSkipped)
-		{
-			pNZBInfo->SetUrlStatus((NZBInfo::EUrlStatus)iUrlStatus);
-		}
-		if (iFormatVersion < 23)
-		{
-			if (iScriptStatus > 1) iScriptStatus--;
-			pNZBInfo->GetScriptStatuses()->Add("SCRIPT", (ScriptStatus::EStatus)iScriptStatus);
-		}
+		remove(destFilename);
+		remove(journalFilename);
+		return true;
 	}
 
-	if (iFormatVersion >= 35)
+	FILE* outfile = fopen(tempFilename, FOPEN_WB);
+
+	if (!outfile)
 	{
-		int iUnpackCleanedUpDisk, iHealthPaused, iAddUrlPaused = 0;
-		if (iFormatVersion >= 46)
-		{
-			if (fscanf(infile, "%i,%i,%i\n", &iUnpackCleanedUpDisk, &iHealthPaused, &iAddUrlPaused) != 3) goto error;
-		}
-		else
-		{
-			if (fscanf(infile, "%i,%i\n", &iUnpackCleanedUpDisk, &iHealthPaused) != 2) goto error;
-		}
-		pNZBInfo->SetUnpackCleanedUpDisk((bool)iUnpackCleanedUpDisk);
-		pNZBInfo->SetHealthPaused((bool)iHealthPaused);
-		pNZBInfo->SetAddUrlPaused((bool)iAddUrlPaused);
+		error("Error saving diskstate: Could not create file %s", tempFilename);
+		return false;
 	}
-	else if (iFormatVersion >= 28)
+
+	m_iGeneration++;
+
+	fprintf(outfile, "%s%i\n", FORMATVERSION_SIGNATURE, QUEUE_FORMAT_VERSION);
+	fprintf(outfile, "%u\n", m_iGeneration);
+
+	bool bOK = WriteSnapshotRecords(outfile, &m_WrittenQueueOrder) &&
+		WriteSnapshotRecords(outfile, &m_WrittenHistoryOrder);
+
+	if (g_pOptions->GetFlushQueue())
 	{
-		int iDeleted, iUnpackCleanedUpDisk, iHealthPaused, iHealthDeleted;
-		if (fscanf(infile, "%i,%i,%i,%i\n", &iDeleted, &iUnpackCleanedUpDisk, &iHealthPaused, &iHealthDeleted) != 4) goto error;
-		pNZBInfo->SetUnpackCleanedUpDisk((bool)iUnpackCleanedUpDisk);
-		pNZBInfo->SetHealthPaused((bool)iHealthPaused);
-		pNZBInfo->SetDeleteStatus(iHealthDeleted ? NZBInfo::dsHealth : iDeleted ? NZBInfo::dsManual : NZBInfo::dsNone);
+		bOK = Util::FlushFileBuffers(outfile) && bOK;
 	}
+	bOK = fclose(outfile) == 0 && bOK;
 
-	if (iFormatVersion >= 28)
+	if (!bOK)
 	{
-		int iFileCount, iParkedFileCount, iMessageCount = 0;
-		if (iFormatVersion >= 52)
-		{
-			if (fscanf(infile, "%i,%i,%i\n", &iFileCount, &iParkedFileCount, &iMessageCount) != 3) goto error;
-		}
-		else
-		{
-			if (fscanf(infile, "%i,%i\n", &iFileCount, &iParkedFileCount) != 2) goto error;
-		}
+		error("Error saving diskstate: Could not write file %s", tempFilename);
+		return false;
+	}
 
-		pNZBInfo->SetFileCount(iFileCount);
-		pNZBInfo->SetParkedFileCount(iParkedFileCount);
-		pNZBInfo->SetMessageCount(iMessageCount);
+	// now rename to dest file name
+	remove(destFilename);
+	if (rename(tempFilename, destFilename))
+	{
+		error("Error saving diskstate: Could not rename file %s to %s", tempFilename, destFilename);
+		return false;
 	}
-	else
+
+	remove(journalFilename);
+
+	return true;
+}
+
+bool DiskState::WriteSnapshotRecords(FILE* outfile, IDList* pOrder)
+{
+	fprintf(outfile, "%i\n", (int)pOrder->size());
+	for (IDList::iterator it = pOrder->begin(); it != pOrder->end(); it++)
 	{
-		if (iFormatVersion >= 19)
+		WrittenRecords::iterator it2 = m_WrittenRecords.find(*it);
+		if (it2 == m_WrittenRecords.end())
 		{
-			int iUnpackCleanedUpDisk;
-			if (fscanf(infile, "%i\n", &iUnpackCleanedUpDisk) != 1) goto error;
-			pNZBInfo->SetUnpackCleanedUpDisk((bool)iUnpackCleanedUpDisk);
+			error("Error saving diskstate: Record for item %i is missing", *it);
+			return false;
 		}
-		
-		int iFileCount;
-		if (fscanf(infile, "%i\n", &iFileCount) != 1) goto error;
-		pNZBInfo->SetFileCount(iFileCount);
 
-		if (iFormatVersion >= 10)
+		int iLen = strlen(it2->second);
+		if (fwrite(it2->second, 1, iLen, outfile) != (size_t)iLen)
 		{
-			if (fscanf(infile, "%i\n", &iFileCount) != 1) goto error;
-			pNZBInfo->SetParkedFileCount(iFileCount);
+			return false;
 		}
 	}
+	return true;
+}
 
-	if (iFormatVersion >= 44)
+/*
+ * Appends transactions to the journal. A new journal is started after
+ * each snapshot, it begins with the generation of the snapshot.
+ */
+bool DiskState::WriteJournal(StringBuilder* pJournal)
+{
+	char szFilename[1024];
+	snprintf(szFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), JOURNAL_FILENAME);
+	szFilename[1024-1] = '\0';
+
+	FILE* outfile = fopen(szFilename, m_bJournalStarted ? FOPEN_AB : FOPEN_WB);
+	if (!outfile)
 	{
-		int iMinTime, iMaxTime;
-		if (fscanf(infile, "%i,%i\n", &iMinTime, &iMaxTime) != 2) goto error;
-		pNZBInfo->SetMinTime((time_t)iMinTime);
-		pNZBInfo->SetMaxTime((time_t)iMaxTime);
+		error("Error saving diskstate: Could not open file %s", szFilename);
+		return false;
 	}
 
-	if (iFormatVersion >= 51)
+	bool bOK = true;
+	if (!m_bJournalStarted)
 	{
-		int iParFull, iForceParFull, iForceRepair;
-		if (fscanf(infile, "%i,%i,%i\n", &iParFull, &iForceParFull, &iForceRepair) != 3) goto error;
-		pNZBInfo->SetParFull((bool)iParFull);
-		if (pNZBInfo->GetPostInfo())
+		bOK = fprintf(outfile, "%s%i\n", FORMATVERSION_SIGNATURE, QUEUE_FORMAT_VERSION) > 0 &&
+			fprintf(outfile, "%u\n", m_iGeneration) > 0;
+	}
+
+	int iLen = strlen(pJournal->GetBuffer());
+	bOK = bOK && fwrite(pJournal->GetBuffer(), 1, iLen, outfile) == (size_t)iLen;
+	if (g_pOptions->GetFlushQueue())
+	{
+		bOK = Util::FlushFileBuffers(outfile) && bOK;
+	}
+	bOK = fclose(outfile) == 0 && bOK;
+
+	if (!bOK)
+	{
+		error("Error saving diskstate: Could not write file %s", szFilename);
+	}
+
+	m_bJournalStarted = bOK;
+
+	return bOK;
+}
+
+/*
+ * Adds the record to the transaction unless it is the same as the one already
+ * saved; a changed item often has the same record if only unsaved fields were changed.
+ * Records are compared by length and 64-bit hash.
+ */
+void DiskState::AppendJournalRecord(QueueTransaction* pTransaction, char cKind, int iID, StringBuilder* pRecord,
+	RecordHashes* pHashes)
+{
+	int iLen = strlen(pRecord->GetBuffer());
+	unsigned long long lHash = Util::HashFNV64(pRecord->GetBuffer(), iLen);
+
+	RecordHash& recordHash = (*pHashes)[iID];
+	if (recordHash.iLen == iLen && recordHash.lHash == lHash)
+	{
+		return;
+	}
+
+	m_lSnapshotSize += iLen - recordHash.iLen;
+	recordHash.iLen = iLen;
+	recordHash.lHash = lHash;
+
+	QueueTransaction::Record record = { cKind, iID, strdup(pRecord->GetBuffer()) };
+	pTransaction->records.push_back(record);
+}
+
+/*
+ * Forgets records of items which are no longer in their lists. Items which
+ * are neither in queue nor in history are marked as removed in the transaction.
+ */
+void DiskState::AppendJournalRemoved(QueueTransaction* pTransaction, IDList* pQueueOrder, IDList* pHistoryOrder)
+{
+	std::set<int> queueIDs(pQueueOrder->begin(), pQueueOrder->end());
+	std::set<int> historyIDs(pHistoryOrder->begin(), pHistoryOrder->end());
+	std::set<int> removedIDs;
+
+	for (RecordHashes::iterator it = m_QueueHashes.begin(); it != m_QueueHashes.end(); )
+	{
+		if (queueIDs.find(it->first) == queueIDs.end())
 		{
-			pNZBInfo->GetPostInfo()->SetForceParFull((bool)iForceParFull);
-			pNZBInfo->GetPostInfo()->SetForceRepair((bool)iForceRepair);
+			if (historyIDs.find(it->first) == historyIDs.end())
+			{
+				removedIDs.insert(it->first);
+			}
+			m_lSnapshotSize -= it->second.iLen;
+			m_QueueHashes.erase(it++);
+		}
+		else
+		{
+			it++;
 		}
 	}
 
-	if (true) // clang requires a block for goto to work
+	for (RecordHashes::iterator it = m_HistoryHashes.begin(); it != m_HistoryHashes.end(); )
 	{
-		unsigned int iFullContentHash = 0, iFilteredContentHash = 0;
-		if (iFormatVersion >= 34)
+		if (historyIDs.find(it->first) == historyIDs.end())
 		{
-			if (fscanf(infile, "%u,%u\n", &iFullContentHash, &iFilteredContentHash) != 2) goto error;
+			if (queueIDs.find(it->first) == queueIDs.end())
+			{
+				removedIDs.insert(it->first);
+			}
+			m_lSnapshotSize -= it->second.iLen;
+			m_HistoryHashes.erase(it++);
 		}
-		else if (iFormatVersion >= 32)
+		else
 		{
-			if (fscanf(infile, "%u\n", &iFullContentHash) != 1) goto error;
+			it++;
 		}
-		pNZBInfo->SetFullContentHash(iFullContentHash);
-		pNZBInfo->SetFilteredContentHash(iFilteredContentHash);
 	}
 
-	if (iFormatVersion >= 28)
-	{
-		unsigned long High1, Low1, High2, Low2, High3, Low3;
-		if (fscanf(infile, "%lu,%lu,%lu,%lu,%lu,%lu\n", &High1, &Low1, &High2, &Low2, &High3, &Low3) != 6) goto error;
-		pNZBInfo->SetSize(Util::JoinInt64(High1, Low1));
-		pNZBInfo->SetSuccessSize(Util::JoinInt64(High2, Low2));
-		pNZBInfo->SetFailedSize(Util::JoinInt64(High3, Low3));
-		pNZBInfo->SetCurrentSuccessSize(pNZBInfo->GetSuccessSize());
-		pNZBInfo->SetCurrentFailedSize(pNZBInfo->GetFailedSize());
+	pTransaction->removed.assign(removedIDs.begin(), removedIDs.end());
+}
 
-		if (fscanf(infile, "%lu,%lu,%lu,%lu,%lu,%lu\n", &High1, &Low1, &High2, &Low2, &High3, &Low3) != 6) goto error;
-		pNZBInfo->SetParSize(Util::JoinInt64(High1, Low1));
-		pNZBInfo->SetParSuccessSize(Util::JoinInt64(High2, Low2));
-		pNZBInfo->SetParFailedSize(Util::JoinInt64(High3, Low3));
-		pNZBInfo->SetParCurrentSuccessSize(pNZBInfo->GetParSuccessSize());
-		pNZBInfo->SetParCurrentFailedSize(pNZBInfo->GetParFailedSize());
-	}
-	else
-	{
-		unsigned long High, Low;
-		if (fscanf(infile, "%lu,%lu\n", &High, &Low) != 2) goto error;
-		pNZBInfo->SetSize(Util::JoinInt64(High, Low));
-	}
-	
-	if (iFormatVersion >= 30)
+void DiskState::AppendJournalOrder(StringBuilder* pJournal, const char* szKind, IDList* pOrder)
+{
+	fprintf(pJournal, "%s %i\n", szKind, (int)pOrder->size());
+	for (IDList::iterator it = pOrder->begin(); it != pOrder->end(); it++)
 	{
-		int iTotalArticles, iSuccessArticles, iFailedArticles;
-		if (fscanf(infile, "%i,%i,%i\n", &iTotalArticles, &iSuccessArticles, &iFailedArticles) != 3) goto error;
-		pNZBInfo->SetTotalArticles(iTotalArticles);
-		pNZBInfo->SetSuccessArticles(iSuccessArticles);
-		pNZBInfo->SetFailedArticles(iFailedArticles);
-		pNZBInfo->SetCurrentSuccessArticles(iSuccessArticles);
-		pNZBInfo->SetCurrentFailedArticles(iFailedArticles);
+		fprintf(pJournal, "%i\n", *it);
 	}
+}
 
-	if (iFormatVersion >= 31)
+/*
+ * Reads the journal and remembers positions of records from committed transactions.
+ * Returns false if there is no journal or if it doesn't belong to the loaded queue file.
+ */
+bool DiskState::ScanJournal(JournalIndex* pJournalIndex, unsigned int iGeneration)
+{
+	char szFilename[1024];
+	snprintf(szFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), JOURNAL_FILENAME);
+	szFilename[1024-1] = '\0';
+
+	FILE* infile = fopen(szFilename, FOPEN_RB);
+	if (!infile)
 	{
-		if (!fgets(buf, sizeof(buf), infile)) goto error;
-		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-		if (iFormatVersion < 36) ConvertDupeKey(buf, sizeof(buf));
-		pNZBInfo->SetDupeKey(buf);
+		return false;
 	}
 
-	if (true) // clang requires a block for goto to work
+	char buf[1024];
+	unsigned int iJournalGeneration = 0;
+	if (fgets(buf, sizeof(buf), infile))
 	{
-		int iDupeMode = 0, iDupeScore = 0;
-		if (iFormatVersion >= 39)
-		{
-			if (fscanf(infile, "%i,%i\n", &iDupeMode, &iDupeScore) != 2) goto error;
-		}
-		else if (iFormatVersion >= 31)
+		pJournalIndex->iFormatVersion = ParseFormatVersion(buf);
+		if (fscanf(infile, "%u\n", &iJournalGeneration) != 1)
 		{
-			int iDupe;
-			if (fscanf(infile, "%i,%i,%i\n", &iDupe, &iDupeMode, &iDupeScore) != 3) goto error;
+			iJournalGeneration = 0;
 		}
-		pNZBInfo->SetDupeMode((EDupeMode)iDupeMode);
-		pNZBInfo->SetDupeScore(iDupeScore);
 	}
 
-	if (iFormatVersion >= 48)
+	if (pJournalIndex->iFormatVersion != QUEUE_FORMAT_VERSION || iJournalGeneration != iGeneration)
 	{
-		unsigned long High1, Low1, iDownloadSec, iPostTotalSec, iParSec, iRepairSec, iUnpackSec;
-		if (fscanf(infile, "%lu,%lu,%i,%i,%i,%i,%i\n", &High1, &Low1, &iDownloadSec, &iPostTotalSec, &iParSec, &iRepairSec, &iUnpackSec) != 7) goto error;
-		pNZBInfo->SetDownloadedSize(Util::JoinInt64(High1, Low1));
-		pNZBInfo->SetDownloadSec(iDownloadSec);
-		pNZBInfo->SetPostTotalSec(iPostTotalSec);
-		pNZBInfo->SetParSec(iParSec);
-		pNZBInfo->SetRepairSec(iRepairSec);
-		pNZBInfo->SetUnpackSec(iUnpackSec);
+		fclose(infile);
+		warn("Discarding obsolete queue journal %s", szFilename);
+		remove(szFilename);
+		return false;
+	}
+
+	JournalIndex::Records records;
+	bool bQueueOrder = false;
+	bool bHistoryOrder = false;
+	IDList queueOrder;
+	IDList historyOrder;
+	int iTransactions = 0;
+
+	while (fgets(buf, sizeof(buf), infile))
+	{
+		int iID, iLen, iCount;
+		char cKind;
+		if (sscanf(buf, "%c %i %i", &cKind, &iID, &iLen) == 3 && (cKind == 'Q' || cKind == 'H'))
+		{
+			JournalIndex::Record& record = records[iID];
+			record.cKind = cKind;
+			record.lOffset = ftell(infile);
+			if (fseek(infile, iLen, SEEK_CUR)) break;
+		}
+		else if (sscanf(buf, "X %i", &iID) == 1)
+		{
+			JournalIndex::Record& record = records[iID];
+			record.cKind = 'X';
+			record.lOffset = 0;
+		}
+		else if (sscanf(buf, "QO %i", &iCount) == 1 || sscanf(buf, "HO %i", &iCount) == 1)
+		{
+			bool bQueue = buf[0] == 'Q';
+			IDList* pOrder = bQueue ? &queueOrder : &historyOrder;
+			pOrder->clear();
+			bool bOK = true;
+			for (int i = 0; i < iCount && bOK; i++)
+			{
+				bOK = fscanf(infile, "%i\n", &iID) == 1;
+				pOrder->push_back(iID);
+			}
+			if (!bOK) break;
+			if (bQueue)
+			{
+				bQueueOrder = true;
+			}
+			else
+			{
+				bHistoryOrder = true;
+			}
+		}
+		else if (!strcmp(buf, "C\n"))
+		{
+			// transaction complete
+			for (JournalIndex::Records::iterator it = records.begin(); it != records.end(); it++)
+			{
+				pJournalIndex->records[it->first] = it->second;
+			}
+			if (bQueueOrder)
+			{
+				pJournalIndex->bQueueOrder = true;
+				pJournalIndex->queueOrder = queueOrder;
+			}
+			if (bHistoryOrder)
+			{
+				pJournalIndex->bHistoryOrder = true;
+				pJournalIndex->historyOrder = historyOrder;
+			}
+			records.clear();
+			bQueueOrder = false;
+			bHistoryOrder = false;
+			iTransactions++;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	fclose(infile);
+
+	if (!records.empty() || bQueueOrder || bHistoryOrder)
+	{
+		warn("Incomplete transaction in queue journal %s was ignored", szFilename);
+	}
+
+	detail("Loaded %i transaction(s) from queue journal", iTransactions);
+
+	return true;
+}
+
+/*
+ * Returns true if the item loaded from queue file has a newer version in the journal.
+ * File-infos of such items are not loaded since they may be already deleted.
+ */
+bool DiskState::IsSuperseded(int iID)
+{
+	return m_pJournalIndex && m_pJournalIndex->records.find(iID) != m_pJournalIndex->records.end();
+}
+
+bool DiskState::ApplyJournal(DownloadQueue* pDownloadQueue, JournalIndex* pJournalIndex, Servers* pServers)
+{
+	typedef std::map<int, NZBInfo*> NZBMap;
+	typedef std::map<int, HistoryInfo*> HistoryMap;
+
+	char szFilename[1024];
+	snprintf(szFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), JOURNAL_FILENAME);
+	szFilename[1024-1] = '\0';
+
+	FILE* infile = fopen(szFilename, FOPEN_RB);
+	if (!infile)
+	{
+		error("Error reading diskstate: could not open file %s", szFilename);
+		return false;
+	}
+
+	bool bOK = true;
+	NZBList* pQueue = pDownloadQueue->GetQueue();
+	HistoryList* pHistory = pDownloadQueue->GetHistory();
+	NZBMap queueMap;
+	HistoryMap historyMap;
+	IDList queueOrder;
+	IDList historyOrder;
+
+	for (NZBList::iterator it = pQueue->begin(); it != pQueue->end(); it++)
+	{
+		NZBInfo* pNZBInfo = *it;
+		queueMap[pNZBInfo->GetID()] = pNZBInfo;
+		queueOrder.push_back(pNZBInfo->GetID());
+	}
+	pQueue->clear();
+
+	for (HistoryList::iterator it = pHistory->begin(); it != pHistory->end(); it++)
+	{
+		HistoryInfo* pHistoryInfo = *it;
+		historyMap[pHistoryInfo->GetID()] = pHistoryInfo;
+		historyOrder.push_back(pHistoryInfo->GetID());
+	}
+	pHistory->clear();
+
+	for (JournalIndex::Records::iterator it = pJournalIndex->records.begin(); it != pJournalIndex->records.end() && bOK; it++)
+	{
+		int iID = it->first;
+		JournalIndex::Record& record = it->second;
+
+		// discard old version of the item
+		NZBMap::iterator itQueue = queueMap.find(iID);
+		if (itQueue != queueMap.end())
+		{
+			delete itQueue->second;
+			queueMap.erase(itQueue);
+		}
+		HistoryMap::iterator itHistory = historyMap.find(iID);
+		if (itHistory != historyMap.end())
+		{
+			delete itHistory->second;
+			historyMap.erase(itHistory);
+		}
+
+		if (record.cKind == 'Q')
+		{
+			NZBInfo* pNZBInfo = new NZBInfo();
+			bOK = !fseek(infile, record.lOffset, SEEK_SET) &&
+				LoadNZBInfo(pNZBInfo, pServers, infile, pJournalIndex->iFormatVersion);
+			if (!bOK)
+			{
+				delete pNZBInfo;
+				break;
+			}
+			queueMap[iID] = pNZBInfo;
+			queueOrder.push_back(iID);
+		}
+		else if (record.cKind == 'H')
+		{
+			HistoryInfo* pHistoryInfo = NULL;
+			bOK = !fseek(infile, record.lOffset, SEEK_SET) &&
+				(pHistoryInfo = LoadHistoryInfo(NULL, pServers, infile, pJournalIndex->iFormatVersion)) != NULL;
+			if (!bOK)
+			{
+				break;
+			}
+			historyMap[iID] = pHistoryInfo;
+			historyOrder.push_back(iID);
+		}
+	}
+
+	fclose(infile);
+
+	if (pJournalIndex->bQueueOrder)
+	{
+		queueOrder = pJournalIndex->queueOrder;
+	}
+	if (pJournalIndex->bHistoryOrder)
+	{
+		historyOrder = pJournalIndex->historyOrder;
+	}
+
+	// rebuild lists in saved order; items not listed in the order (should never happen) are put at the end
+	for (IDList::iterator it = queueOrder.begin(); it != queueOrder.end(); it++)
+	{
+		NZBMap::iterator itQueue = queueMap.find(*it);
+		if (itQueue != queueMap.end())
+		{
+			pQueue->push_back(itQueue->second);
+			queueMap.erase(itQueue);
+		}
+	}
+	for (NZBMap::iterator it = queueMap.begin(); it != queueMap.end(); it++)
+	{
+		pQueue->push_back(it->second);
+	}
+
+	for (IDList::iterator it = historyOrder.begin(); it != historyOrder.end(); it++)
+	{
+		HistoryMap::iterator itHistory = historyMap.find(*it);
+		if (itHistory != historyMap.end())
+		{
+			pHistory->push_back(itHistory->second);
+			historyMap.erase(itHistory);
+		}
+	}
+	for (HistoryMap::iterator it = historyMap.begin(); it != historyMap.end(); it++)
+	{
+		pHistory->push_back(it->second);
+	}
+
+	if (!bOK)
+	{
+		error("Error reading diskstate for file %s", szFilename);
+	}
+
+	return bOK;
+}
+
+bool DiskState::LoadDownloadQueue(DownloadQueue* pDownloadQueue, Servers* pServers)
+{
+	debug("Loading queue from disk");
+
+	bool bOK = false;
+	int iFormatVersion = 0;
+
+	char fileName[1024];
+	snprintf(fileName, 1024, "%s%s", g_pOptions->GetQueueDir(), "queue");
+	fileName[1024-1] = '\0';
+
+	FILE* infile = fopen(fileName, FOPEN_RB);
+
+	if (!infile)
+	{
+		error("Error reading diskstate: could not open file %s", fileName);
+		return false;
+	}
+
+	char FileSignatur[128];
+	fgets(FileSignatur, sizeof(FileSignatur), infile);
+	iFormatVersion = ParseFormatVersion(FileSignatur);
+	if (iFormatVersion < 3 || iFormatVersion > QUEUE_FORMAT_VERSION)
+	{
+		error("Could not load diskstate due to file version mismatch");
+		fclose(infile);
+		return false;
+	}
+
+	NZBList nzbList(false);
+	NZBList sortList(false);
+	FileList summaryList(false);
+	JournalIndex journalIndex;
+	bool bJournal = false;
+
+	m_pSummaryList = &summaryList;
+
+	if (iFormatVersion >= 54)
+	{
+		unsigned int iGeneration;
+		if (fscanf(infile, "%u\n", &iGeneration) != 1) goto error;
+		bJournal = ScanJournal(&journalIndex, iGeneration);
+		m_pJournalIndex = bJournal ? &journalIndex : NULL;
+		m_iGeneration = iGeneration;
+	}
+
+	if (iFormatVersion < 43)
+	{
+		// load nzb-infos
+		if (!LoadNZBList(&nzbList, pServers, infile, iFormatVersion)) goto error;
+
+		// load file-infos
+		if (!LoadFileQueue12(&nzbList, &sortList, infile, iFormatVersion)) goto error;
+	}
+	else
+	{
+		if (!LoadNZBList(pDownloadQueue->GetQueue(), pServers, infile, iFormatVersion)) goto error;
+	}
+
+	if (iFormatVersion >= 7 && iFormatVersion < 45)
+	{
+		// load post-queue from v12
+		if (!LoadPostQueue12(pDownloadQueue, &nzbList, infile, iFormatVersion)) goto error;
+	}
+	else if (iFormatVersion < 7)
+	{
+		// load post-queue from v5
+		LoadPostQueue5(pDownloadQueue, &nzbList);
+	}
+
+	if (iFormatVersion >= 15 && iFormatVersion < 46)
+	{
+		// load url-queue
+		if (!LoadUrlQueue12(pDownloadQueue, infile, iFormatVersion)) goto error;
+	}
+
+	if (iFormatVersion >= 9)
+	{
+		// load history
+		if (!LoadHistory(pDownloadQueue, &nzbList, pServers, infile, iFormatVersion)) goto error;
+	}
+
+	// file summaries must be loaded before the journal can delete or move the items
+	m_pSummaryList = NULL;
+	LoadFileSummaries(&summaryList);
+
+	if (bJournal)
+	{
+		// apply changes saved after the queue file was written
+		m_pJournalIndex = NULL;
+		if (!ApplyJournal(pDownloadQueue, &journalIndex, pServers)) goto error;
+	}
+
+	if (iFormatVersion >= 9 && iFormatVersion < 43)
+	{
+		// load parked file-infos
+		if (!LoadFileQueue12(&nzbList, NULL, infile, iFormatVersion)) goto error;
+	}
+
+	if (iFormatVersion < 29)
+	{
+		CalcCriticalHealth(&nzbList);
+	}
+
+	if (iFormatVersion < 43)
+	{
+		// finalize queue reading
+		CompleteNZBList12(pDownloadQueue, &sortList, iFormatVersion);
+	}
+
+	if (iFormatVersion < 47)
+	{
+		CompleteDupList12(pDownloadQueue, iFormatVersion);
+	}
+
+	if (!LoadAllFileStates(pDownloadQueue, pServers)) goto error;
+
+	bOK = true;
+
+error:
+
+	fclose(infile);
+	if (!bOK)
+	{
+		error("Error reading diskstate for file %s", fileName);
+	}
+
+	// the queue is written into a new snapshot on next save
+	m_pJournalIndex = NULL;
+	m_pSummaryList = NULL;
+	ResetJournal();
+
+	pDownloadQueue->InvalidateIndex();
+
+	NZBInfo::ResetGenID(true);
+	FileInfo::ResetGenID(true);
+
+	if (iFormatVersion > 0)
+	{
+		CalcFileStats(pDownloadQueue, iFormatVersion);
+	}
+
+	return bOK;
+}
+
+void DiskState::CompleteNZBList12(DownloadQueue* pDownloadQueue, NZBList* pNZBList, int iFormatVersion)
+{
+	// put all NZBs referenced from file queue into pDownloadQueue->GetQueue()
+	for (NZBList::iterator it = pNZBList->begin(); it != pNZBList->end(); it++)
+	{
+		NZBInfo* pNZBInfo = *it;
+		pDownloadQueue->GetQueue()->push_back(pNZBInfo);
+	}
+
+	if (31 <= iFormatVersion && iFormatVersion < 42)
+	{
+		// due to a bug in r811 (v12-testing) new NZBIDs were generated on each refresh of web-ui
+		// this resulted in very high numbers for NZBIDs
+		// here we renumber NZBIDs in order to keep them low.
+		NZBInfo::ResetGenID(false);
+		int iID = 1;
+		for (NZBList::iterator it = pNZBList->begin(); it != pNZBList->end(); it++)
+		{
+			NZBInfo* pNZBInfo = *it;
+			pNZBInfo->SetID(iID++);
+		}
+	}
+}
+
+void DiskState::CompleteDupList12(DownloadQueue* pDownloadQueue, int iFormatVersion)
+{
+	NZBInfo::ResetGenID(true);
+
+	for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
+	{
+		HistoryInfo* pHistoryInfo = *it;
+
+		if (pHistoryInfo->GetKind() == HistoryInfo::hkDup)
+		{
+			pHistoryInfo->GetDupInfo()->SetID(NZBInfo::GenerateID());
+		}
+	}
+}
+
+bool DiskState::LoadNZBList(NZBList* pNZBList, Servers* pServers, FILE* infile, int iFormatVersion)
+{
+	debug("Loading nzb list from disk");
+
+	// load nzb-infos
+	int size;
+	if (fscanf(infile, "%i\n", &size) != 1) goto error;
+	for (int i = 0; i < size; i++)
+	{
+		NZBInfo* pNZBInfo = new NZBInfo();
+		pNZBList->push_back(pNZBInfo);
+		if (!LoadNZBInfo(pNZBInfo, pServers, infile, iFormatVersion)) goto error;
+	}
+
+	return true;
+
+error:
+	error("Error reading nzb list from disk");
+	return false;
+}
+
+void DiskState::SaveNZBInfo(NZBInfo* pNZBInfo, StringBuilder* outfile, bool bFileInfos)
+{
+	fprintf(outfile, "%i\n", pNZBInfo->GetID());
+	fprintf(outfile, "%i\n", (int)pNZBInfo->GetKind());
+	fprintf(outfile, "%s\n", pNZBInfo->GetURL());
+	fprintf(outfile, "%s\n", pNZBInfo->GetFilename());
+	fprintf(outfile, "%s\n", pNZBInfo->GetDestDir());
+	fprintf(outfile, "%s\n", pNZBInfo->GetFinalDir());
+	fprintf(outfile, "%s\n", pNZBInfo->GetQueuedFilename());
+	fprintf(outfile, "%s\n", pNZBInfo->GetName());
+	fprintf(outfile, "%s\n", pNZBInfo->GetCategory());
+	fprintf(outfile, "%i,%i,%i,%i\n", (int)pNZBInfo->GetPriority(), 
+		pNZBInfo->GetPostInfo() ? (int)pNZBInfo->GetPostInfo()->GetStage() + 1 : 0,
+		(int)pNZBInfo->GetDeletePaused(), (int)pNZBInfo->GetManyDupeFiles());
+	fprintf(outfile, "%i,%i,%i,%i,%i,%i,%i\n", (int)pNZBInfo->GetParStatus(), (int)pNZBInfo->GetUnpackStatus(),
+		(int)pNZBInfo->GetMoveStatus(), (int)pNZBInfo->GetRenameStatus(), (int)pNZBInfo->GetDeleteStatus(),
+		(int)pNZBInfo->GetMarkStatus(), (int)pNZBInfo->GetUrlStatus());
+	fprintf(outfile, "%i,%i,%i\n", (int)pNZBInfo->GetUnpackCleanedUpDisk(), (int)pNZBInfo->GetHealthPaused(),
+		(int)pNZBInfo->GetAddUrlPaused());
+	fprintf(outfile, "%i,%i,%i\n", pNZBInfo->GetFileCount(), pNZBInfo->GetParkedFileCount(), pNZBInfo->GetMessageCount());
+	fprintf(outfile, "%i,%i\n", (int)pNZBInfo->GetMinTime(), (int)pNZBInfo->GetMaxTime());
+	fprintf(outfile, "%i,%i,%i\n", (int)pNZBInfo->GetParFull(), 
+		pNZBInfo->GetPostInfo() ? (int)pNZBInfo->GetPostInfo()->GetForceParFull() : 0,
+		pNZBInfo->GetPostInfo() ? (int)pNZBInfo->GetPostInfo()->GetForceRepair() : 0);
+
+	fprintf(outfile, "%u,%u\n", pNZBInfo->GetFullContentHash(), pNZBInfo->GetFilteredContentHash());
+
+	unsigned long High1, Low1, High2, Low2, High3, Low3;
+	Util::SplitInt64(pNZBInfo->GetSize(), &High1, &Low1);
+	Util::SplitInt64(pNZBInfo->GetSuccessSize(), &High2, &Low2);
+	Util::SplitInt64(pNZBInfo->GetFailedSize(), &High3, &Low3);
+	fprintf(outfile, "%lu,%lu,%lu,%lu,%lu,%lu\n", High1, Low1, High2, Low2, High3, Low3);
+
+	Util::SplitInt64(pNZBInfo->GetParSize(), &High1, &Low1);
+	Util::SplitInt64(pNZBInfo->GetParSuccessSize(), &High2, &Low2);
+	Util::SplitInt64(pNZBInfo->GetParFailedSize(), &High3, &Low3);
+	fprintf(outfile, "%lu,%lu,%lu,%lu,%lu,%lu\n", High1, Low1, High2, Low2, High3, Low3);
+
+	fprintf(outfile, "%i,%i,%i\n", pNZBInfo->GetTotalArticles(), pNZBInfo->GetSuccessArticles(), pNZBInfo->GetFailedArticles());
+
+	fprintf(outfile, "%s\n", pNZBInfo->GetDupeKey());
+	fprintf(outfile, "%i,%i\n", (int)pNZBInfo->GetDupeMode(), pNZBInfo->GetDupeScore());
+
+	Util::SplitInt64(pNZBInfo->GetDownloadedSize(), &High1, &Low1);
+	fprintf(outfile, "%lu,%lu,%i,%i,%i,%i,%i\n", High1, Low1, pNZBInfo->GetDownloadSec(), pNZBInfo->GetPostTotalSec(),
+		pNZBInfo->GetParSec(), pNZBInfo->GetRepairSec(), pNZBInfo->GetUnpackSec());
+
+	fprintf(outfile, "%i\n", (int)pNZBInfo->GetCompletedFiles()->size());
+	for (CompletedFiles::iterator it = pNZBInfo->GetCompletedFiles()->begin(); it != pNZBInfo->GetCompletedFiles()->end(); it++)
+	{
+		CompletedFile* pCompletedFile = *it;
+		fprintf(outfile, "%i,%i,%lu,%s\n", pCompletedFile->GetID(), (int)pCompletedFile->GetStatus(),
+			pCompletedFile->GetCrc(), pCompletedFile->GetFileName());
+	}
+
+	fprintf(outfile, "%i\n", (int)pNZBInfo->GetParameters()->size());
+	for (NZBParameterList::iterator it = pNZBInfo->GetParameters()->begin(); it != pNZBInfo->GetParameters()->end(); it++)
+	{
+		NZBParameter* pParameter = *it;
+		fprintf(outfile, "%s=%s\n", pParameter->GetName(), pParameter->GetValue());
+	}
+
+	fprintf(outfile, "%i\n", (int)pNZBInfo->GetScriptStatuses()->size());
+	for (ScriptStatusList::iterator it = pNZBInfo->GetScriptStatuses()->begin(); it != pNZBInfo->GetScriptStatuses()->end(); it++)
+	{
+		ScriptStatus* pScriptStatus = *it;
+		fprintf(outfile, "%i,%s\n", pScriptStatus->GetStatus(), pScriptStatus->GetName());
+	}
+
+	SaveServerStats(pNZBInfo->GetServerStats(), outfile);
+
+	// save file-infos
+	int iSize = 0;
+	for (FileList::iterator it = pNZBInfo->GetFileList()->begin(); it != pNZBInfo->GetFileList()->end() && bFileInfos; it++)
+	{
+		FileInfo* pFileInfo = *it;
+		if (!pFileInfo->GetDeleted())
+		{
+			iSize++;
+		}
+	}
+	fprintf(outfile, "%i\n", iSize);
+	for (FileList::iterator it = pNZBInfo->GetFileList()->begin(); it != pNZBInfo->GetFileList()->end() && bFileInfos; it++)
+	{
+		FileInfo* pFileInfo = *it;
+		if (!pFileInfo->GetDeleted())
+		{
+			fprintf(outfile, "%i,%i,%i,%i\n", pFileInfo->GetID(), (int)pFileInfo->GetPaused(), 
+				(int)pFileInfo->GetTime(), (int)pFileInfo->GetExtraPriority());
+		}
+	}
+}
+
+bool DiskState::LoadNZBInfo(NZBInfo* pNZBInfo, Servers* pServers, FILE* infile, int iFormatVersion)
+{
+	char buf[10240];
+
+	if (iFormatVersion >= 24)
+	{
+		int iID;
+		if (fscanf(infile, "%i\n", &iID) != 1) goto error;
+		pNZBInfo->SetID(iID);
+	}
+
+	if (iFormatVersion >= 46)
+	{
+		int iKind;
+		if (fscanf(infile, "%i\n", &iKind) != 1) goto error;
+		pNZBInfo->SetKind((NZBInfo::EKind)iKind);
+
+		if (!fgets(buf, sizeof(buf), infile)) goto error;
+		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+		pNZBInfo->SetURL(buf);
+	}
+
+	if (!fgets(buf, sizeof(buf), infile)) goto error;
+	if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+	pNZBInfo->SetFilename(buf);
+
+	if (!fgets(buf, sizeof(buf), infile)) goto error;
+	if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+	pNZBInfo->SetDestDir(buf);
+
+	if (iFormatVersion >= 27)
+	{
+		if (!fgets(buf, sizeof(buf), infile)) goto error;
+		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+		pNZBInfo->SetFinalDir(buf);
+	}
+
+	if (iFormatVersion >= 5)
+	{
+		if (!fgets(buf, sizeof(buf), infile)) goto error;
+		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+		pNZBInfo->SetQueuedFilename(buf);
+	}
+
+	if (iFormatVersion >= 13)
+	{
+		if (!fgets(buf, sizeof(buf), infile)) goto error;
+		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+		if (strlen(buf) > 0)
+		{
+			pNZBInfo->SetName(buf);
+		}
+	}
+
+	if (iFormatVersion >= 4)
+	{
+		if (!fgets(buf, sizeof(buf), infile)) goto error;
+		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+		pNZBInfo->SetCategory(buf);
+	}
+
+	if (true) // clang requires a block for goto to work
+	{
+		int iPriority = 0, iPostProcess = 0, iPostStage = 0, iDeletePaused = 0, iManyDupeFiles = 0;
+		if (iFormatVersion >= 45)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i\n", &iPriority, &iPostStage, &iDeletePaused, &iManyDupeFiles) != 4) goto error;
+		}
+		else if (iFormatVersion >= 44)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i\n", &iPriority, &iPostProcess, &iDeletePaused, &iManyDupeFiles) != 4) goto error;
+		}
+		else if (iFormatVersion >= 41)
+		{
+			if (fscanf(infile, "%i,%i,%i\n", &iPostProcess, &iDeletePaused, &iManyDupeFiles) != 3) goto error;
+		}
+		else if (iFormatVersion >= 40)
+		{
+			if (fscanf(infile, "%i,%i\n", &iPostProcess, &iDeletePaused) != 2) goto error;
+		}
+		else if (iFormatVersion >= 4)
+		{
+			if (fscanf(infile, "%i\n", &iPostProcess) != 1) goto error;
+		}
+		pNZBInfo->SetPriority(iPriority);
+		pNZBInfo->SetDeletePaused((bool)iDeletePaused);
+		pNZBInfo->SetManyDupeFiles((bool)iManyDupeFiles);
+		if (iPostStage > 0)
+		{
+			pNZBInfo->EnterPostProcess();
+			pNZBInfo->GetPostInfo()->SetStage((PostInfo::EStage)iPostStage);
+		}
+	}
+
+	if (iFormatVersion >= 8 && iFormatVersion < 18)
+	{
+		int iParStatus;
+		if (fscanf(infile, "%i\n", &iParStatus) != 1) goto error;
+		pNZBInfo->SetParStatus((NZBInfo::EParStatus)iParStatus);
+	}
+
+	if (iFormatVersion >= 9 && iFormatVersion < 18)
+	{
+		int iScriptStatus;
+		if (fscanf(infile, "%i\n", &iScriptStatus) != 1) goto error;
+		if (iScriptStatus > 1) iScriptStatus--;
+		pNZBInfo->GetScriptStatuses()->Add("SCRIPT", (ScriptStatus::EStatus)iScriptStatus);
+	}
+
+	if (iFormatVersion >= 18)
+	{
+		int iParStatus, iUnpackStatus, iScriptStatus, iMoveStatus = 0,
+			iRenameStatus = 0, iDeleteStatus = 0, iMarkStatus = 0, iUrlStatus = 0;
+		if (iFormatVersion >= 46)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus, &iMoveStatus,
+				&iRenameStatus, &iDeleteStatus, &iMarkStatus, &iUrlStatus) != 7) goto error;
+		}
+		else if (iFormatVersion >= 37)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus,
+				&iMoveStatus, &iRenameStatus, &iDeleteStatus, &iMarkStatus) != 6) goto error;
+		}
+		else if (iFormatVersion >= 35)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus,
+				&iMoveStatus, &iRenameStatus, &iDeleteStatus) != 5) goto error;
+		}
+		else if (iFormatVersion >= 23)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus,
+				&iMoveStatus, &iRenameStatus) != 4) goto error;
+		}
+		else if (iFormatVersion >= 21)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus,
+				&iScriptStatus, &iMoveStatus, &iRenameStatus) != 5) goto error;
+		}
+		else if (iFormatVersion >= 20)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i\n", &iParStatus, &iUnpackStatus,
+				&iScriptStatus, &iMoveStatus) != 4) goto error;
+		}
+		else
+		{
+			if (fscanf(infile, "%i,%i,%i\n", &iParStatus, &iUnpackStatus, &iScriptStatus) != 3) goto error;
+		}
+		pNZBInfo->SetParStatus((NZBInfo::EParStatus)iParStatus);
+		pNZBInfo->SetUnpackStatus((NZBInfo::EUnpackStatus)iUnpackStatus);
+		pNZBInfo->SetMoveStatus((NZBInfo::EMoveStatus)iMoveStatus);
+		pNZBInfo->SetRenameStatus((NZBInfo::ERenameStatus)iRenameStatus);
+		pNZBInfo->SetDeleteStatus((NZBInfo::EDeleteStatus)iDeleteStatus);
+		pNZBInfo->SetMarkStatus((NZBInfo::EMarkStatus)iMarkStatus);
+		if (pNZBInfo->GetKind() == NZBInfo::nkNzb ||
+			(NZBInfo::EUrlStatus)iUrlStatus >= NZBInfo::lsScanSkipped)
+		{
+			pNZBInfo->SetUrlStatus((NZBInfo::EUrlStatus)iUrlStatus);
+		}
+		if (iFormatVersion < 23)
+		{
+			if (iScriptStatus > 1) iScriptStatus--;
+			pNZBInfo->GetScriptStatuses()->Add("SCRIPT", (ScriptStatus::EStatus)iScriptStatus);
+		}
+	}
+
+	if (iFormatVersion >= 35)
+	{
+		int iUnpackCleanedUpDisk, iHealthPaused, iAddUrlPaused = 0;
+		if (iFormatVersion >= 46)
+		{
+			if (fscanf(infile, "%i,%i,%i\n", &iUnpackCleanedUpDisk, &iHealthPaused, &iAddUrlPaused) != 3) goto error;
+		}
+		else
+		{
+			if (fscanf(infile, "%i,%i\n", &iUnpackCleanedUpDisk, &iHealthPaused) != 2) goto error;
+		}
+		pNZBInfo->SetUnpackCleanedUpDisk((bool)iUnpackCleanedUpDisk);
+		pNZBInfo->SetHealthPaused((bool)iHealthPaused);
+		pNZBInfo->SetAddUrlPaused((bool)iAddUrlPaused);
+	}
+	else if (iFormatVersion >= 28)
+	{
+		int iDeleted, iUnpackCleanedUpDisk, iHealthPaused, iHealthDeleted;
+		if (fscanf(infile, "%i,%i,%i,%i\n", &iDeleted, &iUnpackCleanedUpDisk, &iHealthPaused, &iHealthDeleted) != 4) goto error;
+		pNZBInfo->SetUnpackCleanedUpDisk((bool)iUnpackCleanedUpDisk);
+		pNZBInfo->SetHealthPaused((bool)iHealthPaused);
+		pNZBInfo->SetDeleteStatus(iHealthDeleted ? NZBInfo::dsHealth : iDeleted ? NZBInfo::dsManual : NZBInfo::dsNone);
+	}
+
+	if (iFormatVersion >= 28)
+	{
+		int iFileCount, iParkedFileCount, iMessageCount = 0;
+		if (iFormatVersion >= 52)
+		{
+			if (fscanf(infile, "%i,%i,%i\n", &iFileCount, &iParkedFileCount, &iMessageCount) != 3) goto error;
+		}
+		else
+		{
+			if (fscanf(infile, "%i,%i\n", &iFileCount, &iParkedFileCount) != 2) goto error;
+		}
+
+		pNZBInfo->SetFileCount(iFileCount);
+		pNZBInfo->SetParkedFileCount(iParkedFileCount);
+		pNZBInfo->SetMessageCount(iMessageCount);
+	}
+	else
+	{
+		if (iFormatVersion >= 19)
+		{
+			int iUnpackCleanedUpDisk;
+			if (fscanf(infile, "%i\n", &iUnpackCleanedUpDisk) != 1) goto error;
+			pNZBInfo->SetUnpackCleanedUpDisk((bool)iUnpackCleanedUpDisk);
+		}
+		
+		int iFileCount;
+		if (fscanf(infile, "%i\n", &iFileCount) != 1) goto error;
+		pNZBInfo->SetFileCount(iFileCount);
+
+		if (iFormatVersion >= 10)
+		{
+			if (fscanf(infile, "%i\n", &iFileCount) != 1) goto error;
+			pNZBInfo->SetParkedFileCount(iFileCount);
+		}
+	}
+
+	if (iFormatVersion >= 44)
+	{
+		int iMinTime, iMaxTime;
+		if (fscanf(infile, "%i,%i\n", &iMinTime, &iMaxTime) != 2) goto error;
+		pNZBInfo->SetMinTime((time_t)iMinTime);
+		pNZBInfo->SetMaxTime((time_t)iMaxTime);
+	}
+
+	if (iFormatVersion >= 51)
+	{
+		int iParFull, iForceParFull, iForceRepair;
+		if (fscanf(infile, "%i,%i,%i\n", &iParFull, &iForceParFull, &iForceRepair) != 3) goto error;
+		pNZBInfo->SetParFull((bool)iParFull);
+		if (pNZBInfo->GetPostInfo())
+		{
+			pNZBInfo->GetPostInfo()->SetForceParFull((bool)iForceParFull);
+			pNZBInfo->GetPostInfo()->SetForceRepair((bool)iForceRepair);
+		}
+	}
+
+	if (true) // clang requires a block for goto to work
+	{
+		unsigned int iFullContentHash = 0, iFilteredContentHash = 0;
+		if (iFormatVersion >= 34)
+		{
+			if (fscanf(infile, "%u,%u\n", &iFullContentHash, &iFilteredContentHash) != 2) goto error;
+		}
+		else if (iFormatVersion >= 32)
+		{
+			if (fscanf(infile, "%u\n", &iFullContentHash) != 1) goto error;
+		}
+		pNZBInfo->SetFullContentHash(iFullContentHash);
+		pNZBInfo->SetFilteredContentHash(iFilteredContentHash);
+	}
+
+	if (iFormatVersion >= 28)
+	{
+		unsigned long High1, Low1, High2, Low2, High3, Low3;
+		if (fscanf(infile, "%lu,%lu,%lu,%lu,%lu,%lu\n", &High1, &Low1, &High2, &Low2, &High3, &Low3) != 6) goto error;
+		pNZBInfo->SetSize(Util::JoinInt64(High1, Low1));
+		pNZBInfo->SetSuccessSize(Util::JoinInt64(High2, Low2));
+		pNZBInfo->SetFailedSize(Util::JoinInt64(High3, Low3));
+		pNZBInfo->SetCurrentSuccessSize(pNZBInfo->GetSuccessSize());
+		pNZBInfo->SetCurrentFailedSize(pNZBInfo->GetFailedSize());
+
+		if (fscanf(infile, "%lu,%lu,%lu,%lu,%lu,%lu\n", &High1, &Low1, &High2, &Low2, &High3, &Low3) != 6) goto error;
+		pNZBInfo->SetParSize(Util::JoinInt64(High1, Low1));
+		pNZBInfo->SetParSuccessSize(Util::JoinInt64(High2, Low2));
+		pNZBInfo->SetParFailedSize(Util::JoinInt64(High3, Low3));
+		pNZBInfo->SetParCurrentSuccessSize(pNZBInfo->GetParSuccessSize());
+		pNZBInfo->SetParCurrentFailedSize(pNZBInfo->GetParFailedSize());
+	}
+	else
+	{
+		unsigned long High, Low;
+		if (fscanf(infile, "%lu,%lu\n", &High, &Low) != 2) goto error;
+		pNZBInfo->SetSize(Util::JoinInt64(High, Low));
+	}
+	
+	if (iFormatVersion >= 30)
+	{
+		int iTotalArticles, iSuccessArticles, iFailedArticles;
+		if (fscanf(infile, "%i,%i,%i\n", &iTotalArticles, &iSuccessArticles, &iFailedArticles) != 3) goto error;
+		pNZBInfo->SetTotalArticles(iTotalArticles);
+		pNZBInfo->SetSuccessArticles(iSuccessArticles);
+		pNZBInfo->SetFailedArticles(iFailedArticles);
+		pNZBInfo->SetCurrentSuccessArticles(iSuccessArticles);
+		pNZBInfo->SetCurrentFailedArticles(iFailedArticles);
+	}
+
+	if (iFormatVersion >= 31)
+	{
+		if (!fgets(buf, sizeof(buf), infile)) goto error;
+		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+		if (iFormatVersion < 36) ConvertDupeKey(buf, sizeof(buf));
+		pNZBInfo->SetDupeKey(buf);
+	}
+
+	if (true) // clang requires a block for goto to work
+	{
+		int iDupeMode = 0, iDupeScore = 0;
+		if (iFormatVersion >= 39)
+		{
+			if (fscanf(infile, "%i,%i\n", &iDupeMode, &iDupeScore) != 2) goto error;
+		}
+		else if (iFormatVersion >= 31)
+		{
+			int iDupe;
+			if (fscanf(infile, "%i,%i,%i\n", &iDupe, &iDupeMode, &iDupeScore) != 3) goto error;
+		}
+		pNZBInfo->SetDupeMode((EDupeMode)iDupeMode);
+		pNZBInfo->SetDupeScore(iDupeScore);
+	}
+
+	if (iFormatVersion >= 48)
+	{
+		unsigned long High1, Low1, iDownloadSec, iPostTotalSec, iParSec, iRepairSec, iUnpackSec;
+		if (fscanf(infile, "%lu,%lu,%i,%i,%i,%i,%i\n", &High1, &Low1, &iDownloadSec, &iPostTotalSec, &iParSec, &iRepairSec, &iUnpackSec) != 7) goto error;
+		pNZBInfo->SetDownloadedSize(Util::JoinInt64(High1, Low1));
+		pNZBInfo->SetDownloadSec(iDownloadSec);
+		pNZBInfo->SetPostTotalSec(iPostTotalSec);
+		pNZBInfo->SetParSec(iParSec);
+		pNZBInfo->SetRepairSec(iRepairSec);
+		pNZBInfo->SetUnpackSec(iUnpackSec);
 	}
 
 	if (iFormatVersion >= 4)
@@ -776,268 +1948,884 @@ bool DiskState::LoadNZBInfo(NZBInfo* pNZBInfo, Servers* pServers, FILE* infile,
 			if (!fgets(buf, sizeof(buf), infile)) goto error;
 			if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
 
-			int iID = 0;
-			char* szFileName = buf;
-			int iStatus = 0;
-			unsigned long lCrc = 0;
+			int iID = 0;
+			char* szFileName = buf;
+			int iStatus = 0;
+			unsigned long lCrc = 0;
+
+			if (iFormatVersion >= 49)
+			{
+				if (iFormatVersion >= 50)
+				{
+					if (sscanf(buf, "%i,%i,%lu", &iID, &iStatus, &lCrc) != 3) goto error;
+					szFileName = strchr(buf, ',');
+					if (szFileName) szFileName = strchr(szFileName+1, ',');
+					if (szFileName) szFileName = strchr(szFileName+1, ',');
+				}
+				else
+				{
+					if (sscanf(buf, "%i,%lu", &iStatus, &lCrc) != 2) goto error;
+					szFileName = strchr(buf + 2, ',');
+				}
+				if (szFileName)
+				{
+					szFileName++;
+				}
+			}
+
+			pNZBInfo->GetCompletedFiles()->push_back(new CompletedFile(iID, szFileName, (CompletedFile::EStatus)iStatus, lCrc));
+		}
+	}
+
+	if (iFormatVersion >= 6)
+	{
+		int iParameterCount;
+		if (fscanf(infile, "%i\n", &iParameterCount) != 1) goto error;
+		for (int i = 0; i < iParameterCount; i++)
+		{
+			if (!fgets(buf, sizeof(buf), infile)) goto error;
+			if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+
+			char* szValue = strchr(buf, '=');
+			if (szValue)
+			{
+				*szValue = '\0';
+				szValue++;
+				pNZBInfo->GetParameters()->SetParameter(buf, szValue);
+			}
+		}
+	}
+
+	if (iFormatVersion >= 23)
+	{
+		int iScriptCount;
+		if (fscanf(infile, "%i\n", &iScriptCount) != 1) goto error;
+		for (int i = 0; i < iScriptCount; i++)
+		{
+			if (!fgets(buf, sizeof(buf), infile)) goto error;
+			if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+			
+			char* szScriptName = strchr(buf, ',');
+			if (szScriptName)
+			{
+				szScriptName++;
+				int iStatus = atoi(buf);
+				if (iStatus > 1 && iFormatVersion < 25) iStatus--;
+				pNZBInfo->GetScriptStatuses()->Add(szScriptName, (ScriptStatus::EStatus)iStatus);
+			}
+		}
+	}
+
+	if (iFormatVersion >= 30)
+	{
+		if (!LoadServerStats(pNZBInfo->GetServerStats(), pServers, infile)) goto error;
+		pNZBInfo->GetCurrentServerStats()->ListOp(pNZBInfo->GetServerStats(), ServerStatList::soSet);
+	}
+
+	if (iFormatVersion >= 11 && iFormatVersion < 52)
+	{
+		int iLogCount;
+		if (fscanf(infile, "%i\n", &iLogCount) != 1) goto error;
+		for (int i = 0; i < iLogCount; i++)
+		{
+			if (!fgets(buf, sizeof(buf), infile)) goto error;
+		}
+	}
+	
+	if (iFormatVersion < 26)
+	{
+		NZBParameter* pUnpackParameter = pNZBInfo->GetParameters()->Find("*Unpack:", false);
+		if (!pUnpackParameter)
+		{
+			pNZBInfo->GetParameters()->SetParameter("*Unpack:", g_pOptions->GetUnpack() ? "yes" : "no");
+		}
+	}
+
+	if (iFormatVersion >= 43)
+	{
+		int iFileCount;
+		if (fscanf(infile, "%i\n", &iFileCount) != 1) goto error;
+		for (int i = 0; i < iFileCount; i++)
+		{
+			unsigned int id, paused, iTime = 0;
+			int iPriority = 0, iExtraPriority = 0;
+
+			if (iFormatVersion >= 44)
+			{
+				if (fscanf(infile, "%i,%i,%i,%i\n", &id, &paused, &iTime, &iExtraPriority) != 4) goto error;
+			}
+			else
+			{
+				if (fscanf(infile, "%i,%i,%i,%i,%i\n", &id, &paused, &iTime, &iPriority, &iExtraPriority) != 5) goto error;
+				pNZBInfo->SetPriority(iPriority);
+			}
+
+			if (IsSuperseded(pNZBInfo->GetID()))
+			{
+				// the item is loaded from journal later
+				continue;
+			}
+
+			char fileName[1024];
+			snprintf(fileName, 1024, "%s%i", g_pOptions->GetQueueDir(), id);
+			fileName[1024-1] = '\0';
+			FileInfo* pFileInfo = new FileInfo();
+			pFileInfo->SetID(id);
+
+			// file summaries are loaded later in parallel
+			bool bDefer = m_pSummaryList && iFormatVersion >= 30;
+			if (bDefer)
+			{
+				m_pSummaryList->push_back(pFileInfo);
+			}
+
+			bool res = bDefer || LoadFileInfo(pFileInfo, fileName, true, false);
+			if (res)
+			{
+				pFileInfo->SetID(id);
+				pFileInfo->SetPaused(paused);
+				pFileInfo->SetTime(iTime);
+				pFileInfo->SetExtraPriority(iExtraPriority != 0);
+				pFileInfo->SetNZBInfo(pNZBInfo);
+				if (iFormatVersion < 30)
+				{
+					pNZBInfo->SetTotalArticles(pNZBInfo->GetTotalArticles() + pFileInfo->GetTotalArticles());
+				}
+				pNZBInfo->GetFileList()->push_back(pFileInfo);
+			}
+			else
+			{
+				delete pFileInfo;
+			}
+		}
+	}
+
+	return true;
+
+error:
+	error("Error reading nzb info from disk");
+	return false;
+}
+
+bool DiskState::LoadFileQueue12(NZBList* pNZBList, NZBList* pSortList, FILE* infile, int iFormatVersion)
+{
+	debug("Loading file queue from disk");
+
+	int size;
+	if (fscanf(infile, "%i\n", &size) != 1) goto error;
+	for (int i = 0; i < size; i++)
+	{
+		unsigned int id, iNZBIndex, paused;
+		unsigned int iTime = 0;
+		int iPriority = 0, iExtraPriority = 0;
+		if (iFormatVersion >= 17)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i,%i,%i\n", &id, &iNZBIndex, &paused, &iTime, &iPriority, &iExtraPriority) != 6) goto error;
+		}
+		else if (iFormatVersion >= 14)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i,%i\n", &id, &iNZBIndex, &paused, &iTime, &iPriority) != 5) goto error;
+		}
+		else if (iFormatVersion >= 12)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i\n", &id, &iNZBIndex, &paused, &iTime) != 4) goto error;
+		}
+		else
+		{
+			if (fscanf(infile, "%i,%i,%i\n", &id, &iNZBIndex, &paused) != 3) goto error;
+		}
+		if (iNZBIndex > pNZBList->size()) goto error;
+
+		char fileName[1024];
+		snprintf(fileName, 1024, "%s%i", g_pOptions->GetQueueDir(), id);
+		fileName[1024-1] = '\0';
+		FileInfo* pFileInfo = new FileInfo();
+		bool res = LoadFileInfo(pFileInfo, fileName, true, false);
+		if (res)
+		{
+			NZBInfo* pNZBInfo = pNZBList->at(iNZBIndex - 1);
+			pNZBInfo->SetPriority(iPriority);
+			pFileInfo->SetID(id);
+			pFileInfo->SetPaused(paused);
+			pFileInfo->SetTime(iTime);
+			pFileInfo->SetExtraPriority(iExtraPriority != 0);
+			pFileInfo->SetNZBInfo(pNZBInfo);
+			if (iFormatVersion < 30)
+			{
+				pNZBInfo->SetTotalArticles(pNZBInfo->GetTotalArticles() + pFileInfo->GetTotalArticles());
+			}
+			pNZBInfo->GetFileList()->push_back(pFileInfo);
+
+			if (pSortList && std::find(pSortList->begin(), pSortList->end(), pNZBInfo) == pSortList->end())
+			{
+				pSortList->push_back(pNZBInfo);
+			}
+		}
+		else
+		{
+			delete pFileInfo;
+		}
+	}
+
+	return true;
+
+error:
+	error("Error reading file queue from disk");
+	return false;
+}
+
+void DiskState::SaveServerStats(ServerStatList* pServerStatList, StringBuilder* outfile)
+{
+	fprintf(outfile, "%i\n", (int)pServerStatList->size());
+	for (ServerStatList::iterator it = pServerStatList->begin(); it != pServerStatList->end(); it++)
+	{
+		ServerStat* pServerStat = *it;
+		fprintf(outfile, "%i,%i,%i\n", pServerStat->GetServerID(), pServerStat->GetSuccessArticles(), pServerStat->GetFailedArticles());
+	}
+}
+
+bool DiskState::LoadServerStats(ServerStatList* pServerStatList, Servers* pServers, FILE* infile)
+{
+	int iStatCount;
+	if (fscanf(infile, "%i\n", &iStatCount) != 1) goto error;
+	for (int i = 0; i < iStatCount; i++)
+	{
+		int iServerID, iSuccessArticles, iFailedArticles;
+		if (fscanf(infile, "%i,%i,%i\n", &iServerID, &iSuccessArticles, &iFailedArticles) != 3) goto error;
+		SetServerStat(pServerStatList, pServers, iServerID, iSuccessArticles, iFailedArticles);
+	}
+
+	return true;
 
-			if (iFormatVersion >= 49)
+error:
+	error("Error reading server stats from disk");
+	return false;
+}
+
+void DiskState::SetServerStat(ServerStatList* pServerStatList, Servers* pServers, int iServerID,
+	int iSuccessArticles, int iFailedArticles)
+{
+	if (pServers)
+	{
+		// find server (id could change if config file was edited)
+		for (Servers::iterator it = pServers->begin(); it != pServers->end(); it++)
+		{
+			NewsServer* pNewsServer = *it;
+			if (pNewsServer->GetStateID() == iServerID)
 			{
-				if (iFormatVersion >= 50)
-				{
-					if (sscanf(buf, "%i,%i,%lu", &iID, &iStatus, &lCrc) != 3) goto error;
-					szFileName = strchr(buf, ',');
-					if (szFileName) szFileName = strchr(szFileName+1, ',');
-					if (szFileName) szFileName = strchr(szFileName+1, ',');
-				}
-				else
-				{
-					if (sscanf(buf, "%i,%lu", &iStatus, &lCrc) != 2) goto error;
-					szFileName = strchr(buf + 2, ',');
-				}
-				if (szFileName)
-				{
-					szFileName++;
-				}
+				pServerStatList->StatOp(pNewsServer->GetID(), iSuccessArticles, iFailedArticles, ServerStatList::soSet);
 			}
+		}
+	}
+}
 
-			pNZBInfo->GetCompletedFiles()->push_back(new CompletedFile(iID, szFileName, (CompletedFile::EStatus)iStatus, lCrc));
+bool DiskState::SaveFile(FileInfo* pFileInfo)
+{
+	char fileName[1024];
+	snprintf(fileName, 1024, "%s%i", g_pOptions->GetQueueDir(), pFileInfo->GetID());
+	fileName[1024-1] = '\0';
+	return SaveFileInfo(pFileInfo, fileName);
+}
+
+/*
+ * FileInfo is saved in binary format. The articles are stored as an array of fixed size
+ * records followed by a pool with message-ids. This allows to load the file summary
+ * at startup without decoding of article list.
+ */
+bool DiskState::SaveFileInfo(FileInfo* pFileInfo, const char* szFilename)
+{
+	debug("Saving FileInfo to disk");
+
+	FILE* outfile = fopen(szFilename, FOPEN_WB);
+
+	if (!outfile)
+	{
+		error("Error saving diskstate: could not create file %s", szFilename);
+		return false;
+	}
+
+	BinaryWriter writer(outfile);
+	writer.WriteHeader(BINARY_KIND_FILEINFO, BINARY_FILEINFO_VERSION);
+
+	writer.WriteStr(pFileInfo->GetSubject());
+	writer.WriteStr(pFileInfo->GetFilename());
+	writer.WriteInt64(pFileInfo->GetSize());
+	writer.WriteInt64(pFileInfo->GetMissedSize());
+	writer.WriteInt((int)pFileInfo->GetParFile());
+	writer.WriteInt(pFileInfo->GetTotalArticles());
+	writer.WriteInt(pFileInfo->GetMissedArticles());
+
+	writer.WriteInt((int)pFileInfo->GetGroups()->size());
+	for (FileInfo::Groups::iterator it = pFileInfo->GetGroups()->begin(); it != pFileInfo->GetGroups()->end(); it++)
+	{
+		writer.WriteStr(*it);
+	}
+
+	int iPoolSize = 0;
+	for (FileInfo::Articles::iterator it = pFileInfo->GetArticles()->begin(); it != pFileInfo->GetArticles()->end(); it++)
+	{
+		ArticleInfo* pArticleInfo = *it;
+		iPoolSize += strlen(pArticleInfo->GetMessageID()) + 1;
+	}
+
+	writer.WriteInt((int)pFileInfo->GetArticles()->size());
+	writer.WriteInt(iPoolSize);
+
+	int iPoolOffset = 0;
+	for (FileInfo::Articles::iterator it = pFileInfo->GetArticles()->begin(); it != pFileInfo->GetArticles()->end(); it++)
+	{
+		ArticleInfo* pArticleInfo = *it;
+		writer.WriteInt(pArticleInfo->GetPartNumber());
+		writer.WriteInt(pArticleInfo->GetSize());
+		writer.WriteInt(iPoolOffset);
+		iPoolOffset += strlen(pArticleInfo->GetMessageID()) + 1;
+	}
+
+	for (FileInfo::Articles::iterator it = pFileInfo->GetArticles()->begin(); it != pFileInfo->GetArticles()->end(); it++)
+	{
+		ArticleInfo* pArticleInfo = *it;
+		writer.Write(pArticleInfo->GetMessageID(), strlen(pArticleInfo->GetMessageID()) + 1);
+	}
+
+	bool bOK = writer.Flush();
+	fclose(outfile);
+
+	if (!bOK)
+	{
+		error("Error saving diskstate: could not write file %s", szFilename);
+	}
+
+	return bOK;
+}
+
+/*
+ * Loads article list of the file. Article states from checkpoint file which
+ * were not applied at startup (see LoadPartialStates) are applied now.
+ */
+bool DiskState::LoadArticles(FileInfo* pFileInfo)
+{
+	char fileName[1024];
+	snprintf(fileName, 1024, "%s%i", g_pOptions->GetQueueDir(), pFileInfo->GetID());
+	fileName[1024-1] = '\0';
+	if (!LoadFileInfo(pFileInfo, fileName, false, true))
+	{
+		return false;
+	}
+
+	DeferredStates::iterator it = m_DeferredStates.find(pFileInfo->GetID());
+	if (it != m_DeferredStates.end())
+	{
+		BinaryReader reader(it->second.pData, it->second.iSize);
+		bool bOK = ReadArticleStates(&reader, pFileInfo, false);
+		free(it->second.pData);
+		m_DeferredStates.erase(it);
+		if (!bOK)
+		{
+			error("Error reading partial state for file %s", pFileInfo->GetFilename());
+			return false;
 		}
 	}
 
-	if (iFormatVersion >= 6)
+	return true;
+}
+
+bool DiskState::LoadFileSummary(FileInfo* pFileInfo)
+{
+	char fileName[1024];
+	snprintf(fileName, 1024, "%s%i", g_pOptions->GetQueueDir(), pFileInfo->GetID());
+	fileName[1024-1] = '\0';
+	return LoadFileInfo(pFileInfo, fileName, true, false);
+}
+
+/*
+ * Loads summaries of file-infos collected during parsing of queue file.
+ * The files are independent from each other and are loaded by several
+ * threads at once; file-infos which couldn't be loaded are removed from queue.
+ */
+void DiskState::LoadFileSummaries(FileList* pFileList)
+{
+	if (pFileList->empty())
 	{
-		int iParameterCount;
-		if (fscanf(infile, "%i\n", &iParameterCount) != 1) goto error;
-		for (int i = 0; i < iParameterCount; i++)
+		return;
+	}
+
+	int iThreads = Util::NumberOfCpuCores();
+	if (iThreads < 1)
+	{
+		iThreads = 1;
+	}
+	if (iThreads > (int)pFileList->size() / 100 + 1)
+	{
+		// not worth to start many threads for few files
+		iThreads = (int)pFileList->size() / 100 + 1;
+	}
+
+	debug("Loading %i file summaries using %i thread(s)", (int)pFileList->size(), iThreads);
+
+	// the calling thread takes part in the work too
+	SummaryLoader loader(this, pFileList);
+	WorkerPool pool(iThreads - 1);
+	pool.Execute(&loader, (int)pFileList->size());
+
+	for (int i = 0; i < (int)pFileList->size(); i++)
+	{
+		if (loader.GetFailed(i))
+		{
+			FileInfo* pFileInfo = pFileList->at(i);
+			pFileInfo->GetNZBInfo()->GetFileList()->Remove(pFileInfo);
+			delete pFileInfo;
+		}
+	}
+}
+
+bool DiskState::LoadFileInfo(FileInfo* pFileInfo, const char * szFilename, bool bFileSummary, bool bArticles)
+{
+	debug("Loading FileInfo from disk");
+
+	MappedFile mappedFile;
+	if (mappedFile.Open(szFilename) && BinaryReader::IsBinary(mappedFile.GetData(), mappedFile.GetSize()))
+	{
+		return LoadBinaryFileInfo(pFileInfo, szFilename, &mappedFile, bFileSummary, bArticles);
+	}
+	mappedFile.Close();
+
+	// file in old text format, it is converted into binary format when loaded at startup
+	bool bConvert = bFileSummary;
+
+	FILE* infile = fopen(szFilename, FOPEN_RB);
+
+	if (!infile)
+	{
+		error("Error reading diskstate: could not open file %s", szFilename);
+		return false;
+	}
+
+	char buf[1024];
+	int iFormatVersion = 0;
+
+	if (fgets(buf, sizeof(buf), infile))
+	{
+		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+		iFormatVersion = ParseFormatVersion(buf);
+		if (iFormatVersion > 3)
+		{
+			error("Could not load diskstate due to file version mismatch");
+			goto error;
+		}
+	}
+	else
+	{
+		goto error;
+	}
+	
+	if (iFormatVersion >= 2)
+	{
+		if (!fgets(buf, sizeof(buf), infile)) goto error;
+		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+	}
+
+	if (bFileSummary) pFileInfo->SetSubject(buf);
+
+	if (!fgets(buf, sizeof(buf), infile)) goto error;
+	if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+	if (bFileSummary) pFileInfo->SetFilename(buf);
+
+	if (iFormatVersion < 2)
+	{
+		int iFilenameConfirmed;
+		if (fscanf(infile, "%i\n", &iFilenameConfirmed) != 1) goto error;
+		if (bFileSummary) pFileInfo->SetFilenameConfirmed(iFilenameConfirmed);
+	}
+	
+	unsigned long High, Low;
+	if (fscanf(infile, "%lu,%lu\n", &High, &Low) != 2) goto error;
+	if (bFileSummary) pFileInfo->SetSize(Util::JoinInt64(High, Low));
+	if (bFileSummary) pFileInfo->SetRemainingSize(pFileInfo->GetSize());
+
+	if (iFormatVersion >= 2)
+	{
+		if (fscanf(infile, "%lu,%lu\n", &High, &Low) != 2) goto error;
+		if (bFileSummary) pFileInfo->SetMissedSize(Util::JoinInt64(High, Low));
+		if (bFileSummary) pFileInfo->SetRemainingSize(pFileInfo->GetSize() - pFileInfo->GetMissedSize());
+
+		int iParFile;
+		if (fscanf(infile, "%i\n", &iParFile) != 1) goto error;
+		if (bFileSummary) pFileInfo->SetParFile((bool)iParFile);
+	}
+
+	if (iFormatVersion >= 3)
+	{
+		int iTotalArticles, iMissedArticles;
+		if (fscanf(infile, "%i,%i\n", &iTotalArticles, &iMissedArticles) != 2) goto error;
+		if (bFileSummary) pFileInfo->SetTotalArticles(iTotalArticles);
+		if (bFileSummary) pFileInfo->SetMissedArticles(iMissedArticles);
+	}
+	
+	int size;
+	if (fscanf(infile, "%i\n", &size) != 1) goto error;
+	for (int i = 0; i < size; i++)
+	{
+		if (!fgets(buf, sizeof(buf), infile)) goto error;
+		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+		if (bFileSummary) pFileInfo->GetGroups()->push_back(strdup(buf));
+	}
+
+	if (fscanf(infile, "%i\n", &size) != 1) goto error;
+
+	if (iFormatVersion < 3 && bFileSummary)
+	{
+		pFileInfo->SetTotalArticles(size);
+	}
+
+	if (bArticles || bConvert)
+	{
+		for (int i = 0; i < size; i++)
 		{
+			int PartNumber, PartSize;
+			if (fscanf(infile, "%i,%i\n", &PartNumber, &PartSize) != 2) goto error;
+
 			if (!fgets(buf, sizeof(buf), infile)) goto error;
 			if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
 
-			char* szValue = strchr(buf, '=');
-			if (szValue)
-			{
-				*szValue = '\0';
-				szValue++;
-				pNZBInfo->GetParameters()->SetParameter(buf, szValue);
-			}
+			ArticleInfo* pArticleInfo = pFileInfo->GetArticlePool()->NewArticle();
+			pArticleInfo->SetPartNumber(PartNumber);
+			pArticleInfo->SetSize(PartSize);
+			pArticleInfo->SetMessageID(pFileInfo->GetArticlePool()->AddString(buf));
+			pFileInfo->GetArticles()->push_back(pArticleInfo);
 		}
 	}
 
-	if (iFormatVersion >= 23)
-	{
-		int iScriptCount;
-		if (fscanf(infile, "%i\n", &iScriptCount) != 1) goto error;
-		for (int i = 0; i < iScriptCount; i++)
+	fclose(infile);
+
+	if (bConvert)
+	{
+		SaveFileInfo(pFileInfo, szFilename);
+		if (!bArticles)
 		{
-			if (!fgets(buf, sizeof(buf), infile)) goto error;
-			if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-			
-			char* szScriptName = strchr(buf, ',');
-			if (szScriptName)
-			{
-				szScriptName++;
-				int iStatus = atoi(buf);
-				if (iStatus > 1 && iFormatVersion < 25) iStatus--;
-				pNZBInfo->GetScriptStatuses()->Add(szScriptName, (ScriptStatus::EStatus)iStatus);
-			}
+			pFileInfo->ClearArticles();
 		}
 	}
 
-	if (iFormatVersion >= 30)
+	return true;
+
+error:
+	fclose(infile);
+	error("Error reading diskstate for file %s", szFilename);
+	return false;
+}
+
+bool DiskState::LoadBinaryFileInfo(FileInfo* pFileInfo, const char* szFilename, MappedFile* pMappedFile, bool bFileSummary, bool bArticles)
+{
+	BinaryReader reader(pMappedFile->GetData(), pMappedFile->GetSize());
+
+	int iFormatVersion;
+	if (!reader.ReadHeader(BINARY_KIND_FILEINFO, &iFormatVersion)) goto error;
+	if (iFormatVersion > BINARY_FILEINFO_VERSION)
 	{
-		if (!LoadServerStats(pNZBInfo->GetServerStats(), pServers, infile)) goto error;
-		pNZBInfo->GetCurrentServerStats()->ListOp(pNZBInfo->GetServerStats(), ServerStatList::soSet);
+		error("Could not load diskstate due to file version mismatch");
+		goto error;
 	}
 
-	if (iFormatVersion >= 11 && iFormatVersion < 52)
 	{
-		int iLogCount;
-		if (fscanf(infile, "%i\n", &iLogCount) != 1) goto error;
-		for (int i = 0; i < iLogCount; i++)
+		const char* szSubject;
+		const char* szName;
+		long long lSize, lMissedSize;
+		int iParFile, iTotalArticles, iMissedArticles;
+		if (!reader.ReadStr(&szSubject) || !reader.ReadStr(&szName) ||
+			!reader.ReadInt64(&lSize) || !reader.ReadInt64(&lMissedSize) ||
+			!reader.ReadInt(&iParFile) || !reader.ReadInt(&iTotalArticles) ||
+			!reader.ReadInt(&iMissedArticles)) goto error;
+
+		int iGroupCount;
+		if (!reader.ReadInt(&iGroupCount)) goto error;
+		for (int i = 0; i < iGroupCount; i++)
 		{
-			if (!fgets(buf, sizeof(buf), infile)) goto error;
+			const char* szGroup;
+			if (!reader.ReadStr(&szGroup)) goto error;
+			if (bFileSummary) pFileInfo->GetGroups()->push_back(strdup(szGroup));
 		}
-	}
-	
-	if (iFormatVersion < 26)
-	{
-		NZBParameter* pUnpackParameter = pNZBInfo->GetParameters()->Find("*Unpack:", false);
-		if (!pUnpackParameter)
+
+		if (bFileSummary)
 		{
-			pNZBInfo->GetParameters()->SetParameter("*Unpack:", g_pOptions->GetUnpack() ? "yes" : "no");
+			pFileInfo->SetSubject(szSubject);
+			pFileInfo->SetFilename(szName);
+			pFileInfo->SetSize(lSize);
+			pFileInfo->SetMissedSize(lMissedSize);
+			pFileInfo->SetRemainingSize(lSize - lMissedSize);
+			pFileInfo->SetParFile((bool)iParFile);
+			pFileInfo->SetTotalArticles(iTotalArticles);
+			pFileInfo->SetMissedArticles(iMissedArticles);
 		}
 	}
 
-	if (iFormatVersion >= 43)
+	if (bArticles)
 	{
-		int iFileCount;
-		if (fscanf(infile, "%i\n", &iFileCount) != 1) goto error;
-		for (int i = 0; i < iFileCount; i++)
-		{
-			unsigned int id, paused, iTime = 0;
-			int iPriority = 0, iExtraPriority = 0;
+		int iArticleCount, iPoolSize;
+		if (!reader.ReadInt(&iArticleCount) || !reader.ReadInt(&iPoolSize)) goto error;
+		if (iArticleCount < 0 || iPoolSize < 0 ||
+			reader.GetRemaining() != (long long)iArticleCount * 3 * (long long)sizeof(int) + iPoolSize) goto error;
 
-			if (iFormatVersion >= 44)
-			{
-				if (fscanf(infile, "%i,%i,%i,%i\n", &id, &paused, &iTime, &iExtraPriority) != 4) goto error;
-			}
-			else
-			{
-				if (fscanf(infile, "%i,%i,%i,%i,%i\n", &id, &paused, &iTime, &iPriority, &iExtraPriority) != 5) goto error;
-				pNZBInfo->SetPriority(iPriority);
-			}
+		// the string pool is copied as a whole, message-ids point into the copy
+		ArticlePool* pArticlePool = pFileInfo->GetArticlePool();
+		pArticlePool->Reserve(iArticleCount, iPoolSize);
+		const char* pFilePool = reader.GetPos() + iArticleCount * 3 * sizeof(int);
+		const char* pPool = pArticlePool->AddData(pFilePool, iPoolSize);
+		pFileInfo->GetArticles()->reserve(iArticleCount);
 
-			char fileName[1024];
-			snprintf(fileName, 1024, "%s%i", g_pOptions->GetQueueDir(), id);
-			fileName[1024-1] = '\0';
-			FileInfo* pFileInfo = new FileInfo();
-			bool res = LoadFileInfo(pFileInfo, fileName, true, false);
-			if (res)
-			{
-				pFileInfo->SetID(id);
-				pFileInfo->SetPaused(paused);
-				pFileInfo->SetTime(iTime);
-				pFileInfo->SetExtraPriority(iExtraPriority != 0);
-				pFileInfo->SetNZBInfo(pNZBInfo);
-				if (iFormatVersion < 30)
-				{
-					pNZBInfo->SetTotalArticles(pNZBInfo->GetTotalArticles() + pFileInfo->GetTotalArticles());
-				}
-				pNZBInfo->GetFileList()->push_back(pFileInfo);
-			}
-			else
-			{
-				delete pFileInfo;
-			}
+		for (int i = 0; i < iArticleCount; i++)
+		{
+			int iPartNumber, iPartSize, iPoolOffset;
+			if (!reader.ReadInt(&iPartNumber) || !reader.ReadInt(&iPartSize) || !reader.ReadInt(&iPoolOffset)) goto error;
+			if (iPoolOffset < 0 || iPoolOffset >= iPoolSize || !memchr(pPool + iPoolOffset, '\0', iPoolSize - iPoolOffset)) goto error;
+
+			ArticleInfo* pArticleInfo = pArticlePool->NewArticle();
+			pArticleInfo->SetPartNumber(iPartNumber);
+			pArticleInfo->SetSize(iPartSize);
+			pArticleInfo->SetMessageID(pPool + iPoolOffset);
+			pFileInfo->GetArticles()->push_back(pArticleInfo);
 		}
 	}
 
 	return true;
 
 error:
-	error("Error reading nzb info from disk");
+	error("Error reading diskstate for file %s", szFilename);
 	return false;
 }
 
-bool DiskState::LoadFileQueue12(NZBList* pNZBList, NZBList* pSortList, FILE* infile, int iFormatVersion)
+bool DiskState::SaveFileState(FileInfo* pFileInfo, bool bCompleted)
 {
-	debug("Loading file queue from disk");
+	debug("Saving FileState to disk");
+
+	char szFilename[1024];
+	snprintf(szFilename, 1024, "%s%i%s", g_pOptions->GetQueueDir(), pFileInfo->GetID(), bCompleted ? "c" : "s");
+	szFilename[1024-1] = '\0';
+
+	FILE* outfile = fopen(szFilename, FOPEN_WB);
+
+	if (!outfile)
+	{
+		error("Error saving diskstate: could not create file %s", szFilename);
+		return false;
+	}
+
+	BinaryWriter writer(outfile);
+	writer.WriteHeader(BINARY_KIND_FILESTATE, BINARY_FILESTATE_VERSION);
+	WriteFileState(&writer, pFileInfo);
+
+	bool bOK = writer.Flush();
+	fclose(outfile);
+
+	if (!bOK)
+	{
+		error("Error saving diskstate: could not write file %s", szFilename);
+	}
+
+	return bOK;
+}
+
+void DiskState::WriteFileState(BinaryWriter* pWriter, FileInfo* pFileInfo)
+{
+	WriteFileStateSummary(pWriter, pFileInfo);
+
+	pWriter->WriteInt((int)pFileInfo->GetArticles()->size());
+	for (FileInfo::Articles::iterator it = pFileInfo->GetArticles()->begin(); it != pFileInfo->GetArticles()->end(); it++)
+	{
+		ArticleInfo* pArticleInfo = *it;
+		pWriter->WriteInt((int)pArticleInfo->GetStatus());
+		pWriter->WriteInt(pArticleInfo->GetSegmentSize());
+		pWriter->WriteInt64(pArticleInfo->GetSegmentOffset());
+		pWriter->WriteInt((int)pArticleInfo->GetCrc());
+	}
+}
+
+void DiskState::WriteFileStateSummary(BinaryWriter* pWriter, FileInfo* pFileInfo)
+{
+	pWriter->WriteInt(pFileInfo->GetSuccessArticles());
+	pWriter->WriteInt(pFileInfo->GetFailedArticles());
+	pWriter->WriteInt64(pFileInfo->GetRemainingSize());
+	pWriter->WriteInt64(pFileInfo->GetSuccessSize());
+	pWriter->WriteInt64(pFileInfo->GetFailedSize());
+
+	pWriter->WriteInt((int)pFileInfo->GetServerStats()->size());
+	for (ServerStatList::iterator it = pFileInfo->GetServerStats()->begin(); it != pFileInfo->GetServerStats()->end(); it++)
+	{
+		ServerStat* pServerStat = *it;
+		pWriter->WriteInt(pServerStat->GetServerID());
+		pWriter->WriteInt(pServerStat->GetSuccessArticles());
+		pWriter->WriteInt(pServerStat->GetFailedArticles());
+	}
+}
+
+/*
+ * Returns the number of bytes written by WriteFileState.
+ */
+int DiskState::CalcFileStateSize(FileInfo* pFileInfo)
+{
+	return CalcFileStateSummarySize(pFileInfo) + 4 + ARTICLESTATE_SIZE * (int)pFileInfo->GetArticles()->size();
+}
+
+int DiskState::CalcFileStateSummarySize(FileInfo* pFileInfo)
+{
+	return 4 + 4 + 8 + 8 + 8 + 4 + (4 + 4 + 4) * (int)pFileInfo->GetServerStats()->size();
+}
+
+bool DiskState::LoadFileState(FileInfo* pFileInfo, Servers* pServers, bool bCompleted)
+{
+	char szFilename[1024];
+	snprintf(szFilename, 1024, "%s%i%s", g_pOptions->GetQueueDir(), pFileInfo->GetID(), bCompleted ? "c" : "s");
+	szFilename[1024-1] = '\0';
+
+	bool bHasArticles = !pFileInfo->GetArticles()->empty();
+
+	MappedFile mappedFile;
+	if (mappedFile.Open(szFilename) && BinaryReader::IsBinary(mappedFile.GetData(), mappedFile.GetSize()))
+	{
+		return LoadBinaryFileState(pFileInfo, pServers, bCompleted, szFilename, &mappedFile);
+	}
+	mappedFile.Close();
+
+	FILE* infile = fopen(szFilename, FOPEN_RB);
+
+	if (!infile)
+	{
+		error("Error reading diskstate: could not open file %s", szFilename);
+		return false;
+	}
+
+	char buf[1024];
+	int iFormatVersion = 0;
+
+	if (fgets(buf, sizeof(buf), infile))
+	{
+		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+		iFormatVersion = ParseFormatVersion(buf);
+		if (iFormatVersion > 2)
+		{
+			error("Could not load diskstate due to file version mismatch");
+			goto error;
+		}
+	}
+	else
+	{
+		goto error;
+	}
+
+	int iSuccessArticles, iFailedArticles;
+	if (fscanf(infile, "%i,%i\n", &iSuccessArticles, &iFailedArticles) != 2) goto error;
+	pFileInfo->SetSuccessArticles(iSuccessArticles);
+	pFileInfo->SetFailedArticles(iFailedArticles);
+
+	unsigned long High1, Low1, High2, Low2, High3, Low3;
+	if (fscanf(infile, "%lu,%lu,%lu,%lu,%lu,%lu\n", &High1, &Low1, &High2, &Low2, &High3, &Low3) != 6) goto error;
+	pFileInfo->SetRemainingSize(Util::JoinInt64(High1, Low1));
+	pFileInfo->SetSuccessSize(Util::JoinInt64(High2, Low3));
+	pFileInfo->SetFailedSize(Util::JoinInt64(High3, Low3));
+
+	if (!LoadServerStats(pFileInfo->GetServerStats(), pServers, infile)) goto error;
+
+	int iCompletedArticles;
+	iCompletedArticles = 0; //clang requires initialization in a separate line (due to goto statements)
 
 	int size;
 	if (fscanf(infile, "%i\n", &size) != 1) goto error;
 	for (int i = 0; i < size; i++)
 	{
-		unsigned int id, iNZBIndex, paused;
-		unsigned int iTime = 0;
-		int iPriority = 0, iExtraPriority = 0;
-		if (iFormatVersion >= 17)
-		{
-			if (fscanf(infile, "%i,%i,%i,%i,%i,%i\n", &id, &iNZBIndex, &paused, &iTime, &iPriority, &iExtraPriority) != 6) goto error;
-		}
-		else if (iFormatVersion >= 14)
+		if (!bHasArticles)
 		{
-			if (fscanf(infile, "%i,%i,%i,%i,%i\n", &id, &iNZBIndex, &paused, &iTime, &iPriority) != 5) goto error;
+			pFileInfo->GetArticles()->push_back(pFileInfo->GetArticlePool()->NewArticle());
 		}
-		else if (iFormatVersion >= 12)
+		ArticleInfo* pa = pFileInfo->GetArticles()->at(i);
+
+		int iStatus;
+
+		if (iFormatVersion >= 2)
 		{
-			if (fscanf(infile, "%i,%i,%i,%i\n", &id, &iNZBIndex, &paused, &iTime) != 4) goto error;
+			unsigned long iSegmentOffset, iCrc;
+			int iSegmentSize;
+			if (fscanf(infile, "%i,%lu,%i,%lu\n", &iStatus, &iSegmentOffset, &iSegmentSize, &iCrc) != 4) goto error;
+			pa->SetSegmentOffset(iSegmentOffset);
+			pa->SetSegmentSize(iSegmentSize);
+			pa->SetCrc(iCrc);
 		}
 		else
 		{
-			if (fscanf(infile, "%i,%i,%i\n", &id, &iNZBIndex, &paused) != 3) goto error;
+			if (fscanf(infile, "%i\n", &iStatus) != 1) goto error;
 		}
-		if (iNZBIndex > pNZBList->size()) goto error;
 
-		char fileName[1024];
-		snprintf(fileName, 1024, "%s%i", g_pOptions->GetQueueDir(), id);
-		fileName[1024-1] = '\0';
-		FileInfo* pFileInfo = new FileInfo();
-		bool res = LoadFileInfo(pFileInfo, fileName, true, false);
-		if (res)
+		ArticleInfo::EStatus eStatus = (ArticleInfo::EStatus)iStatus;
+
+		if (eStatus == ArticleInfo::aiRunning)
 		{
-			NZBInfo* pNZBInfo = pNZBList->at(iNZBIndex - 1);
-			pNZBInfo->SetPriority(iPriority);
-			pFileInfo->SetID(id);
-			pFileInfo->SetPaused(paused);
-			pFileInfo->SetTime(iTime);
-			pFileInfo->SetExtraPriority(iExtraPriority != 0);
-			pFileInfo->SetNZBInfo(pNZBInfo);
-			if (iFormatVersion < 30)
-			{
-				pNZBInfo->SetTotalArticles(pNZBInfo->GetTotalArticles() + pFileInfo->GetTotalArticles());
-			}
-			pNZBInfo->GetFileList()->push_back(pFileInfo);
+			eStatus = ArticleInfo::aiUndefined;
+		}
 
-			if (pSortList && std::find(pSortList->begin(), pSortList->end(), pNZBInfo) == pSortList->end())
-			{
-				pSortList->push_back(pNZBInfo);
-			}
+		// don't allow all articles be completed or the file will stuck.
+		// such states should never be saved on disk but just in case.
+		if (iCompletedArticles == size - 1 && !bCompleted)
+		{
+			eStatus = ArticleInfo::aiUndefined;
 		}
-		else
+		if (eStatus != ArticleInfo::aiUndefined)
 		{
-			delete pFileInfo;
+			iCompletedArticles++;
 		}
+
+		pa->SetStatus(eStatus);
+	}
+
+	pFileInfo->SetCompletedArticles(iCompletedArticles);
+
+	fclose(infile);
+
+	if (pServers)
+	{
+		// convert file from old text format into binary format
+		SaveFileState(pFileInfo, bCompleted);
 	}
 
 	return true;
 
 error:
-	error("Error reading file queue from disk");
+	fclose(infile);
+	error("Error reading diskstate for file %s", szFilename);
 	return false;
 }
 
-void DiskState::SaveServerStats(ServerStatList* pServerStatList, FILE* outfile)
+bool DiskState::LoadBinaryFileState(FileInfo* pFileInfo, Servers* pServers, bool bCompleted,
+	const char* szFilename, MappedFile* pMappedFile)
 {
-	fprintf(outfile, "%i\n", (int)pServerStatList->size());
-	for (ServerStatList::iterator it = pServerStatList->begin(); it != pServerStatList->end(); it++)
-	{
-		ServerStat* pServerStat = *it;
-		fprintf(outfile, "%i,%i,%i\n", pServerStat->GetServerID(), pServerStat->GetSuccessArticles(), pServerStat->GetFailedArticles());
-	}
-}
+	BinaryReader reader(pMappedFile->GetData(), pMappedFile->GetSize());
 
-bool DiskState::LoadServerStats(ServerStatList* pServerStatList, Servers* pServers, FILE* infile)
-{
-	int iStatCount;
-	if (fscanf(infile, "%i\n", &iStatCount) != 1) goto error;
-	for (int i = 0; i < iStatCount; i++)
+	int iFormatVersion;
+	if (!reader.ReadHeader(BINARY_KIND_FILESTATE, &iFormatVersion)) goto error;
+	if (iFormatVersion > BINARY_FILESTATE_VERSION)
 	{
-		int iServerID, iSuccessArticles, iFailedArticles;
-		if (fscanf(infile, "%i,%i,%i\n", &iServerID, &iSuccessArticles, &iFailedArticles) != 3) goto error;
-
-		if (pServers)
-		{
-			// find server (id could change if config file was edited)
-			for (Servers::iterator it = pServers->begin(); it != pServers->end(); it++)
-			{
-				NewsServer* pNewsServer = *it;
-				if (pNewsServer->GetStateID() == iServerID)
-				{
-					pServerStatList->StatOp(pNewsServer->GetID(), iSuccessArticles, iFailedArticles, ServerStatList::soSet);
-				}
-			}
-		}
+		error("Could not load diskstate due to file version mismatch");
+		goto error;
 	}
 
+	if (!ReadFileState(&reader, pFileInfo, pServers, bCompleted)) goto error;
+
 	return true;
 
 error:
-	error("Error reading server stats from disk");
+	error("Error reading diskstate for file %s", szFilename);
 	return false;
 }
 
-bool DiskState::SaveFile(FileInfo* pFileInfo)
+#ifndef DISABLE_PARCHECK
+/*
+ * Par-block hashes computed during download are stored in file "<id>h", they are
+ * loaded by the par-checker and deleted together with the completed state of the file.
+ */
+bool DiskState::SaveBlockHashes(int iFileID, BlockHasher* pBlockHasher)
 {
-	char fileName[1024];
-	snprintf(fileName, 1024, "%s%i", g_pOptions->GetQueueDir(), pFileInfo->GetID());
-	fileName[1024-1] = '\0';
-	return SaveFileInfo(pFileInfo, fileName);
-}
+	debug("Saving block hashes to disk");
 
-bool DiskState::SaveFileInfo(FileInfo* pFileInfo, const char* szFilename)
-{
-	debug("Saving FileInfo to disk");
+	char szFilename[1024];
+	snprintf(szFilename, 1024, "%s%ih", g_pOptions->GetQueueDir(), iFileID);
+	szFilename[1024-1] = '\0';
 
 	FILE* outfile = fopen(szFilename, FOPEN_WB);
 
@@ -1047,307 +2835,444 @@ bool DiskState::SaveFileInfo(FileInfo* pFileInfo, const char* szFilename)
 		return false;
 	}
 
-	fprintf(outfile, "%s%i\n", FORMATVERSION_SIGNATURE, 3);
+	BinaryWriter writer(outfile);
+	writer.WriteHeader(BINARY_KIND_BLOCKHASHES, BINARY_BLOCKHASHES_VERSION);
+	writer.WriteInt64(pBlockHasher->GetBlockSize());
+	writer.WriteInt64(pBlockHasher->GetFileSize());
+	writer.Write(pBlockHasher->GetFileMd5(), 16);
+	writer.WriteInt((int)pBlockHasher->GetBlockHashes()->size());
+	for (BlockHasher::BlockHashes::iterator it = pBlockHasher->GetBlockHashes()->begin(); it != pBlockHasher->GetBlockHashes()->end(); it++)
+	{
+		BlockHasher::BlockHash& blockHash = *it;
+		writer.WriteInt((int)blockHash.iCrc);
+		writer.Write(blockHash.Md5, sizeof(blockHash.Md5));
+	}
 
-	fprintf(outfile, "%s\n", pFileInfo->GetSubject());
-	fprintf(outfile, "%s\n", pFileInfo->GetFilename());
+	bool bOK = writer.Flush();
+	fclose(outfile);
 
-	unsigned long High, Low;
-	Util::SplitInt64(pFileInfo->GetSize(), &High, &Low);
-	fprintf(outfile, "%lu,%lu\n", High, Low);
+	if (!bOK)
+	{
+		error("Error saving diskstate: could not write file %s", szFilename);
+	}
 
-	Util::SplitInt64(pFileInfo->GetMissedSize(), &High, &Low);
-	fprintf(outfile, "%lu,%lu\n", High, Low);
+	return bOK;
+}
 
-	fprintf(outfile, "%i\n", (int)pFileInfo->GetParFile());
-	fprintf(outfile, "%i,%i\n", pFileInfo->GetTotalArticles(), pFileInfo->GetMissedArticles());
+bool DiskState::LoadBlockHashes(int iFileID, BlockHasher* pBlockHasher)
+{
+	char szFilename[1024];
+	snprintf(szFilename, 1024, "%s%ih", g_pOptions->GetQueueDir(), iFileID);
+	szFilename[1024-1] = '\0';
 
-	fprintf(outfile, "%i\n", (int)pFileInfo->GetGroups()->size());
-	for (FileInfo::Groups::iterator it = pFileInfo->GetGroups()->begin(); it != pFileInfo->GetGroups()->end(); it++)
+	if (!Util::FileExists(szFilename))
 	{
-		fprintf(outfile, "%s\n", *it);
+		return false;
 	}
 
-	fprintf(outfile, "%i\n", (int)pFileInfo->GetArticles()->size());
-	for (FileInfo::Articles::iterator it = pFileInfo->GetArticles()->begin(); it != pFileInfo->GetArticles()->end(); it++)
+	MappedFile mappedFile;
+	if (!mappedFile.Open(szFilename))
 	{
-		ArticleInfo* pArticleInfo = *it;
-		fprintf(outfile, "%i,%i\n", pArticleInfo->GetPartNumber(), pArticleInfo->GetSize());
-		fprintf(outfile, "%s\n", pArticleInfo->GetMessageID());
+		error("Error reading diskstate: could not open file %s", szFilename);
+		return false;
+	}
+
+	BinaryReader reader(mappedFile.GetData(), mappedFile.GetSize());
+
+	int iFormatVersion;
+	long long lBlockSize, lFileSize;
+	int iBlockCount;
+	if (!reader.ReadHeader(BINARY_KIND_BLOCKHASHES, &iFormatVersion)) goto error;
+	if (iFormatVersion > BINARY_BLOCKHASHES_VERSION)
+	{
+		error("Could not load diskstate due to file version mismatch");
+		goto error;
+	}
+
+	if (!reader.ReadInt64(&lBlockSize) || lBlockSize != pBlockHasher->GetBlockSize()) goto error;
+	if (!reader.ReadInt64(&lFileSize)) goto error;
+	pBlockHasher->SetFileSize(lFileSize);
+	if (!reader.Read(pBlockHasher->GetFileMd5(), 16)) goto error;
+	if (!reader.ReadInt(&iBlockCount) || iBlockCount < 0 || reader.GetRemaining() < (long long)iBlockCount * (4 + 16)) goto error;
+
+	pBlockHasher->GetBlockHashes()->resize(iBlockCount);
+	for (int i = 0; i < iBlockCount; i++)
+	{
+		BlockHasher::BlockHash& blockHash = pBlockHasher->GetBlockHashes()->at(i);
+		int iCrc;
+		if (!reader.ReadInt(&iCrc)) goto error;
+		blockHash.iCrc = (unsigned int)iCrc;
+		if (!reader.Read(blockHash.Md5, sizeof(blockHash.Md5))) goto error;
 	}
 
-	fclose(outfile);
 	return true;
+
+error:
+	error("Error reading diskstate for file %s", szFilename);
+	return false;
 }
+#endif
 
-bool DiskState::LoadArticles(FileInfo* pFileInfo)
+bool DiskState::ReadFileState(BinaryReader* pReader, FileInfo* pFileInfo, Servers* pServers, bool bCompleted)
 {
-	char fileName[1024];
-	snprintf(fileName, 1024, "%s%i", g_pOptions->GetQueueDir(), pFileInfo->GetID());
-	fileName[1024-1] = '\0';
-	return LoadFileInfo(pFileInfo, fileName, false, true);
+	return ReadFileStateSummary(pReader, pFileInfo, pServers) &&
+		ReadArticleStates(pReader, pFileInfo, bCompleted);
 }
 
-bool DiskState::LoadFileInfo(FileInfo* pFileInfo, const char * szFilename, bool bFileSummary, bool bArticles)
+bool DiskState::ReadFileStateSummary(BinaryReader* pReader, FileInfo* pFileInfo, Servers* pServers)
 {
-	debug("Loading FileInfo from disk");
-
-	FILE* infile = fopen(szFilename, FOPEN_RB);
+	int iSuccessArticles, iFailedArticles;
+	long long lRemainingSize, lSuccessSize, lFailedSize;
+	if (!pReader->ReadInt(&iSuccessArticles) || !pReader->ReadInt(&iFailedArticles) ||
+		!pReader->ReadInt64(&lRemainingSize) || !pReader->ReadInt64(&lSuccessSize) ||
+		!pReader->ReadInt64(&lFailedSize)) return false;
+	pFileInfo->SetSuccessArticles(iSuccessArticles);
+	pFileInfo->SetFailedArticles(iFailedArticles);
+	pFileInfo->SetRemainingSize(lRemainingSize);
+	pFileInfo->SetSuccessSize(lSuccessSize);
+	pFileInfo->SetFailedSize(lFailedSize);
 
-	if (!infile)
+	int iStatCount;
+	if (!pReader->ReadInt(&iStatCount)) return false;
+	for (int i = 0; i < iStatCount; i++)
 	{
-		error("Error reading diskstate: could not open file %s", szFilename);
-		return false;
+		int iServerID;
+		if (!pReader->ReadInt(&iServerID) || !pReader->ReadInt(&iSuccessArticles) || !pReader->ReadInt(&iFailedArticles)) return false;
+		SetServerStat(pFileInfo->GetServerStats(), pServers, iServerID, iSuccessArticles, iFailedArticles);
 	}
 
-	char buf[1024];
-	int iFormatVersion = 0;
+	return true;
+}
 
-	if (fgets(buf, sizeof(buf), infile))
+bool DiskState::ReadArticleStates(BinaryReader* pReader, FileInfo* pFileInfo, bool bCompleted)
+{
+	bool bHasArticles = !pFileInfo->GetArticles()->empty();
+
+	int iArticleCount;
+	if (!pReader->ReadInt(&iArticleCount) || iArticleCount < 0) return false;
+	if (bHasArticles && iArticleCount != (int)pFileInfo->GetArticles()->size()) return false;
+
+	int iCompletedArticles = 0;
+	for (int i = 0; i < iArticleCount; i++)
 	{
-		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-		iFormatVersion = ParseFormatVersion(buf);
-		if (iFormatVersion > 3)
+		if (!bHasArticles)
 		{
-			error("Could not load diskstate due to file version mismatch");
-			goto error;
+			pFileInfo->GetArticles()->push_back(pFileInfo->GetArticlePool()->NewArticle());
 		}
-	}
-	else
-	{
-		goto error;
-	}
-	
-	if (iFormatVersion >= 2)
-	{
-		if (!fgets(buf, sizeof(buf), infile)) goto error;
-		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-	}
+		ArticleInfo* pa = pFileInfo->GetArticles()->at(i);
 
-	if (bFileSummary) pFileInfo->SetSubject(buf);
+		int iStatus, iSegmentSize, iCrc;
+		long long lSegmentOffset;
+		if (!pReader->ReadInt(&iStatus) || !pReader->ReadInt(&iSegmentSize) ||
+			!pReader->ReadInt64(&lSegmentOffset) || !pReader->ReadInt(&iCrc)) return false;
+		pa->SetSegmentOffset(lSegmentOffset);
+		pa->SetSegmentSize(iSegmentSize);
+		pa->SetCrc((unsigned long)(unsigned int)iCrc);
 
-	if (!fgets(buf, sizeof(buf), infile)) goto error;
-	if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-	if (bFileSummary) pFileInfo->SetFilename(buf);
+		ArticleInfo::EStatus eStatus = (ArticleInfo::EStatus)iStatus;
 
-	if (iFormatVersion < 2)
-	{
-		int iFilenameConfirmed;
-		if (fscanf(infile, "%i\n", &iFilenameConfirmed) != 1) goto error;
-		if (bFileSummary) pFileInfo->SetFilenameConfirmed(iFilenameConfirmed);
-	}
-	
-	unsigned long High, Low;
-	if (fscanf(infile, "%lu,%lu\n", &High, &Low) != 2) goto error;
-	if (bFileSummary) pFileInfo->SetSize(Util::JoinInt64(High, Low));
-	if (bFileSummary) pFileInfo->SetRemainingSize(pFileInfo->GetSize());
+		if (eStatus == ArticleInfo::aiRunning)
+		{
+			eStatus = ArticleInfo::aiUndefined;
+		}
 
-	if (iFormatVersion >= 2)
-	{
-		if (fscanf(infile, "%lu,%lu\n", &High, &Low) != 2) goto error;
-		if (bFileSummary) pFileInfo->SetMissedSize(Util::JoinInt64(High, Low));
-		if (bFileSummary) pFileInfo->SetRemainingSize(pFileInfo->GetSize() - pFileInfo->GetMissedSize());
+		// don't allow all articles be completed or the file will stuck.
+		// such states should never be saved on disk but just in case.
+		if (iCompletedArticles == iArticleCount - 1 && !bCompleted)
+		{
+			eStatus = ArticleInfo::aiUndefined;
+		}
+		if (eStatus != ArticleInfo::aiUndefined)
+		{
+			iCompletedArticles++;
+		}
 
-		int iParFile;
-		if (fscanf(infile, "%i\n", &iParFile) != 1) goto error;
-		if (bFileSummary) pFileInfo->SetParFile((bool)iParFile);
+		pa->SetStatus(eStatus);
 	}
 
-	if (iFormatVersion >= 3)
-	{
-		int iTotalArticles, iMissedArticles;
-		if (fscanf(infile, "%i,%i\n", &iTotalArticles, &iMissedArticles) != 2) goto error;
-		if (bFileSummary) pFileInfo->SetTotalArticles(iTotalArticles);
-		if (bFileSummary) pFileInfo->SetMissedArticles(iMissedArticles);
-	}
-	
-	int size;
-	if (fscanf(infile, "%i\n", &size) != 1) goto error;
-	for (int i = 0; i < size; i++)
-	{
-		if (!fgets(buf, sizeof(buf), infile)) goto error;
-		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-		if (bFileSummary) pFileInfo->GetGroups()->push_back(strdup(buf));
-	}
+	pFileInfo->SetCompletedArticles(iCompletedArticles);
 
-	if (fscanf(infile, "%i\n", &size) != 1) goto error;
+	return true;
+}
 
-	if (iFormatVersion < 3 && bFileSummary)
-	{
-		pFileInfo->SetTotalArticles(size);
-	}
+/*
+ * Checks article states written by WriteFileState without creating article-infos
+ * and counts completed articles the same way as ReadArticleStates does.
+ */
+bool DiskState::CountArticleStates(const char* pData, int iSize, int* pCompletedArticles)
+{
+	BinaryReader reader(pData, iSize);
+	int iArticleCount;
+	if (!reader.ReadInt(&iArticleCount) || iArticleCount < 0 ||
+		reader.GetRemaining() != (long long)iArticleCount * ARTICLESTATE_SIZE) return false;
 
-	if (bArticles)
+	int iCompletedArticles = 0;
+	for (int i = 0; i < iArticleCount; i++)
 	{
-		for (int i = 0; i < size; i++)
+		int iStatus = 0;
+		if (!reader.ReadInt(&iStatus)) return false;
+		reader.Skip(ARTICLESTATE_SIZE - 4);
+		if (iStatus != ArticleInfo::aiUndefined && iStatus != ArticleInfo::aiRunning &&
+			iCompletedArticles < iArticleCount - 1)
 		{
-			int PartNumber, PartSize;
-			if (fscanf(infile, "%i,%i\n", &PartNumber, &PartSize) != 2) goto error;
-
-			if (!fgets(buf, sizeof(buf), infile)) goto error;
-			if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-
-			ArticleInfo* pArticleInfo = new ArticleInfo();
-			pArticleInfo->SetPartNumber(PartNumber);
-			pArticleInfo->SetSize(PartSize);
-			pArticleInfo->SetMessageID(buf);
-			pFileInfo->GetArticles()->push_back(pArticleInfo);
+			iCompletedArticles++;
 		}
 	}
 
-	fclose(infile);
+	*pCompletedArticles = iCompletedArticles;
 	return true;
-
-error:
-	fclose(infile);
-	error("Error reading diskstate for file %s", szFilename);
-	return false;
 }
 
-bool DiskState::SaveFileState(FileInfo* pFileInfo, bool bCompleted)
+/*
+ * Saves states of partially downloaded files into checkpoint file "partial".
+ * Instead of writing one file per changed file-info the states of all changed
+ * files are appended to the checkpoint file as one block with a single write.
+ * Once the checkpoint file grows too large it is rewritten (compacted) with
+ * the current states of all files which have their articles loaded.
+ *
+ * Block layout: count of entries, entries (file id, size of state, file state)
+ * and end mark; a block without end mark (interrupted write) is ignored on loading.
+ */
+bool DiskState::SavePartialStates(DownloadQueue* pDownloadQueue, bool bCompact)
 {
-	debug("Saving FileState to disk");
+	bCompact = bCompact || m_lPartialSize == 0 || m_lPartialSize > m_lPartialCompactSize;
+
+	FileList fileList(false);
+	FileList deferredList(false);
+	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
+	{
+		NZBInfo* pNZBInfo = *it;
+		for (FileList::iterator it2 = pNZBInfo->GetFileList()->begin(); it2 != pNZBInfo->GetFileList()->end(); it2++)
+		{
+			FileInfo* pFileInfo = *it2;
+			if (bCompact ? !pFileInfo->GetArticles()->empty() : pFileInfo->GetPartialChanged())
+			{
+				fileList.push_back(pFileInfo);
+			}
+			else if (bCompact && m_DeferredStates.find(pFileInfo->GetID()) != m_DeferredStates.end())
+			{
+				deferredList.push_back(pFileInfo);
+			}
+		}
+	}
+
+	if (!bCompact && fileList.empty())
+	{
+		return true;
+	}
 
 	char szFilename[1024];
-	snprintf(szFilename, 1024, "%s%i%s", g_pOptions->GetQueueDir(), pFileInfo->GetID(), bCompleted ? "c" : "s");
+	snprintf(szFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), "partial");
 	szFilename[1024-1] = '\0';
 
-	FILE* outfile = fopen(szFilename, FOPEN_WB);
+	char szTempFilename[1024];
+	snprintf(szTempFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), "partial.new");
+	szTempFilename[1024-1] = '\0';
 
+	const char* szOutFilename = bCompact ? szTempFilename : szFilename;
+	FILE* outfile = fopen(szOutFilename, bCompact ? FOPEN_WB : FOPEN_AB);
 	if (!outfile)
 	{
-		error("Error saving diskstate: could not create file %s", szFilename);
+		error("Error saving diskstate: could not create file %s", szOutFilename);
 		return false;
 	}
 
-	fprintf(outfile, "%s%i\n", FORMATVERSION_SIGNATURE, 2);
+	BinaryWriter writer(outfile);
+	if (bCompact)
+	{
+		writer.WriteHeader(BINARY_KIND_PARTIALSTATE, BINARY_PARTIALSTATE_VERSION);
+	}
 
-	fprintf(outfile, "%i,%i\n", pFileInfo->GetSuccessArticles(), pFileInfo->GetFailedArticles());
+	writer.WriteInt((int)(fileList.size() + deferredList.size()));
+	for (FileList::iterator it = fileList.begin(); it != fileList.end(); it++)
+	{
+		FileInfo* pFileInfo = *it;
+		debug("Saving partial state for %s", pFileInfo->GetFilename());
+		writer.WriteInt(pFileInfo->GetID());
+		writer.WriteInt(CalcFileStateSize(pFileInfo));
+		WriteFileState(&writer, pFileInfo);
+	}
+	for (FileList::iterator it = deferredList.begin(); it != deferredList.end(); it++)
+	{
+		// article states not loaded yet are copied as they are
+		FileInfo* pFileInfo = *it;
+		PartialArticles* pArticles = &m_DeferredStates[pFileInfo->GetID()];
+		writer.WriteInt(pFileInfo->GetID());
+		writer.WriteInt(CalcFileStateSummarySize(pFileInfo) + pArticles->iSize);
+		WriteFileStateSummary(&writer, pFileInfo);
+		writer.Write(pArticles->pData, pArticles->iSize);
+	}
+	writer.WriteInt(PARTIALSTATE_BLOCKEND);
 
-	unsigned long High1, Low1, High2, Low2, High3, Low3;
-	Util::SplitInt64(pFileInfo->GetRemainingSize(), &High1, &Low1);
-	Util::SplitInt64(pFileInfo->GetSuccessSize(), &High2, &Low2);
-	Util::SplitInt64(pFileInfo->GetFailedSize(), &High3, &Low3);
-	fprintf(outfile, "%lu,%lu,%lu,%lu,%lu,%lu\n", High1, Low1, High2, Low2, High3, Low3);
+	bool bOK = writer.Flush();
+	if (g_pOptions->GetFlushQueue())
+	{
+		bOK = Util::FlushFileBuffers(outfile) && bOK;
+	}
+	long long lSize = ftell(outfile);
+	fclose(outfile);
+
+	if (!bOK)
+	{
+		error("Error saving diskstate: could not write file %s", szOutFilename);
+		// the file may end with an incomplete block now, start a new file on next save
+		m_lPartialSize = 0;
+		return false;
+	}
+
+	if (bCompact)
+	{
+		remove(szFilename);
+		if (rename(szTempFilename, szFilename))
+		{
+			error("Error saving diskstate: could not rename file %s to %s", szTempFilename, szFilename);
+			m_lPartialSize = 0;
+			return false;
+		}
+		m_lPartialCompactSize = lSize * 4 > PARTIALSTATE_COMPACTSIZE ? lSize * 4 : PARTIALSTATE_COMPACTSIZE;
+
+		// forget states of files which are not in the queue anymore
+		std::map<int, bool> written;
+		for (FileList::iterator it = deferredList.begin(); it != deferredList.end(); it++)
+		{
+			written[(*it)->GetID()] = true;
+		}
+		for (DeferredStates::iterator it = m_DeferredStates.begin(); it != m_DeferredStates.end(); )
+		{
+			DeferredStates::iterator itCur = it++;
+			if (written.find(itCur->first) == written.end())
+			{
+				free(itCur->second.pData);
+				m_DeferredStates.erase(itCur);
+			}
+		}
+	}
 
-	SaveServerStats(pFileInfo->GetServerStats(), outfile);
+	m_lPartialSize = lSize;
 
-	fprintf(outfile, "%i\n", (int)pFileInfo->GetArticles()->size());
-	for (FileInfo::Articles::iterator it = pFileInfo->GetArticles()->begin(); it != pFileInfo->GetArticles()->end(); it++)
+	for (FileList::iterator it = fileList.begin(); it != fileList.end(); it++)
 	{
-		ArticleInfo* pArticleInfo = *it;
-		fprintf(outfile, "%i,%lu,%i,%lu\n", (int)pArticleInfo->GetStatus(), (unsigned long)pArticleInfo->GetSegmentOffset(),
-			pArticleInfo->GetSegmentSize(), (unsigned long)pArticleInfo->GetCrc());
+		FileInfo* pFileInfo = *it;
+		pFileInfo->SetPartialChanged(false);
 	}
 
-	fclose(outfile);
 	return true;
 }
 
-bool DiskState::LoadFileState(FileInfo* pFileInfo, Servers* pServers, bool bCompleted)
+/*
+ * Loads checkpoint file "partial" saved by SavePartialStates.
+ * For every file only the latest state from a complete block is used.
+ */
+bool DiskState::LoadPartialStates(DownloadQueue* pDownloadQueue, Servers* pServers)
 {
+	typedef std::map<int, FileInfo*> FileMap;
+	typedef std::map<int, std::pair<const char*, int> > StateMap;
+
 	char szFilename[1024];
-	snprintf(szFilename, 1024, "%s%i%s", g_pOptions->GetQueueDir(), pFileInfo->GetID(), bCompleted ? "c" : "s");
+	snprintf(szFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), "partial");
 	szFilename[1024-1] = '\0';
 
-	bool bHasArticles = !pFileInfo->GetArticles()->empty();
-
-	FILE* infile = fopen(szFilename, FOPEN_RB);
+	if (!Util::FileExists(szFilename))
+	{
+		return true;
+	}
 
-	if (!infile)
+	MappedFile mappedFile;
+	if (!mappedFile.Open(szFilename))
 	{
 		error("Error reading diskstate: could not open file %s", szFilename);
 		return false;
 	}
 
-	char buf[1024];
-	int iFormatVersion = 0;
+	BinaryReader reader(mappedFile.GetData(), mappedFile.GetSize());
 
-	if (fgets(buf, sizeof(buf), infile))
-	{
-		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-		iFormatVersion = ParseFormatVersion(buf);
-		if (iFormatVersion > 2)
-		{
-			error("Could not load diskstate due to file version mismatch");
-			goto error;
-		}
-	}
-	else
+	int iFormatVersion;
+	if (!reader.ReadHeader(BINARY_KIND_PARTIALSTATE, &iFormatVersion) || iFormatVersion > BINARY_PARTIALSTATE_VERSION)
 	{
-		goto error;
+		error("Could not load diskstate due to file version mismatch");
+		error("Error reading diskstate for file %s", szFilename);
+		return false;
 	}
 
-	int iSuccessArticles, iFailedArticles;
-	if (fscanf(infile, "%i,%i\n", &iSuccessArticles, &iFailedArticles) != 2) goto error;
-	pFileInfo->SetSuccessArticles(iSuccessArticles);
-	pFileInfo->SetFailedArticles(iFailedArticles);
-
-	unsigned long High1, Low1, High2, Low2, High3, Low3;
-	if (fscanf(infile, "%lu,%lu,%lu,%lu,%lu,%lu\n", &High1, &Low1, &High2, &Low2, &High3, &Low3) != 6) goto error;
-	pFileInfo->SetRemainingSize(Util::JoinInt64(High1, Low1));
-	pFileInfo->SetSuccessSize(Util::JoinInt64(High2, Low3));
-	pFileInfo->SetFailedSize(Util::JoinInt64(High3, Low3));
-
-	if (!LoadServerStats(pFileInfo->GetServerStats(), pServers, infile)) goto error;
-
-	int iCompletedArticles;
-	iCompletedArticles = 0; //clang requires initialization in a separate line (due to goto statements)
-
-	int size;
-	if (fscanf(infile, "%i\n", &size) != 1) goto error;
-	for (int i = 0; i < size; i++)
+	StateMap states;
+	int iBlocks = 0;
+	while (reader.GetRemaining() > 0)
 	{
-		if (!bHasArticles)
-		{
-			pFileInfo->GetArticles()->push_back(new ArticleInfo());
-		}
-		ArticleInfo* pa = pFileInfo->GetArticles()->at(i);
-
-		int iStatus;
-
-		if (iFormatVersion >= 2)
+		StateMap blockStates;
+		int iCount;
+		bool bOK = reader.ReadInt(&iCount) && iCount >= 0;
+		for (int i = 0; i < iCount && bOK; i++)
 		{
-			unsigned long iSegmentOffset, iCrc;
-			int iSegmentSize;
-			if (fscanf(infile, "%i,%lu,%i,%lu\n", &iStatus, &iSegmentOffset, &iSegmentSize, &iCrc) != 4) goto error;
-			pa->SetSegmentOffset(iSegmentOffset);
-			pa->SetSegmentSize(iSegmentSize);
-			pa->SetCrc(iCrc);
+			int iID, iSize;
+			bOK = reader.ReadInt(&iID) && reader.ReadInt(&iSize) &&
+				iSize >= 0 && reader.GetRemaining() >= iSize;
+			if (bOK)
+			{
+				blockStates[iID] = std::make_pair(reader.GetPos(), iSize);
+				reader.Skip(iSize);
+			}
 		}
-		else
+		int iBlockEnd;
+		if (!bOK || !reader.ReadInt(&iBlockEnd) || iBlockEnd != PARTIALSTATE_BLOCKEND)
 		{
-			if (fscanf(infile, "%i\n", &iStatus) != 1) goto error;
+			warn("Incomplete block in file %s was ignored", szFilename);
+			break;
 		}
 
-		ArticleInfo::EStatus eStatus = (ArticleInfo::EStatus)iStatus;
-
-		if (eStatus == ArticleInfo::aiRunning)
+		for (StateMap::iterator it = blockStates.begin(); it != blockStates.end(); it++)
 		{
-			eStatus = ArticleInfo::aiUndefined;
+			states[it->first] = it->second;
 		}
+		iBlocks++;
+	}
 
-		// don't allow all articles be completed or the file will stuck.
-		// such states should never be saved on disk but just in case.
-		if (iCompletedArticles == size - 1 && !bCompleted)
+	FileMap fileMap;
+	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
+	{
+		NZBInfo* pNZBInfo = *it;
+		for (FileList::iterator it2 = pNZBInfo->GetFileList()->begin(); it2 != pNZBInfo->GetFileList()->end(); it2++)
 		{
-			eStatus = ArticleInfo::aiUndefined;
+			FileInfo* pFileInfo = *it2;
+			fileMap[pFileInfo->GetID()] = pFileInfo;
 		}
-		if (eStatus != ArticleInfo::aiUndefined)
+	}
+
+	for (StateMap::iterator it = states.begin(); it != states.end(); it++)
+	{
+		// states of files which are not in the queue anymore are skipped
+		FileMap::iterator itFile = fileMap.find(it->first);
+		if (itFile != fileMap.end())
 		{
-			iCompletedArticles++;
-		}
+			FileInfo* pFileInfo = itFile->second;
+			BinaryReader stateReader(it->second.first, it->second.second);
+			if (!pFileInfo->GetArticles()->empty())
+			{
+				if (!ReadFileState(&stateReader, pFileInfo, pServers, false)) goto error;
+				continue;
+			}
 
-		pa->SetStatus(eStatus);
+			// the article list isn't loaded yet; the summary is applied now and
+			// article states are applied in LoadArticles when the file is needed
+			if (!ReadFileStateSummary(&stateReader, pFileInfo, pServers)) goto error;
+
+			int iCompletedArticles;
+			int iSize = (int)stateReader.GetRemaining();
+			if (!CountArticleStates(stateReader.GetPos(), iSize, &iCompletedArticles)) goto error;
+			pFileInfo->SetCompletedArticles(iCompletedArticles);
+
+			PartialArticles* pArticles = &m_DeferredStates[pFileInfo->GetID()];
+			free(pArticles->pData);
+			pArticles->pData = (char*)malloc(iSize);
+			pArticles->iSize = iSize;
+			memcpy(pArticles->pData, stateReader.GetPos(), iSize);
+		}
 	}
 
-	pFileInfo->SetCompletedArticles(iCompletedArticles);
+	detail("Loaded %i partial state(s) from %i checkpoint(s)", (int)states.size(), iBlocks);
 
-	fclose(infile);
 	return true;
 
 error:
-	fclose(infile);
 	error("Error reading diskstate for file %s", szFilename);
 	return false;
 }
@@ -1365,6 +3290,12 @@ void DiskState::DiscardFiles(NZBInfo* pNZBInfo)
 	for (CompletedFiles::iterator it = pNZBInfo->GetCompletedFiles()->begin(); it != pNZBInfo->GetCompletedFiles()->end(); it++)
 	{
 		CompletedFile* pCompletedFile = *it;
+		if (pCompletedFile->GetID() > 0)
+		{
+			snprintf(szFilename, 1024, "%s%ih", g_pOptions->GetQueueDir(), pCompletedFile->GetID());
+			szFilename[1024-1] = '\0';
+			remove(szFilename);
+		}
 		if (pCompletedFile->GetStatus() != CompletedFile::cfSuccess && pCompletedFile->GetID() > 0)
 		{
 			snprintf(szFilename, 1024, "%s%i", g_pOptions->GetQueueDir(), pCompletedFile->GetID());
@@ -1383,6 +3314,7 @@ void DiskState::DiscardFiles(NZBInfo* pNZBInfo)
 
 	snprintf(szFilename, 1024, "%sn%i.log", g_pOptions->GetQueueDir(), pNZBInfo->GetID());
 	szFilename[1024-1] = '\0';
+	g_pLog->Flush();
 	remove(szFilename);
 }
 
@@ -1390,6 +3322,9 @@ bool DiskState::LoadPostQueue12(DownloadQueue* pDownloadQueue, NZBList* pNZBList
 {
 	debug("Loading post-queue from disk");
 
+	// the queue was changed during loading
+	pDownloadQueue->InvalidateIndex();
+
 	int size;
 	char buf[10240];
 
@@ -1429,7 +3364,7 @@ bool DiskState::LoadPostQueue12(DownloadQueue* pDownloadQueue, NZBList* pNZBList
 		}
 		else
 		{
-			pNZBInfo = FindNZBInfo(pDownloadQueue, iNZBID);
+			pNZBInfo = pDownloadQueue->FindNZBInfo(iNZBID);
 			if (!pNZBInfo) goto error;
 		}
 
@@ -1687,195 +3622,511 @@ bool DiskState::LoadUrlInfo12(NZBInfo* pNZBInfo, FILE* infile, int iFormatVersio
 		pNZBInfo->SetDupeScore(iDupeScore);
 	}
 
-	return true;
+	return true;
+
+error:
+	return false;
+}
+
+void DiskState::SaveDupInfo(DupInfo* pDupInfo, StringBuilder* outfile)
+{
+	unsigned long High, Low;
+	Util::SplitInt64(pDupInfo->GetSize(), &High, &Low);
+	fprintf(outfile, "%i,%lu,%lu,%u,%u,%i,%i\n", (int)pDupInfo->GetStatus(), High, Low,
+		pDupInfo->GetFullContentHash(), pDupInfo->GetFilteredContentHash(),
+		pDupInfo->GetDupeScore(), (int)pDupInfo->GetDupeMode());
+	fprintf(outfile, "%s\n", pDupInfo->GetName());
+	fprintf(outfile, "%s\n", pDupInfo->GetDupeKey());
+}
+
+bool DiskState::LoadDupInfo(DupInfo* pDupInfo, FILE* infile, int iFormatVersion)
+{
+	char buf[1024];
+
+	int iStatus;
+	unsigned long High, Low;
+	unsigned int iFullContentHash, iFilteredContentHash = 0;
+	int iDupeScore, iDupe = 0, iDupeMode = 0;
+	
+	if (iFormatVersion >= 39)
+	{
+		if (fscanf(infile, "%i,%lu,%lu,%u,%u,%i,%i\n", &iStatus, &High, &Low, &iFullContentHash, &iFilteredContentHash, &iDupeScore, &iDupeMode) != 7) goto error;
+	}
+	else if (iFormatVersion >= 38)
+	{
+		if (fscanf(infile, "%i,%lu,%lu,%u,%u,%i,%i,%i\n", &iStatus, &High, &Low, &iFullContentHash, &iFilteredContentHash, &iDupeScore, &iDupe, &iDupeMode) != 8) goto error;
+	}
+	else if (iFormatVersion >= 37)
+	{
+		if (fscanf(infile, "%i,%lu,%lu,%u,%u,%i,%i\n", &iStatus, &High, &Low, &iFullContentHash, &iFilteredContentHash, &iDupeScore, &iDupe) != 7) goto error;
+	}
+	else if (iFormatVersion >= 34)
+	{
+		if (fscanf(infile, "%i,%lu,%lu,%u,%u,%i\n", &iStatus, &High, &Low, &iFullContentHash, &iFilteredContentHash, &iDupeScore) != 6) goto error;
+	}
+	else
+	{
+		if (fscanf(infile, "%i,%lu,%lu,%u,%i\n", &iStatus, &High, &Low, &iFullContentHash, &iDupeScore) != 5) goto error;
+	}
+
+	pDupInfo->SetStatus((DupInfo::EStatus)iStatus);
+	pDupInfo->SetFullContentHash(iFullContentHash);
+	pDupInfo->SetFilteredContentHash(iFilteredContentHash);
+	pDupInfo->SetSize(Util::JoinInt64(High, Low));
+	pDupInfo->SetDupeScore(iDupeScore);
+	pDupInfo->SetDupeMode((EDupeMode)iDupeMode);
+
+	if (!fgets(buf, sizeof(buf), infile)) goto error;
+	if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+	pDupInfo->SetName(buf);
+
+	if (!fgets(buf, sizeof(buf), infile)) goto error;
+	if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+	if (iFormatVersion < 36) ConvertDupeKey(buf, sizeof(buf));
+	pDupInfo->SetDupeKey(buf);
+
+	return true;
+
+error:
+	return false;
+}
+
+void DiskState::SaveHistoryInfo(HistoryInfo* pHistoryInfo, StringBuilder* outfile, bool bFileInfos)
+{
+	fprintf(outfile, "%i,%i,%i\n", pHistoryInfo->GetID(), (int)pHistoryInfo->GetKind(), (int)pHistoryInfo->GetTime());
+
+	if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb || pHistoryInfo->GetKind() == HistoryInfo::hkUrl)
+	{
+		SaveNZBInfo(pHistoryInfo->GetNZBInfo(), outfile, bFileInfos);
+	}
+	else if (pHistoryInfo->GetKind() == HistoryInfo::hkDup)
+	{
+		SaveDupInfo(pHistoryInfo->GetDupInfo(), outfile);
+	}
+}
+
+bool DiskState::LoadHistory(DownloadQueue* pDownloadQueue, NZBList* pNZBList, Servers* pServers, FILE* infile, int iFormatVersion)
+{
+	debug("Loading history from disk");
+
+	int size;
+	if (fscanf(infile, "%i\n", &size) != 1) goto error;
+	for (int i = 0; i < size; i++)
+	{
+		HistoryInfo* pHistoryInfo = LoadHistoryInfo(pNZBList, pServers, infile, iFormatVersion);
+		if (!pHistoryInfo) goto error;
+		pDownloadQueue->GetHistory()->push_back(pHistoryInfo);
+	}
+
+	return true;
+
+error:
+	error("Error reading diskstate for history");
+	return false;
+}
+
+HistoryInfo* DiskState::LoadHistoryInfo(NZBList* pNZBList, Servers* pServers, FILE* infile, int iFormatVersion, bool bDetached)
+{
+	HistoryInfo* pHistoryInfo = NULL;
+	HistoryInfo::EKind eKind = HistoryInfo::hkNzb;
+	int iID = 0;
+	int iTime;
+
+	if (iFormatVersion >= 33)
+	{
+		int iKind = 0;
+		if (fscanf(infile, "%i,%i,%i\n", &iID, &iKind, &iTime) != 3) goto error;
+		eKind = (HistoryInfo::EKind)iKind;
+	}
+	else
+	{
+		if (iFormatVersion >= 24)
+		{
+			if (fscanf(infile, "%i\n", &iID) != 1) goto error;
+		}
+
+		if (iFormatVersion >= 15)
+		{
+			int iKind = 0;
+			if (fscanf(infile, "%i\n", &iKind) != 1) goto error;
+			eKind = (HistoryInfo::EKind)iKind;
+		}
+	}
+
+	if (eKind == HistoryInfo::hkNzb)
+	{
+		NZBInfo* pNZBInfo = NULL;
+
+		if (iFormatVersion < 43)
+		{
+			unsigned int iNZBIndex;
+			if (fscanf(infile, "%i\n", &iNZBIndex) != 1) goto error;
+			pNZBInfo = pNZBList->at(iNZBIndex - 1);
+		}
+		else
+		{
+			pNZBInfo = new NZBInfo(bDetached);
+			if (!LoadNZBInfo(pNZBInfo, pServers, infile, iFormatVersion)) goto error;
+			pNZBInfo->LeavePostProcess();
+		}
+
+		pHistoryInfo = new HistoryInfo(pNZBInfo, bDetached);
+		
+		if (iFormatVersion < 28 && pNZBInfo->GetParStatus() == 0 &&
+			pNZBInfo->GetUnpackStatus() == 0 && pNZBInfo->GetMoveStatus() == 0)
+		{
+			pNZBInfo->SetDeleteStatus(NZBInfo::dsManual);
+		}
+	}
+	else if (eKind == HistoryInfo::hkUrl)
+	{
+		NZBInfo* pNZBInfo = new NZBInfo(bDetached);
+		if (iFormatVersion >= 46)
+		{
+			if (!LoadNZBInfo(pNZBInfo, pServers, infile, iFormatVersion)) goto error;
+		}
+		else
+		{
+			if (!LoadUrlInfo12(pNZBInfo, infile, iFormatVersion)) goto error;
+		}
+		pHistoryInfo = new HistoryInfo(pNZBInfo, bDetached);
+	}
+	else if (eKind == HistoryInfo::hkDup)
+	{
+		DupInfo* pDupInfo = new DupInfo(bDetached);
+		if (!LoadDupInfo(pDupInfo, infile, iFormatVersion)) goto error;
+		if (iFormatVersion >= 47)
+		{
+			pDupInfo->SetID(iID);
+		}
+		pHistoryInfo = new HistoryInfo(pDupInfo, bDetached);
+	}
+	else
+	{
+		goto error;
+	}
+
+	if (iFormatVersion < 33)
+	{
+		if (fscanf(infile, "%i\n", &iTime) != 1) goto error;
+	}
+
+	pHistoryInfo->SetTime((time_t)iTime);
+
+	return pHistoryInfo;
+
+error:
+	return NULL;
+}
+
+ArchiveEntry::ArchiveEntry(HistoryInfo* pHistoryInfo, long lOffset)
+{
+	m_iID = pHistoryInfo->GetID();
+	m_eKind = pHistoryInfo->GetKind();
+	m_tTime = pHistoryInfo->GetTime();
+	m_lOffset = lOffset;
+	m_szStatus = pHistoryInfo->MakeTextStatus();
 
-error:
-	return false;
+	if (m_eKind == HistoryInfo::hkNzb || m_eKind == HistoryInfo::hkUrl)
+	{
+		m_lSize = pHistoryInfo->GetNZBInfo()->GetSize();
+		m_szCategory = strdup(pHistoryInfo->GetNZBInfo()->GetCategory());
+	}
+	else
+	{
+		m_lSize = pHistoryInfo->GetDupInfo()->GetSize();
+		m_szCategory = strdup("");
+	}
+
+	char szName[1024];
+	pHistoryInfo->GetName(szName, sizeof(szName));
+	m_szName = strdup(szName);
 }
 
-void DiskState::SaveDupInfo(DupInfo* pDupInfo, FILE* outfile)
+ArchiveEntry::~ArchiveEntry()
 {
-	unsigned long High, Low;
-	Util::SplitInt64(pDupInfo->GetSize(), &High, &Low);
-	fprintf(outfile, "%i,%lu,%lu,%u,%u,%i,%i\n", (int)pDupInfo->GetStatus(), High, Low,
-		pDupInfo->GetFullContentHash(), pDupInfo->GetFilteredContentHash(),
-		pDupInfo->GetDupeScore(), (int)pDupInfo->GetDupeMode());
-	fprintf(outfile, "%s\n", pDupInfo->GetName());
-	fprintf(outfile, "%s\n", pDupInfo->GetDupeKey());
+	free(m_szName);
+	free(m_szCategory);
 }
 
-bool DiskState::LoadDupInfo(DupInfo* pDupInfo, FILE* infile, int iFormatVersion)
+/*
+ * Appends expired history items to file "archive". Each item is saved in
+ * the same format as in file "queue" and is preceded by line "A <length>".
+ * File-infos of items are not archived since they are deleted from disk
+ * together with the items.
+ */
+bool DiskState::ArchiveHistory(HistoryList* pHistoryList)
 {
-	char buf[1024];
+	char szFilename[1024];
+	snprintf(szFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), ARCHIVE_FILENAME);
+	szFilename[1024-1] = '\0';
 
-	int iStatus;
-	unsigned long High, Low;
-	unsigned int iFullContentHash, iFilteredContentHash = 0;
-	int iDupeScore, iDupe = 0, iDupeMode = 0;
-	
-	if (iFormatVersion >= 39)
+	m_mutexArchive.Lock();
+
+	bool bNewFile = !Util::FileExists(szFilename);
+	FILE* outfile = fopen(szFilename, FOPEN_AB);
+	if (!outfile)
 	{
-		if (fscanf(infile, "%i,%lu,%lu,%u,%u,%i,%i\n", &iStatus, &High, &Low, &iFullContentHash, &iFilteredContentHash, &iDupeScore, &iDupeMode) != 7) goto error;
+		m_mutexArchive.Unlock();
+		error("Error saving history archive: Could not open file %s", szFilename);
+		return false;
 	}
-	else if (iFormatVersion >= 38)
+
+	bool bOK = true;
+	if (bNewFile)
 	{
-		if (fscanf(infile, "%i,%lu,%lu,%u,%u,%i,%i,%i\n", &iStatus, &High, &Low, &iFullContentHash, &iFilteredContentHash, &iDupeScore, &iDupe, &iDupeMode) != 8) goto error;
+		bOK = fprintf(outfile, "%s%i\n", FORMATVERSION_SIGNATURE, QUEUE_FORMAT_VERSION) > 0;
 	}
-	else if (iFormatVersion >= 37)
+	fseek(outfile, 0, SEEK_END);
+
+	for (HistoryList::iterator it = pHistoryList->begin(); it != pHistoryList->end() && bOK; it++)
 	{
-		if (fscanf(infile, "%i,%lu,%lu,%u,%u,%i,%i\n", &iStatus, &High, &Low, &iFullContentHash, &iFilteredContentHash, &iDupeScore, &iDupe) != 7) goto error;
+		HistoryInfo* pHistoryInfo = *it;
+		StringBuilder record;
+		SaveHistoryInfo(pHistoryInfo, &record, false);
+		int iLen = strlen(record.GetBuffer());
+
+		bOK = fprintf(outfile, "A %i\n", iLen) > 0;
+		long lOffset = ftell(outfile);
+		bOK = bOK && fwrite(record.GetBuffer(), 1, iLen, outfile) == (size_t)iLen;
+
+		if (bOK && m_bArchiveLoaded)
+		{
+			m_ArchiveIndex.push_back(new ArchiveEntry(pHistoryInfo, lOffset));
+		}
 	}
-	else if (iFormatVersion >= 34)
+
+	bOK = fclose(outfile) == 0 && bOK;
+
+	if (!bOK)
 	{
-		if (fscanf(infile, "%i,%lu,%lu,%u,%u,%i\n", &iStatus, &High, &Low, &iFullContentHash, &iFilteredContentHash, &iDupeScore) != 6) goto error;
+		// the index doesn't match the file anymore
+		ClearArchiveIndex();
 	}
-	else
+
+	m_mutexArchive.Unlock();
+
+	if (!bOK)
 	{
-		if (fscanf(infile, "%i,%lu,%lu,%u,%i\n", &iStatus, &High, &Low, &iFullContentHash, &iDupeScore) != 5) goto error;
+		error("Error saving history archive: Could not write file %s", szFilename);
 	}
 
-	pDupInfo->SetStatus((DupInfo::EStatus)iStatus);
-	pDupInfo->SetFullContentHash(iFullContentHash);
-	pDupInfo->SetFilteredContentHash(iFilteredContentHash);
-	pDupInfo->SetSize(Util::JoinInt64(High, Low));
-	pDupInfo->SetDupeScore(iDupeScore);
-	pDupInfo->SetDupeMode((EDupeMode)iDupeMode);
-
-	if (!fgets(buf, sizeof(buf), infile)) goto error;
-	if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-	pDupInfo->SetName(buf);
+	return bOK;
+}
 
-	if (!fgets(buf, sizeof(buf), infile)) goto error;
-	if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-	if (iFormatVersion < 36) ConvertDupeKey(buf, sizeof(buf));
-	pDupInfo->SetDupeKey(buf);
+/*
+ * Removes items having history time older than tMinTime from the archive.
+ */
+void DiskState::PruneHistoryArchive(time_t tMinTime)
+{
+	char szFilename[1024];
+	snprintf(szFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), ARCHIVE_FILENAME);
+	szFilename[1024-1] = '\0';
 
-	return true;
+	char szTempFilename[1024];
+	snprintf(szTempFilename, 1024, "%s%s.new", g_pOptions->GetQueueDir(), ARCHIVE_FILENAME);
+	szTempFilename[1024-1] = '\0';
 
-error:
-	return false;
-}
+	m_mutexArchive.Lock();
 
-void DiskState::SaveHistory(DownloadQueue* pDownloadQueue, FILE* outfile)
-{
-	debug("Saving history to disk");
+	FILE* infile = fopen(szFilename, FOPEN_RB);
+	if (!infile)
+	{
+		m_mutexArchive.Unlock();
+		return;
+	}
 
-	fprintf(outfile, "%i\n", (int)pDownloadQueue->GetHistory()->size());
-	for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
+	FILE* outfile = fopen(szTempFilename, FOPEN_WB);
+	if (!outfile)
 	{
-		HistoryInfo* pHistoryInfo = *it;
+		fclose(infile);
+		m_mutexArchive.Unlock();
+		error("Error saving history archive: Could not create file %s", szTempFilename);
+		return;
+	}
 
-		fprintf(outfile, "%i,%i,%i\n", pHistoryInfo->GetID(), (int)pHistoryInfo->GetKind(), (int)pHistoryInfo->GetTime());
+	char buf[1024];
+	bool bOK = fgets(buf, sizeof(buf), infile) && fputs(buf, outfile) >= 0;
+	int iRemoved = 0;
+	int iKept = 0;
+	int iBufSize = 0;
+	char* szRecord = NULL;
+
+	while (bOK && fgets(buf, sizeof(buf), infile))
+	{
+		int iLen;
+		bOK = sscanf(buf, "A %i", &iLen) == 1 && iLen > 0;
+		if (!bOK) break;
 
-		if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb || pHistoryInfo->GetKind() == HistoryInfo::hkUrl)
+		if (iLen + 1 > iBufSize)
 		{
-			SaveNZBInfo(pHistoryInfo->GetNZBInfo(), outfile);
+			iBufSize = iLen + 1;
+			szRecord = (char*)realloc(szRecord, iBufSize);
 		}
-		else if (pHistoryInfo->GetKind() == HistoryInfo::hkDup)
+		bOK = fread(szRecord, 1, iLen, infile) == (size_t)iLen;
+		if (!bOK) break;
+		szRecord[iLen] = '\0';
+
+		int iID, iKind, iTime;
+		bOK = sscanf(szRecord, "%i,%i,%i", &iID, &iKind, &iTime) == 3;
+		if (!bOK) break;
+
+		if ((time_t)iTime < tMinTime)
 		{
-			SaveDupInfo(pHistoryInfo->GetDupInfo(), outfile);
+			iRemoved++;
+			continue;
 		}
+
+		bOK = fprintf(outfile, "A %i\n", iLen) > 0 && fwrite(szRecord, 1, iLen, outfile) == (size_t)iLen;
+		iKept++;
 	}
-}
 
-bool DiskState::LoadHistory(DownloadQueue* pDownloadQueue, NZBList* pNZBList, Servers* pServers, FILE* infile, int iFormatVersion)
-{
-	debug("Loading history from disk");
+	free(szRecord);
+	fclose(infile);
+	bOK = fclose(outfile) == 0 && bOK;
 
-	int size;
-	if (fscanf(infile, "%i\n", &size) != 1) goto error;
-	for (int i = 0; i < size; i++)
+	if (bOK && iRemoved > 0)
 	{
-		HistoryInfo* pHistoryInfo = NULL;
-		HistoryInfo::EKind eKind = HistoryInfo::hkNzb;
-		int iID = 0;
-		int iTime;
-	
-		if (iFormatVersion >= 33)
+		remove(szFilename);
+		if (iKept == 0)
 		{
-			int iKind = 0;
-			if (fscanf(infile, "%i,%i,%i\n", &iID, &iKind, &iTime) != 3) goto error;
-			eKind = (HistoryInfo::EKind)iKind;
+			remove(szTempFilename);
 		}
-		else
+		else if (rename(szTempFilename, szFilename))
 		{
-			if (iFormatVersion >= 24)
-			{
-				if (fscanf(infile, "%i\n", &iID) != 1) goto error;
-			}
-
-			if (iFormatVersion >= 15)
-			{
-				int iKind = 0;
-				if (fscanf(infile, "%i\n", &iKind) != 1) goto error;
-				eKind = (HistoryInfo::EKind)iKind;
-			}
+			error("Error saving history archive: Could not rename file %s to %s", szTempFilename, szFilename);
 		}
+		ClearArchiveIndex();
+		detail("Removed %i item(s) from history archive", iRemoved);
+	}
+	else
+	{
+		remove(szTempFilename);
+	}
 
-		if (eKind == HistoryInfo::hkNzb)
-		{
-			NZBInfo* pNZBInfo = NULL;
+	m_mutexArchive.Unlock();
 
-			if (iFormatVersion < 43)
-			{
-				unsigned int iNZBIndex;
-				if (fscanf(infile, "%i\n", &iNZBIndex) != 1) goto error;
-				pNZBInfo = pNZBList->at(iNZBIndex - 1);
-			}
-			else
-			{
-				pNZBInfo = new NZBInfo();
-				if (!LoadNZBInfo(pNZBInfo, pServers, infile, iFormatVersion)) goto error;
-				pNZBInfo->LeavePostProcess();
-			}
+	if (!bOK)
+	{
+		error("Error reading history archive %s", szFilename);
+	}
+}
 
-			pHistoryInfo = new HistoryInfo(pNZBInfo);
-			
-			if (iFormatVersion < 28 && pNZBInfo->GetParStatus() == 0 &&
-				pNZBInfo->GetUnpackStatus() == 0 && pNZBInfo->GetMoveStatus() == 0)
-			{
-				pNZBInfo->SetDeleteStatus(NZBInfo::dsManual);
-			}
-		}
-		else if (eKind == HistoryInfo::hkUrl)
-		{
-			NZBInfo* pNZBInfo = new NZBInfo();
-			if (iFormatVersion >= 46)
-			{
-				if (!LoadNZBInfo(pNZBInfo, pServers, infile, iFormatVersion)) goto error;
-			}
-			else
-			{
-				if (!LoadUrlInfo12(pNZBInfo, infile, iFormatVersion)) goto error;
-			}
-			pHistoryInfo = new HistoryInfo(pNZBInfo);
-		}
-		else if (eKind == HistoryInfo::hkDup)
-		{
-			DupInfo* pDupInfo = new DupInfo();
-			if (!LoadDupInfo(pDupInfo, infile, iFormatVersion)) goto error;
-			if (iFormatVersion >= 47)
-			{
-				pDupInfo->SetID(iID);
-			}
-			pHistoryInfo = new HistoryInfo(pDupInfo);
-		}
+/*
+ * Returns the index of archived history items loading it from disk if necessary.
+ * The archive must be unlocked with UnlockHistoryArchive.
+ */
+ArchiveIndex* DiskState::LockHistoryArchive()
+{
+	m_mutexArchive.Lock();
+	if (!m_bArchiveLoaded)
+	{
+		m_bArchiveLoaded = LoadArchiveIndex();
+	}
+	return &m_ArchiveIndex;
+}
 
-		if (iFormatVersion < 33)
-		{
-			if (fscanf(infile, "%i\n", &iTime) != 1) goto error;
-		}
+void DiskState::UnlockHistoryArchive()
+{
+	m_mutexArchive.Unlock();
+}
+
+bool DiskState::LoadArchiveIndex()
+{
+	ClearArchiveIndex();
 
-		pHistoryInfo->SetTime((time_t)iTime);
+	char szFilename[1024];
+	snprintf(szFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), ARCHIVE_FILENAME);
+	szFilename[1024-1] = '\0';
 
-		pDownloadQueue->GetHistory()->push_back(pHistoryInfo);
+	FILE* infile = fopen(szFilename, FOPEN_RB);
+	if (!infile)
+	{
+		// no archive yet
+		return true;
+	}
+
+	char buf[1024];
+	m_iArchiveVersion = fgets(buf, sizeof(buf), infile) ? ParseFormatVersion(buf) : 0;
+	if (m_iArchiveVersion != QUEUE_FORMAT_VERSION)
+	{
+		fclose(infile);
+		error("Could not load history archive %s due to file version mismatch", szFilename);
+		return false;
+	}
+
+	bool bOK = true;
+	while (fgets(buf, sizeof(buf), infile))
+	{
+		int iLen;
+		bOK = sscanf(buf, "A %i", &iLen) == 1;
+		if (!bOK) break;
+
+		long lOffset = ftell(infile);
+		HistoryInfo* pHistoryInfo = LoadHistoryInfo(NULL, NULL, infile, m_iArchiveVersion, true);
+		bOK = pHistoryInfo != NULL;
+		if (!bOK) break;
+
+		m_ArchiveIndex.push_back(new ArchiveEntry(pHistoryInfo, lOffset));
+		delete pHistoryInfo;
+
+		bOK = !fseek(infile, lOffset + iLen, SEEK_SET);
+		if (!bOK) break;
 	}
 
+	fclose(infile);
+
+	if (!bOK)
+	{
+		// the items loaded so far can be still shown
+		error("Error reading history archive %s", szFilename);
+	}
+
+	detail("Loaded index of history archive with %i item(s)", (int)m_ArchiveIndex.size());
+
 	return true;
+}
 
-error:
-	error("Error reading diskstate for history");
-	return false;
+void DiskState::ClearArchiveIndex()
+{
+	for (ArchiveIndex::iterator it = m_ArchiveIndex.begin(); it != m_ArchiveIndex.end(); it++)
+	{
+		delete *it;
+	}
+	m_ArchiveIndex.clear();
+	m_bArchiveLoaded = false;
+}
+
+/*
+ * Loads full archived history item. The archive must be locked.
+ */
+HistoryInfo* DiskState::LoadArchivedHistoryInfo(ArchiveEntry* pArchiveEntry, Servers* pServers)
+{
+	char szFilename[1024];
+	snprintf(szFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), ARCHIVE_FILENAME);
+	szFilename[1024-1] = '\0';
+
+	FILE* infile = fopen(szFilename, FOPEN_RB);
+	if (!infile)
+	{
+		error("Error reading history archive: could not open file %s", szFilename);
+		return NULL;
+	}
+
+	HistoryInfo* pHistoryInfo = NULL;
+	if (!fseek(infile, pArchiveEntry->GetOffset(), SEEK_SET))
+	{
+		pHistoryInfo = LoadHistoryInfo(NULL, pServers, infile, m_iArchiveVersion, true);
+	}
+
+	fclose(infile);
+
+	if (!pHistoryInfo)
+	{
+		error("Error reading history archive %s", szFilename);
+	}
+
+	return pHistoryInfo;
 }
 
 /*
@@ -1896,22 +4147,6 @@ int DiskState::FindNZBInfoIndex(NZBList* pNZBList, NZBInfo* pNZBInfo)
 	return iNZBIndex;
 }
 
-/*
-* Find nzb-info by id.
-*/
-NZBInfo* DiskState::FindNZBInfo(DownloadQueue* pDownloadQueue, int iID)
-{
-	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
-	{
-		NZBInfo* pNZBInfo = *it;
-		if (pNZBInfo->GetID() == iID)
-		{
-			return pNZBInfo;
-		}
-	}
-	return NULL;
-}
-
 /*
  * Deletes whole download queue including history.
  */
@@ -1919,11 +4154,30 @@ void DiskState::DiscardDownloadQueue()
 {
 	debug("Discarding queue");
 
+	// drop changes not written yet
+	m_mutexWrite.Lock();
+	m_mutexPending.Lock();
+	ClearTransactions(&m_PendingTransactions);
+	m_mutexPending.Unlock();
+	ClearWrittenRecords();
+	m_bJournalStarted = false;
+	m_mutexWrite.Unlock();
+
 	char szFullFilename[1024];
 	snprintf(szFullFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), "queue");
 	szFullFilename[1024-1] = '\0';
 	remove(szFullFilename);
 
+	snprintf(szFullFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), JOURNAL_FILENAME);
+	szFullFilename[1024-1] = '\0';
+	remove(szFullFilename);
+	ResetJournal();
+
+	snprintf(szFullFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), "partial");
+	szFullFilename[1024-1] = '\0';
+	remove(szFullFilename);
+	m_lPartialSize = 0;
+
 	DirBrowser dir(g_pOptions->GetQueueDir());
 	while (const char* filename = dir.Next())
 	{
@@ -1992,6 +4246,10 @@ void DiskState::DiscardFile(FileInfo* pFileInfo, bool bDeleteData, bool bDeleteP
 		snprintf(fileName, 1024, "%s%ic", g_pOptions->GetQueueDir(), pFileInfo->GetID());
 		fileName[1024-1] = '\0';
 		remove(fileName);
+
+		snprintf(fileName, 1024, "%s%ih", g_pOptions->GetQueueDir(), pFileInfo->GetID());
+		fileName[1024-1] = '\0';
+		remove(fileName);
 	}
 }
 
@@ -2337,15 +4595,17 @@ bool DiskState::LoadAllFileStates(DownloadQueue* pDownloadQueue, Servers* pServe
 	szCacheFlagFilename[1024-1] = '\0';
 
 	bool bCacheWasActive = Util::FileExists(szCacheFlagFilename);
+	bool bContinuePartial = g_pOptions->GetContinuePartial() && !bCacheWasActive;
 
-	DirBrowser dir(g_pOptions->GetQueueDir());
-	while (const char* filename = dir.Next())
+	if (bContinuePartial)
 	{
-		int id;
-		char suffix;
-		if (sscanf(filename, "%i%c", &id, &suffix) == 2 && suffix == 's')
+		// file states saved by older versions (one file per file-info)
+		DirBrowser dir(g_pOptions->GetQueueDir());
+		while (const char* filename = dir.Next())
 		{
-			if (g_pOptions->GetContinuePartial() && !bCacheWasActive)
+			int id;
+			char suffix;
+			if (sscanf(filename, "%i%c", &id, &suffix) == 2 && suffix == 's')
 			{
 				for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
 				{
@@ -2361,7 +4621,31 @@ bool DiskState::LoadAllFileStates(DownloadQueue* pDownloadQueue, Servers* pServe
 					}
 				}
 			}
-			else
+		}
+
+		if (!LoadPartialStates(pDownloadQueue, pServers)) goto error;
+
+		// write loaded states into a new checkpoint file
+		if (!SavePartialStates(pDownloadQueue, true))
+		{
+			return true;
+		}
+	}
+	else
+	{
+		char szFullFilename[1024];
+		snprintf(szFullFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), "partial");
+		szFullFilename[1024-1] = '\0';
+		remove(szFullFilename);
+	}
+
+	{
+		DirBrowser dir(g_pOptions->GetQueueDir());
+		while (const char* filename = dir.Next())
+		{
+			int id;
+			char suffix;
+			if (sscanf(filename, "%i%c", &id, &suffix) == 2 && suffix == 's')
 			{
 				char szFullFilename[1024];
 				snprintf(szFullFilename, 1024, "%s%s", g_pOptions->GetQueueDir(), filename);
@@ -2882,13 +5166,6 @@ void DiskState::AppendNZBMessage(int iNZBID, Message::EKind eKind, const char* s
 	snprintf(szLogFilename, 1024, "%sn%i.log", g_pOptions->GetQueueDir(), iNZBID);
 	szLogFilename[1024-1] = '\0';
 
-	FILE* outfile = fopen(szLogFilename, FOPEN_ABP);
-	if (!outfile)
-	{
-		error("Error saving log: Could not create file %s", szLogFilename);
-		return;
-	}
-
 	const char* szMessageType[] = { "INFO", "WARNING", "ERROR", "DEBUG", "DETAIL"};
 
 	char tmp2[1024];
@@ -2917,9 +5194,12 @@ void DiskState::AppendNZBMessage(int iNZBID, Message::EKind eKind, const char* s
 	szTime[50-1] = '\0';
 	szTime[strlen(szTime) - 1] = '\0'; // trim LF
 
-	fprintf(outfile, "%s\t%u\t%s\t%s%s", szTime, (int)tm, szMessageType[eKind], tmp2, LINE_ENDING);
+	char szLine[1200];
+	snprintf(szLine, sizeof(szLine), "%s\t%u\t%s\t%s%s", szTime, (int)tm, szMessageType[eKind], tmp2, LINE_ENDING);
+	szLine[1200-1] = '\0';
 
-	fclose(outfile);
+	// written in background by log writer
+	g_pLog->AppendToFile(szLogFilename, szLine, eKind);
 }
 
 void DiskState::LoadNZBMessages(int iNZBID, MessageList* pMessages)
@@ -2932,6 +5212,9 @@ void DiskState::LoadNZBMessages(int iNZBID, MessageList* pMessages)
 	snprintf(szLogFilename, 1024, "%sn%i.log", g_pOptions->GetQueueDir(), iNZBID);
 	szLogFilename[1024-1] = '\0';
 
+	// write pending messages first
+	g_pLog->Flush();
+
 	if (!Util::FileExists(szLogFilename))
 	{
 		return;
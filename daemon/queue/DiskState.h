@@ -26,29 +26,155 @@
 #ifndef DISKSTATE_H
 #define DISKSTATE_H
 
+#include <map>
+#include <vector>
+
 #include "DownloadInfo.h"
 #include "FeedInfo.h"
 #include "NewsServer.h"
 #include "StatMeter.h"
 #include "Log.h"
+#include "Thread.h"
+#include "Util.h"
+
+class JournalIndex;
+class BinaryWriter;
+class BinaryReader;
+class BlockHasher;
+class QueueWriter;
+class QueueTransaction;
+
+/*
+ * Short description of a history item stored in the history archive.
+ * The full item is loaded from disk on request.
+ */
+class ArchiveEntry
+{
+private:
+	int					m_iID;
+	HistoryInfo::EKind	m_eKind;
+	time_t				m_tTime;
+	long long			m_lSize;
+	long				m_lOffset;
+	char*				m_szName;
+	char*				m_szCategory;
+	const char*			m_szStatus;
+
+public:
+						ArchiveEntry(HistoryInfo* pHistoryInfo, long lOffset);
+						~ArchiveEntry();
+	int					GetID() { return m_iID; }
+	HistoryInfo::EKind	GetKind() { return m_eKind; }
+	time_t				GetTime() { return m_tTime; }
+	long long			GetSize() { return m_lSize; }
+	long				GetOffset() { return m_lOffset; }
+	const char*			GetName() { return m_szName; }
+	const char*			GetCategory() { return m_szCategory; }
+	const char*			GetStatus() { return m_szStatus; }
+};
+
+typedef std::vector<ArchiveEntry*> ArchiveIndex;
 
 class DiskState
 {
 private:
+	struct RecordHash
+	{
+		unsigned long long	lHash;
+		int					iLen;
+	};
+	typedef std::map<int, RecordHash>	RecordHashes;
+	typedef std::map<int, char*>		WrittenRecords;
+	typedef std::vector<QueueTransaction*>	Transactions;
+
+	struct PartialArticles
+	{
+		char*			pData;
+		int				iSize;
+						PartialArticles() : pData(NULL), iSize(0) {}
+	};
+	typedef std::map<int, PartialArticles>	DeferredStates;
+
+	// state of queue records as saved on disk (snapshot file plus journal)
+	bool				m_bJournalReady;
+	long long			m_lSnapshotSize;
+	long long			m_lJournalSize;
+	RecordHashes		m_QueueHashes;
+	RecordHashes		m_HistoryHashes;
+	IDList				m_QueueOrder;
+	IDList				m_HistoryOrder;
+	JournalIndex*		m_pJournalIndex;
+	long long			m_lPartialSize;
+	long long			m_lPartialCompactSize;
+	DeferredStates		m_DeferredStates;
+	FileList*			m_pSummaryList;
+	int					m_iHistoryGeneration;
+
+	// history archive, the index is loaded on first use
+	Mutex				m_mutexArchive;
+	ArchiveIndex		m_ArchiveIndex;
+	bool				m_bArchiveLoaded;
+	int					m_iArchiveVersion;
+
+	// queue transactions prepared for writing in background
+	QueueWriter*		m_pQueueWriter;
+	Mutex				m_mutexPending;
+	ConditionVar		m_condPending;
+	Transactions		m_PendingTransactions;
+	bool				m_bWriteFailed;
+
+	// records written to disk, used by writer to compact the journal; protected by m_mutexWrite
+	Mutex				m_mutexWrite;
+	WrittenRecords		m_WrittenRecords;
+	IDList				m_WrittenQueueOrder;
+	IDList				m_WrittenHistoryOrder;
+	unsigned int		m_iGeneration;
+	bool				m_bJournalStarted;
+
 	int					fscanf(FILE* infile, const char* Format, ...);
+	int					fprintf(FILE* outfile, const char* Format, ...);
+	int					fprintf(StringBuilder* outfile, const char* Format, ...);
 	int					ParseFormatVersion(const char* szFormatSignature);
 	bool				SaveFileInfo(FileInfo* pFileInfo, const char* szFilename);
 	bool				LoadFileInfo(FileInfo* pFileInfo, const char* szFilename, bool bFileSummary, bool bArticles);
-	void				SaveNZBQueue(DownloadQueue* pDownloadQueue, FILE* outfile);
+	bool				LoadBinaryFileInfo(FileInfo* pFileInfo, const char* szFilename, MappedFile* pMappedFile, bool bFileSummary, bool bArticles);
+	bool				LoadBinaryFileState(FileInfo* pFileInfo, Servers* pServers, bool bCompleted, const char* szFilename, MappedFile* pMappedFile);
+	void				WriteFileState(BinaryWriter* pWriter, FileInfo* pFileInfo);
+	void				WriteFileStateSummary(BinaryWriter* pWriter, FileInfo* pFileInfo);
+	int					CalcFileStateSize(FileInfo* pFileInfo);
+	int					CalcFileStateSummarySize(FileInfo* pFileInfo);
+	bool				ReadFileState(BinaryReader* pReader, FileInfo* pFileInfo, Servers* pServers, bool bCompleted);
+	bool				ReadFileStateSummary(BinaryReader* pReader, FileInfo* pFileInfo, Servers* pServers);
+	bool				ReadArticleStates(BinaryReader* pReader, FileInfo* pFileInfo, bool bCompleted);
+	bool				CountArticleStates(const char* pData, int iSize, int* pCompletedArticles);
+	void				LoadFileSummaries(FileList* pFileList);
+	bool				LoadPartialStates(DownloadQueue* pDownloadQueue, Servers* pServers);
+	void				SaveJournal(DownloadQueue* pDownloadQueue, bool bReset);
+	void				QueueWrite(QueueTransaction* pTransaction);
+	void				ClearTransactions(Transactions* pTransactions);
+	void				ApplyTransaction(QueueTransaction* pTransaction, StringBuilder* pJournal);
+	void				ClearWrittenRecords();
+	bool				WriteSnapshot();
+	bool				WriteSnapshotRecords(FILE* outfile, IDList* pOrder);
+	bool				WriteJournal(StringBuilder* pJournal);
+	void				ResetJournal();
+	void				AppendJournalRecord(QueueTransaction* pTransaction, char cKind, int iID, StringBuilder* pRecord, RecordHashes* pHashes);
+	void				AppendJournalRemoved(QueueTransaction* pTransaction, IDList* pQueueOrder, IDList* pHistoryOrder);
+	void				AppendJournalOrder(StringBuilder* pJournal, const char* szKind, IDList* pOrder);
+	bool				ScanJournal(JournalIndex* pJournalIndex, unsigned int iGeneration);
+	bool				ApplyJournal(DownloadQueue* pDownloadQueue, JournalIndex* pJournalIndex, Servers* pServers);
+	bool				IsSuperseded(int iID);
 	bool				LoadNZBList(NZBList* pNZBList, Servers* pServers, FILE* infile, int iFormatVersion);
-	void				SaveNZBInfo(NZBInfo* pNZBInfo, FILE* outfile);
+	void				SaveNZBInfo(NZBInfo* pNZBInfo, StringBuilder* outfile, bool bFileInfos);
 	bool				LoadNZBInfo(NZBInfo* pNZBInfo, Servers* pServers, FILE* infile, int iFormatVersion);
 	void				SavePostQueue(DownloadQueue* pDownloadQueue, FILE* outfile);
-	void				SaveDupInfo(DupInfo* pDupInfo, FILE* outfile);
+	void				SaveDupInfo(DupInfo* pDupInfo, StringBuilder* outfile);
 	bool				LoadDupInfo(DupInfo* pDupInfo, FILE* infile, int iFormatVersion);
-	void				SaveHistory(DownloadQueue* pDownloadQueue, FILE* outfile);
 	bool				LoadHistory(DownloadQueue* pDownloadQueue, NZBList* pNZBList, Servers* pServers, FILE* infile, int iFormatVersion);
-	NZBInfo*			FindNZBInfo(DownloadQueue* pDownloadQueue, int iID);
+	void				SaveHistoryInfo(HistoryInfo* pHistoryInfo, StringBuilder* outfile, bool bFileInfos);
+	HistoryInfo*		LoadHistoryInfo(NZBList* pNZBList, Servers* pServers, FILE* infile, int iFormatVersion, bool bDetached = false);
+	bool				LoadArchiveIndex();
+	void				ClearArchiveIndex();
 	bool				SaveFeedStatus(Feeds* pFeeds, FILE* outfile);
 	bool				LoadFeedStatus(Feeds* pFeeds, FILE* infile, int iFormatVersion);
 	bool				SaveFeedHistory(FeedHistory* pFeedHistory, FILE* outfile);
@@ -60,8 +186,9 @@ private:
 	void				CalcFileStats(DownloadQueue* pDownloadQueue, int iFormatVersion);
 	void				CalcNZBFileStats(NZBInfo* pNZBInfo, int iFormatVersion);
 	bool				LoadAllFileStates(DownloadQueue* pDownloadQueue, Servers* pServers);
-	void				SaveServerStats(ServerStatList* pServerStatList, FILE* outfile);
+	void				SaveServerStats(ServerStatList* pServerStatList, StringBuilder* outfile);
 	bool				LoadServerStats(ServerStatList* pServerStatList, Servers* pServers, FILE* infile);
+	void				SetServerStat(ServerStatList* pServerStatList, Servers* pServers, int iServerID, int iSuccessArticles, int iFailedArticles);
 
 	// backward compatibility functions (conversions from older formats)
 	bool				LoadPostQueue12(DownloadQueue* pDownloadQueue, NZBList* pNZBList, FILE* infile, int iFormatVersion);
@@ -76,13 +203,24 @@ private:
 	void				CalcCriticalHealth(NZBList* pNZBList);
 
 public:
+						DiskState();
+						~DiskState();
+	void				StartQueueWriter();
+	void				StopQueueWriter();
+	void				WaitQueueWrite();
+	void				WakeQueueWriter();
+	void				WriteQueueFiles();
 	bool				DownloadQueueExists();
 	bool				SaveDownloadQueue(DownloadQueue* pDownloadQueue);
 	bool				LoadDownloadQueue(DownloadQueue* pDownloadQueue, Servers* pServers);
 	bool				SaveFile(FileInfo* pFileInfo);
 	bool				SaveFileState(FileInfo* pFileInfo, bool bCompleted);
 	bool				LoadFileState(FileInfo* pFileInfo, Servers* pServers, bool bCompleted);
+	bool				SaveBlockHashes(int iFileID, BlockHasher* pBlockHasher);
+	bool				LoadBlockHashes(int iFileID, BlockHasher* pBlockHasher);
+	bool				SavePartialStates(DownloadQueue* pDownloadQueue, bool bCompact);
 	bool				LoadArticles(FileInfo* pFileInfo);
+	bool				LoadFileSummary(FileInfo* pFileInfo);
 	void				DiscardDownloadQueue();
 	void				DiscardFile(FileInfo* pFileInfo, bool bDeleteData, bool bDeletePartialState, bool bDeleteCompletedState);
 	void				DiscardFiles(NZBInfo* pNZBInfo);
@@ -95,6 +233,11 @@ public:
 	void				DeleteCacheFlag();
 	void				AppendNZBMessage(int iNZBID, Message::EKind eKind, const char* szText);
 	void				LoadNZBMessages(int iNZBID, MessageList* pMessages);
+	bool				ArchiveHistory(HistoryList* pHistoryList);
+	void				PruneHistoryArchive(time_t tMinTime);
+	ArchiveIndex*		LockHistoryArchive();
+	void				UnlockHistoryArchive();
+	HistoryInfo*		LoadArchivedHistoryInfo(ArchiveEntry* pArchiveEntry, Servers* pServers);
 };
 
 extern DiskState* g_pDiskState;
@@ -39,10 +39,12 @@
 #include <ctype.h>
 #include <sys/stat.h>
 #include <algorithm>
+#include <new>
 
 #include "nzbget.h"
 #include "DownloadInfo.h"
 #include "ArticleWriter.h"
+#include "BlockHasher.h"
 #include "DiskState.h"
 #include "Options.h"
 #include "Util.h"
@@ -53,6 +55,8 @@ int NZBInfo::m_iIDGen = 0;
 int NZBInfo::m_iIDMax = 0;
 DownloadQueue* DownloadQueue::g_pDownloadQueue = NULL;
 bool DownloadQueue::g_bLoaded = false;
+int DownloadQueue::g_iHistoryGeneration = 0;
+Mutex DownloadQueue::g_mutexHistoryGeneration;
 
 NZBParameter::NZBParameter(const char* szName)
 {
@@ -267,7 +271,12 @@ void ServerStatList::ListOp(ServerStatList* pServerStats, EStatOperation eStatOp
 }
 
 
-NZBInfo::NZBInfo() : m_FileList(true)
+/*
+ * Detached nzb-infos are temporary read-only views (for example of archived
+ * history items), they keep the id loaded from disk and don't allocate a new one.
+ */
+NZBInfo::NZBInfo(bool bDetached) : m_FileList(true),
+	m_Messages(g_pOptions ? g_pOptions->GetLogBufferSize() : 1000)
 {
 	debug("Creating NZBInfo");
 
@@ -326,10 +335,8 @@ NZBInfo::NZBInfo() : m_FileList(true)
 	m_tMaxTime = 0;
 	m_iPriority = 0;
 	m_iActiveDownloads = 0;
-	m_Messages.clear();
 	m_pPostInfo = NULL;
-	m_iIDMessageGen = 0;
-	m_iID = ++m_iIDGen;
+	m_iID = bDetached ? 0 : Atomic::Add(&m_iIDGen, 1);
 	m_lDownloadedSize = 0;
 	m_iDownloadSec = 0;
 	m_iPostTotalSec = 0;
@@ -340,8 +347,10 @@ NZBInfo::NZBInfo() : m_FileList(true)
 	m_bReprocess = false;
 	m_tQueueScriptTime = 0;
 	m_bParFull = false;
+	m_lParBlockSize = 0;
 	m_iMessageCount = 0;
 	m_iCachedMessageCount = 0;
+	m_bChanged = true;
 }
 
 NZBInfo::~NZBInfo()
@@ -370,6 +379,7 @@ void NZBInfo::SetID(int iID)
 	{
 		m_iIDMax = m_iID;
 	}
+	m_bChanged = true;
 }
 
 void NZBInfo::ResetGenID(bool bMax)
@@ -387,7 +397,7 @@ void NZBInfo::ResetGenID(bool bMax)
 
 int NZBInfo::GenerateID()
 {
-	return ++m_iIDGen;
+	return Atomic::Add(&m_iIDGen, 1);
 }
 
 void NZBInfo::ClearCompletedFiles()
@@ -397,24 +407,28 @@ void NZBInfo::ClearCompletedFiles()
 		delete *it;
 	}
 	m_completedFiles.clear();
+	m_bChanged = true;
 }
 
 void NZBInfo::SetDestDir(const char* szDestDir)
 {
 	free(m_szDestDir);
 	m_szDestDir = strdup(szDestDir);
+	m_bChanged = true;
 }
 
 void NZBInfo::SetFinalDir(const char* szFinalDir)
 {
 	free(m_szFinalDir);
 	m_szFinalDir = strdup(szFinalDir);
+	m_bChanged = true;
 }
 
 void NZBInfo::SetURL(const char* szURL)
 {
 	free(m_szURL);
 	m_szURL = strdup(szURL);
+	m_bChanged = true;
 
 	if (!m_szName)
 	{
@@ -434,6 +448,7 @@ void NZBInfo::SetFilename(const char* szFilename)
 
 	free(m_szFilename);
 	m_szFilename = strdup(szFilename);
+	m_bChanged = true;
 
 	if ((!m_szName || !bHadFilename) && !Util::EmptyStr(szFilename))
 	{
@@ -451,24 +466,28 @@ void NZBInfo::SetName(const char* szName)
 {
 	free(m_szName);
 	m_szName = szName ? strdup(szName) : NULL;
+	m_bChanged = true;
 }
 
 void NZBInfo::SetCategory(const char* szCategory)
 {
 	free(m_szCategory);
 	m_szCategory = strdup(szCategory);
+	m_bChanged = true;
 }
 
 void NZBInfo::SetQueuedFilename(const char * szQueuedFilename)
 {
 	free(m_szQueuedFilename);
 	m_szQueuedFilename = strdup(szQueuedFilename);
+	m_bChanged = true;
 }
 
 void NZBInfo::SetDupeKey(const char* szDupeKey)
 {
 	free(m_szDupeKey);
 	m_szDupeKey = strdup(szDupeKey ? szDupeKey : "");
+	m_bChanged = true;
 }
 
 void NZBInfo::MakeNiceNZBName(const char * szNZBFilename, char * szBuffer, int iSize, bool bRemoveExt)
@@ -625,6 +644,7 @@ void NZBInfo::UpdateMinMaxTime()
 {
 	m_tMinTime = 0;
 	m_tMaxTime = 0;
+	m_bChanged = true;
 
 	bool bFirst = true;
 	for (FileList::iterator it = m_FileList.begin(); it != m_FileList.end(); it++)
@@ -650,15 +670,13 @@ void NZBInfo::UpdateMinMaxTime()
 	}
 }
 
-MessageList* NZBInfo::LockCachedMessages()
-{
-	m_mutexLog.Lock();
-	return &m_Messages;
-}
-
-void NZBInfo::UnlockCachedMessages()
+/*
+ * See MessageRing::Read. The caller must keep the NZBInfo alive
+ * (by locking the download queue) but the log itself isn't locked.
+ */
+void NZBInfo::GetCachedMessages(MessageList* pMessages, int iIDFrom, int iLastCount)
 {
-	m_mutexLog.Unlock();
+	m_Messages.Read(pMessages, iIDFrom, iLastCount);
 }
 
 void NZBInfo::AddMessage(Message::EKind eKind, const char * szText)
@@ -687,23 +705,16 @@ void NZBInfo::AddMessage(Message::EKind eKind, const char * szText)
 	}
 
 	m_mutexLog.Lock();
-	Message* pMessage = new Message(++m_iIDMessageGen, eKind, time(NULL), szText);
-	m_Messages.push_back(pMessage);
+	m_Messages.Add(eKind, time(NULL), szText);
 
 	if (g_pOptions->GetSaveQueue() && g_pOptions->GetServerMode() && g_pOptions->GetNzbLog())
 	{
 		g_pDiskState->AppendNZBMessage(m_iID, eKind, szText);
 		m_iMessageCount++;
+		m_bChanged = true;
 	}
 
-	while (m_Messages.size() > (unsigned int)g_pOptions->GetLogBufferSize())
-	{
-		Message* pMessage = m_Messages.front();
-		delete pMessage;
-		m_Messages.pop_front();
-	}
-
-	m_iCachedMessageCount = m_Messages.size();
+	m_iCachedMessageCount = m_Messages.GetCount();
 	m_mutexLog.Unlock();
 }
 
@@ -731,6 +742,8 @@ void NZBInfo::ClearMessages()
 void NZBInfo::CopyFileList(NZBInfo* pSrcNZBInfo)
 {
 	m_FileList.Clear();
+	m_bChanged = true;
+	pSrcNZBInfo->SetChanged(true);
 
 	for (FileList::iterator it = pSrcNZBInfo->GetFileList()->begin(); it != pSrcNZBInfo->GetFileList()->end(); it++)
 	{
@@ -775,12 +788,14 @@ void NZBInfo::EnterPostProcess()
 {
 	m_pPostInfo = new PostInfo();
 	m_pPostInfo->SetNZBInfo(this);
+	m_bChanged = true;
 }
 
 void NZBInfo::LeavePostProcess()
 {
 	delete m_pPostInfo;
 	m_pPostInfo = NULL;
+	m_bChanged = true;
 	ClearMessages();
 }
 
@@ -798,6 +813,7 @@ void NZBInfo::SetActiveDownloads(int iActiveDownloads)
 		{
 			m_iDownloadSec += time(NULL) - m_tDownloadStartTime;
 			m_tDownloadStartTime = 0;
+			m_bChanged = true;
 		}
 	}
 	m_iActiveDownloads = iActiveDownloads;
@@ -1002,29 +1018,23 @@ ArticleInfo::ArticleInfo()
 {
 	//debug("Creating ArticleInfo");
 	m_szMessageID = NULL;
+	m_iPartNumber = 0;
 	m_iSize = 0;
 	m_pSegmentContent = NULL;
 	m_iSegmentOffset = 0;
 	m_iSegmentSize = 0;
 	m_eStatus = aiUndefined;
 	m_szResultFilename = NULL;
-	m_lCrc = 0;
+	m_iCrc = 0;
 }
 
 ArticleInfo::~ ArticleInfo()
 {
 	//debug("Destroying ArticleInfo");
 	DiscardSegment();
-	free(m_szMessageID);
 	free(m_szResultFilename);
 }
 
-void ArticleInfo::SetMessageID(const char * szMessageID)
-{
-	free(m_szMessageID);
-	m_szMessageID = strdup(szMessageID);
-}
-
 void ArticleInfo::SetResultFilename(const char * v)
 {
 	free(m_szResultFilename);
@@ -1050,6 +1060,118 @@ void ArticleInfo::DiscardSegment()
 }
 
 
+ArticlePool::ArticlePool()
+{
+	m_pStringPos = NULL;
+	m_iStringFree = 0;
+	m_iArticleCount = 0;
+	m_lStringSize = 0;
+	m_lAllocated = 0;
+}
+
+ArticlePool::~ArticlePool()
+{
+	Clear();
+}
+
+void ArticlePool::Clear()
+{
+	for (ArticleBlocks::iterator it = m_ArticleBlocks.begin(); it != m_ArticleBlocks.end(); it++)
+	{
+		ArticleBlock& block = *it;
+		for (int i = 0; i < block.iUsed; i++)
+		{
+			block.pArticles[i].~ArticleInfo();
+		}
+		free(block.pArticles);
+	}
+	m_ArticleBlocks.clear();
+
+	for (StringChunks::iterator it = m_StringChunks.begin(); it != m_StringChunks.end(); it++)
+	{
+		free(*it);
+	}
+	m_StringChunks.clear();
+
+	m_pStringPos = NULL;
+	m_iStringFree = 0;
+	m_iArticleCount = 0;
+	m_lStringSize = 0;
+	m_lAllocated = 0;
+}
+
+/*
+ * Makes sure the next "iArticles" articles and "iStringSize" bytes of strings
+ * fit into one block each, used when the numbers are known in advance.
+ */
+void ArticlePool::Reserve(int iArticles, int iStringSize)
+{
+	ArticleBlock* pBlock = m_ArticleBlocks.empty() ? NULL : &m_ArticleBlocks.back();
+	if (iArticles > 0 && (!pBlock || pBlock->iCapacity - pBlock->iUsed < iArticles))
+	{
+		ArticleBlock block;
+		block.pArticles = (ArticleInfo*)malloc(sizeof(ArticleInfo) * iArticles);
+		block.iCapacity = iArticles;
+		block.iUsed = 0;
+		m_ArticleBlocks.push_back(block);
+		m_lAllocated += sizeof(ArticleInfo) * iArticles;
+	}
+
+	if (iStringSize > m_iStringFree)
+	{
+		m_pStringPos = (char*)malloc(iStringSize);
+		m_iStringFree = iStringSize;
+		m_StringChunks.push_back(m_pStringPos);
+		m_lAllocated += iStringSize;
+	}
+}
+
+ArticleInfo* ArticlePool::NewArticle()
+{
+	ArticleBlock* pBlock = m_ArticleBlocks.empty() ? NULL : &m_ArticleBlocks.back();
+	if (!pBlock || pBlock->iUsed == pBlock->iCapacity)
+	{
+		// grow geometrically but keep the unused tail of the last block small
+		Reserve(std::min(std::max(m_iArticleCount, 16), 1024), 0);
+		pBlock = &m_ArticleBlocks.back();
+	}
+
+	ArticleInfo* pArticleInfo = new (pBlock->pArticles + pBlock->iUsed) ArticleInfo();
+	pBlock->iUsed++;
+	m_iArticleCount++;
+	return pArticleInfo;
+}
+
+char* ArticlePool::AllocString(int iSize)
+{
+	if (iSize > m_iStringFree)
+	{
+		Reserve(0, std::max(iSize, (int)std::min(std::max(m_lStringSize, 1024LL), 65536LL)));
+	}
+
+	char* pResult = m_pStringPos;
+	m_pStringPos += iSize;
+	m_iStringFree -= iSize;
+	m_lStringSize += iSize;
+	return pResult;
+}
+
+const char* ArticlePool::AddString(const char* szValue)
+{
+	int iSize = strlen(szValue) + 1;
+	char* szResult = AllocString(iSize);
+	memcpy(szResult, szValue, iSize);
+	return szResult;
+}
+
+const char* ArticlePool::AddData(const char* pData, int iSize)
+{
+	char* pResult = AllocString(iSize);
+	memcpy(pResult, pData, iSize);
+	return pResult;
+}
+
+
 FileInfo::FileInfo(int iID)
 {
 	debug("Creating FileInfo");
@@ -1082,7 +1204,9 @@ FileInfo::FileInfo(int iID)
 	m_bAutoDeleted = false;
 	m_iCachedArticles = 0;
 	m_bPartialChanged = false;
-	m_iID = iID ? iID : ++m_iIDGen;
+	m_lLastUsed = 0;
+	m_pBlockHasher = NULL;
+	m_iID = iID ? iID : Atomic::Add(&m_iIDGen, 1);
 }
 
 FileInfo::~ FileInfo()
@@ -1093,6 +1217,7 @@ FileInfo::~ FileInfo()
 	free(m_szFilename);
 	free(m_szOutputFilename);
 	delete m_pMutexOutputFile;
+	SetBlockHasher(NULL);
 
 	for (Groups::iterator it = m_Groups.begin(); it != m_Groups.end() ;it++)
 	{
@@ -1103,13 +1228,28 @@ FileInfo::~ FileInfo()
 	ClearArticles();
 }
 
+void FileInfo::SetBlockHasher(BlockHasher* pBlockHasher)
+{
+#ifndef DISABLE_PARCHECK
+	delete m_pBlockHasher;
+#endif
+	m_pBlockHasher = pBlockHasher;
+}
+
 void FileInfo::ClearArticles()
 {
-	for (Articles::iterator it = m_Articles.begin(); it != m_Articles.end() ;it++)
-	{
-		delete *it;
-	}
-	m_Articles.clear();
+	// swap releases the memory of the list, which clear() would keep
+	Articles().swap(m_Articles);
+	m_ArticlePool.Clear();
+}
+
+/*
+ * Memory used by loaded articles: article-infos, message-ids and the list of pointers.
+ * Result filenames of downloaded articles are short-lived and not counted.
+ */
+long long FileInfo::CalcArticleMemory()
+{
+	return m_ArticlePool.GetAllocated() + m_Articles.capacity() * sizeof(ArticleInfo*);
 }
 
 void FileInfo::SetID(int iID)
@@ -1140,10 +1280,41 @@ void FileInfo::SetPaused(bool bPaused)
 	{
 		m_pNZBInfo->SetPausedFileCount(m_pNZBInfo->GetPausedFileCount() + (bPaused ? 1 : -1));
 		m_pNZBInfo->SetPausedSize(m_pNZBInfo->GetPausedSize() + (bPaused ? m_lRemainingSize : - m_lRemainingSize));
+		m_pNZBInfo->SetChanged(true);
 	}
 	m_bPaused = bPaused;
 }
 
+/*
+ * File list is saved with nzb-info, changes of saved fields mark the nzb-info as changed.
+ */
+void FileInfo::SetTime(time_t tTime)
+{
+	m_tTime = tTime;
+	if (m_pNZBInfo)
+	{
+		m_pNZBInfo->SetChanged(true);
+	}
+}
+
+void FileInfo::SetDeleted(bool bDeleted)
+{
+	m_bDeleted = bDeleted;
+	if (m_pNZBInfo)
+	{
+		m_pNZBInfo->SetChanged(true);
+	}
+}
+
+void FileInfo::SetExtraPriority(bool bExtraPriority)
+{
+	m_bExtraPriority = bExtraPriority;
+	if (m_pNZBInfo)
+	{
+		m_pNZBInfo->SetChanged(true);
+	}
+}
+
 void FileInfo::SetSubject(const char* szSubject)
 {
 	m_szSubject = strdup(szSubject);
@@ -1281,7 +1452,7 @@ void PostInfo::SetProgressLabel(const char* szProgressLabel)
 }
 
 
-DupInfo::DupInfo()
+DupInfo::DupInfo(bool bDetached)
 {
 	m_iID = 0;
 	m_szName = NULL;
@@ -1292,6 +1463,8 @@ DupInfo::DupInfo()
 	m_iFullContentHash = 0;
 	m_iFilteredContentHash = 0;
 	m_eStatus = dsUndefined;
+	m_bDetached = bDetached;
+	m_bChanged = true;
 }
 
 DupInfo::~DupInfo()
@@ -1309,35 +1482,79 @@ void DupInfo::SetID(int iID)
 	}
 }
 
+void DupInfo::Changed()
+{
+	m_bChanged = true;
+	if (!m_bDetached)
+	{
+		DownloadQueue::HistoryChanged();
+	}
+}
+
 void DupInfo::SetName(const char* szName)
 {
 	free(m_szName);
 	m_szName = strdup(szName);
+	Changed();
 }
 
 void DupInfo::SetDupeKey(const char* szDupeKey)
 {
 	free(m_szDupeKey);
 	m_szDupeKey = strdup(szDupeKey);
+	Changed();
 }
 
+void DupInfo::SetFullContentHash(unsigned int iFullContentHash)
+{
+	m_iFullContentHash = iFullContentHash;
+	Changed();
+}
+
+void DupInfo::SetFilteredContentHash(unsigned int iFilteredContentHash)
+{
+	m_iFilteredContentHash = iFilteredContentHash;
+	Changed();
+}
 
-HistoryInfo::HistoryInfo(NZBInfo* pNZBInfo)
+
+/*
+ * Detached history-infos aren't part of the history list,
+ * creating and destroying them doesn't change the history generation.
+ */
+HistoryInfo::HistoryInfo(NZBInfo* pNZBInfo, bool bDetached)
 {
 	m_eKind = pNZBInfo->GetKind() == NZBInfo::nkNzb ? hkNzb : hkUrl;
 	m_pInfo = pNZBInfo;
 	m_tTime = 0;
+	m_bDetached = bDetached;
+	m_bChanged = true;
+	if (!m_bDetached)
+	{
+		DownloadQueue::HistoryChanged();
+	}
 }
 
-HistoryInfo::HistoryInfo(DupInfo* pDupInfo)
+HistoryInfo::HistoryInfo(DupInfo* pDupInfo, bool bDetached)
 {
 	m_eKind = hkDup;
 	m_pInfo = pDupInfo;
 	m_tTime = 0;
+	m_bDetached = bDetached;
+	m_bChanged = true;
+	if (!m_bDetached)
+	{
+		DownloadQueue::HistoryChanged();
+	}
 }
 
 HistoryInfo::~HistoryInfo()
 {
+	if (!m_bDetached)
+	{
+		DownloadQueue::HistoryChanged();
+	}
+
 	if ((m_eKind == hkNzb || m_eKind == hkUrl) && m_pInfo)
 	{
 		delete (NZBInfo*)m_pInfo;
@@ -1360,6 +1577,32 @@ int HistoryInfo::GetID()
 	}
 }
 
+/*
+ * History record consists of history-info and its nzb-info or dup-info,
+ * a change in any of them requires the record to be written.
+ */
+bool HistoryInfo::GetChanged()
+{
+	if (m_bChanged || !m_pInfo)
+	{
+		return m_bChanged;
+	}
+	return m_eKind == hkDup ? ((DupInfo*)m_pInfo)->GetChanged() : ((NZBInfo*)m_pInfo)->GetChanged();
+}
+
+void HistoryInfo::SetChanged(bool bChanged)
+{
+	m_bChanged = bChanged;
+	if (m_eKind == hkDup && m_pInfo)
+	{
+		((DupInfo*)m_pInfo)->SetChanged(bChanged);
+	}
+	else if (m_pInfo)
+	{
+		((NZBInfo*)m_pInfo)->SetChanged(bChanged);
+	}
+}
+
 void HistoryInfo::GetName(char* szBuffer, int iSize)
 {
 	if (m_eKind == hkNzb || m_eKind == hkUrl)
@@ -1378,16 +1621,228 @@ void HistoryInfo::GetName(char* szBuffer, int iSize)
 	}
 }
 
+const char* HistoryInfo::MakeTextStatus()
+{
+	const char* szStatus = "FAILURE/INTERNAL_ERROR";
+
+	if (m_eKind == hkNzb || m_eKind == hkUrl)
+	{
+		szStatus = GetNZBInfo()->MakeTextStatus(false);
+	}
+	else if (m_eKind == hkDup)
+	{
+		const char* szDupStatusName[] = { "FAILURE/INTERNAL_ERROR", "SUCCESS/HIDDEN", "FAILURE/HIDDEN",
+			"DELETED/MANUAL", "DELETED/DUPE", "FAILURE/BAD", "SUCCESS/GOOD" };
+		szStatus = szDupStatusName[GetDupInfo()->GetStatus()];
+	}
+
+	return szStatus;
+}
+
+/*
+ * History items are also created and destroyed outside of the queue lock
+ * (when loading the history archive), the counter is protected by its own mutex.
+ */
+void DownloadQueue::HistoryChanged()
+{
+	g_mutexHistoryGeneration.Lock();
+	g_iHistoryGeneration++;
+	g_mutexHistoryGeneration.Unlock();
+}
 
 DownloadQueue* DownloadQueue::Lock()
 {
-	g_pDownloadQueue->m_LockMutex.Lock();
+	long long lStartTicks = Util::CurrentTicks();
+	g_pDownloadQueue->m_Lock.Lock();
+	// counters are modified only while holding the lock
+	g_pDownloadQueue->m_lLockWaitUSec += Util::CurrentTicks() - lStartTicks;
+	g_pDownloadQueue->m_lLockCount++;
 	return g_pDownloadQueue;
 }
 
 void DownloadQueue::Unlock()
 {
-	g_pDownloadQueue->m_LockMutex.Unlock();
+	g_pDownloadQueue->m_Lock.Unlock();
+}
+
+/*
+ * Locks the queue for reading. Many readers can hold the lock at the same time,
+ * they wait only for a writer holding the lock (obtained with Lock()).
+ * The queue must not be modified while holding a shared lock.
+ */
+DownloadQueue* DownloadQueue::LockShared()
+{
+	long long lStartTicks = Util::CurrentTicks();
+	g_pDownloadQueue->m_Lock.LockShared();
+	long long lWaitUSec = Util::CurrentTicks() - lStartTicks;
+
+	// readers run concurrently, the counters need own protection
+	g_pDownloadQueue->m_mutexSharedStat.Lock();
+	g_pDownloadQueue->m_lSharedWaitUSec += lWaitUSec;
+	g_pDownloadQueue->m_lSharedCount++;
+	g_pDownloadQueue->m_mutexSharedStat.Unlock();
+
+	return g_pDownloadQueue;
+}
+
+void DownloadQueue::UnlockShared()
+{
+	g_pDownloadQueue->m_Lock.UnlockShared();
+}
+
+/*
+ * Returns total time spent waiting for the queue lock and the number of lock acquisitions,
+ * separately for exclusive (writer) and shared (reader) locks.
+ * The values are read without locking, they are used for statistics only.
+ */
+void DownloadQueue::GetLockStat(long long* pLockWaitUSec, long long* pLockCount,
+	long long* pSharedWaitUSec, long long* pSharedCount)
+{
+	*pLockWaitUSec = g_pDownloadQueue->m_lLockWaitUSec;
+	*pLockCount = g_pDownloadQueue->m_lLockCount;
+	*pSharedWaitUSec = g_pDownloadQueue->m_lSharedWaitUSec;
+	*pSharedCount = g_pDownloadQueue->m_lSharedCount;
+}
+
+/*
+ * ID indexes of queue and history are built on first lookup and then kept up to date
+ * by code which adds items to or removes items from queue or history (AddToIndex,
+ * RemoveFromIndex). Code which changes the lists in bulk (loading from disk) calls
+ * InvalidateIndex instead. Lookups and index updates require exclusive lock.
+ */
+void DownloadQueue::BuildIndex()
+{
+	m_NZBIndex.clear();
+	m_FileIndex.clear();
+	m_HistoryIndex.clear();
+
+	for (NZBList::iterator it = m_Queue.begin(); it != m_Queue.end(); it++)
+	{
+		NZBInfo* pNZBInfo = *it;
+		m_NZBIndex.insert(NZBIndex::value_type(pNZBInfo->GetID(), pNZBInfo));
+		for (FileList::iterator it2 = pNZBInfo->GetFileList()->begin(); it2 != pNZBInfo->GetFileList()->end(); it2++)
+		{
+			FileInfo* pFileInfo = *it2;
+			m_FileIndex.insert(FileIndex::value_type(pFileInfo->GetID(), pFileInfo));
+		}
+	}
+
+	for (HistoryList::iterator it = m_History.begin(); it != m_History.end(); it++)
+	{
+		HistoryInfo* pHistoryInfo = *it;
+		m_HistoryIndex.insert(HistoryIndex::value_type(pHistoryInfo->GetID(), pHistoryInfo));
+	}
+
+	m_bIndexValid = true;
+}
+
+NZBInfo* DownloadQueue::FindNZBInfo(int iID)
+{
+	if (!m_bIndexValid)
+	{
+		BuildIndex();
+	}
+	NZBIndex::iterator it = m_NZBIndex.find(iID);
+	return it != m_NZBIndex.end() ? it->second : NULL;
+}
+
+FileInfo* DownloadQueue::FindFileInfo(int iID)
+{
+	if (!m_bIndexValid)
+	{
+		BuildIndex();
+	}
+	FileIndex::iterator it = m_FileIndex.find(iID);
+	return it != m_FileIndex.end() ? it->second : NULL;
+}
+
+HistoryInfo* DownloadQueue::FindHistoryInfo(int iID)
+{
+	if (!m_bIndexValid)
+	{
+		BuildIndex();
+	}
+	HistoryIndex::iterator it = m_HistoryIndex.find(iID);
+	return it != m_HistoryIndex.end() ? it->second : NULL;
+}
+
+/*
+ * Adds nzb-item together with its files.
+ * If the index wasn't built yet there is nothing to update, it is built on first lookup.
+ */
+void DownloadQueue::AddToIndex(NZBInfo* pNZBInfo)
+{
+	if (!m_bIndexValid)
+	{
+		return;
+	}
+
+	m_NZBIndex[pNZBInfo->GetID()] = pNZBInfo;
+	for (FileList::iterator it = pNZBInfo->GetFileList()->begin(); it != pNZBInfo->GetFileList()->end(); it++)
+	{
+		FileInfo* pFileInfo = *it;
+		m_FileIndex[pFileInfo->GetID()] = pFileInfo;
+	}
+}
+
+void DownloadQueue::AddToIndex(HistoryInfo* pHistoryInfo)
+{
+	if (m_bIndexValid)
+	{
+		m_HistoryIndex[pHistoryInfo->GetID()] = pHistoryInfo;
+	}
+}
+
+/*
+ * Removes nzb-item together with its files. An entry is removed only if it points to
+ * the given object because the ID may already be taken by another item (an URL is
+ * replaced with the downloaded nzb having the same ID).
+ */
+void DownloadQueue::RemoveFromIndex(NZBInfo* pNZBInfo)
+{
+	if (!m_bIndexValid)
+	{
+		return;
+	}
+
+	NZBIndex::iterator it = m_NZBIndex.find(pNZBInfo->GetID());
+	if (it != m_NZBIndex.end() && it->second == pNZBInfo)
+	{
+		m_NZBIndex.erase(it);
+	}
+
+	for (FileList::iterator it2 = pNZBInfo->GetFileList()->begin(); it2 != pNZBInfo->GetFileList()->end(); it2++)
+	{
+		RemoveFromIndex(*it2);
+	}
+}
+
+void DownloadQueue::RemoveFromIndex(FileInfo* pFileInfo)
+{
+	if (!m_bIndexValid)
+	{
+		return;
+	}
+
+	FileIndex::iterator it = m_FileIndex.find(pFileInfo->GetID());
+	if (it != m_FileIndex.end() && it->second == pFileInfo)
+	{
+		m_FileIndex.erase(it);
+	}
+}
+
+void DownloadQueue::RemoveFromIndex(HistoryInfo* pHistoryInfo)
+{
+	if (!m_bIndexValid)
+	{
+		return;
+	}
+
+	HistoryIndex::iterator it = m_HistoryIndex.find(pHistoryInfo->GetID());
+	if (it != m_HistoryIndex.end() && it->second == pHistoryInfo)
+	{
+		m_HistoryIndex.erase(it);
+	}
 }
 
 void DownloadQueue::CalcRemainingSize(long long* pRemaining, long long* pRemainingForced)
@@ -29,6 +29,7 @@
 
 #include <vector>
 #include <deque>
+#include <map>
 #include <time.h>
 
 #include "Observer.h"
@@ -38,6 +39,7 @@
 class NZBInfo;
 class DownloadQueue;
 class PostInfo;
+class BlockHasher;
 
 class ServerStat
 {
@@ -74,6 +76,12 @@ public:
 	void				Clear();
 };
 
+class ArticlePool;
+
+/*
+ * Article-infos are allocated by ArticlePool of their file and must not be
+ * created or deleted directly. The message-id is stored in the same pool.
+ */
 class ArticleInfo
 {
 public:
@@ -86,23 +94,26 @@ public:
 	};
 	
 private:
-	int					m_iPartNumber;
-	char*				m_szMessageID;
-	int					m_iSize;
+	const char*			m_szMessageID;
 	char*				m_pSegmentContent;
+	char*				m_szResultFilename;
 	long long			m_iSegmentOffset;
+	int					m_iPartNumber;
+	int					m_iSize;
 	int					m_iSegmentSize;
-	EStatus				m_eStatus;
-	char*				m_szResultFilename;
-	unsigned long		m_lCrc;
+	unsigned int		m_iCrc;
+	unsigned char		m_eStatus;
 
-public:
 						ArticleInfo();
 						~ArticleInfo();
+
+	friend class ArticlePool;
+
+public:
 	void 				SetPartNumber(int s) { m_iPartNumber = s; }
 	int 				GetPartNumber() { return m_iPartNumber; }
 	const char* 		GetMessageID() { return m_szMessageID; }
-	void 				SetMessageID(const char* szMessageID);
+	void 				SetMessageID(const char* szMessageID) { m_szMessageID = szMessageID; }
 	void 				SetSize(int iSize) { m_iSize = iSize; }
 	int 				GetSize() { return m_iSize; }
 	void				AttachSegment(char* pContent, long long iOffset, int iSize);
@@ -112,12 +123,53 @@ public:
 	long long			GetSegmentOffset() { return m_iSegmentOffset; }
 	void 				SetSegmentSize(int iSegmentSize) { m_iSegmentSize = iSegmentSize; }
 	int 				GetSegmentSize() { return m_iSegmentSize; }
-	EStatus				GetStatus() { return m_eStatus; }
-	void				SetStatus(EStatus Status) { m_eStatus = Status; }
+	EStatus				GetStatus() { return (EStatus)m_eStatus; }
+	void				SetStatus(EStatus Status) { m_eStatus = (unsigned char)Status; }
 	const char*			GetResultFilename() { return m_szResultFilename; }
 	void 				SetResultFilename(const char* v);
-	unsigned long		GetCrc() { return m_lCrc; }
-	void				SetCrc(unsigned long lCrc) { m_lCrc = lCrc; }
+	unsigned long		GetCrc() { return m_iCrc; }
+	void				SetCrc(unsigned long lCrc) { m_iCrc = (unsigned int)lCrc; }
+};
+
+/*
+ * Memory pool for article-infos and message-ids of one file.
+ * Article-infos are placed in blocks, strings are packed into chunks; both
+ * grow with the number of articles. All memory is released in one go by Clear().
+ * Message-ids set via SetMessageID must be stored in the pool of the same file.
+ */
+class ArticlePool
+{
+private:
+	struct ArticleBlock
+	{
+		ArticleInfo*	pArticles;
+		int				iCapacity;
+		int				iUsed;
+	};
+
+	typedef std::vector<ArticleBlock>	ArticleBlocks;
+	typedef std::vector<char*>			StringChunks;
+
+	ArticleBlocks		m_ArticleBlocks;
+	StringChunks		m_StringChunks;
+	char*				m_pStringPos;
+	int					m_iStringFree;
+	int					m_iArticleCount;
+	long long			m_lStringSize;
+	long long			m_lAllocated;
+
+	char*				AllocString(int iSize);
+
+public:
+						ArticlePool();
+						~ArticlePool();
+	void				Reserve(int iArticles, int iStringSize);
+	ArticleInfo*		NewArticle();
+	const char*			AddString(const char* szValue);
+	const char*			AddData(const char* pData, int iSize);
+	void				Clear();
+	int					GetArticleCount() { return m_iArticleCount; }
+	long long			GetAllocated() { return m_lAllocated; }
 };
 
 class FileInfo
@@ -130,6 +182,7 @@ private:
 	int					m_iID;
 	NZBInfo*			m_pNZBInfo;
 	Articles			m_Articles;
+	ArticlePool			m_ArticlePool;
 	Groups				m_Groups;
 	ServerStatList		m_ServerStats;
 	char* 				m_szSubject;
@@ -157,6 +210,8 @@ private:
 	bool				m_bAutoDeleted;
 	int					m_iCachedArticles;
 	bool				m_bPartialChanged;
+	unsigned long long	m_lLastUsed;
+	BlockHasher*		m_pBlockHasher;
 
 	static int			m_iIDGen;
 	static int			m_iIDMax;
@@ -172,6 +227,8 @@ public:
 	NZBInfo*			GetNZBInfo() { return m_pNZBInfo; }
 	void				SetNZBInfo(NZBInfo* pNZBInfo) { m_pNZBInfo = pNZBInfo; }
 	Articles* 			GetArticles() { return &m_Articles; }
+	ArticlePool*		GetArticlePool() { return &m_ArticlePool; }
+	long long			CalcArticleMemory();
 	Groups* 			GetGroups() { return &m_Groups; }
 	const char*			GetSubject() { return m_szSubject; }
 	void 				SetSubject(const char* szSubject);
@@ -199,11 +256,11 @@ public:
 	int					GetSuccessArticles() { return m_iSuccessArticles; }
 	void 				SetSuccessArticles(int iSuccessArticles) { m_iSuccessArticles = iSuccessArticles; }
 	time_t				GetTime() { return m_tTime; }
-	void				SetTime(time_t tTime) { m_tTime = tTime; }
+	void				SetTime(time_t tTime);
 	bool				GetPaused() { return m_bPaused; }
 	void				SetPaused(bool bPaused);
 	bool				GetDeleted() { return m_bDeleted; }
-	void				SetDeleted(bool Deleted) { m_bDeleted = Deleted; }
+	void				SetDeleted(bool bDeleted);
 	int					GetCompletedArticles() { return m_iCompletedArticles; }
 	void				SetCompletedArticles(int iCompletedArticles) { m_iCompletedArticles = iCompletedArticles; }
 	bool				GetParFile() { return m_bParFile; }
@@ -216,7 +273,7 @@ public:
 	bool				GetOutputInitialized() { return m_bOutputInitialized; }
 	void				SetOutputInitialized(bool bOutputInitialized) { m_bOutputInitialized = bOutputInitialized; }
 	bool				GetExtraPriority() { return m_bExtraPriority; }
-	void				SetExtraPriority(bool bExtraPriority) { m_bExtraPriority = bExtraPriority; }
+	void				SetExtraPriority(bool bExtraPriority);
 	int					GetActiveDownloads() { return m_iActiveDownloads; }
 	void				SetActiveDownloads(int iActiveDownloads);
 	bool				GetAutoDeleted() { return m_bAutoDeleted; }
@@ -225,7 +282,11 @@ public:
 	void				SetCachedArticles(int iCachedArticles) { m_iCachedArticles = iCachedArticles; }
 	bool				GetPartialChanged() { return m_bPartialChanged; }
 	void				SetPartialChanged(bool bPartialChanged) { m_bPartialChanged = bPartialChanged; }
+	unsigned long long	GetLastUsed() { return m_lLastUsed; }
+	void				SetLastUsed(unsigned long long lLastUsed) { m_lLastUsed = lLastUsed; }
 	ServerStatList*		GetServerStats() { return &m_ServerStats; }
+	BlockHasher*		GetBlockHasher() { return m_pBlockHasher; }
+	void				SetBlockHasher(BlockHasher* pBlockHasher);
 };
                               
 typedef std::deque<FileInfo*> FileListBase;
@@ -488,8 +549,7 @@ private:
 	ServerStatList		m_ServerStats;
 	ServerStatList		m_CurrentServerStats;
 	Mutex				m_mutexLog;
-	MessageList			m_Messages;
-	int					m_iIDMessageGen;
+	MessageRing			m_Messages;
 	PostInfo*			m_pPostInfo;
 	long long 			m_lDownloadedSize;
 	time_t				m_tDownloadStartTime;
@@ -501,8 +561,10 @@ private:
 	bool				m_bReprocess;
 	time_t				m_tQueueScriptTime;
 	bool				m_bParFull;
+	long long			m_lParBlockSize;
 	int					m_iMessageCount;
 	int					m_iCachedMessageCount;
+	bool				m_bChanged;
 
 	static int			m_iIDGen;
 	static int			m_iIDMax;
@@ -510,14 +572,14 @@ private:
 	void				ClearMessages();
 
 public:
-						NZBInfo();
+						NZBInfo(bool bDetached = false);
 						~NZBInfo();
 	int					GetID() { return m_iID; }
 	void				SetID(int iID);
 	static void			ResetGenID(bool bMax);
 	static int			GenerateID();
 	EKind				GetKind() { return m_eKind; }
-	void				SetKind(EKind eKind) { m_eKind = eKind; }
+	void				SetKind(EKind eKind) { m_eKind = eKind; m_bChanged = true; }
 	const char*			GetURL() { return m_szURL; }			// needs locking (for shared objects)
 	void				SetURL(const char* szURL);				// needs locking (for shared objects)
 	const char*			GetFilename() { return m_szFilename; }
@@ -533,11 +595,11 @@ public:
 	const char*			GetName() { return m_szName; } 	   // needs locking (for shared objects)
 	void				SetName(const char* szName);	   // needs locking (for shared objects)
 	int					GetFileCount() { return m_iFileCount; }
-	void 				SetFileCount(int iFileCount) { m_iFileCount = iFileCount; }
+	void 				SetFileCount(int iFileCount) { m_iFileCount = iFileCount; m_bChanged = true; }
 	int					GetParkedFileCount() { return m_iParkedFileCount; }
-	void 				SetParkedFileCount(int iParkedFileCount) { m_iParkedFileCount = iParkedFileCount; }
+	void 				SetParkedFileCount(int iParkedFileCount) { m_iParkedFileCount = iParkedFileCount; m_bChanged = true; }
 	long long 			GetSize() { return m_lSize; }
-	void 				SetSize(long long lSize) { m_lSize = lSize; }
+	void 				SetSize(long long lSize) { m_lSize = lSize; m_bChanged = true; }
 	long long 			GetRemainingSize() { return m_lRemainingSize; }
 	void	 			SetRemainingSize(long long lRemainingSize) { m_lRemainingSize = lRemainingSize; }
 	long long 			GetPausedSize() { return m_lPausedSize; }
@@ -549,80 +611,80 @@ public:
 	int					GetActiveDownloads() { return m_iActiveDownloads; }
 	void				SetActiveDownloads(int iActiveDownloads);
 	long long			GetSuccessSize() { return m_lSuccessSize; }
-	void 				SetSuccessSize(long long lSuccessSize) { m_lSuccessSize = lSuccessSize; }
+	void 				SetSuccessSize(long long lSuccessSize) { m_lSuccessSize = lSuccessSize; m_bChanged = true; }
 	long long			GetFailedSize() { return m_lFailedSize; }
-	void 				SetFailedSize(long long lFailedSize) { m_lFailedSize = lFailedSize; }
+	void 				SetFailedSize(long long lFailedSize) { m_lFailedSize = lFailedSize; m_bChanged = true; }
 	long long			GetCurrentSuccessSize() { return m_lCurrentSuccessSize; }
 	void 				SetCurrentSuccessSize(long long lCurrentSuccessSize) { m_lCurrentSuccessSize = lCurrentSuccessSize; }
 	long long			GetCurrentFailedSize() { return m_lCurrentFailedSize; }
 	void 				SetCurrentFailedSize(long long lCurrentFailedSize) { m_lCurrentFailedSize = lCurrentFailedSize; }
 	long long			GetParSize() { return m_lParSize; }
-	void 				SetParSize(long long lParSize) { m_lParSize = lParSize; }
+	void 				SetParSize(long long lParSize) { m_lParSize = lParSize; m_bChanged = true; }
 	long long			GetParSuccessSize() { return m_lParSuccessSize; }
-	void 				SetParSuccessSize(long long lParSuccessSize) { m_lParSuccessSize = lParSuccessSize; }
+	void 				SetParSuccessSize(long long lParSuccessSize) { m_lParSuccessSize = lParSuccessSize; m_bChanged = true; }
 	long long			GetParFailedSize() { return m_lParFailedSize; }
-	void 				SetParFailedSize(long long lParFailedSize) { m_lParFailedSize = lParFailedSize; }
+	void 				SetParFailedSize(long long lParFailedSize) { m_lParFailedSize = lParFailedSize; m_bChanged = true; }
 	long long			GetParCurrentSuccessSize() { return m_lParCurrentSuccessSize; }
 	void 				SetParCurrentSuccessSize(long long lParCurrentSuccessSize) { m_lParCurrentSuccessSize = lParCurrentSuccessSize; }
 	long long			GetParCurrentFailedSize() { return m_lParCurrentFailedSize; }
 	void 				SetParCurrentFailedSize(long long lParCurrentFailedSize) { m_lParCurrentFailedSize = lParCurrentFailedSize; }
 	int					GetTotalArticles() { return m_iTotalArticles; }
-	void 				SetTotalArticles(int iTotalArticles) { m_iTotalArticles = iTotalArticles; }
+	void 				SetTotalArticles(int iTotalArticles) { m_iTotalArticles = iTotalArticles; m_bChanged = true; }
 	int					GetSuccessArticles() { return m_iSuccessArticles; }
-	void 				SetSuccessArticles(int iSuccessArticles) { m_iSuccessArticles = iSuccessArticles; }
+	void 				SetSuccessArticles(int iSuccessArticles) { m_iSuccessArticles = iSuccessArticles; m_bChanged = true; }
 	int					GetFailedArticles() { return m_iFailedArticles; }
-	void 				SetFailedArticles(int iFailedArticles) { m_iFailedArticles = iFailedArticles; }
+	void 				SetFailedArticles(int iFailedArticles) { m_iFailedArticles = iFailedArticles; m_bChanged = true; }
 	int					GetCurrentSuccessArticles() { return m_iCurrentSuccessArticles; }
 	void 				SetCurrentSuccessArticles(int iCurrentSuccessArticles) { m_iCurrentSuccessArticles = iCurrentSuccessArticles; }
 	int					GetCurrentFailedArticles() { return m_iCurrentFailedArticles; }
 	void 				SetCurrentFailedArticles(int iCurrentFailedArticles) { m_iCurrentFailedArticles = iCurrentFailedArticles; }
 	int					GetPriority() { return m_iPriority; }
-	void				SetPriority(int iPriority) { m_iPriority = iPriority; }
+	void				SetPriority(int iPriority) { m_iPriority = iPriority; m_bChanged = true; }
 	bool				GetForcePriority() { return m_iPriority >= FORCE_PRIORITY; }
 	time_t				GetMinTime() { return m_tMinTime; }
-	void				SetMinTime(time_t tMinTime) { m_tMinTime = tMinTime; }
+	void				SetMinTime(time_t tMinTime) { m_tMinTime = tMinTime; m_bChanged = true; }
 	time_t				GetMaxTime() { return m_tMaxTime; }
-	void				SetMaxTime(time_t tMaxTime) { m_tMaxTime = tMaxTime; }
+	void				SetMaxTime(time_t tMaxTime) { m_tMaxTime = tMaxTime; m_bChanged = true; }
 	void				BuildDestDirName();
 	void				BuildFinalDirName(char* szFinalDirBuf, int iBufSize);
 	CompletedFiles*		GetCompletedFiles() { return &m_completedFiles; }		// needs locking (for shared objects)
 	void				ClearCompletedFiles();
 	ERenameStatus		GetRenameStatus() { return m_eRenameStatus; }
-	void				SetRenameStatus(ERenameStatus eRenameStatus) { m_eRenameStatus = eRenameStatus; }
+	void				SetRenameStatus(ERenameStatus eRenameStatus) { m_eRenameStatus = eRenameStatus; m_bChanged = true; }
 	EParStatus			GetParStatus() { return m_eParStatus; }
-	void				SetParStatus(EParStatus eParStatus) { m_eParStatus = eParStatus; }
+	void				SetParStatus(EParStatus eParStatus) { m_eParStatus = eParStatus; m_bChanged = true; }
 	EUnpackStatus		GetUnpackStatus() { return m_eUnpackStatus; }
-	void				SetUnpackStatus(EUnpackStatus eUnpackStatus) { m_eUnpackStatus = eUnpackStatus; }
+	void				SetUnpackStatus(EUnpackStatus eUnpackStatus) { m_eUnpackStatus = eUnpackStatus; m_bChanged = true; }
 	ECleanupStatus		GetCleanupStatus() { return m_eCleanupStatus; }
 	void				SetCleanupStatus(ECleanupStatus eCleanupStatus) { m_eCleanupStatus = eCleanupStatus; }
 	EMoveStatus			GetMoveStatus() { return m_eMoveStatus; }
-	void				SetMoveStatus(EMoveStatus eMoveStatus) { m_eMoveStatus = eMoveStatus; }
+	void				SetMoveStatus(EMoveStatus eMoveStatus) { m_eMoveStatus = eMoveStatus; m_bChanged = true; }
 	EDeleteStatus		GetDeleteStatus() { return m_eDeleteStatus; }
-	void				SetDeleteStatus(EDeleteStatus eDeleteStatus) { m_eDeleteStatus = eDeleteStatus; }
+	void				SetDeleteStatus(EDeleteStatus eDeleteStatus) { m_eDeleteStatus = eDeleteStatus; m_bChanged = true; }
 	EMarkStatus			GetMarkStatus() { return m_eMarkStatus; }
-	void				SetMarkStatus(EMarkStatus eMarkStatus) { m_eMarkStatus = eMarkStatus; }
+	void				SetMarkStatus(EMarkStatus eMarkStatus) { m_eMarkStatus = eMarkStatus; m_bChanged = true; }
 	EUrlStatus			GetUrlStatus() { return m_eUrlStatus; }
-	void				SetUrlStatus(EUrlStatus eUrlStatus) { m_eUrlStatus = eUrlStatus; }
+	void				SetUrlStatus(EUrlStatus eUrlStatus) { m_eUrlStatus = eUrlStatus; m_bChanged = true; }
 	const char*			GetQueuedFilename() { return m_szQueuedFilename; }
 	void				SetQueuedFilename(const char* szQueuedFilename);
 	bool				GetDeleting() { return m_bDeleting; }
 	void				SetDeleting(bool bDeleting) { m_bDeleting = bDeleting; }
 	bool				GetDeletePaused() { return m_bDeletePaused; }
-	void				SetDeletePaused(bool bDeletePaused) { m_bDeletePaused = bDeletePaused; }
+	void				SetDeletePaused(bool bDeletePaused) { m_bDeletePaused = bDeletePaused; m_bChanged = true; }
 	bool				GetManyDupeFiles() { return m_bManyDupeFiles; }
-	void				SetManyDupeFiles(bool bManyDupeFiles) { m_bManyDupeFiles = bManyDupeFiles; }
+	void				SetManyDupeFiles(bool bManyDupeFiles) { m_bManyDupeFiles = bManyDupeFiles; m_bChanged = true; }
 	bool				GetAvoidHistory() { return m_bAvoidHistory; }
 	void				SetAvoidHistory(bool bAvoidHistory) { m_bAvoidHistory = bAvoidHistory; }
 	bool				GetHealthPaused() { return m_bHealthPaused; }
-	void				SetHealthPaused(bool bHealthPaused) { m_bHealthPaused = bHealthPaused; }
+	void				SetHealthPaused(bool bHealthPaused) { m_bHealthPaused = bHealthPaused; m_bChanged = true; }
 	bool				GetParCleanup() { return m_bParCleanup; }
 	void				SetParCleanup(bool bParCleanup) { m_bParCleanup = bParCleanup; }
 	bool				GetCleanupDisk() { return m_bCleanupDisk; }
 	void				SetCleanupDisk(bool bCleanupDisk) { m_bCleanupDisk = bCleanupDisk; }
 	bool				GetUnpackCleanedUpDisk() { return m_bUnpackCleanedUpDisk; }
-	void				SetUnpackCleanedUpDisk(bool bUnpackCleanedUpDisk) { m_bUnpackCleanedUpDisk = bUnpackCleanedUpDisk; }
+	void				SetUnpackCleanedUpDisk(bool bUnpackCleanedUpDisk) { m_bUnpackCleanedUpDisk = bUnpackCleanedUpDisk; m_bChanged = true; }
 	bool				GetAddUrlPaused() { return m_bAddUrlPaused; }
-	void				SetAddUrlPaused(bool bAddUrlPaused) { m_bAddUrlPaused = bAddUrlPaused; }
+	void				SetAddUrlPaused(bool bAddUrlPaused) { m_bAddUrlPaused = bAddUrlPaused; m_bChanged = true; }
 	FileList*			GetFileList() { return &m_FileList; }					// needs locking (for shared objects)
 	NZBParameterList*	GetParameters() { return &m_ppParameters; }				// needs locking (for shared objects)
 	ScriptStatusList*	GetScriptStatuses() { return &m_scriptStatuses; }        // needs locking (for shared objects)
@@ -633,33 +695,35 @@ public:
 	const char*			GetDupeKey() { return m_szDupeKey; }					// needs locking (for shared objects)
 	void				SetDupeKey(const char* szDupeKey);						// needs locking (for shared objects)
 	int					GetDupeScore() { return m_iDupeScore; }
-	void				SetDupeScore(int iDupeScore) { m_iDupeScore = iDupeScore; }
+	void				SetDupeScore(int iDupeScore) { m_iDupeScore = iDupeScore; m_bChanged = true; }
 	EDupeMode			GetDupeMode() { return m_eDupeMode; }
-	void				SetDupeMode(EDupeMode eDupeMode) { m_eDupeMode = eDupeMode; }
+	void				SetDupeMode(EDupeMode eDupeMode) { m_eDupeMode = eDupeMode; m_bChanged = true; }
 	unsigned int		GetFullContentHash() { return m_iFullContentHash; }
-	void				SetFullContentHash(unsigned int iFullContentHash) { m_iFullContentHash = iFullContentHash; }
+	void				SetFullContentHash(unsigned int iFullContentHash) { m_iFullContentHash = iFullContentHash; m_bChanged = true; }
 	unsigned int		GetFilteredContentHash() { return m_iFilteredContentHash; }
-	void				SetFilteredContentHash(unsigned int iFilteredContentHash) { m_iFilteredContentHash = iFilteredContentHash; }
+	void				SetFilteredContentHash(unsigned int iFilteredContentHash) { m_iFilteredContentHash = iFilteredContentHash; m_bChanged = true; }
 	long long 			GetDownloadedSize() { return m_lDownloadedSize; }
-	void 				SetDownloadedSize(long long lDownloadedSize) { m_lDownloadedSize = lDownloadedSize; }
+	void 				SetDownloadedSize(long long lDownloadedSize) { m_lDownloadedSize = lDownloadedSize; m_bChanged = true; }
 	int					GetDownloadSec() { return m_iDownloadSec; }
-	void 				SetDownloadSec(int iDownloadSec) { m_iDownloadSec = iDownloadSec; }
+	void 				SetDownloadSec(int iDownloadSec) { m_iDownloadSec = iDownloadSec; m_bChanged = true; }
 	int					GetPostTotalSec() { return m_iPostTotalSec; }
-	void 				SetPostTotalSec(int iPostTotalSec) { m_iPostTotalSec = iPostTotalSec; }
+	void 				SetPostTotalSec(int iPostTotalSec) { m_iPostTotalSec = iPostTotalSec; m_bChanged = true; }
 	int					GetParSec() { return m_iParSec; }
-	void 				SetParSec(int iParSec) { m_iParSec = iParSec; }
+	void 				SetParSec(int iParSec) { m_iParSec = iParSec; m_bChanged = true; }
 	int					GetRepairSec() { return m_iRepairSec; }
-	void 				SetRepairSec(int iRepairSec) { m_iRepairSec = iRepairSec; }
+	void 				SetRepairSec(int iRepairSec) { m_iRepairSec = iRepairSec; m_bChanged = true; }
 	int					GetUnpackSec() { return m_iUnpackSec; }
-	void 				SetUnpackSec(int iUnpackSec) { m_iUnpackSec = iUnpackSec; }
+	void 				SetUnpackSec(int iUnpackSec) { m_iUnpackSec = iUnpackSec; m_bChanged = true; }
 	time_t				GetDownloadStartTime() { return m_tDownloadStartTime; }
 	void 				SetDownloadStartTime(time_t tDownloadStartTime) { m_tDownloadStartTime = tDownloadStartTime; }
 	void				SetReprocess(bool bReprocess) { m_bReprocess = bReprocess; }
 	bool				GetReprocess() { return m_bReprocess; }
 	time_t				GetQueueScriptTime() { return m_tQueueScriptTime; }
 	void 				SetQueueScriptTime(time_t tQueueScriptTime) { m_tQueueScriptTime = tQueueScriptTime; }
-	void				SetParFull(bool bParFull) { m_bParFull = bParFull; }
+	void				SetParFull(bool bParFull) { m_bParFull = bParFull; m_bChanged = true; }
 	bool				GetParFull() { return m_bParFull; }
+	long long			GetParBlockSize() { return m_lParBlockSize; }
+	void				SetParBlockSize(long long lParBlockSize) { m_lParBlockSize = lParBlockSize; }
 
 	void				CopyFileList(NZBInfo* pSrcNZBInfo);
 	void				UpdateMinMaxTime();
@@ -672,10 +736,11 @@ public:
 	void				AddMessage(Message::EKind eKind, const char* szText);
 	void				PrintMessage(Message::EKind eKind, const char* szFormat, ...);
 	int					GetMessageCount() { return m_iMessageCount; }
-	void				SetMessageCount(int iMessageCount) { m_iMessageCount = iMessageCount; }
+	void				SetMessageCount(int iMessageCount) { m_iMessageCount = iMessageCount; m_bChanged = true; }
 	int					GetCachedMessageCount() { return m_iCachedMessageCount; }
-	MessageList*		LockCachedMessages();
-	void				UnlockCachedMessages();
+	bool				GetChanged() { return m_bChanged; }			// record must be written on next save
+	void				SetChanged(bool bChanged) { m_bChanged = bChanged; }
+	void				GetCachedMessages(MessageList* pMessages, int iIDFrom, int iLastCount);
 };
 
 typedef std::deque<NZBInfo*> NZBQueueBase;
@@ -739,7 +804,7 @@ public:
 	NZBInfo*			GetNZBInfo() { return m_pNZBInfo; }
 	void				SetNZBInfo(NZBInfo* pNZBInfo) { m_pNZBInfo = pNZBInfo; }
 	EStage				GetStage() { return m_eStage; }
-	void				SetStage(EStage eStage) { m_eStage = eStage; }
+	void				SetStage(EStage eStage) { m_eStage = eStage; m_pNZBInfo->SetChanged(true); }
 	void				SetProgressLabel(const char* szProgressLabel);
 	const char*			GetProgressLabel() { return m_szProgressLabel; }
 	int					GetFileProgress() { return m_iFileProgress; }
@@ -757,9 +822,9 @@ public:
 	bool				GetRequestParCheck() { return m_bRequestParCheck; }
 	void				SetRequestParCheck(bool bRequestParCheck) { m_bRequestParCheck = bRequestParCheck; }
 	bool				GetForceParFull() { return m_bForceParFull; }
-	void				SetForceParFull(bool bForceParFull) { m_bForceParFull = bForceParFull; }
+	void				SetForceParFull(bool bForceParFull) { m_bForceParFull = bForceParFull; m_pNZBInfo->SetChanged(true); }
 	bool				GetForceRepair() { return m_bForceRepair; }
-	void				SetForceRepair(bool bForceRepair) { m_bForceRepair = bForceRepair; }
+	void				SetForceRepair(bool bForceRepair) { m_bForceRepair = bForceRepair; m_pNZBInfo->SetChanged(true); }
 	bool				GetParRepaired() { return m_bParRepaired; }
 	void				SetParRepaired(bool bParRepaired) { m_bParRepaired = bParRepaired; }
 	bool				GetUnpackTried() { return m_bUnpackTried; }
@@ -801,9 +866,13 @@ private:
 	unsigned int		m_iFullContentHash;
 	unsigned int		m_iFilteredContentHash;
 	EStatus				m_eStatus;
+	bool				m_bDetached;
+	bool				m_bChanged;
+
+	void				Changed();
 
 public:
-						DupInfo();
+						DupInfo(bool bDetached = false);
 						~DupInfo();
 	int					GetID() { return m_iID; }
 	void				SetID(int iID);
@@ -812,17 +881,19 @@ public:
 	const char*			GetDupeKey() { return m_szDupeKey; }	// needs locking (for shared objects)
 	void				SetDupeKey(const char* szDupeKey);		// needs locking (for shared objects)
 	int					GetDupeScore() { return m_iDupeScore; }
-	void				SetDupeScore(int iDupeScore) { m_iDupeScore = iDupeScore; }
+	void				SetDupeScore(int iDupeScore) { m_iDupeScore = iDupeScore; Changed(); }
 	EDupeMode			GetDupeMode() { return m_eDupeMode; }
-	void				SetDupeMode(EDupeMode eDupeMode) { m_eDupeMode = eDupeMode; }
+	void				SetDupeMode(EDupeMode eDupeMode) { m_eDupeMode = eDupeMode; Changed(); }
 	long long			GetSize() { return m_lSize; }
-	void 				SetSize(long long lSize) { m_lSize = lSize; }
+	void 				SetSize(long long lSize) { m_lSize = lSize; Changed(); }
 	unsigned int		GetFullContentHash() { return m_iFullContentHash; }
-	void				SetFullContentHash(unsigned int iFullContentHash) { m_iFullContentHash = iFullContentHash; }
+	void				SetFullContentHash(unsigned int iFullContentHash);
 	unsigned int		GetFilteredContentHash() { return m_iFilteredContentHash; }
-	void				SetFilteredContentHash(unsigned int iFilteredContentHash) { m_iFilteredContentHash = iFilteredContentHash; }
+	void				SetFilteredContentHash(unsigned int iFilteredContentHash);
 	EStatus				GetStatus() { return m_eStatus; }
-	void				SetStatus(EStatus Status) { m_eStatus = Status; }
+	void				SetStatus(EStatus Status) { m_eStatus = Status; Changed(); }
+	bool				GetChanged() { return m_bChanged; }
+	void				SetChanged(bool bChanged) { m_bChanged = bChanged; }
 };
 
 class HistoryInfo
@@ -840,10 +911,12 @@ private:
 	EKind				m_eKind;
 	void*				m_pInfo;
 	time_t				m_tTime;
+	bool				m_bDetached;
+	bool				m_bChanged;
 
 public:
-						HistoryInfo(NZBInfo* pNZBInfo);
-						HistoryInfo(DupInfo* pDupInfo);
+						HistoryInfo(NZBInfo* pNZBInfo, bool bDetached = false);
+						HistoryInfo(DupInfo* pDupInfo, bool bDetached = false);
 						~HistoryInfo();
 	EKind				GetKind() { return m_eKind; }
 	int					GetID();
@@ -851,8 +924,11 @@ public:
 	DupInfo*			GetDupInfo() { return (DupInfo*)m_pInfo; }
 	void				DiscardNZBInfo() { m_pInfo = NULL; }
 	time_t				GetTime() { return m_tTime; }
-	void				SetTime(time_t tTime) { m_tTime = tTime; }
+	void				SetTime(time_t tTime) { m_tTime = tTime; m_bChanged = true; }
+	bool				GetChanged();
+	void				SetChanged(bool bChanged);
 	void				GetName(char* szBuffer, int iSize);		// needs locking (for shared objects)
+	const char*			MakeTextStatus();
 };
 
 typedef std::deque<HistoryInfo*> HistoryList;
@@ -936,15 +1012,33 @@ public:
 	};
 
 private:
+	typedef std::map<int, NZBInfo*>		NZBIndex;
+	typedef std::map<int, FileInfo*>	FileIndex;
+	typedef std::map<int, HistoryInfo*>	HistoryIndex;
+
 	NZBList					m_Queue;
 	HistoryList				m_History;
-	Mutex	 				m_LockMutex;
+	NZBIndex				m_NZBIndex;
+	FileIndex				m_FileIndex;
+	HistoryIndex			m_HistoryIndex;
+	bool					m_bIndexValid;
+	RWLock	 				m_Lock;
+	long long				m_lLockWaitUSec;
+	long long				m_lLockCount;
+	Mutex					m_mutexSharedStat;
+	long long				m_lSharedWaitUSec;
+	long long				m_lSharedCount;
 
 	static DownloadQueue*	g_pDownloadQueue;
 	static bool				g_bLoaded;
+	static int				g_iHistoryGeneration;
+	static Mutex			g_mutexHistoryGeneration;
+
+	void					BuildIndex();
 
 protected:
-							DownloadQueue() : m_Queue(true) {}
+							DownloadQueue() : m_Queue(true), m_bIndexValid(false), m_lLockWaitUSec(0), m_lLockCount(0),
+								m_lSharedWaitUSec(0), m_lSharedCount(0) {}
 	static void				Init(DownloadQueue* pGlobalInstance) { g_pDownloadQueue = pGlobalInstance; }
 	static void				Final() { g_pDownloadQueue = NULL; }
 	static void				Loaded() { g_bLoaded = true; }
@@ -954,12 +1048,28 @@ public:
 	static bool				IsLoaded() { return g_bLoaded; }
 	static DownloadQueue*	Lock();
 	static void				Unlock();
+	static DownloadQueue*	LockShared();
+	static void				UnlockShared();
+	static void				GetLockStat(long long* pLockWaitUSec, long long* pLockCount,
+								long long* pSharedWaitUSec, long long* pSharedCount);
 	NZBList*				GetQueue() { return &m_Queue; }
 	HistoryList*			GetHistory() { return &m_History; }
 	virtual bool			EditEntry(int ID, EEditAction eAction, int iOffset, const char* szText) = 0;
 	virtual bool			EditList(IDList* pIDList, NameList* pNameList, EMatchMode eMatchMode, EEditAction eAction, int iOffset, const char* szText) = 0;
 	virtual void			Save() = 0;
 	void					CalcRemainingSize(long long* pRemaining, long long* pRemainingForced);
+	NZBInfo*				FindNZBInfo(int iID);
+	FileInfo*				FindFileInfo(int iID);
+	HistoryInfo*			FindHistoryInfo(int iID);
+	void					AddToIndex(NZBInfo* pNZBInfo);
+	void					AddToIndex(HistoryInfo* pHistoryInfo);
+	void					RemoveFromIndex(NZBInfo* pNZBInfo);
+	void					RemoveFromIndex(FileInfo* pFileInfo);
+	void					RemoveFromIndex(HistoryInfo* pHistoryInfo);
+	void					InvalidateIndex() { m_bIndexValid = false; }
+	// the generation changes on every modification of history items
+	static int				GetHistoryGeneration() { return g_iHistoryGeneration; }
+	static void				HistoryChanged();
 };
 
 #endif
@@ -50,6 +50,172 @@
 #include "HistoryCoordinator.h"
 #include "DupeCoordinator.h"
 
+DupeCoordinator::DupeCoordinator()
+{
+	m_bIndexBuilt = false;
+	m_iIndexGeneration = 0;
+	m_iIndexHistorySize = 0;
+}
+
+void DupeCoordinator::DupeIndex::Clear(int iCapacity)
+{
+	unsigned int iSize = 16;
+	while (iSize < (unsigned int)iCapacity * 2)
+	{
+		iSize <<= 1;
+	}
+	m_iMask = iSize - 1;
+	m_Heads.assign(iSize, -1);
+	m_Next.clear();
+	m_Keys.clear();
+	m_Positions.clear();
+}
+
+void DupeCoordinator::DupeIndex::Add(unsigned int iKey, int iPosition)
+{
+	int iEntry = (int)m_Keys.size();
+	m_Keys.push_back(iKey);
+	m_Positions.push_back(iPosition);
+	m_Next.push_back(m_Heads[iKey & m_iMask]);
+	m_Heads[iKey & m_iMask] = iEntry;
+}
+
+void DupeCoordinator::DupeIndex::Find(unsigned int iKey, Positions* pPositions)
+{
+	for (int iEntry = m_Heads[iKey & m_iMask]; iEntry > -1; iEntry = m_Next[iEntry])
+	{
+		if (m_Keys[iEntry] == iKey)
+		{
+			pPositions->push_back(m_Positions[iEntry]);
+		}
+	}
+}
+
+unsigned int DupeCoordinator::StrHash(const char* szValue)
+{
+	return szValue ? Util::HashBJ96(szValue, strlen(szValue), 0) : 0;
+}
+
+void DupeCoordinator::AddToIndex(int iPosition, const char* szName, const char* szDupeKey,
+	unsigned int iFullContentHash, unsigned int iFilteredContentHash)
+{
+	m_NameIndex.Add(StrHash(szName), iPosition);
+	if (!Util::EmptyStr(szDupeKey))
+	{
+		m_DupeKeyIndex.Add(StrHash(szDupeKey), iPosition);
+	}
+	if (iFullContentHash > 0)
+	{
+		m_FullHashIndex.Add(iFullContentHash, iPosition);
+	}
+	if (iFilteredContentHash > 0)
+	{
+		m_FilteredHashIndex.Add(iFilteredContentHash, iPosition);
+	}
+}
+
+/*
+ * Rebuilds the index of history if it was changed since the last build.
+ */
+void DupeCoordinator::UpdateIndex(DownloadQueue* pDownloadQueue)
+{
+	int iHistorySize = (int)pDownloadQueue->GetHistory()->size();
+
+	if (m_bIndexBuilt && m_iIndexGeneration == DownloadQueue::GetHistoryGeneration() &&
+		m_iIndexHistorySize == iHistorySize)
+	{
+		return;
+	}
+
+	m_NameIndex.Clear(iHistorySize);
+	m_DupeKeyIndex.Clear(iHistorySize);
+	m_FullHashIndex.Clear(iHistorySize);
+	m_FilteredHashIndex.Clear(iHistorySize);
+
+	int iPosition = 0;
+	for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++, iPosition++)
+	{
+		HistoryInfo* pHistoryInfo = *it;
+		if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb)
+		{
+			NZBInfo* pNZBInfo = pHistoryInfo->GetNZBInfo();
+			AddToIndex(iPosition, pNZBInfo->GetName(), pNZBInfo->GetDupeKey(),
+				pNZBInfo->GetFullContentHash(), pNZBInfo->GetFilteredContentHash());
+		}
+		else if (pHistoryInfo->GetKind() == HistoryInfo::hkDup)
+		{
+			DupInfo* pDupInfo = pHistoryInfo->GetDupInfo();
+			AddToIndex(iPosition, pDupInfo->GetName(), pDupInfo->GetDupeKey(),
+				pDupInfo->GetFullContentHash(), pDupInfo->GetFilteredContentHash());
+		}
+	}
+
+	m_bIndexBuilt = true;
+	m_iIndexGeneration = DownloadQueue::GetHistoryGeneration();
+	m_iIndexHistorySize = iHistorySize;
+}
+
+/*
+ * Finds candidates for duplicates: items having the same name, the same dupe key
+ * or the same content hash (for non-NULL/non-zero parameters). The items are
+ * returned in the order of queue and history, the callers check them using
+ * the same conditions as when scanning the whole lists.
+ * The queue is usually short and changes often, it is scanned directly;
+ * the history is looked up in the index.
+ */
+void DupeCoordinator::FindDupes(DownloadQueue* pDownloadQueue, const char* szName, const char* szDupeKey,
+	unsigned int iFullContentHash, unsigned int iFilteredContentHash,
+	QueueDupes* pQueueDupes, HistoryDupes* pHistoryDupes)
+{
+	if (pQueueDupes)
+	{
+		for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
+		{
+			NZBInfo* pNZBInfo = *it;
+			if ((szName && !strcmp(szName, pNZBInfo->GetName())) ||
+				(!Util::EmptyStr(szDupeKey) && !strcmp(szDupeKey, pNZBInfo->GetDupeKey())) ||
+				(iFullContentHash > 0 && iFullContentHash == pNZBInfo->GetFullContentHash()) ||
+				(iFilteredContentHash > 0 && iFilteredContentHash == pNZBInfo->GetFilteredContentHash()))
+			{
+				pQueueDupes->push_back(pNZBInfo);
+			}
+		}
+	}
+
+	if (!pHistoryDupes)
+	{
+		return;
+	}
+
+	UpdateIndex(pDownloadQueue);
+
+	Positions positions;
+	if (szName)
+	{
+		m_NameIndex.Find(StrHash(szName), &positions);
+	}
+	if (!Util::EmptyStr(szDupeKey))
+	{
+		m_DupeKeyIndex.Find(StrHash(szDupeKey), &positions);
+	}
+	if (iFullContentHash > 0)
+	{
+		m_FullHashIndex.Find(iFullContentHash, &positions);
+	}
+	if (iFilteredContentHash > 0)
+	{
+		m_FilteredHashIndex.Find(iFilteredContentHash, &positions);
+	}
+
+	std::sort(positions.begin(), positions.end());
+	positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+
+	for (Positions::iterator it = positions.begin(); it != positions.end(); it++)
+	{
+		pHistoryDupes->push_back(pDownloadQueue->GetHistory()->at(*it));
+	}
+}
+
 bool DupeCoordinator::SameNameOrKey(const char* szName1, const char* szDupeKey1,
 	const char* szName2, const char* szDupeKey2)
 {
@@ -77,7 +243,10 @@ void DupeCoordinator::NZBFound(DownloadQueue* pDownloadQueue, NZBInfo* pNZBInfo)
 	debug("Checking duplicates for %s", pNZBInfo->GetName());
 
 	// find duplicates in download queue with exactly same content
-	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
+	QueueDupes contentDupes;
+	FindDupes(pDownloadQueue, NULL, NULL, pNZBInfo->GetFullContentHash(),
+		pNZBInfo->GetFilteredContentHash(), &contentDupes, NULL);
+	for (QueueDupes::iterator it = contentDupes.begin(); it != contentDupes.end(); it++)
 	{
 		NZBInfo* pQueuedNZBInfo = *it;
 		bool bSameContent = (pNZBInfo->GetFullContentHash() > 0 &&
@@ -110,7 +279,9 @@ void DupeCoordinator::NZBFound(DownloadQueue* pDownloadQueue, NZBInfo* pNZBInfo)
 	// take these properties from this item
 	if (Util::EmptyStr(pNZBInfo->GetDupeKey()) && pNZBInfo->GetDupeScore() == 0)
 	{
-		for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
+		QueueDupes queueDupes;
+		FindDupes(pDownloadQueue, pNZBInfo->GetName(), NULL, 0, 0, &queueDupes, NULL);
+		for (QueueDupes::iterator it = queueDupes.begin(); it != queueDupes.end(); it++)
 		{
 			NZBInfo* pQueuedNZBInfo = *it;
 			if (!strcmp(pQueuedNZBInfo->GetName(), pNZBInfo->GetName()) &&
@@ -126,7 +297,9 @@ void DupeCoordinator::NZBFound(DownloadQueue* pDownloadQueue, NZBInfo* pNZBInfo)
 	}
 	if (Util::EmptyStr(pNZBInfo->GetDupeKey()) && pNZBInfo->GetDupeScore() == 0)
 	{
-		for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
+		HistoryDupes historyDupes;
+		FindDupes(pDownloadQueue, pNZBInfo->GetName(), NULL, 0, 0, NULL, &historyDupes);
+		for (HistoryDupes::iterator it = historyDupes.begin(); it != historyDupes.end(); it++)
 		{
 			HistoryInfo* pHistoryInfo = *it;
 			if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb &&
@@ -162,7 +335,10 @@ void DupeCoordinator::NZBFound(DownloadQueue* pDownloadQueue, NZBInfo* pNZBInfo)
 	// find duplicates in queue having exactly same content
 	// also: nzb-files having duplicates marked as good are skipped
 	// also (only in score mode): nzb-files having success-duplicates in dup-history but don't having duplicates in recent history are skipped
-	for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
+	HistoryDupes historyDupes;
+	FindDupes(pDownloadQueue, pNZBInfo->GetName(), pNZBInfo->GetDupeKey(), pNZBInfo->GetFullContentHash(),
+		pNZBInfo->GetFilteredContentHash(), NULL, &historyDupes);
+	for (HistoryDupes::iterator it = historyDupes.begin(); it != historyDupes.end(); it++)
 	{
 		HistoryInfo* pHistoryInfo = *it;
 
@@ -221,7 +397,9 @@ void DupeCoordinator::NZBFound(DownloadQueue* pDownloadQueue, NZBInfo* pNZBInfo)
 	if (!bSameContent && !bGood && pNZBInfo->GetDupeMode() == dmScore)
 	{
 		// nzb-files having success-duplicates in recent history (with different content) are added to history for backup
-		for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
+		HistoryDupes historyDupes;
+		FindDupes(pDownloadQueue, pNZBInfo->GetName(), pNZBInfo->GetDupeKey(), 0, 0, NULL, &historyDupes);
+		for (HistoryDupes::iterator it = historyDupes.begin(); it != historyDupes.end(); it++)
 		{
 			HistoryInfo* pHistoryInfo = *it;
 			if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb &&
@@ -263,38 +441,48 @@ void DupeCoordinator::NZBFound(DownloadQueue* pDownloadQueue, NZBInfo* pNZBInfo)
 	// only one item remains in queue and another one is moved to history as dupe-backup
 	if (pNZBInfo->GetDupeMode() == dmScore)
 	{
-		// find duplicates in download queue
-		int index = 0;
-		for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); index++)
+		// find duplicates in download queue;
+		// deleting of items changes the queue, the search is then repeated
+		std::set<int> processedIDs;
+		bool bDeleted = true;
+		while (bDeleted)
 		{
-			NZBInfo* pQueuedNZBInfo = *it++;
-			if (pQueuedNZBInfo != pNZBInfo &&
-				pQueuedNZBInfo->GetKind() == NZBInfo::nkNzb &&
-				pQueuedNZBInfo->GetDupeMode() != dmForce &&
-				SameNameOrKey(pQueuedNZBInfo->GetName(), pQueuedNZBInfo->GetDupeKey(),
-					pNZBInfo->GetName(), pNZBInfo->GetDupeKey()))
+			bDeleted = false;
+			QueueDupes queueDupes;
+			FindDupes(pDownloadQueue, pNZBInfo->GetName(), pNZBInfo->GetDupeKey(), 0, 0, &queueDupes, NULL);
+			for (QueueDupes::iterator it = queueDupes.begin(); it != queueDupes.end() && !bDeleted; it++)
 			{
-				// if queue has a duplicate with the same or higher score - the new item
-				// is moved to history as dupe-backup
-				if (pNZBInfo->GetDupeScore() <= pQueuedNZBInfo->GetDupeScore())
-				{
-					// Flag saying QueueCoordinator to skip nzb-file
-					pNZBInfo->SetDeleteStatus(NZBInfo::dsDupe);
-					info("Collection %s is a duplicate to %s", pNZBInfo->GetName(), pQueuedNZBInfo->GetName());
-					return;
-				}
-
-				// if queue has a duplicate with lower score - the existing item is moved
-				// to history as dupe-backup (unless it is in post-processing stage) and
-				// the new item is added to queue (unless it is in post-processing stage)
-				if (!pQueuedNZBInfo->GetPostInfo())
+				NZBInfo* pQueuedNZBInfo = *it;
+				if (pQueuedNZBInfo != pNZBInfo &&
+					pQueuedNZBInfo->GetKind() == NZBInfo::nkNzb &&
+					pQueuedNZBInfo->GetDupeMode() != dmForce &&
+					processedIDs.find(pQueuedNZBInfo->GetID()) == processedIDs.end() &&
+					SameNameOrKey(pQueuedNZBInfo->GetName(), pQueuedNZBInfo->GetDupeKey(),
+						pNZBInfo->GetName(), pNZBInfo->GetDupeKey()))
 				{
-					// the existing queue item is moved to history as dupe-backup
-					info("Moving collection %s with lower duplicate score to history", pQueuedNZBInfo->GetName());
-					pQueuedNZBInfo->SetDeleteStatus(NZBInfo::dsDupe);
-					pDownloadQueue->EditEntry(pQueuedNZBInfo->GetID(),
-						DownloadQueue::eaGroupDelete, 0, NULL);
-					it = pDownloadQueue->GetQueue()->begin() + index;
+					// if queue has a duplicate with the same or higher score - the new item
+					// is moved to history as dupe-backup
+					if (pNZBInfo->GetDupeScore() <= pQueuedNZBInfo->GetDupeScore())
+					{
+						// Flag saying QueueCoordinator to skip nzb-file
+						pNZBInfo->SetDeleteStatus(NZBInfo::dsDupe);
+						info("Collection %s is a duplicate to %s", pNZBInfo->GetName(), pQueuedNZBInfo->GetName());
+						return;
+					}
+
+					// if queue has a duplicate with lower score - the existing item is moved
+					// to history as dupe-backup (unless it is in post-processing stage) and
+					// the new item is added to queue (unless it is in post-processing stage)
+					if (!pQueuedNZBInfo->GetPostInfo())
+					{
+						// the existing queue item is moved to history as dupe-backup
+						info("Moving collection %s with lower duplicate score to history", pQueuedNZBInfo->GetName());
+						processedIDs.insert(pQueuedNZBInfo->GetID());
+						pQueuedNZBInfo->SetDeleteStatus(NZBInfo::dsDupe);
+						pDownloadQueue->EditEntry(pQueuedNZBInfo->GetID(),
+							DownloadQueue::eaGroupDelete, 0, NULL);
+						bDeleted = true;
+					}
 				}
 			}
 		}
@@ -321,10 +509,14 @@ void DupeCoordinator::NZBCompleted(DownloadQueue* pDownloadQueue, NZBInfo* pNZBI
 */
 void DupeCoordinator::ReturnBestDupe(DownloadQueue* pDownloadQueue, NZBInfo* pNZBInfo, const char* szNZBName, const char* szDupeKey)
 {
+	QueueDupes queueDupes;
+	HistoryDupes historyDupes;
+	FindDupes(pDownloadQueue, szNZBName, szDupeKey, 0, 0, &queueDupes, &historyDupes);
+
 	// check if history (recent or dup) has other success-duplicates or good-duplicates
 	bool bHistoryDupe = false;
 	int iHistoryScore = 0;
-	for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
+	for (HistoryDupes::iterator it = historyDupes.begin(); it != historyDupes.end(); it++)
 	{
 		HistoryInfo* pHistoryInfo = *it;
 		bool bGoodDupe = false;
@@ -366,7 +558,7 @@ void DupeCoordinator::ReturnBestDupe(DownloadQueue* pDownloadQueue, NZBInfo* pNZ
 	// check if duplicates exist in download queue
 	bool bQueueDupe = false;
 	int iQueueScore = 0;
-	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
+	for (QueueDupes::iterator it = queueDupes.begin(); it != queueDupes.end(); it++)
 	{
 		NZBInfo* pQueuedNZBInfo = *it;
 		if (pQueuedNZBInfo != pNZBInfo &&
@@ -383,7 +575,7 @@ void DupeCoordinator::ReturnBestDupe(DownloadQueue* pDownloadQueue, NZBInfo* pNZ
 	// find dupe-backup with highest score, whose score is also higher than other
 	// success-duplicates and higher than already queued items
 	HistoryInfo* pHistoryDupe = NULL;
-	for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
+	for (HistoryDupes::iterator it = historyDupes.begin(); it != historyDupes.end(); it++)
 	{
 		HistoryInfo* pHistoryInfo = *it;
 		if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb &&
@@ -468,11 +660,13 @@ void DupeCoordinator::HistoryCleanup(DownloadQueue* pDownloadQueue, HistoryInfo*
 		pMarkHistoryInfo->GetKind() == HistoryInfo::hkDup ? pMarkHistoryInfo->GetDupInfo()->GetName() :
 		NULL;
 	bool bChanged = false;
-	int index = 0;
+
+	HistoryDupes historyDupes;
+	FindDupes(pDownloadQueue, szNZBName, szDupeKey, 0, 0, NULL, &historyDupes);
 
 	// traversing in a reverse order to delete items in order they were added to history
 	// (just to produce the log-messages in a more logical order)
-	for (HistoryList::reverse_iterator it = pDownloadQueue->GetHistory()->rbegin(); it != pDownloadQueue->GetHistory()->rend(); )
+	for (HistoryDupes::reverse_iterator it = historyDupes.rbegin(); it != historyDupes.rend(); it++)
 	{
 		HistoryInfo* pHistoryInfo = *it;
 
@@ -482,16 +676,13 @@ void DupeCoordinator::HistoryCleanup(DownloadQueue* pDownloadQueue, HistoryInfo*
 			pHistoryInfo != pMarkHistoryInfo &&
 			SameNameOrKey(pHistoryInfo->GetNZBInfo()->GetName(), pHistoryInfo->GetNZBInfo()->GetDupeKey(), szNZBName, szDupeKey))
 		{
-			g_pHistoryCoordinator->HistoryHide(pDownloadQueue, pHistoryInfo, index);
-			index++;
-			it = pDownloadQueue->GetHistory()->rbegin() + index;
+			// the item is replaced in place, positions of other items don't change
+			HistoryList::reverse_iterator itHistory = std::find(pDownloadQueue->GetHistory()->rbegin(),
+				pDownloadQueue->GetHistory()->rend(), pHistoryInfo);
+			g_pHistoryCoordinator->HistoryHide(pDownloadQueue, pHistoryInfo,
+				(int)(itHistory - pDownloadQueue->GetHistory()->rbegin()));
 			bChanged = true;
 		}
-		else
-		{
-			it++;
-			index++;
-		}
 	}
 
 	if (bChanged)
@@ -505,8 +696,12 @@ DupeCoordinator::EDupeStatus DupeCoordinator::GetDupeStatus(DownloadQueue* pDown
 {
 	EDupeStatus eStatuses = dsNone;
 
+	QueueDupes queueDupes;
+	HistoryDupes historyDupes;
+	FindDupes(pDownloadQueue, szName, szDupeKey, 0, 0, &queueDupes, &historyDupes);
+
 	// find duplicates in download queue
-	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
+	for (QueueDupes::iterator it = queueDupes.begin(); it != queueDupes.end(); it++)
 	{
 		NZBInfo* pNZBInfo = *it;
 		if (SameNameOrKey(szName, szDupeKey, pNZBInfo->GetName(), pNZBInfo->GetDupeKey()))
@@ -523,7 +718,7 @@ DupeCoordinator::EDupeStatus DupeCoordinator::GetDupeStatus(DownloadQueue* pDown
 	}
 
 	// find duplicates in history
-	for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
+	for (HistoryDupes::iterator it = historyDupes.begin(); it != historyDupes.end(); it++)
 	{
 		HistoryInfo* pHistoryInfo = *it;
 
@@ -26,6 +26,8 @@
 #ifndef DUPECOORDINATOR_H
 #define DUPECOORDINATOR_H
 
+#include <vector>
+
 #include "DownloadInfo.h"
 
 class DupeCoordinator
@@ -42,11 +44,54 @@ public:
 	};
 
 private:
+	typedef std::vector<int>			Positions;
+	typedef std::vector<NZBInfo*>		QueueDupes;
+	typedef std::vector<HistoryInfo*>	HistoryDupes;
+
+	/*
+	 * Hash table mapping keys (hashes of names, dupe keys or content hashes)
+	 * to positions of items in history. Different strings may have
+	 * the same key, the found items must be checked by the caller.
+	 */
+	class DupeIndex
+	{
+	private:
+		typedef std::vector<int>			Links;
+		typedef std::vector<unsigned int>	Keys;
+
+		Links			m_Heads;
+		Links			m_Next;
+		Keys			m_Keys;
+		Links			m_Positions;
+		unsigned int	m_iMask;
+
+	public:
+		void			Clear(int iCapacity);
+		void			Add(unsigned int iKey, int iPosition);
+		void			Find(unsigned int iKey, Positions* pPositions);
+	};
+
+	DupeIndex			m_NameIndex;
+	DupeIndex			m_DupeKeyIndex;
+	DupeIndex			m_FullHashIndex;
+	DupeIndex			m_FilteredHashIndex;
+	bool				m_bIndexBuilt;
+	int					m_iIndexGeneration;
+	int					m_iIndexHistorySize;
+
+	void				UpdateIndex(DownloadQueue* pDownloadQueue);
+	void				AddToIndex(int iPosition, const char* szName, const char* szDupeKey,
+							unsigned int iFullContentHash, unsigned int iFilteredContentHash);
+	void				FindDupes(DownloadQueue* pDownloadQueue, const char* szName, const char* szDupeKey,
+							unsigned int iFullContentHash, unsigned int iFilteredContentHash,
+							QueueDupes* pQueueDupes, HistoryDupes* pHistoryDupes);
+	static unsigned int	StrHash(const char* szValue);
 	void				ReturnBestDupe(DownloadQueue* pDownloadQueue, NZBInfo* pNZBInfo, const char* szNZBName, const char* szDupeKey);
 	void				HistoryCleanup(DownloadQueue* pDownloadQueue, HistoryInfo* pMarkHistoryInfo);
 	bool				SameNameOrKey(const char* szName1, const char* szDupeKey1, const char* szName2, const char* szDupeKey2);
 
 public:
+						DupeCoordinator();
 	void				NZBCompleted(DownloadQueue* pDownloadQueue, NZBInfo* pNZBInfo);
 	void				NZBFound(DownloadQueue* pDownloadQueue, NZBInfo* pNZBInfo);
 	void				HistoryMark(DownloadQueue* pDownloadQueue, HistoryInfo* pHistoryInfo, NZBInfo::EMarkStatus eMarkStatus);
@@ -40,6 +40,7 @@
 #include <unistd.h>
 #endif
 #include <set>
+#include <vector>
 #include <algorithm>
 
 #include "nzbget.h"
@@ -58,6 +59,10 @@
 HistoryCoordinator::HistoryCoordinator()
 {
 	debug("Creating HistoryCoordinator");
+
+	m_iCheckedGeneration = -1;
+	m_tOldestTime = 0;
+	m_tArchivePruned = 0;
 }
 
 HistoryCoordinator::~HistoryCoordinator()
@@ -76,6 +81,7 @@ void HistoryCoordinator::Cleanup()
 		delete *it;
 	}
 	pDownloadQueue->GetHistory()->clear();
+	pDownloadQueue->InvalidateIndex();
 
 	DownloadQueue::Unlock();
 }
@@ -87,9 +93,22 @@ void HistoryCoordinator::IntervalCheck()
 {
 	DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
 
-	time_t tMinTime = time(NULL) - g_pOptions->GetKeepHistory() * 60*60*24;
+	time_t tCurTime = time(NULL);
+	time_t tMinTime = tCurTime - g_pOptions->GetKeepHistory() * 60*60*24;
+
+	if (m_iCheckedGeneration == DownloadQueue::GetHistoryGeneration() && m_tOldestTime >= tMinTime)
+	{
+		// history wasn't changed since last check and no items have expired yet
+		DownloadQueue::Unlock();
+		PruneArchive(tCurTime);
+		return;
+	}
+
+	ArchiveExpired(pDownloadQueue, tMinTime);
+
 	bool bChanged = false;
 	int index = 0;
+	time_t tOldestTime = tCurTime;
 
 	// traversing in a reverse order to delete items in order they were added to history
 	// (just to produce the log-messages in a more logical order)
@@ -110,7 +129,8 @@ void HistoryCoordinator::IntervalCheck()
 				pHistoryInfo->GetName(szNiceName, 1024);
 
 				pDownloadQueue->GetHistory()->erase(pDownloadQueue->GetHistory()->end() - 1 - index);
-				
+				pDownloadQueue->RemoveFromIndex(pHistoryInfo);
+
 				if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb)
 				{
 					DeleteDiskFiles(pHistoryInfo->GetNZBInfo());
@@ -125,17 +145,69 @@ void HistoryCoordinator::IntervalCheck()
 		}
 		else
 		{
+			if (pHistoryInfo->GetKind() != HistoryInfo::hkDup && pHistoryInfo->GetTime() < tOldestTime)
+			{
+				tOldestTime = pHistoryInfo->GetTime();
+			}
 			it++;
 			index++;
 		}
 	}
 
+	m_iCheckedGeneration = DownloadQueue::GetHistoryGeneration();
+	m_tOldestTime = tOldestTime;
+
 	if (bChanged)
 	{
 		pDownloadQueue->Save();
 	}
 
 	DownloadQueue::Unlock();
+
+	PruneArchive(tCurTime);
+}
+
+/*
+ * Saves expired history items into the history archive before they are
+ * hidden or removed from history.
+ */
+void HistoryCoordinator::ArchiveExpired(DownloadQueue* pDownloadQueue, time_t tMinTime)
+{
+	if (g_pOptions->GetArchiveHistory() == 0 || !g_pOptions->GetSaveQueue() || !g_pOptions->GetServerMode())
+	{
+		return;
+	}
+
+	HistoryList expired;
+	for (HistoryList::reverse_iterator it = pDownloadQueue->GetHistory()->rbegin(); it != pDownloadQueue->GetHistory()->rend(); it++)
+	{
+		HistoryInfo* pHistoryInfo = *it;
+		if (pHistoryInfo->GetKind() != HistoryInfo::hkDup && pHistoryInfo->GetTime() < tMinTime)
+		{
+			expired.push_back(pHistoryInfo);
+		}
+	}
+
+	if (!expired.empty())
+	{
+		g_pDiskState->ArchiveHistory(&expired);
+	}
+}
+
+/*
+ * Removes outdated items from the history archive, once a day.
+ */
+void HistoryCoordinator::PruneArchive(time_t tCurTime)
+{
+	if (g_pOptions->GetArchiveHistory() == 0 || !g_pOptions->GetSaveQueue() || !g_pOptions->GetServerMode() ||
+		(tCurTime - m_tArchivePruned < 60*60*24 && tCurTime >= m_tArchivePruned))
+	{
+		return;
+	}
+
+	m_tArchivePruned = tCurTime;
+	g_pDiskState->PruneHistoryArchive(tCurTime -
+		(g_pOptions->GetKeepHistory() + g_pOptions->GetArchiveHistory()) * 60*60*24);
 }
 
 void HistoryCoordinator::DeleteDiskFiles(NZBInfo* pNZBInfo)
@@ -182,16 +254,20 @@ void HistoryCoordinator::AddToHistory(DownloadQueue* pDownloadQueue, NZBInfo* pN
 		HistoryInfo* pHistoryInfo = *it;
 		if (pHistoryInfo->GetNZBInfo() == pNZBInfo)
 		{
+			pDownloadQueue->RemoveFromIndex(pHistoryInfo);
 			delete pHistoryInfo;
 			pDownloadQueue->GetHistory()->erase(it);
 			break;
 		}
 	}
 
+	// files are removed from the index together with the nzb
+	pDownloadQueue->RemoveFromIndex(pNZBInfo);
+	pDownloadQueue->GetQueue()->Remove(pNZBInfo);
 	HistoryInfo* pHistoryInfo = new HistoryInfo(pNZBInfo);
 	pHistoryInfo->SetTime(time(NULL));
 	pDownloadQueue->GetHistory()->push_front(pHistoryInfo);
-	pDownloadQueue->GetQueue()->Remove(pNZBInfo);
+	pDownloadQueue->AddToIndex(pHistoryInfo);
 
 	if (pNZBInfo->GetDeleteStatus() == NZBInfo::dsNone)
 	{
@@ -226,11 +302,24 @@ void HistoryCoordinator::AddToHistory(DownloadQueue* pDownloadQueue, NZBInfo* pN
 }
 
 void HistoryCoordinator::HistoryHide(DownloadQueue* pDownloadQueue, HistoryInfo* pHistoryInfo, int rindex)
+{
+	// replace history element
+	HistoryInfo* pNewHistoryInfo = CreateHiddenItem(pHistoryInfo);
+	(*pDownloadQueue->GetHistory())[pDownloadQueue->GetHistory()->size() - 1 - rindex] = pNewHistoryInfo;
+	pDownloadQueue->RemoveFromIndex(pHistoryInfo);
+	pDownloadQueue->AddToIndex(pNewHistoryInfo);
+	delete pHistoryInfo;
+}
+
+/*
+ * Creates a dup-item to replace a hidden history item. The downloaded files
+ * of the hidden item are deleted, the item itself is destroyed by the caller.
+ */
+HistoryInfo* HistoryCoordinator::CreateHiddenItem(HistoryInfo* pHistoryInfo)
 {
 	char szNiceName[1024];
 	pHistoryInfo->GetName(szNiceName, 1024);
 
-	// replace history element
 	DupInfo* pDupInfo = new DupInfo();
 	pDupInfo->SetID(pHistoryInfo->GetNZBInfo()->GetID());
 	pDupInfo->SetName(pHistoryInfo->GetNZBInfo()->GetName());
@@ -252,95 +341,171 @@ void HistoryCoordinator::HistoryHide(DownloadQueue* pDownloadQueue, HistoryInfo*
 
 	HistoryInfo* pNewHistoryInfo = new HistoryInfo(pDupInfo);
 	pNewHistoryInfo->SetTime(pHistoryInfo->GetTime());
-	(*pDownloadQueue->GetHistory())[pDownloadQueue->GetHistory()->size() - 1 - rindex] = pNewHistoryInfo;
 
 	DeleteDiskFiles(pHistoryInfo->GetNZBInfo());
 
-	delete pHistoryInfo;
 	info("Collection %s removed from history", szNiceName);
+
+	return pNewHistoryInfo;
 }
 
+/*
+ * Items deleted or returned from history stay in the history list until all IDs
+ * are processed, the list is then updated in one pass.
+ */
 bool HistoryCoordinator::EditList(DownloadQueue* pDownloadQueue, IDList* pIDList, DownloadQueue::EEditAction eAction, int iOffset, const char* szText)
 {
 	bool bOK = false;
+	std::set<int> processedIDs;
+	Replacements replacements;
+	std::vector<NZBInfo*> returnedNZBs;
 
 	for (IDList::iterator itID = pIDList->begin(); itID != pIDList->end(); itID++)
 	{
 		int iID = *itID;
-		for (HistoryList::iterator itHistory = pDownloadQueue->GetHistory()->begin(); itHistory != pDownloadQueue->GetHistory()->end(); itHistory++)
+		if (!processedIDs.insert(iID).second)
 		{
-			HistoryInfo* pHistoryInfo = *itHistory;
-			if (pHistoryInfo->GetID() == iID)
-			{
-				bOK = true;
+			continue;
+		}
+
+		HistoryInfo* pHistoryInfo = pDownloadQueue->FindHistoryInfo(iID);
+		if (!pHistoryInfo)
+		{
+			continue;
+		}
+
+		bOK = true;
+
+		switch (eAction)
+		{
+			case DownloadQueue::eaHistoryDelete:
+			case DownloadQueue::eaHistoryFinalDelete:
+				HistoryDelete(pDownloadQueue, pHistoryInfo, eAction == DownloadQueue::eaHistoryFinalDelete, &replacements);
+				break;
 
-				switch (eAction)
+			case DownloadQueue::eaHistoryReturn:
+			case DownloadQueue::eaHistoryProcess:
+			{
+				NZBInfo* pNZBInfo = HistoryReturn(pDownloadQueue, pHistoryInfo, eAction == DownloadQueue::eaHistoryProcess, &replacements);
+				if (pNZBInfo && eAction == DownloadQueue::eaHistoryProcess)
 				{
-					case DownloadQueue::eaHistoryDelete:
-					case DownloadQueue::eaHistoryFinalDelete:
-						HistoryDelete(pDownloadQueue, itHistory, pHistoryInfo, eAction == DownloadQueue::eaHistoryFinalDelete);
-						break;
-
-					case DownloadQueue::eaHistoryReturn:
-					case DownloadQueue::eaHistoryProcess:
-						HistoryReturn(pDownloadQueue, itHistory, pHistoryInfo, eAction == DownloadQueue::eaHistoryProcess);
-						break;
-
-					case DownloadQueue::eaHistoryRedownload:
-						HistoryRedownload(pDownloadQueue, itHistory, pHistoryInfo, false);
-						break;
-
- 					case DownloadQueue::eaHistorySetParameter:
-						bOK = HistorySetParameter(pHistoryInfo, szText);
-						break;
-
- 					case DownloadQueue::eaHistorySetCategory:
-						bOK = HistorySetCategory(pHistoryInfo, szText);
-						break;
-
- 					case DownloadQueue::eaHistorySetName:
-						bOK = HistorySetName(pHistoryInfo, szText);
-						break;
-
-					case DownloadQueue::eaHistorySetDupeKey:
-					case DownloadQueue::eaHistorySetDupeScore:
-					case DownloadQueue::eaHistorySetDupeMode:
-					case DownloadQueue::eaHistorySetDupeBackup:
-						HistorySetDupeParam(pHistoryInfo, eAction, szText);
-						break;
-
-					case DownloadQueue::eaHistoryMarkBad:
-						g_pDupeCoordinator->HistoryMark(pDownloadQueue, pHistoryInfo, NZBInfo::ksBad);
-						break;
-
-					case DownloadQueue::eaHistoryMarkGood:
-						g_pDupeCoordinator->HistoryMark(pDownloadQueue, pHistoryInfo, NZBInfo::ksGood);
-						break;
-
-					case DownloadQueue::eaHistoryMarkSuccess:
-						g_pDupeCoordinator->HistoryMark(pDownloadQueue, pHistoryInfo, NZBInfo::ksSuccess);
-						break;
-
-					default:
-						// nothing, just to avoid compiler warning
-						break;
+					returnedNZBs.push_back(pNZBInfo);
 				}
+				break;
+			}
 
+			case DownloadQueue::eaHistoryRedownload:
+			{
+				NZBInfo* pNZBInfo = HistoryRedownload(pDownloadQueue, pHistoryInfo, false, &replacements);
+				if (pNZBInfo)
+				{
+					returnedNZBs.push_back(pNZBInfo);
+				}
 				break;
 			}
+
+			case DownloadQueue::eaHistorySetParameter:
+				bOK = HistorySetParameter(pHistoryInfo, szText);
+				break;
+
+			case DownloadQueue::eaHistorySetCategory:
+				bOK = HistorySetCategory(pHistoryInfo, szText);
+				break;
+
+			case DownloadQueue::eaHistorySetName:
+				bOK = HistorySetName(pHistoryInfo, szText);
+				break;
+
+			case DownloadQueue::eaHistorySetDupeKey:
+			case DownloadQueue::eaHistorySetDupeScore:
+			case DownloadQueue::eaHistorySetDupeMode:
+			case DownloadQueue::eaHistorySetDupeBackup:
+				HistorySetDupeParam(pHistoryInfo, eAction, szText);
+				break;
+
+			case DownloadQueue::eaHistoryMarkBad:
+				g_pDupeCoordinator->HistoryMark(pDownloadQueue, pHistoryInfo, NZBInfo::ksBad);
+				break;
+
+			case DownloadQueue::eaHistoryMarkGood:
+				g_pDupeCoordinator->HistoryMark(pDownloadQueue, pHistoryInfo, NZBInfo::ksGood);
+				break;
+
+			case DownloadQueue::eaHistoryMarkSuccess:
+				g_pDupeCoordinator->HistoryMark(pDownloadQueue, pHistoryInfo, NZBInfo::ksSuccess);
+				break;
+
+			default:
+				// nothing, just to avoid compiler warning
+				break;
+		}
+	}
+
+	ApplyReplacements(pDownloadQueue, &replacements);
+
+	for (std::vector<NZBInfo*>::iterator it = returnedNZBs.begin(); it != returnedNZBs.end(); it++)
+	{
+		NZBInfo* pNZBInfo = *it;
+		if (eAction == DownloadQueue::eaHistoryProcess)
+		{
+			// start postprocessing
+			debug("Restarting postprocessing for %s", pNZBInfo->GetName());
+			g_pPrePostProcessor->NZBDownloaded(pDownloadQueue, pNZBInfo);
+		}
+		else
+		{
+			g_pPrePostProcessor->NZBAdded(pDownloadQueue, pNZBInfo);
 		}
 	}
 
 	if (bOK)
 	{
+		// edited history items must be written on next save
+		DownloadQueue::HistoryChanged();
 		pDownloadQueue->Save();
 	}
 
 	return bOK;
 }
 
-void HistoryCoordinator::HistoryDelete(DownloadQueue* pDownloadQueue, HistoryList::iterator itHistory,
-	HistoryInfo* pHistoryInfo, bool bFinal)
+/*
+ * Removes and replaces history items in one pass over the history and destroys
+ * the removed items. The removed items are already taken out of the ID index
+ * by the functions which put them into the list of replacements.
+ */
+void HistoryCoordinator::ApplyReplacements(DownloadQueue* pDownloadQueue, Replacements* pReplacements)
+{
+	if (pReplacements->empty())
+	{
+		return;
+	}
+
+	HistoryList* pHistory = pDownloadQueue->GetHistory();
+	HistoryList::iterator itOut = pHistory->begin();
+	for (HistoryList::iterator it = pHistory->begin(); it != pHistory->end(); it++)
+	{
+		Replacements::iterator itReplacement = pReplacements->find(*it);
+		if (itReplacement == pReplacements->end())
+		{
+			*itOut++ = *it;
+		}
+		else if (itReplacement->second)
+		{
+			*itOut++ = itReplacement->second;
+			pDownloadQueue->AddToIndex(itReplacement->second);
+		}
+	}
+	pHistory->erase(itOut, pHistory->end());
+
+	for (Replacements::iterator it = pReplacements->begin(); it != pReplacements->end(); it++)
+	{
+		delete it->first;
+	}
+	pReplacements->clear();
+}
+
+void HistoryCoordinator::HistoryDelete(DownloadQueue* pDownloadQueue, HistoryInfo* pHistoryInfo, bool bFinal,
+	Replacements* pReplacements)
 {
 	char szNiceName[1024];
 	pHistoryInfo->GetName(szNiceName, 1024);
@@ -369,21 +534,25 @@ void HistoryCoordinator::HistoryDelete(DownloadQueue* pDownloadQueue, HistoryLis
 
 	if (bFinal || !g_pOptions->GetDupeCheck() || pHistoryInfo->GetKind() == HistoryInfo::hkUrl)
 	{
-		pDownloadQueue->GetHistory()->erase(itHistory);
-		delete pHistoryInfo;
+		pDownloadQueue->RemoveFromIndex(pHistoryInfo);
+		(*pReplacements)[pHistoryInfo] = NULL;
 	}
 	else
 	{
 		if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb)
 		{
 			// replace history element
-			int rindex = pDownloadQueue->GetHistory()->size() - 1 - (itHistory - pDownloadQueue->GetHistory()->begin());
-			HistoryHide(pDownloadQueue, pHistoryInfo, rindex);
+			pDownloadQueue->RemoveFromIndex(pHistoryInfo);
+			(*pReplacements)[pHistoryInfo] = CreateHiddenItem(pHistoryInfo);
 		}
 	}
 }
 
-void HistoryCoordinator::HistoryReturn(DownloadQueue* pDownloadQueue, HistoryList::iterator itHistory, HistoryInfo* pHistoryInfo, bool bReprocess)
+/*
+ * Returns the nzb-item moved back to download queue or NULL.
+ */
+NZBInfo* HistoryCoordinator::HistoryReturn(DownloadQueue* pDownloadQueue, HistoryInfo* pHistoryInfo, bool bReprocess,
+	Replacements* pReplacements)
 {
 	char szNiceName[1024];
 	pHistoryInfo->GetName(szNiceName, 1024);
@@ -393,7 +562,7 @@ void HistoryCoordinator::HistoryReturn(DownloadQueue* pDownloadQueue, HistoryLis
 	if (bReprocess && pHistoryInfo->GetKind() != HistoryInfo::hkNzb)
 	{
 		error("Could not restart postprocessing for %s: history item has wrong type", szNiceName);
-		return;
+		return NULL;
 	}
 
 	if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb)
@@ -412,10 +581,13 @@ void HistoryCoordinator::HistoryReturn(DownloadQueue* pDownloadQueue, HistoryLis
 		if (!(bUnparked || bReprocess))
 		{
 			warn("Could not return %s back from history to download queue: history item does not have any files left for download", szNiceName);
-			return;
+			return NULL;
 		}
 
+		// the ID of the history item isn't available after discarding its nzb
+		pDownloadQueue->RemoveFromIndex(pHistoryInfo);
 		pDownloadQueue->GetQueue()->push_front(pNZBInfo);
+		pDownloadQueue->AddToIndex(pNZBInfo);
 		pHistoryInfo->DiscardNZBInfo();
 
 		// reset postprocessing status variables
@@ -452,33 +624,32 @@ void HistoryCoordinator::HistoryReturn(DownloadQueue* pDownloadQueue, HistoryLis
 	if (pHistoryInfo->GetKind() == HistoryInfo::hkUrl)
 	{
 		pNZBInfo = pHistoryInfo->GetNZBInfo();
+		pDownloadQueue->RemoveFromIndex(pHistoryInfo);
 		pHistoryInfo->DiscardNZBInfo();
 		pNZBInfo->SetUrlStatus(NZBInfo::lsNone);
 		pNZBInfo->SetDeleteStatus(NZBInfo::dsNone);
 		pDownloadQueue->GetQueue()->push_front(pNZBInfo);
+		pDownloadQueue->AddToIndex(pNZBInfo);
 	}
 
-	pDownloadQueue->GetHistory()->erase(itHistory);
-	// the object "pHistoryInfo" is released few lines later, after the call to "NZBDownloaded"
+	// the history item is removed by the caller, postprocessing is restarted after that
+	(*pReplacements)[pHistoryInfo] = NULL;
 	pNZBInfo->PrintMessage(Message::mkInfo, "%s returned from history back to download queue", szNiceName);
 
-	if (bReprocess)
-	{
-		// start postprocessing
-		debug("Restarting postprocessing for %s", szNiceName);
-		g_pPrePostProcessor->NZBDownloaded(pDownloadQueue, pNZBInfo);
-	}
-
-	delete pHistoryInfo;
+	return pNZBInfo;
 }
 
-void HistoryCoordinator::HistoryRedownload(DownloadQueue* pDownloadQueue, HistoryList::iterator itHistory,
-	HistoryInfo* pHistoryInfo, bool bRestorePauseState)
+/*
+ * Returns the nzb-item moved back to download queue, the caller must report it
+ * as added after removing the history item. For URLs returns NULL.
+ */
+NZBInfo* HistoryCoordinator::HistoryRedownload(DownloadQueue* pDownloadQueue, HistoryInfo* pHistoryInfo,
+	bool bRestorePauseState, Replacements* pReplacements)
 {
 	if (pHistoryInfo->GetKind() == HistoryInfo::hkUrl)
 	{
-		HistoryReturn(pDownloadQueue, itHistory, pHistoryInfo, false);
-		return;
+		HistoryReturn(pDownloadQueue, pHistoryInfo, false, pReplacements);
+		return NULL;
 	}
 
 	if (pHistoryInfo->GetKind() != HistoryInfo::hkNzb)
@@ -486,7 +657,7 @@ void HistoryCoordinator::HistoryRedownload(DownloadQueue* pDownloadQueue, Histor
 		char szNiceName[1024];
 		pHistoryInfo->GetName(szNiceName, 1024);
 		error("Could not return %s from history back to queue: history item has wrong type", szNiceName);
-		return;
+		return NULL;
 	}
 
 	NZBInfo* pNZBInfo = pHistoryInfo->GetNZBInfo();
@@ -496,7 +667,7 @@ void HistoryCoordinator::HistoryRedownload(DownloadQueue* pDownloadQueue, Histor
 	{
 		error("Could not return %s from history back to queue: could not find source nzb-file %s",
 			pNZBInfo->GetName(), pNZBInfo->GetQueuedFilename());
-		return;
+		return NULL;
 	}
 
 	NZBFile* pNZBFile = NZBFile::Create(pNZBInfo->GetQueuedFilename(), "");
@@ -504,7 +675,7 @@ void HistoryCoordinator::HistoryRedownload(DownloadQueue* pDownloadQueue, Histor
 	{
 		error("Could not return %s from history back to queue: could not parse nzb-file",
 			pNZBInfo->GetName());
-		return;
+		return NULL;
 	}
 
 	info("Returning %s from history back to queue", pNZBInfo->GetName());
@@ -558,9 +729,9 @@ void HistoryCoordinator::HistoryRedownload(DownloadQueue* pDownloadQueue, Histor
 	g_pQueueCoordinator->CheckDupeFileInfos(pNZBInfo);
 	delete pNZBFile;
 
-	HistoryReturn(pDownloadQueue, itHistory, pHistoryInfo, false);
+	HistoryReturn(pDownloadQueue, pHistoryInfo, false, pReplacements);
 
-	g_pPrePostProcessor->NZBAdded(pDownloadQueue, pNZBInfo);
+	return pNZBInfo;
 }
 
 bool HistoryCoordinator::HistorySetParameter(HistoryInfo* pHistoryInfo, const char* szText)
@@ -583,6 +754,7 @@ bool HistoryCoordinator::HistorySetParameter(HistoryInfo* pHistoryInfo, const ch
 		*szValue = '\0';
 		szValue++;
 		pHistoryInfo->GetNZBInfo()->GetParameters()->SetParameter(szStr, szValue);
+		pHistoryInfo->GetNZBInfo()->SetChanged(true);
 	}
 	else
 	{
@@ -729,7 +901,11 @@ void HistoryCoordinator::HistorySetDupeParam(HistoryInfo* pHistoryInfo, Download
 
 void HistoryCoordinator::Redownload(DownloadQueue* pDownloadQueue, HistoryInfo* pHistoryInfo)
 {
-	HistoryList::iterator it = std::find(pDownloadQueue->GetHistory()->begin(),
-		pDownloadQueue->GetHistory()->end(), pHistoryInfo);
-	HistoryRedownload(pDownloadQueue, it, pHistoryInfo, true);
+	Replacements replacements;
+	NZBInfo* pNZBInfo = HistoryRedownload(pDownloadQueue, pHistoryInfo, true, &replacements);
+	ApplyReplacements(pDownloadQueue, &replacements);
+	if (pNZBInfo)
+	{
+		g_pPrePostProcessor->NZBAdded(pDownloadQueue, pNZBInfo);
+	}
 }
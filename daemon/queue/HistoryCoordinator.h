@@ -26,20 +26,33 @@
 #ifndef HISTORYCOORDINATOR_H
 #define HISTORYCOORDINATOR_H
 
+#include <map>
+
 #include "DownloadInfo.h"
 
 class HistoryCoordinator
 {
 private:
-	void				HistoryDelete(DownloadQueue* pDownloadQueue, HistoryList::iterator itHistory, HistoryInfo* pHistoryInfo, bool bFinal);
-	void				HistoryReturn(DownloadQueue* pDownloadQueue, HistoryList::iterator itHistory, HistoryInfo* pHistoryInfo, bool bReprocess);
-	void				HistoryRedownload(DownloadQueue* pDownloadQueue, HistoryList::iterator itHistory, HistoryInfo* pHistoryInfo, bool bRestorePauseState);
+	// removed history items and items taking their places (NULL if an item is just removed)
+	typedef std::map<HistoryInfo*, HistoryInfo*> Replacements;
+
+	int					m_iCheckedGeneration;
+	time_t				m_tOldestTime;
+	time_t				m_tArchivePruned;
+
+	void				ApplyReplacements(DownloadQueue* pDownloadQueue, Replacements* pReplacements);
+	HistoryInfo*		CreateHiddenItem(HistoryInfo* pHistoryInfo);
+	void				HistoryDelete(DownloadQueue* pDownloadQueue, HistoryInfo* pHistoryInfo, bool bFinal, Replacements* pReplacements);
+	NZBInfo*			HistoryReturn(DownloadQueue* pDownloadQueue, HistoryInfo* pHistoryInfo, bool bReprocess, Replacements* pReplacements);
+	NZBInfo*			HistoryRedownload(DownloadQueue* pDownloadQueue, HistoryInfo* pHistoryInfo, bool bRestorePauseState, Replacements* pReplacements);
 	bool				HistorySetParameter(HistoryInfo* pHistoryInfo, const char* szText);
 	void				HistorySetDupeParam(HistoryInfo* pHistoryInfo, DownloadQueue::EEditAction eAction, const char* szText);
 	bool				HistorySetCategory(HistoryInfo* pHistoryInfo, const char* szText);
 	bool				HistorySetName(HistoryInfo* pHistoryInfo, const char* szText);
 	void				HistoryTransformToDup(DownloadQueue* pDownloadQueue, HistoryInfo* pHistoryInfo, int rindex);
 	void				SaveQueue(DownloadQueue* pDownloadQueue);
+	void				ArchiveExpired(DownloadQueue* pDownloadQueue, time_t tMinTime);
+	void				PruneArchive(time_t tCurTime);
 
 public:
 						HistoryCoordinator();
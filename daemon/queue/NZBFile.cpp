@@ -34,6 +34,7 @@
 
 #include <string.h>
 #include <list>
+#include <algorithm>
 #include <ctype.h>
 #ifdef WIN32
 #include <comutil.h>
@@ -65,13 +66,22 @@ NZBFile::NZBFile(const char* szFileName, const char* szCategory)
 	m_pNZBInfo->SetCategory(szCategory);
 	m_pNZBInfo->BuildDestDirName();
 
-#ifndef WIN32
 	m_bPassword = false;
 	m_pFileInfo = NULL;
 	m_pArticle = NULL;
 	m_szTagContent = NULL;
 	m_iTagContentLen = 0;
-#endif
+	m_iTagContentSize = 0;
+	m_pStream = NULL;
+	m_szSourceBuffer = NULL;
+	m_iSourceSize = 0;
+	m_iSourcePos = 0;
+	m_pBuffer = NULL;
+	m_iBufferSize = 0;
+	m_iBufferLen = 0;
+	m_bStreamEnd = false;
+	m_bRootClosed = false;
+	m_szElementPath[0] = '\0';
 }
 
 NZBFile::~NZBFile()
@@ -82,10 +92,9 @@ NZBFile::~NZBFile()
     free(m_szFileName);
     free(m_szPassword);
 
-#ifndef WIN32
 	delete m_pFileInfo;
 	free(m_szTagContent);
-#endif
+	free(m_pBuffer);
 
 	delete m_pNZBInfo;
 }
@@ -98,14 +107,14 @@ void NZBFile::LogDebugInfo()
 void NZBFile::AddArticle(FileInfo* pFileInfo, ArticleInfo* pArticleInfo)
 {
 	// make Article-List big enough
-	while ((int)pFileInfo->GetArticles()->size() < pArticleInfo->GetPartNumber())
-		pFileInfo->GetArticles()->push_back(NULL);
-
-	int index = pArticleInfo->GetPartNumber() - 1;
-	if ((*pFileInfo->GetArticles())[index])
+	if ((int)pFileInfo->GetArticles()->size() < pArticleInfo->GetPartNumber())
 	{
-		delete (*pFileInfo->GetArticles())[index];
+		pFileInfo->GetArticles()->resize(pArticleInfo->GetPartNumber(), NULL);
 	}
+
+	// a duplicate article replaces the previous one, which stays in the article pool
+	// of the file until the articles are cleared
+	int index = pArticleInfo->GetPartNumber() - 1;
 	(*pFileInfo->GetArticles())[index] = pArticleInfo;
 }
 
@@ -120,14 +129,12 @@ void NZBFile::AddFileInfo(FileInfo* pFileInfo)
 	int iMissedArticles = 0;
 	FileInfo::Articles* pArticles = pFileInfo->GetArticles();
 	int iTotalArticles = (int)pArticles->size();
-	int i = 0;
-	for (FileInfo::Articles::iterator it = pArticles->begin(); it != pArticles->end(); )
+	FileInfo::Articles::iterator itOut = pArticles->begin();
+	for (FileInfo::Articles::iterator it = pArticles->begin(); it != pArticles->end(); it++)
 	{
 		ArticleInfo* pArticle = *it;
 		if (!pArticle)
 		{
-			pArticles->erase(it);
-			it = pArticles->begin() + i;
 			iMissedArticles++;
 			if (lOneSize > 0)
 			{
@@ -145,10 +152,10 @@ void NZBFile::AddFileInfo(FileInfo* pFileInfo)
 			{
 				lOneSize = pArticle->GetSize();
 			}
-			it++;
-			i++;
+			*itOut++ = pArticle;
 		}
 	}
+	pArticles->erase(itOut, pArticles->end());
 
 	if (pArticles->empty())
 	{
@@ -199,11 +206,13 @@ void NZBFile::ParseSubject(FileInfo* pFileInfo, bool TryQuotes)
 	// marks as non separatable token delimiters.
 	// then take the last token containing dot (".") as a filename
 
-	typedef std::list<char*> TokenList;
-	TokenList tokens;
-	tokens.clear();
+	const char* szBestToken = NULL;
+	int iBestLen = 0;
+	const char* szLastToken = NULL;
+	int iLastLen = 0;
 
-	// tokenizing
+	// tokenizing, the best candidate for being a filename is
+	// the last token containing a dot, which is not the last character
 	char* p = (char*)pFileInfo->GetSubject();
 	char* start = p;
 	bool quot = false;
@@ -217,10 +226,14 @@ void NZBFile::ParseSubject(FileInfo* pFileInfo, bool TryQuotes)
 			int len = (int)(p - start);
 			if (len > 0)
 			{
-				char* token = (char*)malloc(len + 1);
-				strncpy(token, start, len);
-				token[len] = '\0';
-				tokens.push_back(token);
+				szLastToken = start;
+				iLastLen = len;
+				const char* point = (const char*)memchr(start, '.', len);
+				if (point && point < start + len - 1)
+				{
+					szBestToken = start;
+					iBestLen = len;
+				}
 			}
 			start = p;
 			if (ch != '\"' || quot)
@@ -249,27 +262,18 @@ void NZBFile::ParseSubject(FileInfo* pFileInfo, bool TryQuotes)
 		p++;
 	}
 
-	if (!tokens.empty())
+	if (szLastToken)
 	{
-		// finding the best candidate for being a filename
-		char* besttoken = tokens.back();
-		for (TokenList::reverse_iterator it = tokens.rbegin(); it != tokens.rend(); it++)
+		if (!szBestToken)
 		{
-			char* s = *it;
-			char* p = strchr(s, '.');
-			if (p && (p[1] != '\0'))
-			{
-				besttoken = s;
-				break;
-			}
-		}
-		pFileInfo->SetFilename(besttoken);
-
-		// free mem
-		for (TokenList::iterator it = tokens.begin(); it != tokens.end(); it++)
-		{
-			free(*it);
+			szBestToken = szLastToken;
+			iBestLen = iLastLen;
 		}
+		char* filename = (char*)malloc(iBestLen + 1);
+		memcpy(filename, szBestToken, iBestLen);
+		filename[iBestLen] = '\0';
+		pFileInfo->SetFilename(filename);
+		free(filename);
 	}
 	else
 	{
@@ -492,197 +496,604 @@ void NZBFile::ReadPassword()
 	free(buf);
 }
 
-#ifdef WIN32
-NZBFile* NZBFile::Create(const char* szFileName, const char* szCategory)
+/*
+ * The streaming parser is used first. Files it can't handle (unsupported XML
+ * constructs, other encodings than UTF-8, malformed files) are parsed with
+ * the XML parser, which also reports errors.
+ */
+NZBFile* NZBFile::Create(const char* szFileName, const char* szCategory, bool bXmlParser)
 {
-    CoInitialize(NULL);
+	NZBFile* pFile = new NZBFile(szFileName, szCategory);
 
-	HRESULT hr;
+	if (!pFile->Load(bXmlParser))
+	{
+		delete pFile;
+		return NULL;
+	}
 
-	MSXML::IXMLDOMDocumentPtr doc;
-	hr = doc.CreateInstance(MSXML::CLSID_DOMDocument);
-    if (FAILED(hr))
-    {
-        return NULL;
-    }
+	return pFile;
+}
 
-    // Load the XML document file...
-	doc->put_resolveExternals(VARIANT_FALSE);
-	doc->put_validateOnParse(VARIANT_FALSE);
-	doc->put_async(VARIANT_FALSE);
+/*
+ * Parses nzb-file content from memory. The file name is used to build the
+ * name of nzb and in error messages; the file doesn't need to exist.
+ */
+NZBFile* NZBFile::CreateFromBuffer(const char* szBuffer, int iBufSize, const char* szFileName,
+	const char* szCategory, bool bXmlParser)
+{
+	NZBFile* pFile = new NZBFile(szFileName, szCategory);
+	pFile->m_szSourceBuffer = szBuffer;
+	pFile->m_iSourceSize = iBufSize;
 
-	// filename needs to be properly encoded
-	char* szURL = (char*)malloc(strlen(szFileName)*3 + 1);
-	EncodeURL(szFileName, szURL);
-	debug("url=\"%s\"", szURL);
-	_variant_t v(szURL);
-	free(szURL);
+	bool bOK = pFile->Load(bXmlParser);
+	pFile->m_szSourceBuffer = NULL;
 
-	VARIANT_BOOL success = doc->load(v);
-	if (success == VARIANT_FALSE)
+	if (!bOK)
 	{
-		_bstr_t r(doc->GetparseError()->reason);
-		const char* szErrMsg = r;
-		error("Error parsing nzb-file %s: %s", Util::BaseFileName(szFileName), szErrMsg);
+		delete pFile;
 		return NULL;
 	}
 
-    NZBFile* pFile = new NZBFile(szFileName, szCategory);
+	return pFile;
+}
 
-    if (!pFile->ParseNZB(doc))
+bool NZBFile::Load(bool bXmlParser)
+{
+	if (bXmlParser || !ParseStream())
 	{
-		delete pFile;
-		return NULL;
+		m_pNZBInfo->GetFileList()->Clear();
+		delete m_pFileInfo;
+		m_pFileInfo = NULL;
+		m_pArticle = NULL;
+		free(m_szPassword);
+		m_szPassword = NULL;
+		m_bPassword = false;
+		m_iTagContentLen = 0;
+
+		if (!ParseXml())
+		{
+			return false;
+		}
 	}
 
-	if (pFile->GetNZBInfo()->GetFileList()->empty())
+	if (m_pNZBInfo->GetFileList()->empty())
 	{
-		error("Error parsing nzb-file %s: file has no content", Util::BaseFileName(szFileName));
-		delete pFile;
-		return NULL;
+		error("Error parsing nzb-file %s: file has no content", Util::BaseFileName(m_szFileName));
+		return false;
 	}
 
-	pFile->ProcessFiles();
+	ProcessFiles();
 
-    return pFile;
+	return true;
 }
 
-void NZBFile::EncodeURL(const char* szFilename, char* szURL)
+static inline bool IsXmlSpace(char ch)
 {
-	while (char ch = *szFilename++)
+	return ch == ' ' || ch == 10 || ch == 13 || ch == 9;
+}
+
+/*
+ * Returns the position after the terminator or "0" if it isn't in the buffer yet.
+ */
+static int FindTerminator(const char* szBuf, int iLen, int iFrom, const char* szTerminator)
+{
+	int iTermLen = strlen(szTerminator);
+	for (int i = iFrom; i <= iLen - iTermLen; i++)
 	{
-		if (('0' <= ch && ch <= '9') ||
-			('a' <= ch && ch <= 'z') ||
-			('A' <= ch && ch <= 'Z') )
+		const char* p = (const char*)memchr(szBuf + i, szTerminator[0], iLen - iTermLen - i + 1);
+		if (!p)
 		{
-			*szURL++ = ch;
+			break;
 		}
-		else
+		i = (int)(p - szBuf);
+		if (!strncmp(p, szTerminator, iTermLen))
 		{
-			*szURL++ = '%';
-			int a = (unsigned char)ch >> 4;
-			*szURL++ = a > 9 ? a - 10 + 'a' : a + '0';
-			a = ch & 0xF;
-			*szURL++ = a > 9 ? a - 10 + 'a' : a + '0';
+			return i + iTermLen;
 		}
 	}
-	*szURL = NULL;
+	return 0;
 }
 
-bool NZBFile::ParseNZB(IUnknown* nzb)
+/*
+ * Single pass parser for nzb-files. The file is read in chunks, elements are
+ * passed directly to Parse_StartElement/Parse_EndElement without copying of
+ * names and attributes. Only the subset of XML used in nzb-files is supported;
+ * returns false for anything else.
+ */
+bool NZBFile::ParseStream()
 {
-	MSXML::IXMLDOMDocumentPtr doc = nzb;
-	MSXML::IXMLDOMNodePtr root = doc->documentElement;
+	if (m_szSourceBuffer)
+	{
+		m_iSourcePos = 0;
+	}
+	else
+	{
+		m_pStream = fopen(m_szFileName, FOPEN_RB);
+		if (!m_pStream)
+		{
+			return false;
+		}
+	}
 
-	MSXML::IXMLDOMNodePtr node = root->selectSingleNode("/nzb/head/meta[@type='password']");
-	if (node)
+	m_iBufferSize = 256 * 1024;
+	m_pBuffer = (char*)malloc(m_iBufferSize);
+	m_iBufferLen = 0;
+	m_bStreamEnd = false;
+	m_bRootClosed = false;
+	m_szElementPath[0] = '\0';
+
+	int iPos = 0;
+	bool bOK = ReadStream(&iPos);
+
+	// skip UTF-8 byte order mark
+	if (m_iBufferLen >= 3 && !strncmp(m_pBuffer, "\xEF\xBB\xBF", 3))
 	{
-		_bstr_t password(node->Gettext());
-		m_szPassword = strdup(password);
+		iPos = 3;
 	}
 
-	MSXML::IXMLDOMNodeListPtr fileList = root->selectNodes("/nzb/file");
-	for (int i = 0; i < fileList->Getlength(); i++)
+	while (bOK)
 	{
-		node = fileList->Getitem(i);
-		MSXML::IXMLDOMNodePtr attribute = node->Getattributes()->getNamedItem("subject");
-		if (!attribute) return false;
-		_bstr_t subject(attribute->Gettext());
-        FileInfo* pFileInfo = new FileInfo();
-		pFileInfo->SetSubject(subject);
+		if (iPos == m_iBufferLen)
+		{
+			if (m_bStreamEnd)
+			{
+				break;
+			}
+			bOK = ReadStream(&iPos);
+			continue;
+		}
 
-		attribute = node->Getattributes()->getNamedItem("date");
-		if (attribute)
+		char* szStart = m_pBuffer + iPos;
+		int iAvail = m_iBufferLen - iPos;
+
+		if (*szStart == '<')
 		{
-			_bstr_t date(attribute->Gettext());
-			pFileInfo->SetTime(atoi(date));
+			int iLen = FindMarkupEnd(szStart, iAvail);
+			if (iLen == 0)
+			{
+				bOK = !m_bStreamEnd && ReadStream(&iPos);
+				continue;
+			}
+			bOK = iLen > 0 && ParseMarkup(szStart, iLen);
+			iPos += iLen;
 		}
+		else
+		{
+			char* szEnd = (char*)memchr(szStart, '<', iAvail);
+			if (!szEnd && !m_bStreamEnd)
+			{
+				bOK = ReadStream(&iPos);
+				continue;
+			}
+			int iLen = szEnd ? (int)(szEnd - szStart) : iAvail;
+			bOK = ParseText(szStart, iLen, true);
+			iPos += iLen;
+		}
+	}
 
-		MSXML::IXMLDOMNodeListPtr groupList = node->selectNodes("groups/group");
-		for (int g = 0; g < groupList->Getlength(); g++)
+	if (m_pStream)
+	{
+		fclose(m_pStream);
+		m_pStream = NULL;
+	}
+	free(m_pBuffer);
+	m_pBuffer = NULL;
+
+	return bOK && m_bRootClosed;
+}
+
+/*
+ * Moves unprocessed data to the beginning of the buffer and reads the next chunk.
+ */
+bool NZBFile::ReadStream(int* pPos)
+{
+	int iKeep = m_iBufferLen - *pPos;
+	if (*pPos > 0)
+	{
+		memmove(m_pBuffer, m_pBuffer + *pPos, iKeep);
+	}
+	m_iBufferLen = iKeep;
+	*pPos = 0;
+
+	if (m_iBufferLen == m_iBufferSize)
+	{
+		// a single tag or text doesn't fit into the buffer
+		if (m_iBufferSize >= 64 * 1024 * 1024)
 		{
-			MSXML::IXMLDOMNodePtr node = groupList->Getitem(g);
-			_bstr_t group = node->Gettext();
-			pFileInfo->GetGroups()->push_back(strdup((const char*)group));
+			return false;
 		}
+		m_iBufferSize *= 2;
+		m_pBuffer = (char*)realloc(m_pBuffer, m_iBufferSize);
+	}
 
-		MSXML::IXMLDOMNodeListPtr segmentList = node->selectNodes("segments/segment");
-		for (int g = 0; g < segmentList->Getlength(); g++)
+	if (m_szSourceBuffer)
+	{
+		int iRead = m_iSourceSize - m_iSourcePos;
+		if (iRead > m_iBufferSize - m_iBufferLen)
 		{
-			MSXML::IXMLDOMNodePtr node = segmentList->Getitem(g);
-			_bstr_t id = node->Gettext();
-            char szId[2048];
-            snprintf(szId, 2048, "<%s>", (const char*)id);
+			iRead = m_iBufferSize - m_iBufferLen;
+		}
+		memcpy(m_pBuffer + m_iBufferLen, m_szSourceBuffer + m_iSourcePos, iRead);
+		m_iSourcePos += iRead;
+		m_iBufferLen += iRead;
+		m_bStreamEnd = iRead == 0;
+		return true;
+	}
 
-			MSXML::IXMLDOMNodePtr attribute = node->Getattributes()->getNamedItem("number");
-			if (!attribute) return false;
-			_bstr_t number(attribute->Gettext());
+	int iRead = (int)fread(m_pBuffer + m_iBufferLen, 1, m_iBufferSize - m_iBufferLen, m_pStream);
+	m_iBufferLen += iRead;
+	m_bStreamEnd = iRead == 0;
 
-			attribute = node->Getattributes()->getNamedItem("bytes");
-			if (!attribute) return false;
-			_bstr_t bytes(attribute->Gettext());
+	return !ferror(m_pStream);
+}
 
-			int partNumber = atoi(number);
-			int lsize = atoi(bytes);
+/*
+ * Returns the length of markup (tag, comment, etc.), "0" if the markup is
+ * incomplete or "-1" if it isn't supported.
+ */
+int NZBFile::FindMarkupEnd(const char* szMarkup, int iLen)
+{
+	if (iLen < 2)
+	{
+		return 0;
+	}
 
-			if (partNumber > 0)
+	if (szMarkup[1] == '?')
+	{
+		return FindTerminator(szMarkup, iLen, 2, "?>");
+	}
+
+	if (szMarkup[1] == '!')
+	{
+		if (iLen < 4)
+		{
+			return 0;
+		}
+		if (!strncmp(szMarkup, "<!--", 4))
+		{
+			return FindTerminator(szMarkup, iLen, 4, "-->");
+		}
+		if (iLen < 9)
+		{
+			return 0;
+		}
+		if (!strncmp(szMarkup, "<![CDATA[", 9))
+		{
+			return FindTerminator(szMarkup, iLen, 9, "]]>");
+		}
+		if (strncmp(szMarkup, "<!DOCTYPE", 9))
+		{
+			return -1;
+		}
+	}
+
+	const char* szEnd = szMarkup + iLen;
+	for (const char* p = szMarkup + 1; p < szEnd; p++)
+	{
+		char ch = *p;
+		if (ch == '"' || ch == '\'')
+		{
+			// skip quoted value
+			p = (const char*)memchr(p + 1, ch, szEnd - p - 1);
+			if (!p)
 			{
-				ArticleInfo* pArticle = new ArticleInfo();
-				pArticle->SetPartNumber(partNumber);
-				pArticle->SetMessageID(szId);
-				pArticle->SetSize(lsize);
-				AddArticle(pFileInfo, pArticle);
+				return 0;
 			}
 		}
+		else if (ch == '>')
+		{
+			return (int)(p - szMarkup) + 1;
+		}
+		else if (ch == '<' || ch == '[')
+		{
+			// DTD internal subset or malformed tag
+			return -1;
+		}
+	}
 
-		AddFileInfo(pFileInfo);
+	return 0;
+}
+
+bool NZBFile::ParseMarkup(char* szMarkup, int iLen)
+{
+	if (szMarkup[1] == '?')
+	{
+		if (strncmp(szMarkup, "<?xml", 5) || !IsXmlSpace(szMarkup[5]))
+		{
+			// processing instruction
+			return true;
+		}
+
+		// XML declaration: only UTF-8 is supported
+		szMarkup[iLen - 2] = '\0';
+		char* szEncoding = strstr(szMarkup, "encoding");
+		if (!szEncoding)
+		{
+			return true;
+		}
+		szEncoding += 8;
+		while (IsXmlSpace(*szEncoding) || *szEncoding == '=') szEncoding++;
+		char chQuote = *szEncoding++;
+		char* szEnd = strchr(szEncoding, chQuote);
+		if ((chQuote != '"' && chQuote != '\'') || !szEnd)
+		{
+			return false;
+		}
+		*szEnd = '\0';
+		return !strcasecmp(szEncoding, "utf-8") || !strcasecmp(szEncoding, "us-ascii");
 	}
-	return true;
+
+	if (szMarkup[1] == '!')
+	{
+		if (szMarkup[2] == '[')
+		{
+			// CDATA
+			return m_szElementPath[0] && ParseText(szMarkup + 9, iLen - 12, false);
+		}
+		if (szMarkup[2] == 'D')
+		{
+			// DOCTYPE (without internal subset)
+			return !m_szElementPath[0] && !m_bRootClosed;
+		}
+		// comment
+		return true;
+	}
+
+	szMarkup[iLen - 1] = '\0';
+
+	if (szMarkup[1] == '/')
+	{
+		char* szName = szMarkup + 2;
+		for (char* p = szMarkup + iLen - 2; p >= szName && IsXmlSpace(*p); p--) *p = '\0';
+		return ParseEndTag(szName);
+	}
+
+	return ParseStartTag(szMarkup + 1, iLen - 2);
 }
 
-#else
+bool NZBFile::ParseStartTag(char* szTag, int iLen)
+{
+	bool bEmptyElement = iLen > 0 && szTag[iLen - 1] == '/';
+	if (bEmptyElement)
+	{
+		szTag[--iLen] = '\0';
+	}
+
+	char* p = szTag;
+	while (*p && !IsXmlSpace(*p)) p++;
+	int iNameLen = (int)(p - szTag);
+	if (iNameLen == 0 || (m_bRootClosed && !m_szElementPath[0]))
+	{
+		return false;
+	}
+	if (*p)
+	{
+		*p++ = '\0';
+	}
+
+	const int MAX_ATTRS = 32;
+	const char* atts[MAX_ATTRS * 2 + 1];
+	int iAttrCount = 0;
+	while (true)
+	{
+		while (IsXmlSpace(*p)) p++;
+		if (!*p)
+		{
+			break;
+		}
+
+		char* szAttrName = p;
+		while (*p && *p != '=' && !IsXmlSpace(*p)) p++;
+		char* szAttrNameEnd = p;
+		while (IsXmlSpace(*p)) p++;
+		if (*p != '=' || szAttrNameEnd == szAttrName || iAttrCount == MAX_ATTRS)
+		{
+			return false;
+		}
+		p++;
+		*szAttrNameEnd = '\0';
+		while (IsXmlSpace(*p)) p++;
+
+		char chQuote = *p++;
+		char* szValue = p;
+		char* szValueEnd = (chQuote == '"' || chQuote == '\'') ? strchr(szValue, chQuote) : NULL;
+		if (!szValueEnd || memchr(szValue, '<', szValueEnd - szValue))
+		{
+			return false;
+		}
+		p = szValueEnd + 1;
+		if (*p && !IsXmlSpace(*p))
+		{
+			return false;
+		}
 
-NZBFile* NZBFile::Create(const char* szFileName, const char* szCategory)
+		int iValueLen = DecodeText(szValue, (int)(szValueEnd - szValue), true);
+		if (iValueLen < 0)
+		{
+			return false;
+		}
+		szValue[iValueLen] = '\0';
+
+		atts[iAttrCount * 2] = szAttrName;
+		atts[iAttrCount * 2 + 1] = szValue;
+		iAttrCount++;
+	}
+	atts[iAttrCount * 2] = NULL;
+
+	int iPathLen = strlen(m_szElementPath);
+	if (iPathLen + iNameLen + 2 > (int)sizeof(m_szElementPath))
+	{
+		return false;
+	}
+	m_szElementPath[iPathLen] = '/';
+	strcpy(m_szElementPath + iPathLen + 1, szTag);
+
+	Parse_StartElement(szTag, iAttrCount > 0 ? atts : NULL);
+
+	return !bEmptyElement || ParseEndTag(szTag);
+}
+
+bool NZBFile::ParseEndTag(char* szName)
 {
-    NZBFile* pFile = new NZBFile(szFileName, szCategory);
+	char* szLast = strrchr(m_szElementPath, '/');
+	if (!szLast || strcmp(szLast + 1, szName))
+	{
+		return false;
+	}
+	*szLast = '\0';
+	m_bRootClosed = !m_szElementPath[0];
 
-	xmlSAXHandler SAX_handler = {0};
-	SAX_handler.startElement = reinterpret_cast<startElementSAXFunc>(SAX_StartElement);
-	SAX_handler.endElement = reinterpret_cast<endElementSAXFunc>(SAX_EndElement);
-	SAX_handler.characters = reinterpret_cast<charactersSAXFunc>(SAX_characters);
-	SAX_handler.error = reinterpret_cast<errorSAXFunc>(SAX_error);
-	SAX_handler.getEntity = reinterpret_cast<getEntitySAXFunc>(SAX_getEntity);
+	Parse_EndElement(szName);
 
-	pFile->m_bIgnoreNextError = false;
+	return true;
+}
 
-	int ret = xmlSAXUserParseFile(&SAX_handler, pFile, szFileName);
-    
-    if (ret != 0)
+bool NZBFile::ParseText(char* szText, int iLen, bool bDecode)
+{
+	int iStart = 0;
+	while (iStart < iLen && IsXmlSpace(szText[iStart])) iStart++;
+	if (iStart == iLen)
 	{
-		error("Error parsing nzb-file %s", Util::BaseFileName(szFileName));
-		delete pFile;
-		return NULL;
+		return true;
 	}
 
-	if (pFile->GetNZBInfo()->GetFileList()->empty())
+	if (!m_szElementPath[0])
 	{
-		error("Error parsing nzb-file %s: file has no content", Util::BaseFileName(szFileName));
-		delete pFile;
-		return NULL;
+		// text outside of root element
+		return false;
+	}
+
+	iLen -= iStart;
+	if (bDecode)
+	{
+		iLen = DecodeText(szText + iStart, iLen, false);
+		if (iLen < 0)
+		{
+			return false;
+		}
 	}
+	while (iLen > 0 && IsXmlSpace(szText[iStart + iLen - 1])) iLen--;
 
-	pFile->ProcessFiles();
+	Parse_Content(szText + iStart, iLen);
 
-	return pFile;
+	return true;
+}
+
+/*
+ * Decodes entities in place, returns the new length or "-1" on unknown entities.
+ * In attribute values whitespace characters are replaced with spaces.
+ */
+int NZBFile::DecodeText(char* szText, int iLen, bool bAttribute)
+{
+	char* szEnd = szText + iLen;
+
+	if (bAttribute)
+	{
+		for (char* p = szText; p < szEnd; p++)
+		{
+			if (*p == 9 || *p == 10 || *p == 13) *p = ' ';
+		}
+	}
+
+	char* szAmp = (char*)memchr(szText, '&', iLen);
+	if (!szAmp)
+	{
+		return iLen;
+	}
+
+	char* szOut = szAmp;
+	for (char* p = szAmp; p < szEnd; )
+	{
+		if (*p != '&')
+		{
+			*szOut++ = *p++;
+			continue;
+		}
+
+		char* szSemicolon = (char*)memchr(p, ';', std::min((int)(szEnd - p), 12));
+		if (!szSemicolon)
+		{
+			return -1;
+		}
+		const char* szEntity = p + 1;
+		int iEntityLen = (int)(szSemicolon - szEntity);
+
+		if (iEntityLen == 2 && !strncmp(szEntity, "lt", 2))
+		{
+			*szOut++ = '<';
+		}
+		else if (iEntityLen == 2 && !strncmp(szEntity, "gt", 2))
+		{
+			*szOut++ = '>';
+		}
+		else if (iEntityLen == 3 && !strncmp(szEntity, "amp", 3))
+		{
+			*szOut++ = '&';
+		}
+		else if (iEntityLen == 4 && !strncmp(szEntity, "apos", 4))
+		{
+			*szOut++ = '\'';
+		}
+		else if (iEntityLen == 4 && !strncmp(szEntity, "quot", 4))
+		{
+			*szOut++ = '"';
+		}
+		else if (iEntityLen >= 2 && szEntity[0] == '#')
+		{
+			// character reference, encoded as UTF-8; the encoded form is
+			// never longer than the reference
+			bool bHex = szEntity[1] == 'x';
+			const char* szDigits = szEntity + (bHex ? 2 : 1);
+			if (!(bHex ? isxdigit(*szDigits) : isdigit(*szDigits)))
+			{
+				return -1;
+			}
+			char* szNumEnd;
+			unsigned long lCode = strtoul(szDigits, &szNumEnd, bHex ? 16 : 10);
+			if (szNumEnd != szSemicolon || lCode == 0 || lCode > 0x10FFFF)
+			{
+				return -1;
+			}
+			if (lCode < 0x80)
+			{
+				*szOut++ = (char)lCode;
+			}
+			else if (lCode < 0x800)
+			{
+				*szOut++ = (char)(0xC0 | (lCode >> 6));
+				*szOut++ = (char)(0x80 | (lCode & 0x3F));
+			}
+			else if (lCode < 0x10000)
+			{
+				*szOut++ = (char)(0xE0 | (lCode >> 12));
+				*szOut++ = (char)(0x80 | ((lCode >> 6) & 0x3F));
+				*szOut++ = (char)(0x80 | (lCode & 0x3F));
+			}
+			else
+			{
+				*szOut++ = (char)(0xF0 | (lCode >> 18));
+				*szOut++ = (char)(0x80 | ((lCode >> 12) & 0x3F));
+				*szOut++ = (char)(0x80 | ((lCode >> 6) & 0x3F));
+				*szOut++ = (char)(0x80 | (lCode & 0x3F));
+			}
+		}
+		else
+		{
+			return -1;
+		}
+
+		p = szSemicolon + 1;
+	}
+
+	return (int)(szOut - szText);
 }
 
 void NZBFile::Parse_StartElement(const char *name, const char **atts)
 {
+	m_iTagContentLen = 0;
 	if (m_szTagContent)
 	{
-		free(m_szTagContent);
-		m_szTagContent = NULL;
-		m_iTagContentLen = 0;
+		m_szTagContent[0] = '\0';
 	}
 	
 	if (!strcmp("file", name))
@@ -744,7 +1155,7 @@ void NZBFile::Parse_StartElement(const char *name, const char **atts)
 		if (partNumber > 0)
 		{
 			// new segment, add it!
-			m_pArticle = new ArticleInfo();
+			m_pArticle = m_pFileInfo->GetArticlePool()->NewArticle();
 			m_pArticle->SetPartNumber(partNumber);
 			m_pArticle->SetSize(lsize);
 			AddArticle(m_pFileInfo, m_pArticle);
@@ -778,9 +1189,10 @@ void NZBFile::Parse_EndElement(const char *name)
 			return;
 		}
 		
-		m_pFileInfo->GetGroups()->push_back(m_szTagContent);
-		m_szTagContent = NULL;
-		m_iTagContentLen = 0;
+		if (m_iTagContentLen > 0)
+		{
+			m_pFileInfo->GetGroups()->push_back(strdup(m_szTagContent));
+		}
 	}
 	else if (!strcmp("segment", name))
 	{
@@ -792,24 +1204,209 @@ void NZBFile::Parse_EndElement(const char *name)
 
 		// Get the #text part
 		char ID[2048];
-		snprintf(ID, 2048, "<%s>", m_szTagContent);
-		m_pArticle->SetMessageID(ID);
+		int iLen = std::min(m_iTagContentLen, 2048 - 3);
+		ID[0] = '<';
+		if (iLen > 0)
+		{
+			memcpy(ID + 1, m_szTagContent, iLen);
+		}
+		ID[iLen + 1] = '>';
+		ID[iLen + 2] = '\0';
+		m_pArticle->SetMessageID(m_pFileInfo->GetArticlePool()->AddData(ID, iLen + 3));
 		m_pArticle = NULL;
 	}
 	else if (!strcmp("meta", name) && m_bPassword)
 	{
-		m_szPassword = strdup(m_szTagContent);
+		free(m_szPassword);
+		m_szPassword = strdup(m_iTagContentLen > 0 ? m_szTagContent : "");
 	}
 }
 
 void NZBFile::Parse_Content(const char *buf, int len)
 {
-	m_szTagContent = (char*)realloc(m_szTagContent, m_iTagContentLen + len + 1);
-	strncpy(m_szTagContent + m_iTagContentLen, buf, len);
+	if (m_iTagContentLen + len + 1 > m_iTagContentSize)
+	{
+		m_iTagContentSize = std::max(m_iTagContentLen + len + 1, m_iTagContentSize * 2);
+		m_szTagContent = (char*)realloc(m_szTagContent, m_iTagContentSize);
+	}
+	memcpy(m_szTagContent + m_iTagContentLen, buf, len);
 	m_iTagContentLen += len;
 	m_szTagContent[m_iTagContentLen] = '\0';
 }
 
+
+#ifdef WIN32
+bool NZBFile::ParseXml()
+{
+    CoInitialize(NULL);
+
+	HRESULT hr;
+
+	MSXML::IXMLDOMDocumentPtr doc;
+	hr = doc.CreateInstance(MSXML::CLSID_DOMDocument);
+    if (FAILED(hr))
+    {
+        return false;
+    }
+
+    // Load the XML document file...
+	doc->put_resolveExternals(VARIANT_FALSE);
+	doc->put_validateOnParse(VARIANT_FALSE);
+	doc->put_async(VARIANT_FALSE);
+
+	_variant_t v;
+	if (m_szSourceBuffer)
+	{
+		// content from memory is passed as array of bytes
+		SAFEARRAY* pArray = SafeArrayCreateVector(VT_UI1, 0, m_iSourceSize);
+		void* pData;
+		SafeArrayAccessData(pArray, &pData);
+		memcpy(pData, m_szSourceBuffer, m_iSourceSize);
+		SafeArrayUnaccessData(pArray);
+		v.vt = VT_ARRAY | VT_UI1;
+		v.parray = pArray;
+	}
+	else
+	{
+		// filename needs to be properly encoded
+		char* szURL = (char*)malloc(strlen(m_szFileName)*3 + 1);
+		EncodeURL(m_szFileName, szURL);
+		debug("url=\"%s\"", szURL);
+		v = szURL;
+		free(szURL);
+	}
+
+	VARIANT_BOOL success = doc->load(v);
+	if (success == VARIANT_FALSE)
+	{
+		_bstr_t r(doc->GetparseError()->reason);
+		const char* szErrMsg = r;
+		error("Error parsing nzb-file %s: %s", Util::BaseFileName(m_szFileName), szErrMsg);
+		return false;
+	}
+
+	return ParseNZB(doc);
+}
+
+void NZBFile::EncodeURL(const char* szFilename, char* szURL)
+{
+	while (char ch = *szFilename++)
+	{
+		if (('0' <= ch && ch <= '9') ||
+			('a' <= ch && ch <= 'z') ||
+			('A' <= ch && ch <= 'Z') )
+		{
+			*szURL++ = ch;
+		}
+		else
+		{
+			*szURL++ = '%';
+			int a = (unsigned char)ch >> 4;
+			*szURL++ = a > 9 ? a - 10 + 'a' : a + '0';
+			a = ch & 0xF;
+			*szURL++ = a > 9 ? a - 10 + 'a' : a + '0';
+		}
+	}
+	*szURL = NULL;
+}
+
+bool NZBFile::ParseNZB(IUnknown* nzb)
+{
+	MSXML::IXMLDOMDocumentPtr doc = nzb;
+	MSXML::IXMLDOMNodePtr root = doc->documentElement;
+
+	MSXML::IXMLDOMNodePtr node = root->selectSingleNode("/nzb/head/meta[@type='password']");
+	if (node)
+	{
+		_bstr_t password(node->Gettext());
+		m_szPassword = strdup(password);
+	}
+
+	MSXML::IXMLDOMNodeListPtr fileList = root->selectNodes("/nzb/file");
+	for (int i = 0; i < fileList->Getlength(); i++)
+	{
+		node = fileList->Getitem(i);
+		MSXML::IXMLDOMNodePtr attribute = node->Getattributes()->getNamedItem("subject");
+		if (!attribute) return false;
+		_bstr_t subject(attribute->Gettext());
+        FileInfo* pFileInfo = new FileInfo();
+		pFileInfo->SetSubject(subject);
+
+		attribute = node->Getattributes()->getNamedItem("date");
+		if (attribute)
+		{
+			_bstr_t date(attribute->Gettext());
+			pFileInfo->SetTime(atoi(date));
+		}
+
+		MSXML::IXMLDOMNodeListPtr groupList = node->selectNodes("groups/group");
+		for (int g = 0; g < groupList->Getlength(); g++)
+		{
+			MSXML::IXMLDOMNodePtr node = groupList->Getitem(g);
+			_bstr_t group = node->Gettext();
+			pFileInfo->GetGroups()->push_back(strdup((const char*)group));
+		}
+
+		MSXML::IXMLDOMNodeListPtr segmentList = node->selectNodes("segments/segment");
+		for (int g = 0; g < segmentList->Getlength(); g++)
+		{
+			MSXML::IXMLDOMNodePtr node = segmentList->Getitem(g);
+			_bstr_t id = node->Gettext();
+            char szId[2048];
+            snprintf(szId, 2048, "<%s>", (const char*)id);
+
+			MSXML::IXMLDOMNodePtr attribute = node->Getattributes()->getNamedItem("number");
+			if (!attribute) return false;
+			_bstr_t number(attribute->Gettext());
+
+			attribute = node->Getattributes()->getNamedItem("bytes");
+			if (!attribute) return false;
+			_bstr_t bytes(attribute->Gettext());
+
+			int partNumber = atoi(number);
+			int lsize = atoi(bytes);
+
+			if (partNumber > 0)
+			{
+				ArticleInfo* pArticle = pFileInfo->GetArticlePool()->NewArticle();
+				pArticle->SetPartNumber(partNumber);
+				pArticle->SetMessageID(pFileInfo->GetArticlePool()->AddString(szId));
+				pArticle->SetSize(lsize);
+				AddArticle(pFileInfo, pArticle);
+			}
+		}
+
+		AddFileInfo(pFileInfo);
+	}
+	return true;
+}
+
+#else
+
+bool NZBFile::ParseXml()
+{
+	xmlSAXHandler SAX_handler = {0};
+	SAX_handler.startElement = reinterpret_cast<startElementSAXFunc>(SAX_StartElement);
+	SAX_handler.endElement = reinterpret_cast<endElementSAXFunc>(SAX_EndElement);
+	SAX_handler.characters = reinterpret_cast<charactersSAXFunc>(SAX_characters);
+	SAX_handler.error = reinterpret_cast<errorSAXFunc>(SAX_error);
+	SAX_handler.getEntity = reinterpret_cast<getEntitySAXFunc>(SAX_getEntity);
+
+	m_bIgnoreNextError = false;
+
+	int ret = m_szSourceBuffer ?
+		xmlSAXUserParseMemory(&SAX_handler, this, m_szSourceBuffer, m_iSourceSize) :
+		xmlSAXUserParseFile(&SAX_handler, this, m_szFileName);
+    
+    if (ret != 0)
+	{
+		error("Error parsing nzb-file %s", Util::BaseFileName(m_szFileName));
+		return false;
+	}
+
+	return true;
+}
+
 void NZBFile::SAX_StartElement(NZBFile* pFile, const char *name, const char **atts)
 {
 	pFile->Parse_StartElement(name, atts);
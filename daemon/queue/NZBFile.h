@@ -28,6 +28,7 @@
 #define NZBFILE_H
 
 #include <list>
+#include <stdio.h>
 
 #include "DownloadInfo.h"
 
@@ -40,8 +41,27 @@ private:
 	NZBInfo*			m_pNZBInfo;
 	char*				m_szFileName;
 	char*				m_szPassword;
+	FileInfo*			m_pFileInfo;
+	ArticleInfo*		m_pArticle;
+	char*				m_szTagContent;
+	int					m_iTagContentLen;
+	int					m_iTagContentSize;
+	bool				m_bPassword;
+
+	// streaming parser
+	FILE*				m_pStream;
+	const char*			m_szSourceBuffer;
+	int					m_iSourceSize;
+	int					m_iSourcePos;
+	char*				m_pBuffer;
+	int					m_iBufferSize;
+	int					m_iBufferLen;
+	bool				m_bStreamEnd;
+	bool				m_bRootClosed;
+	char				m_szElementPath[256];
 
 						NZBFile(const char* szFileName, const char* szCategory);
+	bool				Load(bool bXmlParser);
 	void				AddArticle(FileInfo* pFileInfo, ArticleInfo* pArticleInfo);
 	void				AddFileInfo(FileInfo* pFileInfo);
 	void				ParseSubject(FileInfo* pFileInfo, bool TryQuotes);
@@ -50,30 +70,36 @@ private:
 	void				CalcHashes();
 	bool				HasDuplicateFilenames();
 	void				ReadPassword();
+	void				Parse_StartElement(const char *name, const char **atts);
+	void				Parse_EndElement(const char *name);
+	void				Parse_Content(const char *buf, int len);
+	bool				ParseStream();
+	bool				ReadStream(int* pPos);
+	int					FindMarkupEnd(const char* szMarkup, int iLen);
+	bool				ParseMarkup(char* szMarkup, int iLen);
+	bool				ParseStartTag(char* szTag, int iLen);
+	bool				ParseEndTag(char* szName);
+	bool				ParseText(char* szText, int iLen, bool bDecode);
+	static int			DecodeText(char* szText, int iLen, bool bAttribute);
+	bool				ParseXml();
 #ifdef WIN32
     bool 				ParseNZB(IUnknown* nzb);
 	static void			EncodeURL(const char* szFilename, char* szURL);
 #else
-	FileInfo*			m_pFileInfo;
-	ArticleInfo*		m_pArticle;
-	char*				m_szTagContent;
-	int					m_iTagContentLen;
 	bool				m_bIgnoreNextError;
-	bool				m_bPassword;
 
 	static void			SAX_StartElement(NZBFile* pFile, const char *name, const char **atts);
 	static void			SAX_EndElement(NZBFile* pFile, const char *name);
 	static void			SAX_characters(NZBFile* pFile, const char * xmlstr, int len);
 	static void*		SAX_getEntity(NZBFile* pFile, const char * name);
 	static void			SAX_error(NZBFile* pFile, const char *msg, ...);
-	void				Parse_StartElement(const char *name, const char **atts);
-	void				Parse_EndElement(const char *name);
-	void				Parse_Content(const char *buf, int len);
 #endif
 
 public:
 	virtual 			~NZBFile();
-	static NZBFile*		Create(const char* szFileName, const char* szCategory);
+	static NZBFile*		Create(const char* szFileName, const char* szCategory, bool bXmlParser = false);
+	static NZBFile*		CreateFromBuffer(const char* szBuffer, int iBufSize, const char* szFileName,
+							const char* szCategory, bool bXmlParser = false);
 	const char* 		GetFileName() const { return m_szFileName; }
 	NZBInfo*			GetNZBInfo() { return m_pNZBInfo; }
 	const char*			GetPassword() { return m_szPassword; }
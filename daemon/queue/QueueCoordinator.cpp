@@ -79,6 +79,10 @@ QueueCoordinator::QueueCoordinator()
 
 	m_bHasMoreJobs = true;
 	m_iServerConfigGeneration = 0;
+	m_tLastPartialSave = 0;
+	m_lArticleListMemory = 0;
+	m_lArticleListCheck = 0;
+	m_lArticleListUse = 0;
 
 	g_pLog->RegisterDebuggable(this);
 
@@ -145,22 +149,15 @@ void QueueCoordinator::Load()
 		// re-save file states into diskstate to update server ids
 		if (g_pOptions->GetServerMode() && g_pOptions->GetSaveQueue())
 		{
+			if (g_pOptions->GetContinuePartial())
+			{
+				g_pDiskState->SavePartialStates(pDownloadQueue, true);
+			}
+
 			for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
 			{
 				NZBInfo* pNZBInfo = *it;
 
-				if (g_pOptions->GetContinuePartial())
-				{
-					for (FileList::iterator it2 = pNZBInfo->GetFileList()->begin(); it2 != pNZBInfo->GetFileList()->end(); it2++)
-					{
-						FileInfo* pFileInfo = *it2;
-						if (!pFileInfo->GetArticles()->empty())
-						{
-							g_pDiskState->SaveFileState(pFileInfo, false);
-						}
-					}
-				}
-
 				for (CompletedFiles::iterator it2 = pNZBInfo->GetCompletedFiles()->begin(); it2 != pNZBInfo->GetCompletedFiles()->end(); it2++)
 				{
 					CompletedFile* pCompletedFile = *it2;
@@ -264,7 +261,7 @@ void QueueCoordinator::Run()
 			// this code should not be called too often, once per second is OK
 			g_pServerPool->CloseUnusedConnections();
 			ResetHangingDownloads();
-			if (!bStandBy)
+			if (!bStandBy && time(NULL) - m_tLastPartialSave >= g_pOptions->GetPartialStateInterval())
 			{
 				SavePartialState();
 			}
@@ -319,13 +316,23 @@ void QueueCoordinator::AdjustDownloadsLimit()
 }
 
 void QueueCoordinator::AddNZBFileToQueue(NZBFile* pNZBFile, NZBInfo* pUrlInfo, bool bAddFirst)
+{
+	DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
+	AddNZBFileToQueue(pDownloadQueue, pNZBFile, pUrlInfo, bAddFirst);
+	pDownloadQueue->Save();
+	DownloadQueue::Unlock();
+}
+
+/*
+ * Adds nzb-file to the locked queue without saving the queue, that allows
+ * to add many files at once.
+ */
+void QueueCoordinator::AddNZBFileToQueue(DownloadQueue* pDownloadQueue, NZBFile* pNZBFile, NZBInfo* pUrlInfo, bool bAddFirst)
 {
 	debug("Adding NZBFile to queue");
 
 	NZBInfo* pNZBInfo = pNZBFile->GetNZBInfo();
 
-	DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
-
 	DownloadQueue::Aspect foundAspect = { DownloadQueue::eaNzbFound, pDownloadQueue, pNZBInfo, NULL };
 	pDownloadQueue->Notify(&foundAspect);
 
@@ -386,12 +393,14 @@ void QueueCoordinator::AddNZBFileToQueue(NZBFile* pNZBFile, NZBInfo* pUrlInfo, b
 	if (pUrlInfo)
 	{
 		pNZBInfo->SetID(pUrlInfo->GetID());
+		pDownloadQueue->RemoveFromIndex(pUrlInfo);
 		pDownloadQueue->GetQueue()->Remove(pUrlInfo);
 		delete pUrlInfo;
 	}
 
 	if (eDeleteStatus == NZBInfo::dsNone)
 	{
+		pDownloadQueue->AddToIndex(pNZBInfo);
 		pNZBInfo->PrintMessage(Message::mkInfo, "Collection %s added to queue", pNZBInfo->GetName());
 	}
 
@@ -400,10 +409,6 @@ void QueueCoordinator::AddNZBFileToQueue(NZBFile* pNZBFile, NZBInfo* pUrlInfo, b
 		DownloadQueue::Aspect addedAspect = { DownloadQueue::eaNzbAdded, pDownloadQueue, pNZBInfo, NULL };
 		pDownloadQueue->Notify(&addedAspect);
 	}
-		
-	pDownloadQueue->Save();
-
-	DownloadQueue::Unlock();
 }
 
 void QueueCoordinator::CheckDupeFileInfos(NZBInfo* pNZBInfo)
@@ -451,6 +456,7 @@ void QueueCoordinator::CheckDupeFileInfos(NZBInfo* pNZBInfo)
 		FileInfo* pFileInfo = *it;
 		StatFileInfo(pFileInfo, false);
 		pNZBInfo->GetFileList()->Remove(pFileInfo);
+		pNZBInfo->SetChanged(true);
 		if (g_pOptions->GetSaveQueue() && g_pOptions->GetServerMode())
 		{
 			g_pDiskState->DiscardFile(pFileInfo, true, false, false);
@@ -527,9 +533,19 @@ bool QueueCoordinator::GetNextArticle(DownloadQueue* pDownloadQueue, FileInfo* &
 			break;
 		}
 
+		pFileInfo->SetLastUsed(++m_lArticleListUse);
+
 		if (pFileInfo->GetArticles()->empty() && g_pOptions->GetSaveQueue() && g_pOptions->GetServerMode())
 		{
 			g_pDiskState->LoadArticles(pFileInfo);
+			m_lArticleListMemory += pFileInfo->CalcArticleMemory();
+			long long lLimit = (long long)g_pOptions->GetArticleListLimit() * 1024 * 1024;
+			if (lLimit > 0 && m_lArticleListMemory > lLimit && m_lArticleListMemory > m_lArticleListCheck)
+			{
+				m_lArticleListMemory = UnloadArticleLists(pDownloadQueue, pFileInfo, lLimit / 4 * 3);
+				// if most of the loaded lists can't be unloaded yet don't rescan the queue on each load
+				m_lArticleListCheck = m_lArticleListMemory + lLimit / 4;
+			}
 		}
 
 		// check if the file has any articles left for download
@@ -574,6 +590,70 @@ bool QueueCoordinator::GetNextArticle(DownloadQueue* pDownloadQueue, FileInfo* &
 	return bOK;
 }
 
+/*
+ * Heap order for UnloadArticleLists: the least recently used file is on top.
+ */
+bool QueueCoordinator::CompareLastUsed(FileInfo* pFileInfo1, FileInfo* pFileInfo2)
+{
+	return pFileInfo1->GetLastUsed() > pFileInfo2->GetLastUsed();
+}
+
+/*
+ * Unloads article lists of least recently used files until the memory used by
+ * article lists falls below the target. Files which are being downloaded or
+ * have cached or completed articles keep their lists because the article states
+ * would be lost otherwise. The unloaded lists are loaded from disk again in GetNextArticle.
+ * The memory is recalculated here since the caller's counter doesn't track deleted files.
+ * Returns the memory still used by article lists.
+ */
+long long QueueCoordinator::UnloadArticleLists(DownloadQueue* pDownloadQueue, FileInfo* pCurrentFileInfo, long long lTargetMemory)
+{
+	std::vector<FileInfo*> candidates;
+	long long lMemory = 0;
+
+	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
+	{
+		NZBInfo* pNZBInfo = *it;
+		for (FileList::iterator it2 = pNZBInfo->GetFileList()->begin(); it2 != pNZBInfo->GetFileList()->end(); it2++)
+		{
+			FileInfo* pFileInfo = *it2;
+			if (!pFileInfo->GetArticles()->empty())
+			{
+				lMemory += pFileInfo->CalcArticleMemory();
+				if (pFileInfo != pCurrentFileInfo && pFileInfo->GetActiveDownloads() == 0 &&
+					pFileInfo->GetCachedArticles() == 0 && pFileInfo->GetCompletedArticles() == 0 &&
+					!pFileInfo->GetPartialChanged())
+				{
+					candidates.push_back(pFileInfo);
+				}
+			}
+		}
+	}
+
+	if (lMemory <= lTargetMemory)
+	{
+		return lMemory;
+	}
+
+	// only the unloaded files are taken from the heap, no need to sort all candidates
+	std::make_heap(candidates.begin(), candidates.end(), CompareLastUsed);
+
+	int iUnloaded = 0;
+	while (!candidates.empty() && lMemory > lTargetMemory)
+	{
+		std::pop_heap(candidates.begin(), candidates.end(), CompareLastUsed);
+		FileInfo* pFileInfo = candidates.back();
+		candidates.pop_back();
+		lMemory -= pFileInfo->CalcArticleMemory();
+		pFileInfo->ClearArticles();
+		iUnloaded++;
+	}
+
+	debug("Unloaded article lists of %i file(s), %lli bytes remain loaded", iUnloaded, lMemory);
+
+	return lMemory;
+}
+
 void QueueCoordinator::StartArticleDownload(FileInfo* pFileInfo, ArticleInfo* pArticleInfo, NNTPConnection* pConnection)
 {
 	debug("Starting new ArticleDownloader");
@@ -808,7 +888,9 @@ void QueueCoordinator::DeleteFileInfo(DownloadQueue* pDownloadQueue, FileInfo* p
 	if (std::find(pDownloadQueue->GetQueue()->begin(), pDownloadQueue->GetQueue()->end(), pNZBInfo) !=
 		pDownloadQueue->GetQueue()->end())
 	{
+		pDownloadQueue->RemoveFromIndex(pFileInfo);
 		pNZBInfo->GetFileList()->Remove(pFileInfo);
+		pNZBInfo->SetChanged(true);
 		delete pFileInfo;
 	}
 }
@@ -842,23 +924,10 @@ void QueueCoordinator::SavePartialState()
 		return;
 	}
 
-	DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
-
-	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
-	{
-		NZBInfo* pNZBInfo = *it;
-		for (FileList::iterator it2 = pNZBInfo->GetFileList()->begin(); it2 != pNZBInfo->GetFileList()->end(); it2++)
-		{
-			FileInfo* pFileInfo = *it2;
-			if (pFileInfo->GetPartialChanged())
-			{
-				debug("Saving partial state for %s", pFileInfo->GetFilename());
-				g_pDiskState->SaveFileState(pFileInfo, false);
-				pFileInfo->SetPartialChanged(false);
-			}
-		}
-	}
+	m_tLastPartialSave = time(NULL);
 
+	DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
+	g_pDiskState->SavePartialStates(pDownloadQueue, false);
 	DownloadQueue::Unlock();
 }
 
@@ -1136,6 +1205,8 @@ bool QueueCoordinator::MergeQueueEntries(DownloadQueue* pDownloadQueue, NZBInfo*
 	pDestNZBInfo->SetQueuedFilename(szQueuedFilename);
 	free(szQueuedFilename);
 
+	// the files are already moved to the dest nzb and stay in the index
+	pDownloadQueue->RemoveFromIndex(pSrcNZBInfo);
 	pDownloadQueue->GetQueue()->Remove(pSrcNZBInfo);
 	g_pDiskState->DiscardFiles(pSrcNZBInfo);
 	delete pSrcNZBInfo;
@@ -1178,6 +1249,8 @@ bool QueueCoordinator::SplitQueueEntries(DownloadQueue* pDownloadQueue, FileList
 
 	NZBInfo* pNZBInfo = new NZBInfo();
 	pDownloadQueue->GetQueue()->push_back(pNZBInfo);
+	// the moved files keep their IDs and stay in the index
+	pDownloadQueue->AddToIndex(pNZBInfo);
 
 	pNZBInfo->SetFilename(pSrcNZBInfo->GetFilename());
 	pNZBInfo->SetName(szName);
@@ -1254,6 +1327,7 @@ bool QueueCoordinator::SplitQueueEntries(DownloadQueue* pDownloadQueue, FileList
 
 	if (pSrcNZBInfo->GetFileList()->empty())
 	{
+		pDownloadQueue->RemoveFromIndex(pSrcNZBInfo);
 		pDownloadQueue->GetQueue()->Remove(pSrcNZBInfo);
 		g_pDiskState->DiscardFiles(pSrcNZBInfo);
 		delete pSrcNZBInfo;
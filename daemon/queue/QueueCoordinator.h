@@ -63,6 +63,10 @@ private:
 	bool						m_bHasMoreJobs;
 	int							m_iDownloadsLimit;
 	int							m_iServerConfigGeneration;
+	time_t						m_tLastPartialSave;
+	long long					m_lArticleListMemory;
+	long long					m_lArticleListCheck;
+	unsigned long long			m_lArticleListUse;
 
 	bool					GetNextArticle(DownloadQueue* pDownloadQueue, FileInfo* &pFileInfo, ArticleInfo* &pArticleInfo);
 	void					StartArticleDownload(FileInfo* pFileInfo, ArticleInfo* pArticleInfo, NNTPConnection* pConnection);
@@ -74,6 +78,7 @@ private:
 	void					AdjustDownloadsLimit();
 	void					Load();
 	void					SavePartialState();
+	static bool				CompareLastUsed(FileInfo* pFileInfo1, FileInfo* pFileInfo2);
 
 protected:
 	virtual void			LogDebugInfo();
@@ -83,10 +88,12 @@ public:
 	virtual					~QueueCoordinator();
 	virtual void			Run();
 	virtual void 			Stop();
+	static long long		UnloadArticleLists(DownloadQueue* pDownloadQueue, FileInfo* pCurrentFileInfo, long long lTargetMemory);
 	void					Update(Subject* Caller, void* Aspect);
 
 	// editing queue
 	void					AddNZBFileToQueue(NZBFile* pNZBFile, NZBInfo* pUrlInfo, bool bAddFirst);
+	void					AddNZBFileToQueue(DownloadQueue* pDownloadQueue, NZBFile* pNZBFile, NZBInfo* pUrlInfo, bool bAddFirst);
 	void					CheckDupeFileInfos(NZBInfo* pNZBInfo);
 	bool					HasMoreJobs() { return m_bHasMoreJobs; }
 	void					DiscardDiskFile(FileInfo* pFileInfo);
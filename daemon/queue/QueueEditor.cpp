@@ -272,23 +272,6 @@ QueueEditor::~QueueEditor()
 	debug("Destroying QueueEditor");
 }
 
-FileInfo* QueueEditor::FindFileInfo(int iID)
-{
-	for (NZBList::iterator it = m_pDownloadQueue->GetQueue()->begin(); it != m_pDownloadQueue->GetQueue()->end(); it++)
-	{
-		NZBInfo* pNZBInfo = *it;
-		for (FileList::iterator it2 = pNZBInfo->GetFileList()->begin(); it2 != pNZBInfo->GetFileList()->end(); it2++)
-		{
-			FileInfo* pFileInfo = *it2;
-			if (pFileInfo->GetID() == iID)
-			{
-				return pFileInfo;
-			}
-		}
-	}
-	return NULL;
-}
-
 /*
  * Set the pause flag of the specific entry in the queue
  */
@@ -340,6 +323,7 @@ void QueueEditor::MoveEntry(FileInfo* pFileInfo, int iOffset)
 	{
 		pFileInfo->GetNZBInfo()->GetFileList()->erase(pFileInfo->GetNZBInfo()->GetFileList()->begin() + iEntry);
 		pFileInfo->GetNZBInfo()->GetFileList()->insert(pFileInfo->GetNZBInfo()->GetFileList()->begin() + iNewEntry, pFileInfo);
+		pFileInfo->GetNZBInfo()->SetChanged(true);
 	}
 }
 
@@ -546,6 +530,8 @@ void QueueEditor::PrepareList(ItemList* pItemList, IDList* pIDList,
 	}
 
 	pItemList->reserve(pIDList->size());
+	std::set<int> idSet(pIDList->begin(), pIDList->end());
+
 	if ((iOffset != 0) && 
 		(eAction == DownloadQueue::eaFileMoveOffset || eAction == DownloadQueue::eaFileMoveTop || eAction == DownloadQueue::eaFileMoveBottom))
 	{
@@ -571,8 +557,7 @@ void QueueEditor::PrepareList(ItemList* pItemList, IDList* pIDList,
 			for (int iIndex = iStart; iIndex != iEnd; iIndex += iStep)
 			{
 				FileInfo* pFileInfo = pNZBInfo->GetFileList()->at(iIndex);
-				IDList::iterator it2 = std::find(pIDList->begin(), pIDList->end(), pFileInfo->GetID());
-				if (it2 != pIDList->end())
+				if (idSet.find(pFileInfo->GetID()) != idSet.end())
 				{
 					int iWorkOffset = iOffset;
 					int iDestPos = iIndex + iWorkOffset;
@@ -627,8 +612,7 @@ void QueueEditor::PrepareList(ItemList* pItemList, IDList* pIDList,
 		for (int iIndex = iStart; iIndex != iEnd; iIndex += iStep)
 		{
 			NZBInfo* pNZBInfo = m_pDownloadQueue->GetQueue()->at(iIndex);
-			IDList::iterator it2 = std::find(pIDList->begin(), pIDList->end(), pNZBInfo->GetID());
-			if (it2 != pIDList->end())
+			if (idSet.find(pNZBInfo->GetID()) != idSet.end())
 			{
 				int iWorkOffset = iOffset;
 				int iDestPos = iIndex + iWorkOffset;
@@ -661,74 +645,25 @@ void QueueEditor::PrepareList(ItemList* pItemList, IDList* pIDList,
 	}
 	else if (eAction < DownloadQueue::eaGroupMoveOffset)
 	{
-		// check ID range
-		int iMaxID = 0;
-		int iMinID = MAX_ID;
-		for (NZBList::iterator it = m_pDownloadQueue->GetQueue()->begin(); it != m_pDownloadQueue->GetQueue()->end(); it++)
-		{
-			NZBInfo* pNZBInfo = *it;
-			for (FileList::iterator it2 = pNZBInfo->GetFileList()->begin(); it2 != pNZBInfo->GetFileList()->end(); it2++)
-			{
-				FileInfo* pFileInfo = *it2;
-				int ID = pFileInfo->GetID();
-				if (ID > iMaxID)
-				{
-					iMaxID = ID;
-				}
-				if (ID < iMinID)
-				{
-					iMinID = ID;
-				}
-			}
-		}
-
 		//add IDs to list in order they were transmitted in command
 		for (IDList::iterator it = pIDList->begin(); it != pIDList->end(); it++)
 		{
-			int iID = *it;
-			if (iMinID <= iID && iID <= iMaxID)
+			FileInfo* pFileInfo = m_pDownloadQueue->FindFileInfo(*it);
+			if (pFileInfo)
 			{
-				FileInfo* pFileInfo = FindFileInfo(iID);
-				if (pFileInfo)
-				{
-					pItemList->push_back(new EditItem(pFileInfo, NULL, iOffset));
-				}
+				pItemList->push_back(new EditItem(pFileInfo, NULL, iOffset));
 			}
 		}
 	}
 	else 
 	{
-		// check ID range
-		int iMaxID = 0;
-		int iMinID = MAX_ID;
-		for (NZBList::iterator it = m_pDownloadQueue->GetQueue()->begin(); it != m_pDownloadQueue->GetQueue()->end(); it++)
-		{
-			NZBInfo* pNZBInfo = *it;
-			int ID = pNZBInfo->GetID();
-			if (ID > iMaxID)
-			{
-				iMaxID = ID;
-			}
-			if (ID < iMinID)
-			{
-				iMinID = ID;
-			}
-		}
-
 		//add IDs to list in order they were transmitted in command
 		for (IDList::iterator it = pIDList->begin(); it != pIDList->end(); it++)
 		{
-			int iID = *it;
-			if (iMinID <= iID && iID <= iMaxID)
+			NZBInfo* pNZBInfo = m_pDownloadQueue->FindNZBInfo(*it);
+			if (pNZBInfo)
 			{
-				for (NZBList::iterator it2 = m_pDownloadQueue->GetQueue()->begin(); it2 != m_pDownloadQueue->GetQueue()->end(); it2++)
-				{
-					NZBInfo* pNZBInfo = *it2;
-					if (iID == pNZBInfo->GetID())
-					{
-						pItemList->push_back(new EditItem(NULL, pNZBInfo, iOffset));
-					}
-				}
+				pItemList->push_back(new EditItem(NULL, pNZBInfo, iOffset));
 			}
 		}
 	}
@@ -1204,6 +1139,7 @@ void QueueEditor::ReorderFiles(ItemList* pItemList)
 		{
 			pNZBInfo->GetFileList()->erase(it2);
 			pNZBInfo->GetFileList()->insert(pNZBInfo->GetFileList()->begin() + iInsertPos, pFileInfo);
+			pNZBInfo->SetChanged(true);
 			iInsertPos++;				
 		}
 
@@ -1223,6 +1159,7 @@ void QueueEditor::SetNZBParameter(NZBInfo* pNZBInfo, const char* szParamString)
 		*szValue = '\0';
 		szValue++;
 		pNZBInfo->GetParameters()->SetParameter(szStr, szValue);
+		pNZBInfo->SetChanged(true);
 	}
 	else
 	{
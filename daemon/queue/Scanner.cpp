@@ -34,12 +34,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <vector>
 #ifdef WIN32
 #include <direct.h>
 #else
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 
 #include "nzbget.h"
 #include "Scanner.h"
@@ -49,6 +53,9 @@
 #include "ScanScript.h"
 #include "Util.h"
 
+// in watching mode every n-th periodic check scans the whole incoming directory
+static const int WATCH_FULLSCAN_INTERVALS = 12;
+
 Scanner::FileData::FileData(const char* szFilename)
 {
 	m_szFilename = strdup(szFilename);
@@ -79,6 +86,7 @@ Scanner::QueueData::QueueData(const char* szFilename, const char* szNZBName, con
 	m_pUrlInfo = pUrlInfo;
 	m_pAddStatus = pAddStatus;
 	m_pNZBID = pNZBID;
+	m_pNZBFile = NULL;
 
 	if (pParameters)
 	{
@@ -92,6 +100,7 @@ Scanner::QueueData::~QueueData()
 	free(m_szNZBName);
 	free(m_szCategory);
 	free(m_szDupeKey);
+	delete m_pNZBFile;
 }
 
 void Scanner::QueueData::SetAddStatus(EAddStatus eAddStatus)
@@ -110,6 +119,12 @@ void Scanner::QueueData::SetNZBID(int iNZBID)
 	}
 }
 
+void Scanner::ParseJob::ProcessItem(int iItem)
+{
+	QueueData* pPending = m_pBatch->at(iItem);
+	pPending->SetNZBFile(NZBFile::Create(pPending->GetFilename(), pPending->GetCategory()));
+}
+
 
 Scanner::Scanner()
 {
@@ -120,6 +135,10 @@ Scanner::Scanner()
 	m_iNZBDirInterval = 0;
 	m_iPass = 0;
 	m_bScanScript = false;
+	m_iWatchFd = -1;
+	m_bWatchFailed = false;
+	m_pParsePool = NULL;
+	m_iWatchedChecks = 0;
 }
 
 Scanner::~Scanner()
@@ -133,6 +152,16 @@ Scanner::~Scanner()
 	m_FileList.clear();
 
 	ClearQueueList();
+
+	for (QueueList::iterator it = m_PendingList.begin(); it != m_PendingList.end(); it++)
+	{
+		delete *it;
+	}
+	m_PendingList.clear();
+
+	StopWatching();
+
+	delete m_pParsePool;
 }
 
 void Scanner::InitOptions()
@@ -155,6 +184,11 @@ void Scanner::Check()
 {
 	m_mutexScan.Lock();
 
+	if (Watching() && !g_pOptions->GetPauseScan())
+	{
+		CheckWatchEvents();
+	}
+
 	if (m_bRequestedNZBDirScan || 
 		(!g_pOptions->GetPauseScan() && g_pOptions->GetNzbDirInterval() > 0 && 
 		 m_iNZBDirInterval >= g_pOptions->GetNzbDirInterval() * 1000))
@@ -163,11 +197,26 @@ void Scanner::Check()
 		bool bCheckStat = !m_bRequestedNZBDirScan;
 		m_bRequestedNZBDirScan = false;
 		m_bScanning = true;
-		CheckIncomingNZBs(g_pOptions->GetNzbDir(), "", bCheckStat);
-		if (!bCheckStat && m_bScanScript)
+		if (bCheckStat && Watching() && ++m_iWatchedChecks < WATCH_FULLSCAN_INTERVALS)
 		{
-			// if immediate scan requested, we need second scan to process files extracted by NzbProcess-script
+			// new files are reported by watcher, only files waiting for NzbDirFileAge need to be checked
+			CheckWatchedFiles();
+		}
+		else
+		{
+			// a full scan is still made from time to time in watching mode, the watcher
+			// doesn't get events for files written by other computers to network mounts
+			m_iWatchedChecks = 0;
+			// start watching before the scan to not miss files added during the scan
+			StartWatching();
 			CheckIncomingNZBs(g_pOptions->GetNzbDir(), "", bCheckStat);
+			AddPendingFiles();
+			if (!bCheckStat && m_bScanScript)
+			{
+				// if immediate scan requested, we need second scan to process files extracted by NzbProcess-script
+				CheckIncomingNZBs(g_pOptions->GetNzbDir(), "", bCheckStat);
+				AddPendingFiles();
+			}
 		}
 		m_bScanning = false;
 		m_iNZBDirInterval = 0;
@@ -353,7 +402,6 @@ void Scanner::ProcessIncomingFile(const char* szDirectory, const char* szBaseFil
 	bool bAdded = false;
 	QueueData* pQueueData = NULL;
 	NZBInfo* pUrlInfo = NULL;
-	int iNZBID = 0;
 
 	for (QueueList::iterator it = m_QueueList.begin(); it != m_QueueList.end(); it++)
     {
@@ -406,8 +454,9 @@ void Scanner::ProcessIncomingFile(const char* szDirectory, const char* szBaseFil
 		bool bRenameOK = Util::RenameBak(szFullFilename, "nzb", true, szRenamedName, 1024);
 		if (bRenameOK)
 		{
-			bAdded = AddFileToQueue(szRenamedName, szNZBName, szNZBCategory, iPriority,
-				szDupeKey, iDupeScore, eDupeMode, pParameters, bAddTop, bAddPaused, pUrlInfo, &iNZBID);
+			AddFileToQueue(szRenamedName, szNZBName, szNZBCategory, iPriority,
+				szDupeKey, iDupeScore, eDupeMode, pParameters, bAddTop, bAddPaused, pUrlInfo, pQueueData);
+			bAdded = true;
 		}
 		else
 		{
@@ -418,8 +467,9 @@ void Scanner::ProcessIncomingFile(const char* szDirectory, const char* szBaseFil
 	}
 	else if (bExists && !strcasecmp(szExtension, ".nzb"))
 	{
-		bAdded = AddFileToQueue(szFullFilename, szNZBName, szNZBCategory, iPriority,
-			szDupeKey, iDupeScore, eDupeMode, pParameters, bAddTop, bAddPaused, pUrlInfo, &iNZBID);
+		AddFileToQueue(szFullFilename, szNZBName, szNZBCategory, iPriority,
+			szDupeKey, iDupeScore, eDupeMode, pParameters, bAddTop, bAddPaused, pUrlInfo, pQueueData);
+		bAdded = true;
 	}
 
 	delete pParameters;
@@ -428,10 +478,11 @@ void Scanner::ProcessIncomingFile(const char* szDirectory, const char* szBaseFil
 	free(szNZBCategory);
 	free(szDupeKey);
 
-	if (pQueueData)
+	// the status of added files is set after they are parsed, see AddPendingFiles
+	if (pQueueData && !bAdded)
 	{
-		pQueueData->SetAddStatus(eAddStatus == asFailed ? asFailed : bAdded ? asSuccess : asSkipped);
-		pQueueData->SetNZBID(iNZBID);
+		pQueueData->SetAddStatus(eAddStatus == asFailed ? asFailed : asSkipped);
+		pQueueData->SetNZBID(0);
 	}
 }
 
@@ -481,19 +532,135 @@ void Scanner::InitPPParameters(const char* szCategory, NZBParameterList* pParame
 	}
 }
 
-bool Scanner::AddFileToQueue(const char* szFilename, const char* szNZBName, const char* szCategory,
+/**
+ * Puts the file into the list of pending files. The file is parsed and added
+ * to download queue later, in AddPendingFiles.
+ */
+void Scanner::AddFileToQueue(const char* szFilename, const char* szNZBName, const char* szCategory,
 	int iPriority, const char* szDupeKey, int iDupeScore, EDupeMode eDupeMode,
-	NZBParameterList* pParameters, bool bAddTop, bool bAddPaused, NZBInfo* pUrlInfo, int* pNZBID)
+	NZBParameterList* pParameters, bool bAddTop, bool bAddPaused, NZBInfo* pUrlInfo, QueueData* pQueueData)
+{
+	info("Adding collection %s to queue", Util::BaseFileName(szFilename));
+
+	QueueData* pPending = new QueueData(szFilename, szNZBName, szCategory, iPriority,
+		szDupeKey, iDupeScore, eDupeMode, pParameters, bAddTop, bAddPaused, pUrlInfo,
+		pQueueData ? pQueueData->m_pAddStatus : NULL, pQueueData ? pQueueData->m_pNZBID : NULL);
+	m_PendingList.push_back(pPending);
+}
+
+/**
+ * Parses pending nzb-files using several threads and adds them to download queue.
+ * The files are processed in batches to limit the memory used by parsed files.
+ * Within a batch the files are added to queue in the order they were found
+ * while holding the queue lock only once, so the resulting queue order is the
+ * same as if the files were added one by one.
+ */
+void Scanner::AddPendingFiles()
+{
+	int iBatchSize = Util::NumberOfCpuCores() * 4;
+	if (iBatchSize < 4)
+	{
+		iBatchSize = 4;
+	}
+
+	while (!m_PendingList.empty())
+	{
+		QueueList batch;
+		while (!m_PendingList.empty() && (int)batch.size() < iBatchSize)
+		{
+			batch.push_back(m_PendingList.front());
+			m_PendingList.pop_front();
+		}
+
+		ParsePendingFiles(&batch);
+		QueuePendingFiles(&batch);
+	}
+}
+
+/*
+ * Adds parsed files to download queue and deletes the batch items.
+ */
+void Scanner::QueuePendingFiles(QueueList* pBatch)
 {
-	const char* szBasename = Util::BaseFileName(szFilename);
+	for (QueueList::iterator it = pBatch->begin(); it != pBatch->end(); it++)
+	{
+		QueueData* pPending = *it;
+		if (!PrepareNZBFile(pPending))
+		{
+			pPending->SetAddStatus(asSkipped);
+			pPending->SetNZBID(0);
+		}
+	}
+
+	bool bAdded = false;
+	DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
+
+	for (QueueList::iterator it = pBatch->begin(); it != pBatch->end(); it++)
+	{
+		QueueData* pPending = *it;
+		NZBFile* pNZBFile = pPending->GetNZBFile();
+		if (pNZBFile)
+		{
+			NZBInfo* pNZBInfo = pNZBFile->GetNZBInfo();
+			g_pQueueCoordinator->AddNZBFileToQueue(pDownloadQueue, pNZBFile, pPending->GetUrlInfo(), pPending->GetAddTop());
+			pPending->SetNZBID(pNZBInfo->GetID());
+			pPending->SetAddStatus(asSuccess);
+			bAdded = true;
+		}
+	}
+
+	if (bAdded)
+	{
+		pDownloadQueue->Save();
+	}
+
+	DownloadQueue::Unlock();
+
+	for (QueueList::iterator it = pBatch->begin(); it != pBatch->end(); it++)
+	{
+		delete *it;
+	}
+	pBatch->clear();
+}
+
+void Scanner::ParsePendingFiles(QueueList* pBatch)
+{
+	int iCount = (int)pBatch->size();
+	ParseJob job(pBatch);
+
+	if (iCount <= 1 || Util::NumberOfCpuCores() <= 1)
+	{
+		for (int i = 0; i < iCount; i++)
+		{
+			job.ProcessItem(i);
+		}
+		return;
+	}
+
+	if (!m_pParsePool)
+	{
+		// the pool is kept for next batches; the scanner thread takes part in the work too
+		m_pParsePool = new WorkerPool(Util::NumberOfCpuCores() - 1);
+	}
 
-	info("Adding collection %s to queue", szBasename);
+	debug("Parsing %i nzb-files using %i threads", iCount, m_pParsePool->GetThreadCount() + 1);
+
+	m_pParsePool->Execute(&job, iCount);
+}
+
+/**
+ * Renames the parsed nzb-file and sets up its properties.
+ * Returns false if the file could not be parsed or renamed.
+ */
+bool Scanner::PrepareNZBFile(QueueData* pPending)
+{
+	const char* szFilename = pPending->GetFilename();
+	NZBFile* pNZBFile = pPending->GetNZBFile();
 
-	NZBFile* pNZBFile = NZBFile::Create(szFilename, szCategory);
 	bool bOK = pNZBFile != NULL;
 	if (!bOK)
 	{
-		error("Could not add collection %s to queue", szBasename);
+		error("Could not add collection %s to queue", Util::BaseFileName(szFilename));
 	}
 
 	char bakname2[1024];
@@ -504,59 +671,350 @@ bool Scanner::AddFileToQueue(const char* szFilename, const char* szNZBName, cons
 		error("Could not rename file %s to %s: %s", szFilename, bakname2, Util::GetLastErrorMessage(szSysErrStr, sizeof(szSysErrStr)));
 	}
 
-	if (bOK)
+	if (!bOK)
 	{
-		NZBInfo* pNZBInfo = pNZBFile->GetNZBInfo();
-		pNZBInfo->SetQueuedFilename(bakname2);
+		delete pNZBFile;
+		pPending->SetNZBFile(NULL);
+		return false;
+	}
 
-		if (szNZBName && strlen(szNZBName) > 0)
-		{
-			pNZBInfo->SetName(NULL);
+	NZBInfo* pNZBInfo = pNZBFile->GetNZBInfo();
+	pNZBInfo->SetQueuedFilename(bakname2);
+
+	const char* szNZBName = pPending->GetNZBName();
+	if (szNZBName && strlen(szNZBName) > 0)
+	{
+		pNZBInfo->SetName(NULL);
 #ifdef WIN32
-			char* szAnsiFilename = strdup(szNZBName);
-			WebUtil::Utf8ToAnsi(szAnsiFilename, strlen(szAnsiFilename) + 1);
-			pNZBInfo->SetFilename(szAnsiFilename);
-			free(szAnsiFilename);
+		char* szAnsiFilename = strdup(szNZBName);
+		WebUtil::Utf8ToAnsi(szAnsiFilename, strlen(szAnsiFilename) + 1);
+		pNZBInfo->SetFilename(szAnsiFilename);
+		free(szAnsiFilename);
 #else
-			pNZBInfo->SetFilename(szNZBName);
+		pNZBInfo->SetFilename(szNZBName);
 #endif
-			pNZBInfo->BuildDestDirName();
+		pNZBInfo->BuildDestDirName();
+	}
+
+	pNZBInfo->SetDupeKey(pPending->GetDupeKey());
+	pNZBInfo->SetDupeScore(pPending->GetDupeScore());
+	pNZBInfo->SetDupeMode(pPending->GetDupeMode());
+	pNZBInfo->SetPriority(pPending->GetPriority());
+	if (pPending->GetUrlInfo())
+	{
+		pNZBInfo->SetURL(pPending->GetUrlInfo()->GetURL());
+		pNZBInfo->SetUrlStatus(pPending->GetUrlInfo()->GetUrlStatus());
+	}
+
+	if (pNZBFile->GetPassword())
+	{
+		pNZBInfo->GetParameters()->SetParameter("*Unpack:Password", pNZBFile->GetPassword());
+	}
+
+	pNZBInfo->GetParameters()->CopyFrom(pPending->GetParameters());
+
+	for (::FileList::iterator it = pNZBInfo->GetFileList()->begin(); it != pNZBInfo->GetFileList()->end(); it++)
+	{
+		FileInfo* pFileInfo = *it;
+		pFileInfo->SetPaused(pPending->GetAddPaused());
+	}
+
+	return true;
+}
+
+/*
+ * Starts watching of NzbDir for changes. Once the watching is active the
+ * periodic scans of NzbDir are not needed anymore; if the watching is not
+ * possible the periodic scans are used as usual.
+ */
+void Scanner::StartWatching()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	if (Watching() || m_bWatchFailed || !g_pOptions->GetNzbDirWatch() || g_pOptions->GetNzbDirInterval() == 0)
+	{
+		return;
+	}
+
+	m_iWatchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_iWatchFd < 0)
+	{
+		char szSysErrStr[256];
+		warn("Could not watch directory %s for changes: %s", g_pOptions->GetNzbDir(), Util::GetLastErrorMessage(szSysErrStr, sizeof(szSysErrStr)));
+	}
+
+	if (m_iWatchFd < 0 || !AddWatch(g_pOptions->GetNzbDir(), false))
+	{
+		warn("Using periodic scans of directory %s", g_pOptions->GetNzbDir());
+		m_bWatchFailed = true;
+		StopWatching();
+		return;
+	}
+
+	detail("Watching directory %s for changes", g_pOptions->GetNzbDir());
+#endif
+}
+
+void Scanner::StopWatching()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	if (m_iWatchFd > -1)
+	{
+		close(m_iWatchFd);
+	}
+#endif
+	m_iWatchFd = -1;
+
+	for (WatchList::iterator it = m_WatchList.begin(); it != m_WatchList.end(); it++)
+	{
+		free(it->second);
+	}
+	m_WatchList.clear();
+}
+
+/*
+ * Adds the directory and all its subdirectories to the watch list.
+ * If "bCheckFiles" is set the files found in the directories are checked
+ * using option NzbDirFileAge, that's needed for directories created or
+ * moved into NzbDir after the watching was started.
+ */
+bool Scanner::AddWatch(const char* szDirectory, bool bCheckFiles)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	int iWatch = inotify_add_watch(m_iWatchFd, szDirectory,
+		IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_ONLYDIR);
+	if (iWatch < 0)
+	{
+		char szSysErrStr[256];
+		warn("Could not watch directory %s for changes: %s", szDirectory, Util::GetLastErrorMessage(szSysErrStr, sizeof(szSysErrStr)));
+		return false;
+	}
+
+	WatchList::iterator it = m_WatchList.find(iWatch);
+	if (it != m_WatchList.end())
+	{
+		free(it->second);
+	}
+	m_WatchList[iWatch] = strdup(szDirectory);
+
+	DirBrowser dir(szDirectory);
+	while (const char* filename = dir.Next())
+	{
+		if (!strcmp(filename, ".") || !strcmp(filename, ".."))
+		{
+			continue;
+		}
+
+		char fullfilename[1023 + 1]; // one char reserved for the trailing slash (if needed)
+		snprintf(fullfilename, 1023, "%s%s", szDirectory, filename);
+		fullfilename[1023 - 1] = '\0';
+		if (Util::DirectoryExists(fullfilename))
+		{
+			fullfilename[strlen(fullfilename) + 1] = '\0';
+			fullfilename[strlen(fullfilename)] = PATH_SEPARATOR;
+			if (!AddWatch(fullfilename, bCheckFiles))
+			{
+				return false;
+			}
 		}
+		else if (bCheckFiles && CanProcessFile(fullfilename, true))
+		{
+			ProcessWatchedFile(fullfilename);
+		}
+	}
 
-		pNZBInfo->SetDupeKey(szDupeKey);
-		pNZBInfo->SetDupeScore(iDupeScore);
-		pNZBInfo->SetDupeMode(eDupeMode);
-		pNZBInfo->SetPriority(iPriority);
-		if (pUrlInfo)
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Removes the directory and all its subdirectories from the watch list.
+ */
+void Scanner::RemoveWatch(const char* szDirectory)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	int iLen = strlen(szDirectory);
+	for (WatchList::iterator it = m_WatchList.begin(); it != m_WatchList.end(); )
+	{
+		if (!strncmp(it->second, szDirectory, iLen))
 		{
-			pNZBInfo->SetURL(pUrlInfo->GetURL());
-			pNZBInfo->SetUrlStatus(pUrlInfo->GetUrlStatus());
+			inotify_rm_watch(m_iWatchFd, it->first);
+			free(it->second);
+			m_WatchList.erase(it++);
 		}
+		else
+		{
+			it++;
+		}
+	}
+#endif
+}
 
-		if (pNZBFile->GetPassword())
+/*
+ * Reads pending change notifications without waiting. Nzb-files are added to
+ * queue immediately after they were written or moved into NzbDir. Other files
+ * can be partially written temporary files (for example downloads in progress
+ * in web-browser), they are checked using option NzbDirFileAge.
+ */
+void Scanner::CheckWatchEvents()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	bool bOK = true;
+	bool bOverflow = false;
+	int iLen;
+
+	while (bOK && (iLen = read(m_iWatchFd, buf, sizeof(buf))) > 0)
+	{
+		for (char* p = buf; bOK && p < buf + iLen; )
 		{
-			pNZBInfo->GetParameters()->SetParameter("*Unpack:Password", pNZBFile->GetPassword());
+			struct inotify_event* pEvent = (struct inotify_event*)p;
+			p += sizeof(struct inotify_event) + pEvent->len;
+
+			if (pEvent->mask & IN_Q_OVERFLOW)
+			{
+				warn("Too many changes in directory %s, rescanning the directory", g_pOptions->GetNzbDir());
+				bOverflow = true;
+				bOK = false;
+				break;
+			}
+
+			WatchList::iterator it = m_WatchList.find(pEvent->wd);
+			if (it == m_WatchList.end())
+			{
+				continue;
+			}
+
+			if (pEvent->mask & IN_IGNORED)
+			{
+				// the directory was deleted
+				free(it->second);
+				m_WatchList.erase(it);
+				continue;
+			}
+
+			if (pEvent->len == 0)
+			{
+				continue;
+			}
+
+			char fullfilename[1023 + 1]; // one char reserved for the trailing slash (if needed)
+			snprintf(fullfilename, 1023, "%s%s", it->second, pEvent->name);
+			fullfilename[1023 - 1] = '\0';
+
+			if (pEvent->mask & IN_ISDIR)
+			{
+				fullfilename[strlen(fullfilename) + 1] = '\0';
+				fullfilename[strlen(fullfilename)] = PATH_SEPARATOR;
+				if (pEvent->mask & IN_MOVED_FROM)
+				{
+					RemoveWatch(fullfilename);
+				}
+				else if (pEvent->mask & (IN_CREATE | IN_MOVED_TO))
+				{
+					bOK = AddWatch(fullfilename, true);
+				}
+				continue;
+			}
+
+			if (!(pEvent->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) || !Util::FileExists(fullfilename))
+			{
+				continue;
+			}
+
+			const char* szExtension = strrchr(pEvent->name, '.');
+			if (szExtension && (!strcasecmp(szExtension, ".nzb") || !strcasecmp(szExtension, ".nzb_processed")) &&
+				Util::FileSize(fullfilename) > 0)
+			{
+				ProcessWatchedFile(fullfilename);
+			}
+			else if (CanProcessFile(fullfilename, true))
+			{
+				ProcessWatchedFile(fullfilename);
+			}
 		}
+	}
 
-		pNZBInfo->GetParameters()->CopyFrom(pParameters);
+	if (bOverflow)
+	{
+		// events were lost; the full scan made on next check finds the missed
+		// files and starts watching again
+		StopWatching();
+		m_iNZBDirInterval = g_pOptions->GetNzbDirInterval() * 1000;
+	}
+	else if (!bOK)
+	{
+		warn("Watching of directory %s turned off, using periodic scans", g_pOptions->GetNzbDir());
+		m_bWatchFailed = true;
+		StopWatching();
+	}
+
+	AddPendingFiles();
+#endif
+}
 
-		for (::FileList::iterator it = pNZBInfo->GetFileList()->begin(); it != pNZBInfo->GetFileList()->end(); it++)
+/*
+ * Checks files which are waiting for NzbDirFileAge. In watching mode that's
+ * done instead of periodic scans of NzbDir.
+ */
+void Scanner::CheckWatchedFiles()
+{
+	std::vector<char*> filenames;
+	for (FileList::iterator it = m_FileList.begin(); it != m_FileList.end(); it++)
+	{
+		filenames.push_back(strdup((*it)->GetFilename()));
+	}
+
+	for (std::vector<char*>::iterator it = filenames.begin(); it != filenames.end(); it++)
+	{
+		char* szFilename = *it;
+		if (Util::FileExists(szFilename) && CanProcessFile(szFilename, true))
 		{
-			FileInfo* pFileInfo = *it;
-			pFileInfo->SetPaused(bAddPaused);
+			ProcessWatchedFile(szFilename);
 		}
+		free(szFilename);
+	}
 
-		g_pQueueCoordinator->AddNZBFileToQueue(pNZBFile, pUrlInfo, bAddTop);
+	AddPendingFiles();
+}
 
-		if (pNZBID)
+/*
+ * Processes a file in NzbDir or in one of its subdirectories. The category is
+ * determined from the path of the file.
+ */
+void Scanner::ProcessWatchedFile(const char* szFullFilename)
+{
+	for (QueueList::iterator it = m_PendingList.begin(); it != m_PendingList.end(); it++)
+	{
+		if (Util::SameFilename((*it)->GetFilename(), szFullFilename))
 		{
-			*pNZBID = pNZBInfo->GetID();
+			// already waiting to be added
+			return;
 		}
 	}
 
-	delete pNZBFile;
+	const char* szNzbDir = g_pOptions->GetNzbDir();
+	int iNzbDirLen = strlen(szNzbDir);
+	if (strncmp(szFullFilename, szNzbDir, iNzbDirLen))
+	{
+		return;
+	}
+
+	const char* szBaseFilename = Util::BaseFileName(szFullFilename);
+
+	char szDirectory[1024];
+	int iDirLen = (int)(szBaseFilename - szFullFilename);
+	strncpy(szDirectory, szFullFilename, iDirLen < 1024 ? iDirLen : 1024);
+	szDirectory[iDirLen < 1024 ? iDirLen : 1024 - 1] = '\0';
+
+	// category is the path relative to NzbDir without the trailing slash
+	char szCategory[1024];
+	int iCategoryLen = iDirLen > iNzbDirLen ? iDirLen - iNzbDirLen - 1 : 0;
+	strncpy(szCategory, szFullFilename + iNzbDirLen, iCategoryLen < 1024 ? iCategoryLen : 1024);
+	szCategory[iCategoryLen < 1024 ? iCategoryLen : 1024 - 1] = '\0';
 
-	return bOK;
+	ProcessIncomingFile(szDirectory, szBaseFilename, szFullFilename, szCategory);
 }
 
 void Scanner::ScanNZBDir(bool bSyncMode)
@@ -572,13 +1030,60 @@ void Scanner::ScanNZBDir(bool bSyncMode)
 	}
 }
 
+/**
+ * Adds nzb-file received via API or downloaded from URL. If no scan script
+ * is configured the content is parsed directly from memory and the file is
+ * written into NzbDir only to be kept for history. Otherwise the file is put
+ * into NzbDir and processed by scanner.
+ */
+/*
+ * Checks for xml declaration and nzb-element in the first kilobyte of content,
+ * UTF-8 byte order mark and whitespace before xml declaration are skipped.
+ */
+static bool IsNZBContent(const char* szBuffer, int iBufSize)
+{
+	char buf[1024];
+	int iLen = iBufSize < 1024 ? iBufSize : 1024 - 1;
+	memcpy(buf, szBuffer, iLen);
+	buf[iLen] = '\0';
+
+	char* szStart = buf;
+	if (!strncmp(szStart, "\xEF\xBB\xBF", 3))
+	{
+		szStart += 3;
+	}
+	while (*szStart == ' ' || *szStart == '\t' || *szStart == '\r' || *szStart == '\n')
+	{
+		szStart++;
+	}
+	return !strncmp(szStart, "<?xml", 5) && strstr(szStart, "<nzb");
+}
+
+#ifndef DISABLE_GZIP
+/*
+ * Uncompresses only the beginning of gzip-content to check if it's an nzb-file.
+ */
+static bool IsGZippedNZB(const char* szBuffer, int iBufSize)
+{
+	GUnzipStream cGUnzipStream(1024);
+	cGUnzipStream.Write(szBuffer, iBufSize);
+	const void* pOutBuf;
+	int iOutLen = 0;
+	GUnzipStream::EStatus eStatus = cGUnzipStream.Read(&pOutBuf, &iOutLen);
+	return eStatus != GUnzipStream::zlError && iOutLen > 0 && IsNZBContent((const char*)pOutBuf, iOutLen);
+}
+#endif
+
 Scanner::EAddStatus Scanner::AddExternalFile(const char* szNZBName, const char* szCategory,
 	int iPriority, const char* szDupeKey, int iDupeScore,  EDupeMode eDupeMode,
 	NZBParameterList* pParameters, bool bAddTop, bool bAddPaused, NZBInfo* pUrlInfo,
 	const char* szFileName, const char* szBuffer, int iBufSize, int* pNZBID)
 {
 	bool bNZB = false;
+	bool bDirect = false;
 	char szTempFileName[1024];
+	char* szGUnzipBuffer = NULL;
+	char szUnzippedName[1024];
 
 	if (szFileName)
 	{
@@ -587,26 +1092,51 @@ Scanner::EAddStatus Scanner::AddExternalFile(const char* szNZBName, const char*
 	}
 	else
 	{
-		int iNum = 1;
-		while (iNum == 1 || Util::FileExists(szTempFileName))
+#ifndef DISABLE_GZIP
+		// only compressed nzb-files are uncompressed, other archives (for scan script)
+		// are passed further unchanged
+		if (ZLib::IsGZip(szBuffer, iBufSize) && IsGZippedNZB(szBuffer, iBufSize))
 		{
-			snprintf(szTempFileName, 1024, "%snzb-%i.tmp", g_pOptions->GetTempDir(), iNum);
-			szTempFileName[1024-1] = '\0';
-			iNum++;
+			if (!ZLib::GUnzip(szBuffer, iBufSize, &szGUnzipBuffer, &iBufSize))
+			{
+				error("Could not uncompress nzb-file %s", szNZBName);
+				return asFailed;
+			}
+			szBuffer = szGUnzipBuffer;
+
+			// remove extension ".gz" from the name
+			strncpy(szUnzippedName, szNZBName, 1024);
+			szUnzippedName[1024-1] = '\0';
+			char* szExtension = strrchr(szUnzippedName, '.');
+			if (szExtension && !strcasecmp(szExtension, ".gz"))
+			{
+				*szExtension = '\0';
+				szNZBName = szUnzippedName;
+			}
 		}
+#endif
 
-		if (!Util::SaveBufferIntoFile(szTempFileName, szBuffer, iBufSize))
+		bNZB = IsNZBContent(szBuffer, iBufSize);
+		bDirect = bNZB && !m_bScanScript;
+
+		if (!bDirect)
 		{
-			error("Could not create file %s", szTempFileName);
-			return asFailed;
-		}
+			int iNum = 1;
+			while (iNum == 1 || Util::FileExists(szTempFileName))
+			{
+				snprintf(szTempFileName, 1024, "%snzb-%i.tmp", g_pOptions->GetTempDir(), iNum);
+				szTempFileName[1024-1] = '\0';
+				iNum++;
+			}
 
-		char buf[1024];
-		strncpy(buf, szBuffer, 1024);
-		buf[1024-1] = '\0';
-		bNZB = !strncmp(buf, "<?xml", 5) && strstr(buf, "<nzb");
+			if (!Util::SaveBufferIntoFile(szTempFileName, szBuffer, iBufSize))
+			{
+				error("Could not create file %s", szTempFileName);
+				free(szGUnzipBuffer);
+				return asFailed;
+			}
+		}
 	}
-
 	// move file into NzbDir, make sure the file name is unique
 	char szValidNZBName[1024];
 	strncpy(szValidNZBName, Util::BaseFileName(szNZBName), 1024);
@@ -650,7 +1180,7 @@ Scanner::EAddStatus Scanner::AddExternalFile(const char* szNZBName, const char*
 
 	m_mutexScan.Lock();
 
-	if (!Util::MoveFile(szTempFileName, szScanFileName))
+	if (!bDirect && !Util::MoveFile(szTempFileName, szScanFileName))
 	{
 		char szSysErrStr[256];
 		error("Could not move file %s to %s: %s", szTempFileName, szScanFileName, Util::GetLastErrorMessage(szSysErrStr, sizeof(szSysErrStr)));
@@ -669,6 +1199,45 @@ Scanner::EAddStatus Scanner::AddExternalFile(const char* szNZBName, const char*
 	}
 
 	EAddStatus eAddStatus = asSkipped;
+
+	if (bDirect)
+	{
+		info("Adding collection %s to queue", Util::BaseFileName(szScanFileName));
+
+		NZBParameterList parameters;
+		if (pParameters)
+		{
+			parameters.CopyFrom(pParameters);
+		}
+		InitPPParameters(szUseCategory, &parameters, false);
+
+		QueueData* pPending = new QueueData(szScanFileName, szNZBName, szUseCategory, iPriority,
+			szDupeKey, iDupeScore, eDupeMode, &parameters, bAddTop, bAddPaused, pUrlInfo,
+			&eAddStatus, pNZBID);
+		pPending->SetNZBFile(NZBFile::CreateFromBuffer(szBuffer, iBufSize, szScanFileName, szUseCategory));
+
+		// the file is kept in NzbDir as for files added by scanner,
+		// it's needed to return the items from history back to queue
+		if (Util::SaveBufferIntoFile(szScanFileName, szBuffer, iBufSize))
+		{
+			QueueList batch;
+			batch.push_back(pPending);
+			QueuePendingFiles(&batch);
+		}
+		else
+		{
+			error("Could not create file %s", szScanFileName);
+			delete pPending;
+			eAddStatus = asFailed;
+		}
+
+		free(szUseCategory);
+		m_mutexScan.Unlock();
+		free(szGUnzipBuffer);
+
+		return eAddStatus;
+	}
+
 	QueueData* pQueueData = new QueueData(szScanFileName, szNZBName, szUseCategory, iPriority,
 		szDupeKey, iDupeScore, eDupeMode, pParameters, bAddTop, bAddPaused, pUrlInfo,
 		&eAddStatus, pNZBID);
@@ -677,6 +1246,8 @@ Scanner::EAddStatus Scanner::AddExternalFile(const char* szNZBName, const char*
 
 	m_mutexScan.Unlock();
 
+	free(szGUnzipBuffer);
+
 	ScanNZBDir(true);
 
 	return eAddStatus;
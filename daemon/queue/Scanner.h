@@ -27,10 +27,13 @@
 #define SCANNER_H
 
 #include <deque>
+#include <map>
 #include <time.h>
 #include "DownloadInfo.h"
 #include "Thread.h"
 
+class NZBFile;
+
 class Scanner
 {
 public:
@@ -77,6 +80,9 @@ private:
 		NZBInfo*			m_pUrlInfo;
 		EAddStatus*			m_pAddStatus;
 		int*				m_pNZBID;
+		NZBFile*			m_pNZBFile;
+
+		friend class Scanner;
 
 	public:
 							QueueData(const char* szFilename, const char* szNZBName, const char* szCategory,
@@ -97,9 +103,25 @@ private:
 		NZBInfo*			GetUrlInfo() { return m_pUrlInfo; }
 		void				SetAddStatus(EAddStatus eAddStatus);
 		void				SetNZBID(int iNZBID);
+		NZBFile*			GetNZBFile() { return m_pNZBFile; }
+		void				SetNZBFile(NZBFile* pNZBFile) { m_pNZBFile = pNZBFile; }
 	};
 
 	typedef std::deque<QueueData*>		QueueList;
+	typedef std::map<int, char*>		WatchList;
+
+	/*
+	 * Parses the nzb-files of a batch, see Scanner::ParsePendingFiles.
+	 */
+	class ParseJob : public ParallelJob
+	{
+	private:
+		QueueList*			m_pBatch;
+
+	public:
+							ParseJob(QueueList* pBatch) : m_pBatch(pBatch) {}
+		virtual void		ProcessItem(int iItem);
+	};
 
 	bool				m_bRequestedNZBDirScan;
 	int					m_iNZBDirInterval;
@@ -107,18 +129,37 @@ private:
 	int					m_iPass;
 	FileList			m_FileList;
 	QueueList			m_QueueList;
+	QueueList			m_PendingList;
 	bool				m_bScanning;
 	Mutex				m_mutexScan;
+	int					m_iWatchFd;
+	bool				m_bWatchFailed;
+	WatchList			m_WatchList;
+	WorkerPool*			m_pParsePool;
+	int					m_iWatchedChecks;
 
 	void				CheckIncomingNZBs(const char* szDirectory, const char* szCategory, bool bCheckStat);
-	bool				AddFileToQueue(const char* szFilename, const char* szNZBName, const char* szCategory,
+	void				AddFileToQueue(const char* szFilename, const char* szNZBName, const char* szCategory,
 							int iPriority, const char* szDupeKey, int iDupeScore, EDupeMode eDupeMode,
-							NZBParameterList* pParameters, bool bAddTop, bool bAddPaused, NZBInfo* pUrlInfo, int* pNZBID);
+							NZBParameterList* pParameters, bool bAddTop, bool bAddPaused, NZBInfo* pUrlInfo,
+							QueueData* pQueueData);
+	void				AddPendingFiles();
+	void				ParsePendingFiles(QueueList* pBatch);
+	void				QueuePendingFiles(QueueList* pBatch);
+	bool				PrepareNZBFile(QueueData* pPending);
 	void				ProcessIncomingFile(const char* szDirectory, const char* szBaseFilename,
 							const char* szFullFilename, const char* szCategory);
 	bool				CanProcessFile(const char* szFullFilename, bool bCheckStat);
 	void				DropOldFiles();
 	void				ClearQueueList();
+	bool				Watching() { return m_iWatchFd > -1; }
+	void				StartWatching();
+	void				StopWatching();
+	bool				AddWatch(const char* szDirectory, bool bCheckFiles);
+	void				RemoveWatch(const char* szDirectory);
+	void				CheckWatchEvents();
+	void				CheckWatchedFiles();
+	void				ProcessWatchedFile(const char* szFullFilename);
 
 public:
 						Scanner();
@@ -92,6 +92,7 @@ void UrlDownloader::ProcessHeader(const char* szLine)
 
 			char* szVal = WebUtil::Latin1ToUtf8(szValue);
 			m_pNZBInfo->GetParameters()->SetParameter(szParamName, szVal);
+			m_pNZBInfo->SetChanged(true);
 			free(szVal);
 		}
 		free(szModLine);
@@ -266,6 +267,7 @@ void UrlCoordinator::AddUrlToQueue(NZBInfo* pNZBInfo, bool bAddTop)
 	{
 		pDownloadQueue->GetQueue()->push_back(pNZBInfo);
 	}
+	pDownloadQueue->AddToIndex(pNZBInfo);
 	pDownloadQueue->Save();
 	DownloadQueue::Unlock();
 }
@@ -315,6 +317,7 @@ void UrlCoordinator::StartUrlDownload(NZBInfo* pNZBInfo)
 	snprintf(tmp, 1024, "%surl-%i.tmp", g_pOptions->GetTempDir(), pNZBInfo->GetID());
 	tmp[1024-1] = '\0';
 	pUrlDownloader->SetOutputFilename(tmp);
+	pUrlDownloader->SetMemoryOutput(true);
 
 	pNZBInfo->SetUrlStatus(NZBInfo::lsRunning);
 
@@ -408,13 +411,16 @@ void UrlCoordinator::UrlCompleted(UrlDownloader* pUrlDownloader)
 
 	if (pNZBInfo->GetUrlStatus() == NZBInfo::lsFinished)
 	{
-		// add nzb-file to download queue
+		// add nzb-file to download queue; large responses were written into output file
+		bool bMemoryOutput = pUrlDownloader->GetMemoryOutput();
 		Scanner::EAddStatus eAddStatus = g_pScanner->AddExternalFile(
 			!Util::EmptyStr(pNZBInfo->GetFilename()) ? pNZBInfo->GetFilename() : filename,
 			!Util::EmptyStr(pNZBInfo->GetCategory()) ? pNZBInfo->GetCategory() : pUrlDownloader->GetCategory(),
 			pNZBInfo->GetPriority(), pNZBInfo->GetDupeKey(), pNZBInfo->GetDupeScore(), pNZBInfo->GetDupeMode(),
 			pNZBInfo->GetParameters(), false, pNZBInfo->GetAddUrlPaused(), pNZBInfo,
-			pUrlDownloader->GetOutputFilename(), NULL, 0, NULL);
+			bMemoryOutput ? NULL : pUrlDownloader->GetOutputFilename(),
+			bMemoryOutput ? (pUrlDownloader->GetOutputBuffer() ? pUrlDownloader->GetOutputBuffer() : "") : NULL,
+			bMemoryOutput ? pUrlDownloader->GetOutputBufferLen() : 0, NULL);
 
 		if (eAddStatus == Scanner::asSuccess)
 		{
@@ -431,6 +437,7 @@ void UrlCoordinator::UrlCompleted(UrlDownloader* pUrlDownloader)
 	pDownloadQueue = DownloadQueue::Lock();
 
 	// delete URL from queue
+	pDownloadQueue->RemoveFromIndex(pNZBInfo);
 	pDownloadQueue->GetQueue()->Remove(pNZBInfo);
 	bool bDeleteObj = true;
 
@@ -442,6 +449,7 @@ void UrlCoordinator::UrlCompleted(UrlDownloader* pUrlDownloader)
 		HistoryInfo* pHistoryInfo = new HistoryInfo(pNZBInfo);
 		pHistoryInfo->SetTime(time(NULL));
 		pDownloadQueue->GetHistory()->push_front(pHistoryInfo);
+		pDownloadQueue->AddToIndex(pHistoryInfo);
 		bDeleteObj = false;
 	}
 		
@@ -480,12 +488,14 @@ bool UrlCoordinator::DeleteQueueEntry(DownloadQueue* pDownloadQueue, NZBInfo* pN
 	pNZBInfo->SetDeleteStatus(NZBInfo::dsManual);
 	pNZBInfo->SetUrlStatus(NZBInfo::lsNone);
 
+	pDownloadQueue->RemoveFromIndex(pNZBInfo);
 	pDownloadQueue->GetQueue()->Remove(pNZBInfo);
 	if (g_pOptions->GetKeepHistory() > 0 && !bAvoidHistory)
 	{
 		HistoryInfo* pHistoryInfo = new HistoryInfo(pNZBInfo);
 		pHistoryInfo->SetTime(time(NULL));
 		pDownloadQueue->GetHistory()->push_front(pHistoryInfo);
+		pDownloadQueue->AddToIndex(pHistoryInfo);
 	}
 	else
 	{
@@ -518,7 +518,7 @@ void ListBinCommand::Execute()
 		}
 
 		// Make a data structure and copy all the elements of the list into it
-		DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
+		DownloadQueue* pDownloadQueue = DownloadQueue::LockShared();
 
 		// calculate required buffer size for nzbs
 		int iNrNZBEntries = pDownloadQueue->GetQueue()->size();
@@ -700,7 +700,7 @@ void ListBinCommand::Execute()
 			}
 		}
 
-		DownloadQueue::Unlock();
+		DownloadQueue::UnlockShared();
 
 		delete pRegEx;
 
@@ -712,7 +712,7 @@ void ListBinCommand::Execute()
 
 	if (htonl(ListRequest.m_bServerState))
 	{
-		DownloadQueue *pDownloadQueue = DownloadQueue::Lock();
+		DownloadQueue *pDownloadQueue = DownloadQueue::LockShared();
 		int iPostJobCount = 0;
 		for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
 		{
@@ -721,7 +721,7 @@ void ListBinCommand::Execute()
 		}
 		long long lRemainingSize;
 		pDownloadQueue->CalcRemainingSize(&lRemainingSize, NULL);
-		DownloadQueue::Unlock();
+		DownloadQueue::UnlockShared();
 
 		unsigned long iSizeHi, iSizeLo;
 		ListResponse.m_iDownloadRate = htonl(g_pStatMeter->CalcCurrentDownloadSpeed());
@@ -767,10 +767,13 @@ void LogBinCommand::Execute()
 		return;
 	}
 
-	MessageList* pMessages = g_pLog->LockMessages();
-
 	int iNrEntries = ntohl(LogRequest.m_iLines);
 	unsigned int iIDFrom = ntohl(LogRequest.m_iIDFrom);
+
+	MessageList messages;
+	MessageList* pMessages = &messages;
+	g_pLog->GetMessages(pMessages, (int)iIDFrom, iNrEntries);
+
 	int iStart = pMessages->size();
 	if (iNrEntries > 0)
 	{
@@ -826,8 +829,6 @@ void LogBinCommand::Execute()
 		}
 	}
 
-	g_pLog->UnlockMessages();
-
 	SNZBLogResponse LogResponse;
 	LogResponse.m_MessageBase.m_iSignature = htonl(NZBMESSAGE_SIGNATURE);
 	LogResponse.m_MessageBase.m_iStructSize = htonl(sizeof(LogResponse));
@@ -955,7 +956,7 @@ void PostQueueBinCommand::Execute()
 	int bufsize = 0;
 
 	// Make a data structure and copy all the elements of the list into it
-	NZBList* pNZBList = DownloadQueue::Lock()->GetQueue();
+	NZBList* pNZBList = DownloadQueue::LockShared()->GetQueue();
 
 	// calculate required buffer size
 	int NrEntries = 0;
@@ -1020,7 +1021,7 @@ void PostQueueBinCommand::Execute()
 		}
 	}
 
-	DownloadQueue::Unlock();
+	DownloadQueue::UnlockShared();
 
 	PostQueueResponse.m_iNrTrailingEntries = htonl(NrEntries);
 	PostQueueResponse.m_iTrailingDataLength = htonl(bufsize);
@@ -1114,7 +1115,7 @@ void HistoryBinCommand::Execute()
 	int bufsize = 0;
 
 	// Make a data structure and copy all the elements of the list into it
-	DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
+	DownloadQueue* pDownloadQueue = DownloadQueue::LockShared();
 
 	// calculate required buffer size for nzbs
 	int iNrEntries = 0;
@@ -1196,7 +1197,7 @@ void HistoryBinCommand::Execute()
 		}
 	}
 
-	DownloadQueue::Unlock();
+	DownloadQueue::UnlockShared();
 
 	HistoryResponse.m_iNrTrailingEntries = htonl(iNrEntries);
 	HistoryResponse.m_iTrailingDataLength = htonl(bufsize);
@@ -0,0 +1,409 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#include "win32.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+#include "nzbget.h"
+#include "Metrics.h"
+#include "Log.h"
+#include "Options.h"
+#include "ServerPool.h"
+#include "StatMeter.h"
+#include "ArticleWriter.h"
+#include "DownloadInfo.h"
+#include "Util.h"
+
+static const char* POST_STAGE_NAMES[] = { "QUEUED", "LOADING_PARS", "VERIFYING_SOURCES", "REPAIRING",
+	"VERIFYING_REPAIRED", "RENAMING", "UNPACKING", "MOVING", "EXECUTING_SCRIPT", "FINISHED" };
+
+bool MetricsProcessor::IsMetricsRequest(const char* szUrl)
+{
+	return !strcmp(szUrl, "/metrics");
+}
+
+void MetricsProcessor::Execute()
+{
+	m_cResponse.Clear();
+
+	AppendSpeedMetrics();
+	AppendQueueMetrics();
+	AppendServerMetrics();
+	AppendTimingMetrics();
+	AppendSystemMetrics();
+}
+
+void MetricsProcessor::AppendHeader(const char* szName, const char* szType, const char* szHelp)
+{
+	char szLine[1024];
+	snprintf(szLine, 1024, "# HELP %s %s\n# TYPE %s %s\n", szName, szHelp, szName, szType);
+	szLine[1024-1] = '\0';
+	m_cResponse.Append(szLine);
+}
+
+void MetricsProcessor::AppendName(const char* szName, const char* szLabels)
+{
+	// appended piecewise, label sets (e.g. with server names) can be arbitrarily long
+	m_cResponse.Append(szName);
+	if (szLabels)
+	{
+		m_cResponse.Append("{");
+		m_cResponse.Append(szLabels);
+		m_cResponse.Append("}");
+	}
+}
+
+void MetricsProcessor::AppendValue(const char* szName, const char* szLabels, long long lValue)
+{
+	AppendName(szName, szLabels);
+	char szValue[32];
+	snprintf(szValue, 32, " %lli\n", lValue);
+	szValue[32-1] = '\0';
+	m_cResponse.Append(szValue);
+}
+
+void MetricsProcessor::AppendValue(const char* szName, const char* szLabels, double fValue)
+{
+	AppendName(szName, szLabels);
+	char szValue[512];
+	snprintf(szValue, 512, " %.6f\n", fValue);
+	szValue[512-1] = '\0';
+	m_cResponse.Append(szValue);
+}
+
+/*
+ * Escapes backslash, double quote and line feed as required for label values.
+ * The returned string must be freed by the caller.
+ */
+char* MetricsProcessor::EscapeLabel(const char* szValue)
+{
+	char* szResult = (char*)malloc(strlen(szValue) * 2 + 1);
+	char* szOut = szResult;
+	for (const char* p = szValue; *p; p++)
+	{
+		switch (*p)
+		{
+			case '\\': *szOut++ = '\\'; *szOut++ = '\\'; break;
+			case '"': *szOut++ = '\\'; *szOut++ = '"'; break;
+			case '\n': *szOut++ = '\\'; *szOut++ = 'n'; break;
+			default: *szOut++ = *p;
+		}
+	}
+	*szOut = '\0';
+	return szResult;
+}
+
+void MetricsProcessor::AppendSpeedMetrics()
+{
+	int iUpTimeSec, iDownloadTimeSec;
+	long long lAllBytes;
+	bool bStandBy;
+	g_pStatMeter->CalcTotalStat(&iUpTimeSec, &iDownloadTimeSec, &lAllBytes, &bStandBy);
+
+	AppendHeader("nzbget_download_rate_bytes", "gauge", "Current download speed in bytes per second.");
+	AppendValue("nzbget_download_rate_bytes", NULL, (long long)g_pStatMeter->CalcCurrentDownloadSpeed());
+
+	AppendHeader("nzbget_download_limit_bytes", "gauge", "Download speed limit in bytes per second, 0 if not limited.");
+	AppendValue("nzbget_download_limit_bytes", NULL, (long long)g_pOptions->GetDownloadRate());
+
+	AppendHeader("nzbget_downloaded_bytes_total", "counter", "Total amount of downloaded data.");
+	AppendValue("nzbget_downloaded_bytes_total", NULL, lAllBytes);
+
+	AppendHeader("nzbget_download_time_seconds_total", "counter", "Total time spent downloading.");
+	AppendValue("nzbget_download_time_seconds_total", NULL, (long long)iDownloadTimeSec);
+
+	AppendHeader("nzbget_uptime_seconds", "gauge", "Time since the program start.");
+	AppendValue("nzbget_uptime_seconds", NULL, (long long)iUpTimeSec);
+
+	AppendHeader("nzbget_download_paused", "gauge", "1 if download queue is paused.");
+	AppendValue("nzbget_download_paused", NULL, (long long)(g_pOptions->GetPauseDownload() ? 1 : 0));
+
+	AppendHeader("nzbget_download_standby", "gauge", "1 if there are no active downloads.");
+	AppendValue("nzbget_download_standby", NULL, (long long)(bStandBy ? 1 : 0));
+
+	AppendHeader("nzbget_article_cache_bytes", "gauge", "Memory currently used by article cache.");
+	AppendValue("nzbget_article_cache_bytes", NULL, (long long)g_pArticleCache->GetAllocated());
+
+	AppendHeader("nzbget_article_cache_limit_bytes", "gauge", "Configured size of article cache.");
+	AppendValue("nzbget_article_cache_limit_bytes", NULL, (long long)g_pOptions->GetArticleCache() * 1024 * 1024);
+}
+
+void MetricsProcessor::AppendQueueMetrics()
+{
+	struct PostJob
+	{
+		int			iID;
+		char*		szName;
+		int			iStage;
+		int			iStageSec;
+		int			iTotalSec;
+	};
+	typedef std::vector<PostJob> PostJobs;
+
+	int iNZBCount = 0;
+	int iUrlCount = 0;
+	int iFileCount = 0;
+	int iPausedFileCount = 0;
+	long long lRemainingSize = 0;
+	long long lForcedSize = 0;
+	long long lPausedSize = 0;
+	int iLoadedArticles = 0;
+	long long lArticleMemory = 0;
+	int iHistoryCount = 0;
+	PostJobs postJobs;
+	time_t tCurTime = time(NULL);
+
+	// take a snapshot of queue counters, the formatting is done after releasing the lock
+	DownloadQueue* pDownloadQueue = DownloadQueue::LockShared();
+	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
+	{
+		NZBInfo* pNZBInfo = *it;
+		if (pNZBInfo->GetKind() == NZBInfo::nkUrl)
+		{
+			iUrlCount++;
+			continue;
+		}
+
+		iNZBCount++;
+		iFileCount += (int)pNZBInfo->GetFileList()->size();
+		iPausedFileCount += pNZBInfo->GetPausedFileCount();
+		lPausedSize += pNZBInfo->GetPausedSize();
+
+		for (FileList::iterator it2 = pNZBInfo->GetFileList()->begin(); it2 != pNZBInfo->GetFileList()->end(); it2++)
+		{
+			FileInfo* pFileInfo = *it2;
+			iLoadedArticles += (int)pFileInfo->GetArticles()->size();
+			lArticleMemory += pFileInfo->CalcArticleMemory();
+		}
+
+		PostInfo* pPostInfo = pNZBInfo->GetPostInfo();
+		if (pPostInfo)
+		{
+			PostJob postJob;
+			postJob.iID = pNZBInfo->GetID();
+			postJob.szName = strdup(pNZBInfo->GetName());
+			postJob.iStage = (int)pPostInfo->GetStage();
+			postJob.iStageSec = pPostInfo->GetStageTime() ? (int)(tCurTime - pPostInfo->GetStageTime()) : 0;
+			postJob.iTotalSec = pPostInfo->GetStartTime() ? (int)(tCurTime - pPostInfo->GetStartTime()) : 0;
+			postJobs.push_back(postJob);
+		}
+	}
+	pDownloadQueue->CalcRemainingSize(&lRemainingSize, &lForcedSize);
+	iHistoryCount = (int)pDownloadQueue->GetHistory()->size();
+	DownloadQueue::UnlockShared();
+
+	AppendHeader("nzbget_queue_nzbs", "gauge", "Number of nzb-files in download queue.");
+	AppendValue("nzbget_queue_nzbs", NULL, (long long)iNZBCount);
+
+	AppendHeader("nzbget_queue_urls", "gauge", "Number of urls in download queue.");
+	AppendValue("nzbget_queue_urls", NULL, (long long)iUrlCount);
+
+	AppendHeader("nzbget_queue_files", "gauge", "Number of files in download queue.");
+	AppendValue("nzbget_queue_files", NULL, (long long)iFileCount);
+
+	AppendHeader("nzbget_queue_paused_files", "gauge", "Number of paused files in download queue.");
+	AppendValue("nzbget_queue_paused_files", NULL, (long long)iPausedFileCount);
+
+	AppendHeader("nzbget_queue_remaining_bytes", "gauge", "Remaining size of unpaused files in download queue.");
+	AppendValue("nzbget_queue_remaining_bytes", NULL, lRemainingSize);
+
+	AppendHeader("nzbget_queue_forced_bytes", "gauge", "Remaining size of files with force priority.");
+	AppendValue("nzbget_queue_forced_bytes", NULL, lForcedSize);
+
+	AppendHeader("nzbget_queue_paused_bytes", "gauge", "Remaining size of paused files in download queue.");
+	AppendValue("nzbget_queue_paused_bytes", NULL, lPausedSize);
+
+	AppendHeader("nzbget_queue_loaded_articles", "gauge", "Number of articles currently loaded into memory.");
+	AppendValue("nzbget_queue_loaded_articles", NULL, (long long)iLoadedArticles);
+
+	AppendHeader("nzbget_queue_article_memory_bytes", "gauge", "Memory used by loaded articles and their message-ids.");
+	AppendValue("nzbget_queue_article_memory_bytes", NULL, lArticleMemory);
+
+	AppendHeader("nzbget_history_items", "gauge", "Number of items in history.");
+	AppendValue("nzbget_history_items", NULL, (long long)iHistoryCount);
+
+	AppendHeader("nzbget_postprocess_jobs", "gauge", "Number of nzb-files in post-processing queue.");
+	AppendValue("nzbget_postprocess_jobs", NULL, (long long)postJobs.size());
+
+	AppendHeader("nzbget_postprocess_stage_seconds", "gauge", "Time spent in current post-processing stage.");
+	for (PostJobs::iterator it = postJobs.begin(); it != postJobs.end(); it++)
+	{
+		PostJob& postJob = *it;
+		// names can be of any length, the labels are therefore built piecewise
+		char* szName = EscapeLabel(postJob.szName);
+		char szID[50];
+		snprintf(szID, 50, "id=\"%i\",name=\"", postJob.iID);
+		szID[50-1] = '\0';
+		StringBuilder labels;
+		labels.Append(szID);
+		labels.Append(szName);
+		labels.Append("\",stage=\"");
+		labels.Append(POST_STAGE_NAMES[postJob.iStage]);
+		labels.Append("\"");
+		AppendValue("nzbget_postprocess_stage_seconds", labels.GetBuffer(), (long long)postJob.iStageSec);
+		free(szName);
+	}
+
+	AppendHeader("nzbget_postprocess_total_seconds", "gauge", "Time since start of post-processing.");
+	for (PostJobs::iterator it = postJobs.begin(); it != postJobs.end(); it++)
+	{
+		PostJob& postJob = *it;
+		char szLabels[100];
+		snprintf(szLabels, 100, "id=\"%i\"", postJob.iID);
+		szLabels[100-1] = '\0';
+		AppendValue("nzbget_postprocess_total_seconds", szLabels, (long long)postJob.iTotalSec);
+		free(postJob.szName);
+	}
+}
+
+void MetricsProcessor::AppendServerMetrics()
+{
+	Servers* pServers = g_pServerPool->GetServers();
+
+	AppendHeader("nzbget_server_active", "gauge", "1 if news-server is active.");
+	for (Servers::iterator it = pServers->begin(); it != pServers->end(); it++)
+	{
+		NewsServer* pServer = *it;
+		char* szName = EscapeLabel(pServer->GetName());
+		char szID[50];
+		snprintf(szID, 50, "server=\"%i\",name=\"", pServer->GetID());
+		szID[50-1] = '\0';
+		StringBuilder labels;
+		labels.Append(szID);
+		labels.Append(szName);
+		labels.Append("\"");
+		AppendValue("nzbget_server_active", labels.GetBuffer(), (long long)(pServer->GetActive() ? 1 : 0));
+		free(szName);
+	}
+
+	AppendHeader("nzbget_server_bytes_total", "counter", "Total amount of data downloaded from news-server.");
+	ServerVolumes* pServerVolumes = g_pStatMeter->LockServerVolumes();
+	for (Servers::iterator it = pServers->begin(); it != pServers->end(); it++)
+	{
+		NewsServer* pServer = *it;
+		if (pServer->GetID() < (int)pServerVolumes->size())
+		{
+			char szLabels[100];
+			snprintf(szLabels, 100, "server=\"%i\"", pServer->GetID());
+			szLabels[100-1] = '\0';
+			AppendValue("nzbget_server_bytes_total", szLabels, pServerVolumes->at(pServer->GetID())->GetTotalBytes());
+		}
+	}
+	g_pStatMeter->UnlockServerVolumes();
+}
+
+void MetricsProcessor::AppendTimingMetrics()
+{
+	Servers* pServers = g_pServerPool->GetServers();
+	ServerTimings* pServerTimings = g_pStatMeter->LockServerTimings();
+
+	AppendHeader("nzbget_server_articles_total", "counter", "Number of article download attempts per news-server.");
+	for (Servers::iterator it = pServers->begin(); it != pServers->end(); it++)
+	{
+		NewsServer* pServer = *it;
+		if (pServer->GetID() < (int)pServerTimings->size())
+		{
+			ServerTiming* pServerTiming = pServerTimings->at(pServer->GetID());
+			char szLabels[100];
+			snprintf(szLabels, 100, "server=\"%i\",result=\"success\"", pServer->GetID());
+			szLabels[100-1] = '\0';
+			AppendValue("nzbget_server_articles_total", szLabels, pServerTiming->GetSuccessArticles());
+			snprintf(szLabels, 100, "server=\"%i\",result=\"failure\"", pServer->GetID());
+			szLabels[100-1] = '\0';
+			AppendValue("nzbget_server_articles_total", szLabels, pServerTiming->GetFailedArticles());
+		}
+	}
+
+	AppendHeader("nzbget_article_phase_seconds", "histogram", "Time spent in phases of article download.");
+	for (Servers::iterator it = pServers->begin(); it != pServers->end(); it++)
+	{
+		NewsServer* pServer = *it;
+		if (pServer->GetID() >= (int)pServerTimings->size())
+		{
+			continue;
+		}
+
+		ServerTiming* pServerTiming = pServerTimings->at(pServer->GetID());
+		for (int iPhase = 0; iPhase < ServerTiming::PHASES; iPhase++)
+		{
+			TimeHistogram* pHistogram = pServerTiming->GetHistogram((ServerTiming::EPhase)iPhase);
+			const char* szPhase = ServerTiming::GetPhaseName((ServerTiming::EPhase)iPhase);
+			char szLabels[200];
+
+			// histogram buckets in exposition format are cumulative
+			long long lCumulative = 0;
+			for (int j = 0; j < TimeHistogram::BUCKETS; j++)
+			{
+				lCumulative += pHistogram->GetBucket(j);
+				int iLimit = TimeHistogram::GetBucketLimit(j);
+				if (iLimit > -1)
+				{
+					snprintf(szLabels, 200, "server=\"%i\",phase=\"%s\",le=\"%g\"", pServer->GetID(), szPhase, iLimit / 1000.0);
+				}
+				else
+				{
+					snprintf(szLabels, 200, "server=\"%i\",phase=\"%s\",le=\"+Inf\"", pServer->GetID(), szPhase);
+				}
+				szLabels[200-1] = '\0';
+				AppendValue("nzbget_article_phase_seconds_bucket", szLabels, lCumulative);
+			}
+
+			snprintf(szLabels, 200, "server=\"%i\",phase=\"%s\"", pServer->GetID(), szPhase);
+			szLabels[200-1] = '\0';
+			AppendValue("nzbget_article_phase_seconds_sum", szLabels, pHistogram->GetTotalUSec() / 1000000.0);
+			AppendValue("nzbget_article_phase_seconds_count", szLabels, (long long)pHistogram->GetCount());
+		}
+	}
+
+	g_pStatMeter->UnlockServerTimings();
+}
+
+void MetricsProcessor::AppendSystemMetrics()
+{
+	AppendHeader("nzbget_threads", "gauge", "Number of running threads.");
+	AppendValue("nzbget_threads", NULL, (long long)(Thread::GetThreadCount() - 1)); // not counting itself
+
+	long long lLockWaitUSec, lLockCount, lSharedWaitUSec, lSharedCount;
+	DownloadQueue::GetLockStat(&lLockWaitUSec, &lLockCount, &lSharedWaitUSec, &lSharedCount);
+
+	AppendHeader("nzbget_queue_lock_wait_seconds_total", "counter", "Total time threads spent waiting for download queue lock.");
+	AppendValue("nzbget_queue_lock_wait_seconds_total", "mode=\"exclusive\"", lLockWaitUSec / 1000000.0);
+	AppendValue("nzbget_queue_lock_wait_seconds_total", "mode=\"shared\"", lSharedWaitUSec / 1000000.0);
+
+	AppendHeader("nzbget_queue_lock_acquisitions_total", "counter", "Number of times download queue lock was acquired.");
+	AppendValue("nzbget_queue_lock_acquisitions_total", "mode=\"exclusive\"", lLockCount);
+	AppendValue("nzbget_queue_lock_acquisitions_total", "mode=\"shared\"", lSharedCount);
+}
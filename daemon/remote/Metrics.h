@@ -0,0 +1,58 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "Util.h"
+
+/*
+ * Builds program statistics in Prometheus text exposition format.
+ * The download queue is locked only for the time needed to copy the values.
+ */
+class MetricsProcessor
+{
+private:
+	StringBuilder		m_cResponse;
+
+	void				AppendHeader(const char* szName, const char* szType, const char* szHelp);
+	void				AppendName(const char* szName, const char* szLabels);
+	void				AppendValue(const char* szName, const char* szLabels, long long lValue);
+	void				AppendValue(const char* szName, const char* szLabels, double fValue);
+	void				AppendSpeedMetrics();
+	void				AppendQueueMetrics();
+	void				AppendServerMetrics();
+	void				AppendTimingMetrics();
+	void				AppendSystemMetrics();
+	static char*		EscapeLabel(const char* szValue);
+
+public:
+	void				Execute();
+	const char*			GetResponse() { return m_cResponse.GetBuffer(); }
+	static const char*	GetContentType() { return "text/plain; version=0.0.4"; }
+	static bool			IsMetricsRequest(const char* szUrl);
+};
+
+#endif
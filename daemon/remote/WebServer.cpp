@@ -41,6 +41,7 @@
 #include "nzbget.h"
 #include "WebServer.h"
 #include "XmlRpc.h"
+#include "Metrics.h"
 #include "Log.h"
 #include "Options.h"
 #include "Util.h"
@@ -273,6 +274,19 @@ void WebProcessor::Dispatch()
 		return;
 	}
 
+	if (MetricsProcessor::IsMetricsRequest(m_szUrl))
+	{
+		if (m_eUserAccess == uaAdd)
+		{
+			SendAuthResponse();
+			return;
+		}
+		MetricsProcessor processor;
+		processor.Execute();
+		SendBodyResponse(processor.GetResponse(), strlen(processor.GetResponse()), MetricsProcessor::GetContentType());
+		return;
+	}
+
 	if (Util::EmptyStr(g_pOptions->GetWebDir()))
 	{
 		SendErrorResponse(ERR_HTTP_SERVICE_UNAVAILABLE);
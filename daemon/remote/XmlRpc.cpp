@@ -38,6 +38,8 @@
 #ifndef WIN32
 #include <unistd.h>
 #endif
+#include <vector>
+#include <algorithm>
 
 #include "nzbget.h"
 #include "XmlRpc.h"
@@ -131,6 +133,7 @@ public:
 class LogXmlCommand: public XmlCommand
 {
 protected:
+	MessageList				m_messages;
 	int						m_iIDFrom;
 	int						m_iNrEntries;
 	virtual MessageList*	LockMessages();
@@ -199,8 +202,14 @@ public:
 class HistoryXmlCommand: public NzbInfoXmlCommand
 {
 private:
-	const char*			DetectStatus(HistoryInfo* pHistoryInfo);
+	bool				m_bPaged;
+	int					m_iIndex;
+
+	void				AppendHistoryItem(HistoryInfo* pHistoryInfo);
+	void				ExecutePaged();
+
 public:
+						HistoryXmlCommand(bool bPaged);
 	virtual void		Execute();
 };
 
@@ -293,12 +302,16 @@ public:
 	virtual void		Execute();
 };
 
+class ServerTimingsXmlCommand: public XmlCommand
+{
+public:
+	virtual void		Execute();
+};
+
 class LoadLogXmlCommand: public LogXmlCommand
 {
 private:
-	MessageList				m_messages;
 	int						m_iNZBID;
-	NZBInfo*				m_pNZBInfo;
 protected:
 	virtual void			Execute();
 	virtual MessageList*	LockMessages();
@@ -689,7 +702,11 @@ XmlCommand* XmlRpcProcessor::CreateCommand(const char* szMethodName)
 	}
 	else if (!strcasecmp(szMethodName, "history"))
 	{
-		command = new HistoryXmlCommand();
+		command = new HistoryXmlCommand(false);
+	}
+	else if (!strcasecmp(szMethodName, "historypage"))
+	{
+		command = new HistoryXmlCommand(true);
 	}
 	else if (!strcasecmp(szMethodName, "urlqueue"))
 	{
@@ -751,6 +768,10 @@ XmlCommand* XmlRpcProcessor::CreateCommand(const char* szMethodName)
 	{
 		command = new ResetServerVolumeXmlCommand();
 	}
+	else if (!strcasecmp(szMethodName, "servertimings"))
+	{
+		command = new ServerTimingsXmlCommand();
+	}
 	else if (!strcasecmp(szMethodName, "testserver"))
 	{
 		command = new TestServerXmlCommand();
@@ -1325,7 +1346,7 @@ void StatusXmlCommand::Execute()
 		"\"Active\" : %s\n"
 		"}";
 
-	DownloadQueue *pDownloadQueue = DownloadQueue::Lock();
+	DownloadQueue *pDownloadQueue = DownloadQueue::LockShared();
 	int iPostJobCount = 0;
 	int iUrlCount = 0;
 	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
@@ -1336,7 +1357,7 @@ void StatusXmlCommand::Execute()
 	}
 	long long iRemainingSize, iForcedSize;
 	pDownloadQueue->CalcRemainingSize(&iRemainingSize, &iForcedSize);
-	DownloadQueue::Unlock();
+	DownloadQueue::UnlockShared();
 
 	unsigned long iRemainingSizeHi, iRemainingSizeLo;
 	Util::SplitInt64(iRemainingSize, &iRemainingSizeHi, &iRemainingSizeLo);
@@ -1489,12 +1510,12 @@ void LogXmlCommand::Execute()
 
 MessageList* LogXmlCommand::LockMessages()
 {
-	return g_pLog->LockMessages();
+	g_pLog->GetMessages(&m_messages, m_iIDFrom, m_iNrEntries);
+	return &m_messages;
 }
 
 void LogXmlCommand::UnlockMessages()
 {
-	g_pLog->UnlockMessages();
 }
 
 // struct[] listfiles(int IDFrom, int IDTo, int NZBID) 
@@ -1523,7 +1544,7 @@ void ListFilesXmlCommand::Execute()
 	debug("iIDEnd=%i", iIDEnd);
 
 	AppendResponse(IsJson() ? "[\n" : "<array><data>\n");
-	DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
+	DownloadQueue* pDownloadQueue = DownloadQueue::LockShared();
 
 	const char* XML_LIST_ITEM = 
 		"<value><struct>\n"
@@ -1624,7 +1645,7 @@ void ListFilesXmlCommand::Execute()
 	}
 	free(szItemBuf);
 
-	DownloadQueue::Unlock();
+	DownloadQueue::UnlockShared();
 	AppendResponse(IsJson() ? "\n]" : "</data></array>\n");
 }
 
@@ -1997,7 +2018,9 @@ void NzbInfoXmlCommand::AppendPostInfoFields(PostInfo* pPostInfo, int iLogEntrie
 
 	if (iLogEntries > 0 && pPostInfo)
 	{
-		MessageList* pMessages = pPostInfo->GetNZBInfo()->LockCachedMessages();
+		MessageList messages;
+		MessageList* pMessages = &messages;
+		pPostInfo->GetNZBInfo()->GetCachedMessages(pMessages, 0, iLogEntries);
 		if (!pMessages->empty())
 		{
 			if (iLogEntries > (int)pMessages->size())
@@ -2023,7 +2046,6 @@ void NzbInfoXmlCommand::AppendPostInfoFields(PostInfo* pPostInfo, int iLogEntrie
 				AppendResponse(szItemBuf);
 			}
 		}
-		pPostInfo->GetNZBInfo()->UnlockCachedMessages();
 	}
 
 	AppendResponse(IsJson() ? JSON_POSTQUEUE_ITEM_END : XML_POSTQUEUE_ITEM_END);
@@ -2083,7 +2105,7 @@ void ListGroupsXmlCommand::Execute()
 	char* szItemBuf = (char*)malloc(iItemBufSize);
 	int index = 0;
 
-	DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
+	DownloadQueue* pDownloadQueue = DownloadQueue::LockShared();
 
 	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
 	{
@@ -2120,7 +2142,7 @@ void ListGroupsXmlCommand::Execute()
 		AppendResponse(IsJson() ? JSON_LIST_ITEM_END : XML_LIST_ITEM_END);
 	}
 
-	DownloadQueue::Unlock();
+	DownloadQueue::UnlockShared();
 
 	free(szItemBuf);
 
@@ -2449,7 +2471,7 @@ void PostQueueXmlCommand::Execute()
 
     const char* szPostStageName[] = { "QUEUED", "LOADING_PARS", "VERIFYING_SOURCES", "REPAIRING", "VERIFYING_REPAIRED", "RENAMING", "UNPACKING", "MOVING", "EXECUTING_SCRIPT", "FINISHED" };
 
-	NZBList* pNZBList = DownloadQueue::Lock()->GetQueue();
+	NZBList* pNZBList = DownloadQueue::LockShared()->GetQueue();
 
 	int iItemBufSize = 10240;
 	char* szItemBuf = (char*)malloc(iItemBufSize);
@@ -2489,7 +2511,7 @@ void PostQueueXmlCommand::Execute()
 	}
 	free(szItemBuf);
 
-	DownloadQueue::Unlock();
+	DownloadQueue::UnlockShared();
 
 	AppendResponse(IsJson() ? "\n]" : "</data></array>\n");
 }
@@ -2569,12 +2591,49 @@ void ScanXmlCommand::Execute()
 	BuildBoolResponse(true);
 }
 
+HistoryXmlCommand::HistoryXmlCommand(bool bPaged)
+{
+	m_bPaged = bPaged;
+	m_iIndex = 0;
+}
+
 // struct[] history(bool hidden)
 // Parameter "hidden" is optional (new in v12)
 void HistoryXmlCommand::Execute()
 {
+	if (m_bPaged)
+	{
+		ExecutePaged();
+		return;
+	}
+
 	AppendResponse(IsJson() ? "[\n" : "<array><data>\n");
 
+	bool bDup = false;
+	NextParamAsBool(&bDup);
+
+	DownloadQueue* pDownloadQueue = DownloadQueue::LockShared();
+
+	m_iIndex = 0;
+	for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
+	{
+		HistoryInfo* pHistoryInfo = *it;
+
+		if (pHistoryInfo->GetKind() == HistoryInfo::hkDup && !bDup)
+		{
+			continue;
+		}
+
+		AppendHistoryItem(pHistoryInfo);
+	}
+
+	AppendResponse(IsJson() ? "\n]" : "</data></array>\n");
+
+	DownloadQueue::UnlockShared();
+}
+
+void HistoryXmlCommand::AppendHistoryItem(HistoryInfo* pHistoryInfo)
+{
 	const char* XML_HISTORY_ITEM_START =
 		"<value><struct>\n"
 		"<member><name>ID</name><value><i4>%i</i4></value></member>\n"					// Deprecated, use "NZBID" instead
@@ -2634,101 +2693,441 @@ void HistoryXmlCommand::Execute()
 	const char* szDupStatusName[] = { "UNKNOWN", "SUCCESS", "FAILURE", "DELETED", "DUPE", "BAD", "GOOD" };
     const char* szDupeModeName[] = { "SCORE", "ALL", "FORCE" };
 
-	bool bDup = false;
-	NextParamAsBool(&bDup);
+	const int iItemBufSize = 10240;
+	char szItemBuf[iItemBufSize];
 
-	DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
+	NZBInfo* pNZBInfo = NULL;
+	char szNicename[1024];
+	pHistoryInfo->GetName(szNicename, sizeof(szNicename));
 
-	int iItemBufSize = 10240;
-	char* szItemBuf = (char*)malloc(iItemBufSize);
-	int index = 0;
+	char *xmlNicename = EncodeStr(szNicename);
+	const char* szStatus = pHistoryInfo->MakeTextStatus();
 
-	for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
+	if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb ||
+		pHistoryInfo->GetKind() == HistoryInfo::hkUrl)
 	{
-		HistoryInfo* pHistoryInfo = *it;
+		pNZBInfo = pHistoryInfo->GetNZBInfo();
 
-		if (pHistoryInfo->GetKind() == HistoryInfo::hkDup && !bDup)
-		{
-			continue;
-		}
+		snprintf(szItemBuf, iItemBufSize, IsJson() ? JSON_HISTORY_ITEM_START : XML_HISTORY_ITEM_START,
+			pHistoryInfo->GetID(), xmlNicename, pNZBInfo->GetParkedFileCount(),
+			pHistoryInfo->GetTime(), szStatus);
+	}
+	else if (pHistoryInfo->GetKind() == HistoryInfo::hkDup)
+	{
+		DupInfo* pDupInfo = pHistoryInfo->GetDupInfo();
 
-		NZBInfo* pNZBInfo = NULL;
-		char szNicename[1024];
-		pHistoryInfo->GetName(szNicename, sizeof(szNicename));
+		unsigned long iFileSizeHi, iFileSizeLo, iFileSizeMB;
+		Util::SplitInt64(pDupInfo->GetSize(), &iFileSizeHi, &iFileSizeLo);
+		iFileSizeMB = (int)(pDupInfo->GetSize() / 1024 / 1024);
 
-		char *xmlNicename = EncodeStr(szNicename);
-		const char* szStatus = DetectStatus(pHistoryInfo);
+		char* xmlDupeKey = EncodeStr(pDupInfo->GetDupeKey());
 
-		if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb ||
-			pHistoryInfo->GetKind() == HistoryInfo::hkUrl)
-		{
-			pNZBInfo = pHistoryInfo->GetNZBInfo();
+		snprintf(szItemBuf, iItemBufSize, IsJson() ? JSON_HISTORY_DUP_ITEM : XML_HISTORY_DUP_ITEM,
+			pHistoryInfo->GetID(), pHistoryInfo->GetID(), "DUP", xmlNicename, pHistoryInfo->GetTime(),
+			iFileSizeLo, iFileSizeHi, iFileSizeMB, xmlDupeKey, pDupInfo->GetDupeScore(),
+			szDupeModeName[pDupInfo->GetDupeMode()], szDupStatusName[pDupInfo->GetStatus()],
+			szStatus);
+
+		free(xmlDupeKey);
+	}
+
+	szItemBuf[iItemBufSize-1] = '\0';
+
+	free(xmlNicename);
+
+	if (IsJson() && m_iIndex++ > 0)
+	{
+		AppendResponse(",\n");
+	}
+	AppendResponse(szItemBuf);
+
+	if (pNZBInfo)
+	{
+		AppendNZBInfoFields(pNZBInfo);
+	}
+
+	AppendResponse(IsJson() ? JSON_HISTORY_ITEM_END : XML_HISTORY_ITEM_END);
+}
+
+// Status groups used by the filter buttons in web-interface
+enum EHistoryStatusGroup
+{
+	sgAll,
+	sgSuccess,
+	sgFailure,
+	sgDeleted,
+	sgDupe
+};
+
+struct HistoryPageItem
+{
+	int					m_iID;
+	time_t				m_tTime;
+	long long			m_lSize;
+	const char*			m_szName;
+	const char*			m_szCategory;
+	const char*			m_szStatus;
+	EHistoryStatusGroup	m_eStatusGroup;
+	HistoryInfo*		m_pHistoryInfo;
+	ArchiveEntry*		m_pArchiveEntry;
+};
+
+typedef std::vector<HistoryPageItem> HistoryPageList;
+typedef std::vector<const char*> FilterWords;
+
+class HistorySorter
+{
+public:
+	enum ESortCriteria
+	{
+		scNone,
+		scName,
+		scTime,
+		scSize,
+		scCategory,
+		scStatus
+	};
+
+private:
+	ESortCriteria			m_eSortCriteria;
+	bool					m_bDescending;
+
+public:
+							HistorySorter() : m_eSortCriteria(scNone), m_bDescending(false) {}
+	bool					Init(const char* szSort);
+	bool					IsActive() { return m_eSortCriteria != scNone; }
+	bool					operator()(const HistoryPageItem& Item1, const HistoryPageItem& Item2) const;
+};
+
+/*
+ * Sort criteria may have suffix "+" (ascending) or "-" (descending).
+ * Without suffix times and sizes are sorted in descending order,
+ * all other fields in ascending order.
+ */
+bool HistorySorter::Init(const char* szSort)
+{
+	int iLen = strlen(szSort);
+	char lastCh = iLen > 0 ? szSort[iLen - 1] : '\0';
+	if (lastCh == '+' || lastCh == '-')
+	{
+		iLen--;
+	}
+
+	if (iLen == 0)
+	{
+		m_eSortCriteria = scNone;
+		return true;
+	}
+	else if (!strncasecmp(szSort, "name", iLen) && iLen == 4)
+	{
+		m_eSortCriteria = scName;
+	}
+	else if (!strncasecmp(szSort, "time", iLen) && iLen == 4)
+	{
+		m_eSortCriteria = scTime;
+	}
+	else if (!strncasecmp(szSort, "size", iLen) && iLen == 4)
+	{
+		m_eSortCriteria = scSize;
+	}
+	else if (!strncasecmp(szSort, "category", iLen) && iLen == 8)
+	{
+		m_eSortCriteria = scCategory;
+	}
+	else if (!strncasecmp(szSort, "status", iLen) && iLen == 6)
+	{
+		m_eSortCriteria = scStatus;
+	}
+	else
+	{
+		return false;
+	}
 
-			snprintf(szItemBuf, iItemBufSize, IsJson() ? JSON_HISTORY_ITEM_START : XML_HISTORY_ITEM_START,
-				pHistoryInfo->GetID(), xmlNicename, pNZBInfo->GetParkedFileCount(),
-				pHistoryInfo->GetTime(), szStatus);
+	m_bDescending = lastCh == '-' ||
+		(lastCh != '+' && (m_eSortCriteria == scTime || m_eSortCriteria == scSize));
+
+	return true;
+}
+
+bool HistorySorter::operator()(const HistoryPageItem& Item1, const HistoryPageItem& Item2) const
+{
+	const HistoryPageItem& First = m_bDescending ? Item2 : Item1;
+	const HistoryPageItem& Second = m_bDescending ? Item1 : Item2;
+
+	switch (m_eSortCriteria)
+	{
+		case scName:
+			return strcasecmp(First.m_szName, Second.m_szName) < 0;
+
+		case scTime:
+			return First.m_tTime < Second.m_tTime;
+
+		case scSize:
+			return First.m_lSize < Second.m_lSize;
+
+		case scCategory:
+			return strcasecmp(First.m_szCategory, Second.m_szCategory) < 0;
+
+		case scStatus:
+			return strcmp(First.m_szStatus, Second.m_szStatus) < 0;
+
+		default:
+			return false;
+	}
+}
+
+static bool ContainsNoCase(const char* szStr, const char* szSubstr)
+{
+	int iLen = strlen(szSubstr);
+	for (const char* p = szStr; *p; p++)
+	{
+		if (!strncasecmp(p, szSubstr, iLen))
+		{
+			return true;
 		}
-		else if (pHistoryInfo->GetKind() == HistoryInfo::hkDup)
+	}
+	return iLen == 0;
+}
+
+/*
+ * The filter consists of words separated with spaces. An item matches
+ * if every word is found in its name, category or status.
+ */
+static bool MatchHistoryFilter(HistoryPageItem* pItem, FilterWords* pFilterWords)
+{
+	for (FilterWords::iterator it = pFilterWords->begin(); it != pFilterWords->end(); it++)
+	{
+		const char* szWord = *it;
+		if (!ContainsNoCase(pItem->m_szName, szWord) &&
+			!ContainsNoCase(pItem->m_szCategory, szWord) &&
+			!ContainsNoCase(pItem->m_szStatus, szWord))
 		{
-			DupInfo* pDupInfo = pHistoryInfo->GetDupInfo();
+			return false;
+		}
+	}
+	return true;
+}
 
-			unsigned long iFileSizeHi, iFileSizeLo, iFileSizeMB;
-			Util::SplitInt64(pDupInfo->GetSize(), &iFileSizeHi, &iFileSizeLo);
-			iFileSizeMB = (int)(pDupInfo->GetSize() / 1024 / 1024);
+static EHistoryStatusGroup MakeHistoryStatusGroup(const char* szStatus)
+{
+	if (!strcmp(szStatus, "DELETED/MANUAL"))
+	{
+		return sgDeleted;
+	}
+	else if (!strcmp(szStatus, "DELETED/DUPE"))
+	{
+		return sgDupe;
+	}
+	else if (!strncmp(szStatus, "SUCCESS", 7))
+	{
+		return sgSuccess;
+	}
+	else
+	{
+		return sgFailure;
+	}
+}
 
-			char* xmlDupeKey = EncodeStr(pDupInfo->GetDupeKey());
+static bool ParseHistoryStatusGroup(const char* szGroup, EHistoryStatusGroup* pStatusGroup)
+{
+	const char* Groups[] = { "ALL", "SUCCESS", "FAILURE", "DELETED", "DUPE" };
 
-			snprintf(szItemBuf, iItemBufSize, IsJson() ? JSON_HISTORY_DUP_ITEM : XML_HISTORY_DUP_ITEM,
-				pHistoryInfo->GetID(), pHistoryInfo->GetID(), "DUP", xmlNicename, pHistoryInfo->GetTime(),
-				iFileSizeLo, iFileSizeHi, iFileSizeMB, xmlDupeKey, pDupInfo->GetDupeScore(),
-				szDupeModeName[pDupInfo->GetDupeMode()], szDupStatusName[pDupInfo->GetStatus()],
-				szStatus);
+	if (!*szGroup)
+	{
+		*pStatusGroup = sgAll;
+		return true;
+	}
 
-			free(xmlDupeKey);
+	for (int i = 0; i < (int)(sizeof(Groups) / sizeof(char*)); i++)
+	{
+		if (!strcasecmp(szGroup, Groups[i]))
+		{
+			*pStatusGroup = (EHistoryStatusGroup)i;
+			return true;
 		}
+	}
 
-		szItemBuf[iItemBufSize-1] = '\0';
+	return false;
+}
 
-		free(xmlNicename);
+// struct historypage(bool hidden, int offset, int limit, string sort, string filter, bool archive, string status)
+// All parameters are optional. Returns the number of matching items (member "TotalCount")
+// and the requested page of items (member "Items") in the format of method "history".
+// Limit "0" returns all items starting from offset. Items from the history archive
+// (see option "ArchiveHistory") are listed with the newest items first.
+// Parameter "status" limits the items to one of groups "SUCCESS", "FAILURE", "DELETED"
+// or "DUPE". The sizes of the groups and the number of items before filtering
+// are returned in members "SuccessCount", "FailureCount", "DeletedCount", "DupeCount"
+// and "UnfilteredCount".
+void HistoryXmlCommand::ExecutePaged()
+{
+	bool bDup = false;
+	int iOffset = 0;
+	int iLimit = 0;
+	char* szSort = NULL;
+	char* szFilter = NULL;
+	bool bArchive = false;
+	char* szStatus = NULL;
 
-		if (IsJson() && index++ > 0)
+	NextParamAsBool(&bDup);
+	NextParamAsInt(&iOffset);
+	NextParamAsInt(&iLimit);
+	if (NextParamAsStr(&szSort))
+	{
+		DecodeStr(szSort);
+	}
+	if (NextParamAsStr(&szFilter))
+	{
+		DecodeStr(szFilter);
+	}
+	NextParamAsBool(&bArchive);
+	if (NextParamAsStr(&szStatus))
+	{
+		DecodeStr(szStatus);
+	}
+
+	HistorySorter sorter;
+	EHistoryStatusGroup eStatusGroup = sgAll;
+	if (iOffset < 0 || iLimit < 0 || (szSort && !sorter.Init(szSort)) ||
+		(szStatus && !ParseHistoryStatusGroup(szStatus, &eStatusGroup)))
+	{
+		BuildErrorResponse(2, "Invalid parameter");
+		return;
+	}
+
+	FilterWords filterWords;
+	if (szFilter)
+	{
+		Tokenizer tok(szFilter, " ", true);
+		while (const char* szWord = tok.Next())
 		{
-			AppendResponse(",\n");
+			filterWords.push_back(szWord);
 		}
-		AppendResponse(szItemBuf);
+	}
 
-		if (pNZBInfo)
+	HistoryPageList items;
+	ArchiveIndex* pArchiveIndex = NULL;
+	DownloadQueue* pDownloadQueue = NULL;
+
+	if (bArchive)
+	{
+		if (!g_pDiskState)
 		{
-			AppendNZBInfoFields(pNZBInfo);
+			BuildErrorResponse(3, "History archive is not available");
+			return;
+		}
+
+		pArchiveIndex = g_pDiskState->LockHistoryArchive();
+		items.reserve(pArchiveIndex->size());
+		for (ArchiveIndex::reverse_iterator it = pArchiveIndex->rbegin(); it != pArchiveIndex->rend(); it++)
+		{
+			ArchiveEntry* pArchiveEntry = *it;
+			if (pArchiveEntry->GetKind() != HistoryInfo::hkDup || bDup)
+			{
+				HistoryPageItem item = { pArchiveEntry->GetID(), pArchiveEntry->GetTime(), pArchiveEntry->GetSize(),
+					pArchiveEntry->GetName(), pArchiveEntry->GetCategory(), pArchiveEntry->GetStatus(),
+					MakeHistoryStatusGroup(pArchiveEntry->GetStatus()), NULL, pArchiveEntry };
+				items.push_back(item);
+			}
 		}
-		
-		AppendResponse(IsJson() ? JSON_HISTORY_ITEM_END : XML_HISTORY_ITEM_END);
 	}
-	free(szItemBuf);
+	else
+	{
+		pDownloadQueue = DownloadQueue::LockShared();
+		items.reserve(pDownloadQueue->GetHistory()->size());
+		for (HistoryList::iterator it = pDownloadQueue->GetHistory()->begin(); it != pDownloadQueue->GetHistory()->end(); it++)
+		{
+			HistoryInfo* pHistoryInfo = *it;
+			if (pHistoryInfo->GetKind() == HistoryInfo::hkDup && !bDup)
+			{
+				continue;
+			}
 
-	AppendResponse(IsJson() ? "\n]" : "</data></array>\n");
+			bool bNzb = pHistoryInfo->GetKind() != HistoryInfo::hkDup;
+			const char* szTextStatus = pHistoryInfo->MakeTextStatus();
+			HistoryPageItem item = { pHistoryInfo->GetID(), pHistoryInfo->GetTime(),
+				bNzb ? pHistoryInfo->GetNZBInfo()->GetSize() : pHistoryInfo->GetDupInfo()->GetSize(),
+				bNzb ? pHistoryInfo->GetNZBInfo()->GetName() : pHistoryInfo->GetDupInfo()->GetName(),
+				bNzb ? pHistoryInfo->GetNZBInfo()->GetCategory() : "",
+				szTextStatus, MakeHistoryStatusGroup(szTextStatus), pHistoryInfo, NULL };
+			items.push_back(item);
+		}
+	}
 
-	DownloadQueue::Unlock();
-}
+	int iUnfilteredCount = (int)items.size();
+	int GroupCounts[sgDupe + 1] = { 0 };
 
-const char* HistoryXmlCommand::DetectStatus(HistoryInfo* pHistoryInfo)
-{
-	const char* szStatus = "FAILURE/INTERNAL_ERROR";
+	int iMatchCount = 0;
+	for (int i = 0; i < iUnfilteredCount; i++)
+	{
+		HistoryPageItem& item = items[i];
+		if (MatchHistoryFilter(&item, &filterWords))
+		{
+			GroupCounts[item.m_eStatusGroup]++;
+			if (eStatusGroup == sgAll || item.m_eStatusGroup == eStatusGroup)
+			{
+				items[iMatchCount++] = item;
+			}
+		}
+	}
+	items.resize(iMatchCount);
 
-	if (pHistoryInfo->GetKind() == HistoryInfo::hkNzb || pHistoryInfo->GetKind() == HistoryInfo::hkUrl)
+	if (sorter.IsActive())
 	{
-		NZBInfo* pNZBInfo = pHistoryInfo->GetNZBInfo();
-		szStatus = pNZBInfo->MakeTextStatus(false);
+		std::stable_sort(items.begin(), items.end(), sorter);
 	}
-	else if (pHistoryInfo->GetKind() == HistoryInfo::hkDup)
+
+	int iTotalCount = (int)items.size();
+	int iEnd = iLimit > 0 && iLimit < iTotalCount - iOffset ? iOffset + iLimit : iTotalCount;
+
+	char szContent[1024];
+	snprintf(szContent, sizeof(szContent), IsJson() ?
+		"{\n\"TotalCount\" : %i,\n\"Offset\" : %i,\n\"UnfilteredCount\" : %i,\n"
+		"\"SuccessCount\" : %i,\n\"FailureCount\" : %i,\n\"DeletedCount\" : %i,\n\"DupeCount\" : %i,\n"
+		"\"Items\" : [\n" :
+		"<struct>\n<member><name>TotalCount</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>Offset</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>UnfilteredCount</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>SuccessCount</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>FailureCount</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>DeletedCount</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>DupeCount</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>Items</name><value><array><data>\n",
+		iTotalCount, iOffset, iUnfilteredCount, GroupCounts[sgSuccess], GroupCounts[sgFailure],
+		GroupCounts[sgDeleted], GroupCounts[sgDupe]);
+	szContent[1024-1] = '\0';
+	AppendResponse(szContent);
+
+	m_iIndex = 0;
+	for (int i = iOffset; i < iEnd; i++)
 	{
-		DupInfo* pDupInfo = pHistoryInfo->GetDupInfo();
-		const char* szDupStatusName[] = { "FAILURE/INTERNAL_ERROR", "SUCCESS/HIDDEN", "FAILURE/HIDDEN",
-			"DELETED/MANUAL", "DELETED/DUPE", "FAILURE/BAD", "SUCCESS/GOOD" };
-		szStatus = szDupStatusName[pDupInfo->GetStatus()];
+		HistoryPageItem* pItem = &items[i];
+		if (pItem->m_pHistoryInfo)
+		{
+			AppendHistoryItem(pItem->m_pHistoryInfo);
+		}
+		else
+		{
+			HistoryInfo* pHistoryInfo = g_pDiskState->LoadArchivedHistoryInfo(pItem->m_pArchiveEntry,
+				g_pServerPool->GetServers());
+			if (pHistoryInfo)
+			{
+				AppendHistoryItem(pHistoryInfo);
+				delete pHistoryInfo;
+			}
+		}
 	}
 
-	return szStatus;
+	AppendResponse(IsJson() ? "\n]\n}" : "</data></array></value></member>\n</struct>\n");
+
+	if (bArchive)
+	{
+		g_pDiskState->UnlockHistoryArchive();
+	}
+	else
+	{
+		DownloadQueue::UnlockShared();
+	}
 }
 
 // Deprecated in v13
@@ -2756,7 +3155,7 @@ void UrlQueueXmlCommand::Execute()
 		"\"Priority\" : %i\n"
 		"}";
 
-	DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
+	DownloadQueue* pDownloadQueue = DownloadQueue::LockShared();
 
 	int iItemBufSize = 10240;
 	char* szItemBuf = (char*)malloc(iItemBufSize);
@@ -2791,7 +3190,7 @@ void UrlQueueXmlCommand::Execute()
 	}
 	free(szItemBuf);
 
-	DownloadQueue::Unlock();
+	DownloadQueue::UnlockShared();
 
 	AppendResponse(IsJson() ? "\n]" : "</data></array>\n");
 }
@@ -3586,10 +3985,127 @@ void ResetServerVolumeXmlCommand::Execute()
 	BuildBoolResponse(bOK);
 }
 
+// struct[] servertimings()
+void ServerTimingsXmlCommand::Execute()
+{
+	const char* XML_TIMING_ITEM_START =
+	"<value><struct>\n"
+	"<member><name>ServerID</name><value><i4>%i</i4></value></member>\n"
+	"<member><name>Phases</name><value><array><data>\n";
+
+	const char* XML_PHASE_ITEM_START =
+	"<value><struct>\n"
+	"<member><name>Phase</name><value><string>%s</string></value></member>\n"
+	"<member><name>Count</name><value><i4>%i</i4></value></member>\n"
+	"<member><name>AvgUSec</name><value><i4>%i</i4></value></member>\n"
+	"<member><name>MaxUSec</name><value><i4>%i</i4></value></member>\n"
+	"<member><name>Buckets</name><value><array><data>\n";
+
+	const char* XML_BUCKET_ITEM =
+	"<value><struct>\n"
+	"<member><name>LimitMSec</name><value><i4>%i</i4></value></member>\n"
+	"<member><name>Count</name><value><i4>%i</i4></value></member>\n"
+	"</struct></value>\n";
+
+	const char* XML_PHASE_ITEM_END =
+	"</data></array></value></member>\n"
+	"</struct></value>\n";
+
+	const char* XML_TIMING_ITEM_END =
+	"</data></array></value></member>\n"
+	"</struct></value>\n";
+
+	const char* JSON_TIMING_ITEM_START =
+	"{\n"
+	"\"ServerID\" : %i,\n"
+	"\"Phases\" : [\n";
+
+	const char* JSON_PHASE_ITEM_START =
+	"{\n"
+	"\"Phase\" : \"%s\",\n"
+	"\"Count\" : %i,\n"
+	"\"AvgUSec\" : %i,\n"
+	"\"MaxUSec\" : %i,\n"
+	"\"Buckets\" : [\n";
+
+	const char* JSON_BUCKET_ITEM =
+	"{\n"
+	"\"LimitMSec\" : %i,\n"
+	"\"Count\" : %i\n"
+	"}";
+
+	const char* JSON_PHASE_ITEM_END =
+	"]\n"
+	"}";
+
+	const char* JSON_TIMING_ITEM_END =
+	"]\n"
+	"}";
+
+	AppendResponse(IsJson() ? "[\n" : "<array><data>\n");
+
+	ServerTimings* pServerTimings = g_pStatMeter->LockServerTimings();
+
+	const int iItemBufSize = 1024;
+	char szItemBuf[iItemBufSize];
+	int index = 0;
+
+	for (ServerTimings::iterator it = pServerTimings->begin(); it != pServerTimings->end(); it++, index++)
+	{
+		ServerTiming* pServerTiming = *it;
+
+		if (IsJson() && index > 0)
+		{
+			AppendResponse(",\n");
+		}
+
+		snprintf(szItemBuf, iItemBufSize, IsJson() ? JSON_TIMING_ITEM_START : XML_TIMING_ITEM_START, index);
+		szItemBuf[iItemBufSize-1] = '\0';
+		AppendResponse(szItemBuf);
+
+		for (int i = 0; i < ServerTiming::PHASES; i++)
+		{
+			TimeHistogram* pHistogram = pServerTiming->GetHistogram((ServerTiming::EPhase)i);
+
+			int iAvgUSec = pHistogram->GetCount() > 0 ? (int)(pHistogram->GetTotalUSec() / pHistogram->GetCount()) : 0;
+			snprintf(szItemBuf, iItemBufSize, IsJson() ? JSON_PHASE_ITEM_START : XML_PHASE_ITEM_START,
+				ServerTiming::GetPhaseName((ServerTiming::EPhase)i), pHistogram->GetCount(), iAvgUSec,
+				pHistogram->GetMaxUSec());
+			szItemBuf[iItemBufSize-1] = '\0';
+
+			if (IsJson() && i > 0)
+			{
+				AppendResponse(",\n");
+			}
+			AppendResponse(szItemBuf);
+
+			for (int j = 0; j < TimeHistogram::BUCKETS; j++)
+			{
+				snprintf(szItemBuf, iItemBufSize, IsJson() ? JSON_BUCKET_ITEM : XML_BUCKET_ITEM,
+					TimeHistogram::GetBucketLimit(j), pHistogram->GetBucket(j));
+				szItemBuf[iItemBufSize-1] = '\0';
+
+				if (IsJson() && j > 0)
+				{
+					AppendResponse(",\n");
+				}
+				AppendResponse(szItemBuf);
+			}
+
+			AppendResponse(IsJson() ? JSON_PHASE_ITEM_END : XML_PHASE_ITEM_END);
+		}
+
+		AppendResponse(IsJson() ? JSON_TIMING_ITEM_END : XML_TIMING_ITEM_END);
+	}
+
+	g_pStatMeter->UnlockServerTimings();
+
+	AppendResponse(IsJson() ? "\n]" : "</data></array>\n");
+}
+
 // struct[] loadlog(nzbid, logidfrom, logentries)
 void LoadLogXmlCommand::Execute()
 {
-	m_pNZBInfo = NULL;
 	m_iNZBID = 0;
 	if (!NextParamAsInt(&m_iNZBID))
 	{
@@ -3607,16 +4123,13 @@ MessageList* LoadLogXmlCommand::LockMessages()
 
 	if (m_messages.empty())
 	{
-		DownloadQueue* pDownloadQueue = DownloadQueue::Lock();
-		m_pNZBInfo = pDownloadQueue->GetQueue()->Find(m_iNZBID);
-		if (m_pNZBInfo)
-		{
-			return m_pNZBInfo->LockCachedMessages();
-		}
-		else
+		DownloadQueue* pDownloadQueue = DownloadQueue::LockShared();
+		NZBInfo* pNZBInfo = pDownloadQueue->GetQueue()->Find(m_iNZBID);
+		if (pNZBInfo)
 		{
-			DownloadQueue::Unlock();
+			pNZBInfo->GetCachedMessages(&m_messages, m_iIDFrom, m_iNrEntries);
 		}
+		DownloadQueue::UnlockShared();
 	}
 
 	return &m_messages;
@@ -3624,11 +4137,6 @@ MessageList* LoadLogXmlCommand::LockMessages()
 
 void LoadLogXmlCommand::UnlockMessages()
 {
-	if (m_pNZBInfo)
-	{
-		m_pNZBInfo->UnlockCachedMessages();
-		DownloadQueue::Unlock();
-	}
 }
 
 // string testserver(string host, int port, string username, string password, bool encryption, string cipher, int timeout);
@@ -59,12 +59,11 @@ void Log::Final()
 	g_pLog = NULL;
 }
 
-Log::Log()
+Log::Log() : m_Messages(1000)
 {
-	m_Messages.clear();
-	m_iIDGen = 0;
 	m_szLogFilename = NULL;
 	m_tLastWritten = 0;
+	m_pWriter = NULL;
 #ifdef DEBUG
 	m_bExtraDebug = Util::FileExists("extradebug");
 #endif
@@ -72,6 +71,7 @@ Log::Log()
 
 Log::~Log()
 {
+	StopWriter();
 	Clear();
 	free(m_szLogFilename);
 }
@@ -93,7 +93,7 @@ void Log::LogDebugInfo()
 	info("--------------------------------------------");
 }
 
-void Log::Filelog(const char* msg, ...)
+void Log::Filelog(Message::EKind eKind, const char* msg, ...)
 {
 	if (!m_szLogFilename)
 	{
@@ -126,26 +126,95 @@ void Log::Filelog(const char* msg, ...)
 
 	m_tLastWritten = rawtime;
 
-	FILE* file = fopen(m_szLogFilename, FOPEN_ABP);
-	if (file)
-	{
+#ifdef DEBUG
 #ifdef WIN32
-		unsigned long iProcessId = GetCurrentProcessId();
-		unsigned long iThreadId = GetCurrentThreadId();
+	unsigned long iProcessId = GetCurrentProcessId();
+	unsigned long iThreadId = GetCurrentThreadId();
 #else
-		unsigned long iProcessId = (unsigned long)getpid();
-		unsigned long iThreadId = (unsigned long)pthread_self();
+	unsigned long iProcessId = (unsigned long)getpid();
+	unsigned long iThreadId = (unsigned long)pthread_self();
 #endif
-#ifdef DEBUG
-		fprintf(file, "%s\t%lu\t%lu\t%s%s", szTime, iProcessId, iThreadId, tmp2, LINE_ENDING);
+	char szPrefix[100];
+	snprintf(szPrefix, sizeof(szPrefix), "%s\t%lu\t%lu", szTime, iProcessId, iThreadId);
+	szPrefix[100-1] = '\0';
 #else
-		fprintf(file, "%s\t%s%s", szTime, tmp2, LINE_ENDING);
+	const char* szPrefix = szTime;
 #endif
-		fclose(file);
+
+	char szLine[1200];
+
+	int iDropped = m_pWriter ? m_pWriter->TakeDropped() : 0;
+	if (iDropped > 0)
+	{
+		snprintf(szLine, sizeof(szLine), "%s\tWARNING\t%i log message(s) were not written because the log buffer was full%s",
+			szPrefix, iDropped, LINE_ENDING);
+		szLine[1200-1] = '\0';
+		AppendToFile(m_szLogFilename, szLine, Message::mkWarning);
+	}
+
+	snprintf(szLine, sizeof(szLine), "%s\t%s%s", szPrefix, tmp2, LINE_ENDING);
+	szLine[1200-1] = '\0';
+
+	AppendToFile(m_szLogFilename, szLine, eKind);
+}
+
+void Log::AppendToFile(const char* szFilename, const char* szLine, Message::EKind eKind)
+{
+	if (m_pWriter)
+	{
+		m_pWriter->Append(szFilename, szLine, eKind == Message::mkDetail || eKind == Message::mkDebug);
 	}
 	else
 	{
-		perror(m_szLogFilename);
+		LogWriter::WriteLine(szFilename, szLine);
+	}
+}
+
+/*
+ * Log files are written in background after this call. Must be called
+ * after the process was daemonized.
+ */
+void Log::StartWriter()
+{
+	m_pWriter = new LogWriter();
+	m_pWriter->Start();
+}
+
+/*
+ * Stops the writer thread after it has written all pending lines.
+ * The lines are written directly by the calling threads after that.
+ * Other threads must not write to log files when this method is called.
+ */
+void Log::StopWriter()
+{
+	if (!m_pWriter)
+	{
+		return;
+	}
+
+	m_pWriter->Stop();
+	while (m_pWriter->IsRunning())
+	{
+		usleep(20 * 1000);
+	}
+
+	m_mutexLog.Lock();
+	LogWriter* pWriter = m_pWriter;
+	m_pWriter = NULL;
+	pWriter->Write();
+	m_mutexLog.Unlock();
+
+	delete pWriter;
+}
+
+/*
+ * Writes pending lines to log files. Used before reading or deleting log files.
+ */
+void Log::Flush()
+{
+	if (m_pWriter)
+	{
+		m_pWriter->Write();
 	}
 }
 
@@ -194,7 +263,7 @@ void debug(const char* msg, ...)
 	}
 	if (eMessageTarget == Options::mtLog || eMessageTarget == Options::mtBoth)
 	{
-		g_pLog->Filelog("DEBUG\t%s", tmp2);
+		g_pLog->Filelog(Message::mkDebug, "DEBUG\t%s", tmp2);
 	}
 
 	g_pLog->m_mutexLog.Unlock();
@@ -220,7 +289,7 @@ void error(const char* msg, ...)
 	}
 	if (eMessageTarget == Options::mtLog || eMessageTarget == Options::mtBoth)
 	{
-		g_pLog->Filelog("ERROR\t%s", tmp2);
+		g_pLog->Filelog(Message::mkError, "ERROR\t%s", tmp2);
 	}
 
 	g_pLog->m_mutexLog.Unlock();
@@ -245,7 +314,7 @@ void warn(const char* msg, ...)
 	}
 	if (eMessageTarget == Options::mtLog || eMessageTarget == Options::mtBoth)
 	{
-		g_pLog->Filelog("WARNING\t%s", tmp2);
+		g_pLog->Filelog(Message::mkWarning, "WARNING\t%s", tmp2);
 	}
 
 	g_pLog->m_mutexLog.Unlock();
@@ -270,7 +339,7 @@ void info(const char* msg, ...)
 	}
 	if (eMessageTarget == Options::mtLog || eMessageTarget == Options::mtBoth)
 	{
-		g_pLog->Filelog("INFO\t%s", tmp2);
+		g_pLog->Filelog(Message::mkInfo, "INFO\t%s", tmp2);
 	}
 
 	g_pLog->m_mutexLog.Unlock();
@@ -295,7 +364,7 @@ void detail(const char* msg, ...)
 	}
 	if (eMessageTarget == Options::mtLog || eMessageTarget == Options::mtBoth)
 	{
-		g_pLog->Filelog("DETAIL\t%s", tmp2);
+		g_pLog->Filelog(Message::mkDetail, "DETAIL\t%s", tmp2);
 	}
 
 	g_pLog->m_mutexLog.Unlock();
@@ -338,40 +407,248 @@ void MessageList::Clear()
 	clear();
 }
 
-void Log::Clear()
+//************************************************************
+// MessageRing
+
+MessageRing::MessageRing(int iMaxCapacity)
 {
-	m_mutexLog.Lock();
-	m_Messages.Clear();
-	m_mutexLog.Unlock();
+	m_pBuffer = NULL;
+	m_iLastID = 0;
+	m_iFirstID = 1;
+	m_iTextPos = 0;
+	SetMaxCapacity(iMaxCapacity);
 }
 
-void Log::AddMessage(Message::EKind eKind, const char * szText)
+MessageRing::~MessageRing()
+{
+	FreeBuffers();
+}
+
+void MessageRing::FreeBuffers()
+{
+	Buffer* pBuffer = m_pBuffer;
+	while (pBuffer)
+	{
+		Buffer* pRetired = pBuffer->m_pRetired;
+		free(pBuffer->m_pSlots);
+		free(pBuffer->m_pText);
+		delete pBuffer;
+		pBuffer = pRetired;
+	}
+	m_pBuffer = NULL;
+}
+
+/*
+ * Removes all messages. IDs of new messages continue to increase.
+ */
+void MessageRing::Clear()
 {
-	Message* pMessage = new Message(++m_iIDGen, eKind, time(NULL), szText);
-	m_Messages.push_back(pMessage);
+	while (m_iFirstID <= m_iLastID)
+	{
+		RemoveOldest(m_pBuffer);
+	}
+	m_iTextPos = 0;
+}
+
+/*
+ * Removes all messages, frees the memory and restarts IDs.
+ * Must not be called when other threads may read messages.
+ */
+void MessageRing::Reset()
+{
+	FreeBuffers();
+	m_iLastID = 0;
+	m_iFirstID = 1;
+	m_iTextPos = 0;
+}
 
-	if (g_pOptions)
+void MessageRing::RemoveOldest(Buffer* pBuffer)
+{
+	Slot* pSlot = &pBuffer->m_pSlots[m_iFirstID % pBuffer->m_iCapacity];
+	Atomic::Exchange(&pSlot->m_iID, 0);
+	m_iFirstID++;
+}
+
+/*
+ * Replaces the buffer with a two times larger one. The old buffer is kept
+ * until the ring is destroyed because readers may still copy messages from it.
+ */
+void MessageRing::Grow()
+{
+	Buffer* pOldBuffer = m_pBuffer;
+	int iCapacity = pOldBuffer ? pOldBuffer->m_iCapacity * 2 : 16;
+	if (iCapacity > m_iMaxCapacity)
 	{
-		while (m_Messages.size() > (unsigned int)g_pOptions->GetLogBufferSize())
+		iCapacity = m_iMaxCapacity;
+	}
+
+	Buffer* pBuffer = new Buffer();
+	pBuffer->m_iCapacity = iCapacity;
+	pBuffer->m_iTextSize = iCapacity * TEXT_SIZE_PER_MESSAGE;
+	pBuffer->m_pSlots = (Slot*)calloc(iCapacity, sizeof(Slot));
+	pBuffer->m_pText = (char*)malloc(pBuffer->m_iTextSize);
+	pBuffer->m_pRetired = pOldBuffer;
+
+	// the texts of existing messages are placed one after another
+	m_iTextPos = 0;
+	for (int iID = m_iFirstID; iID <= m_iLastID; iID++)
+	{
+		Slot* pOldSlot = &pOldBuffer->m_pSlots[iID % pOldBuffer->m_iCapacity];
+		Slot* pSlot = &pBuffer->m_pSlots[iID % iCapacity];
+		pSlot->m_iID = iID;
+		pSlot->m_eKind = pOldSlot->m_eKind;
+		pSlot->m_tTime = pOldSlot->m_tTime;
+		pSlot->m_iTextOffset = m_iTextPos;
+		pSlot->m_iTextLen = pOldSlot->m_iTextLen;
+		memcpy(pBuffer->m_pText + m_iTextPos, pOldBuffer->m_pText + pOldSlot->m_iTextOffset, pOldSlot->m_iTextLen);
+		m_iTextPos += pOldSlot->m_iTextLen;
+	}
+
+	Atomic::ExchangePtr((void* volatile*)&m_pBuffer, pBuffer);
+}
+
+/*
+ * Returns the ID of the new message.
+ */
+int MessageRing::Add(Message::EKind eKind, time_t tTime, const char* szText)
+{
+	if (!m_pBuffer ||
+		(m_iLastID - m_iFirstID + 1 >= m_pBuffer->m_iCapacity && m_pBuffer->m_iCapacity < m_iMaxCapacity))
+	{
+		Grow();
+	}
+
+	Buffer* pBuffer = m_pBuffer;
+
+	int iLen = strlen(szText) + 1;
+	if (iLen > 1024)
+	{
+		iLen = 1024;
+	}
+	if (iLen > pBuffer->m_iTextSize)
+	{
+		iLen = pBuffer->m_iTextSize;
+	}
+
+	// the text area is used in circular manner; the text must not wrap around,
+	// the area after the last text remains unused in this case
+	int iPos = m_iTextPos;
+	bool bWrap = iPos + iLen > pBuffer->m_iTextSize;
+	if (bWrap)
+	{
+		iPos = 0;
+	}
+
+	// remove oldest messages until there is a free slot and the text area
+	// needed for the new message doesn't contain texts of other messages
+	while (m_iFirstID <= m_iLastID)
+	{
+		Slot* pOldest = &pBuffer->m_pSlots[m_iFirstID % pBuffer->m_iCapacity];
+		int iOldestEnd = pOldest->m_iTextOffset + pOldest->m_iTextLen;
+		bool bOverlaps = (pOldest->m_iTextOffset < iPos + iLen && iPos < iOldestEnd) ||
+			(bWrap && iOldestEnd > m_iTextPos);
+		if (!bOverlaps && m_iLastID - m_iFirstID + 1 < pBuffer->m_iCapacity)
 		{
-			Message* pMessage = m_Messages.front();
-			delete pMessage;
-			m_Messages.pop_front();
+			break;
 		}
+		RemoveOldest(pBuffer);
 	}
+
+	int iID = m_iLastID + 1;
+	Slot* pSlot = &pBuffer->m_pSlots[iID % pBuffer->m_iCapacity];
+	pSlot->m_eKind = eKind;
+	pSlot->m_tTime = tTime;
+	pSlot->m_iTextOffset = iPos;
+	pSlot->m_iTextLen = iLen;
+	memcpy(pBuffer->m_pText + iPos, szText, iLen - 1);
+	pBuffer->m_pText[iPos + iLen - 1] = '\0';
+	m_iTextPos = iPos + iLen;
+
+	// publish the message to readers
+	Atomic::Exchange(&pSlot->m_iID, iID);
+	Atomic::Exchange(&m_iLastID, iID);
+
+	return iID;
 }
 
-MessageList* Log::LockMessages()
+/*
+ * Copies messages having ID greater or equal iIDFrom, or (if iIDFrom is "0")
+ * the last iLastCount messages, or (if both are "0") all messages.
+ * Can be called at any time from any thread.
+ */
+void MessageRing::Read(MessageList* pMessages, int iIDFrom, int iLastCount)
 {
-	m_mutexLog.Lock();
-	return &m_Messages;
+	int iLastID = Atomic::Get(&m_iLastID);
+	Buffer* pBuffer = GetBuffer();
+	if (!pBuffer)
+	{
+		return;
+	}
+
+	int iStartID = iLastID - pBuffer->m_iCapacity + 1;
+	if (iIDFrom > 0 && iIDFrom > iStartID)
+	{
+		iStartID = iIDFrom;
+	}
+	else if (iIDFrom <= 0 && iLastCount > 0 && iLastID - iLastCount + 1 > iStartID)
+	{
+		iStartID = iLastID - iLastCount + 1;
+	}
+	if (iStartID < 1)
+	{
+		iStartID = 1;
+	}
+
+	char szText[1024];
+	for (int iID = iStartID; iID <= iLastID; iID++)
+	{
+		Slot* pSlot = &pBuffer->m_pSlots[iID % pBuffer->m_iCapacity];
+		if (Atomic::Get(&pSlot->m_iID) != iID)
+		{
+			continue;
+		}
+
+		Message::EKind eKind = pSlot->m_eKind;
+		time_t tTime = pSlot->m_tTime;
+		int iOffset = pSlot->m_iTextOffset;
+		int iLen = pSlot->m_iTextLen;
+		if (iLen < 1 || iLen > 1024 || iOffset < 0 || iOffset + iLen > pBuffer->m_iTextSize)
+		{
+			continue;
+		}
+		memcpy(szText, pBuffer->m_pText + iOffset, iLen);
+		szText[iLen - 1] = '\0';
+
+		// the message could be replaced with a newer one while it was copied
+		if (Atomic::Get(&pSlot->m_iID) != iID)
+		{
+			continue;
+		}
+
+		pMessages->push_back(new Message(iID, eKind, tTime, szText));
+	}
 }
 
-void Log::UnlockMessages()
+void Log::Clear()
 {
+	m_mutexLog.Lock();
+	m_Messages.Clear();
 	m_mutexLog.Unlock();
 }
 
+void Log::AddMessage(Message::EKind eKind, const char * szText)
+{
+	m_Messages.Add(eKind, time(NULL), szText);
+}
+
+/*
+ * See MessageRing::Read.
+ */
+void Log::GetMessages(MessageList* pMessages, int iIDFrom, int iLastCount)
+{
+	m_Messages.Read(pMessages, iIDFrom, iLastCount);
+}
+
 void Log::ResetLog()
 {
 	remove(g_pOptions->GetLogFile());
@@ -460,7 +737,7 @@ void Log::RotateLog()
 * intializing stage and does three things:
 * 1) save the messages to log-file (if they should according to options);
 * 2) delete messages from screen log (if they should not be saved in screen log).
-* 3) renumerate IDs
+* 3) renumerate IDs (messages are added to the buffer again).
 */
 void Log::InitOptions()
 {
@@ -479,11 +756,16 @@ void Log::InitOptions()
 		}
 	}
 
-	m_iIDGen = 0;
+	// messages collected before the options were loaded are filtered using
+	// the configured targets and are then added again to a properly sized buffer
+	MessageList messages;
+	m_Messages.Read(&messages, 0, 0);
+	m_Messages.Reset();
+	m_Messages.SetMaxCapacity(g_pOptions->GetLogBufferSize());
 
-	for (unsigned int i = 0; i < m_Messages.size(); )
+	for (MessageList::iterator it = messages.begin(); it != messages.end(); it++)
 	{
-		Message* pMessage = m_Messages.at(i);
+		Message* pMessage = *it;
 		Options::EMessageTarget eTarget = Options::mtNone;
 		switch (pMessage->GetKind())
 		{
@@ -506,18 +788,12 @@ void Log::InitOptions()
 
 		if (eTarget == Options::mtLog || eTarget == Options::mtBoth)
 		{
-			Filelog("%s\t%s", szMessageType[pMessage->GetKind()], pMessage->GetText());
+			Filelog(pMessage->GetKind(), "%s\t%s", szMessageType[pMessage->GetKind()], pMessage->GetText());
 		}
 
-		if (eTarget == Options::mtLog || eTarget == Options::mtNone)
+		if (eTarget == Options::mtScreen || eTarget == Options::mtBoth)
 		{
-			delete pMessage;
-			m_Messages.erase(m_Messages.begin() + i);
-		}
-		else
-		{
-			pMessage->m_iID = ++m_iIDGen;
-			i++;
+			m_Messages.Add(pMessage->GetKind(), pMessage->GetTime(), pMessage->GetText());
 		}
 	}
 }
@@ -535,3 +811,203 @@ void Log::UnregisterDebuggable(Debuggable* pDebuggable)
 	m_Debuggables.remove(pDebuggable);
 	m_mutexDebug.Unlock();
 }
+
+//************************************************************
+// LogWriter
+
+LogWriter::LogWriter()
+{
+	m_pSlots = new LogSlot[BUFFER_SIZE];
+	for (int i = 0; i < BUFFER_SIZE; i++)
+	{
+		m_pSlots[i].m_iSequence = i;
+	}
+	m_iEnqueuePos = 0;
+	m_iDequeuePos = 0;
+	m_iDropped = 0;
+}
+
+LogWriter::~LogWriter()
+{
+	delete[] m_pSlots;
+}
+
+void LogWriter::Run()
+{
+	while (!IsStopped())
+	{
+		if (Write() == 0)
+		{
+			usleep(10 * 1000);
+		}
+	}
+
+	Write();
+}
+
+void LogWriter::Append(const char* szFilename, const char* szLine, bool bMayDrop)
+{
+	while (!Push(szFilename, szLine))
+	{
+		if (bMayDrop)
+		{
+			Atomic::Add(&m_iDropped, 1);
+			return;
+		}
+
+		// the buffer is full, help the writer thread
+		Write();
+	}
+}
+
+/*
+ * Bounded multi-producer queue: each slot has a sequence number telling
+ * whether the slot is free for the position being written (sequence == position)
+ * or contains a line (sequence == position + 1).
+ * Returns "false" if the buffer is full.
+ */
+bool LogWriter::Push(const char* szFilename, const char* szLine)
+{
+	LogSlot* pSlot = NULL;
+	unsigned int iPos = (unsigned int)Atomic::Get(&m_iEnqueuePos);
+	while (true)
+	{
+		pSlot = &m_pSlots[iPos & (BUFFER_SIZE - 1)];
+		int iDiff = (int)((unsigned int)Atomic::Get(&pSlot->m_iSequence) - iPos);
+		if (iDiff == 0 && Atomic::CompareExchange(&m_iEnqueuePos, (int)iPos, (int)(iPos + 1)))
+		{
+			break;
+		}
+		else if (iDiff < 0)
+		{
+			return false;
+		}
+		iPos = (unsigned int)Atomic::Get(&m_iEnqueuePos);
+	}
+
+	int iFilenameLen = strlen(szFilename);
+	if (iFilenameLen > LINE_SIZE / 2 - 1)
+	{
+		iFilenameLen = LINE_SIZE / 2 - 1;
+	}
+	memcpy(pSlot->m_szData, szFilename, iFilenameLen);
+	pSlot->m_szData[iFilenameLen] = '\0';
+
+	int iLineLen = strlen(szLine);
+	if (iLineLen > LINE_SIZE - iFilenameLen - 1)
+	{
+		iLineLen = LINE_SIZE - iFilenameLen - 1;
+	}
+	memcpy(pSlot->m_szData + iFilenameLen + 1, szLine, iLineLen);
+
+	pSlot->m_iFilenameLen = iFilenameLen;
+	pSlot->m_iLineLen = iLineLen;
+
+	// publish the line to the writer
+	Atomic::Exchange(&pSlot->m_iSequence, (int)(iPos + 1));
+
+	return true;
+}
+
+/*
+ * Writes lines from the buffer, returns the number of written lines.
+ * May be called from any thread to flush the buffer.
+ */
+int LogWriter::Write()
+{
+	struct OpenFile
+	{
+		char			m_szFilename[LINE_SIZE / 2];
+		FILE*			m_pFile;
+	};
+
+	const int MAX_OPEN_FILES = 8;
+	OpenFile openFiles[MAX_OPEN_FILES];
+	int iOpenFiles = 0;
+	int iNextClose = 0;
+	int iWritten = 0;
+
+	m_mutexWrite.Lock();
+
+	// limit the batch size to check for stop requests regularly
+	while (iWritten < BUFFER_SIZE * 4)
+	{
+		LogSlot* pSlot = &m_pSlots[m_iDequeuePos & (BUFFER_SIZE - 1)];
+		int iDiff = (int)((unsigned int)Atomic::Get(&pSlot->m_iSequence) - (m_iDequeuePos + 1));
+		if (iDiff < 0)
+		{
+			// buffer is empty
+			break;
+		}
+
+		const char* szFilename = pSlot->m_szData;
+		OpenFile* pOpenFile = NULL;
+		for (int i = 0; i < iOpenFiles; i++)
+		{
+			if (!strcmp(openFiles[i].m_szFilename, szFilename))
+			{
+				pOpenFile = &openFiles[i];
+				break;
+			}
+		}
+
+		if (!pOpenFile)
+		{
+			if (iOpenFiles < MAX_OPEN_FILES)
+			{
+				pOpenFile = &openFiles[iOpenFiles++];
+			}
+			else
+			{
+				pOpenFile = &openFiles[iNextClose];
+				iNextClose = (iNextClose + 1) % MAX_OPEN_FILES;
+				if (pOpenFile->m_pFile)
+				{
+					fclose(pOpenFile->m_pFile);
+				}
+			}
+
+			strcpy(pOpenFile->m_szFilename, szFilename);
+			pOpenFile->m_pFile = fopen(szFilename, FOPEN_ABP);
+			if (!pOpenFile->m_pFile)
+			{
+				perror(szFilename);
+			}
+		}
+
+		if (pOpenFile->m_pFile)
+		{
+			fwrite(pSlot->m_szData + pSlot->m_iFilenameLen + 1, 1, pSlot->m_iLineLen, pOpenFile->m_pFile);
+		}
+
+		// release the slot for the position one round later
+		Atomic::Exchange(&pSlot->m_iSequence, (int)(m_iDequeuePos + BUFFER_SIZE));
+		m_iDequeuePos++;
+		iWritten++;
+	}
+
+	for (int i = 0; i < iOpenFiles; i++)
+	{
+		if (openFiles[i].m_pFile)
+		{
+			fclose(openFiles[i].m_pFile);
+		}
+	}
+
+	m_mutexWrite.Unlock();
+
+	return iWritten;
+}
+
+void LogWriter::WriteLine(const char* szFilename, const char* szLine)
+{
+	FILE* file = fopen(szFilename, FOPEN_ABP);
+	if (!file)
+	{
+		perror(szFilename);
+		return;
+	}
+
+	fputs(szLine, file);
+	fclose(file);
+}
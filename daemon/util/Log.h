@@ -30,6 +30,7 @@
 #include <deque>
 #include <list>
 #include <time.h>
+#include <stdio.h>
 
 #include "Thread.h"
 
@@ -84,6 +85,103 @@ public:
 	void				Clear();
 };
 
+/*
+ * Ring of the most recent messages with increasing IDs.
+ * The memory is allocated in blocks growing up to the maximum capacity,
+ * the texts are stored in a circular text area; no memory allocations
+ * are made for individual messages.
+ * Messages are added by one thread at a time (callers must serialize adding).
+ * Readers don't lock: they copy the messages and skip the ones which were
+ * overwritten during copying.
+ */
+class MessageRing
+{
+public:
+	static const int	TEXT_SIZE_PER_MESSAGE = 256;
+
+private:
+	struct Slot
+	{
+		volatile int	m_iID;			// "0" if free or being written
+		Message::EKind	m_eKind;
+		time_t			m_tTime;
+		int				m_iTextOffset;
+		int				m_iTextLen;
+	};
+
+	struct Buffer
+	{
+		int				m_iCapacity;
+		int				m_iTextSize;
+		Slot*			m_pSlots;
+		char*			m_pText;
+		Buffer*			m_pRetired;		// smaller buffers which may still be in use by readers
+	};
+
+	Buffer* volatile	m_pBuffer;
+	int					m_iMaxCapacity;
+	volatile int		m_iLastID;
+	int					m_iFirstID;
+	int					m_iTextPos;
+
+	Buffer*				GetBuffer() { return (Buffer*)Atomic::GetPtr((void* volatile*)&m_pBuffer); }
+	void				Grow();
+	void				RemoveOldest(Buffer* pBuffer);
+	void				FreeBuffers();
+
+public:
+						MessageRing(int iMaxCapacity);
+						~MessageRing();
+	void				SetMaxCapacity(int iMaxCapacity) { m_iMaxCapacity = iMaxCapacity > 0 ? iMaxCapacity : 1; }
+	int					Add(Message::EKind eKind, time_t tTime, const char* szText);
+	void				Read(MessageList* pMessages, int iIDFrom, int iLastCount);
+	int					GetCount() { return m_iLastID - m_iFirstID + 1; }
+	void				Clear();
+	void				Reset();
+};
+
+/*
+ * Appends lines to log files in a background thread.
+ * Callers copy the lines into a bounded lock-free ring buffer; the writer thread
+ * takes them out in batches and opens each file only once per batch.
+ * When the buffer is full the lines which may be dropped are dropped (and counted),
+ * other lines are written by the calling thread itself.
+ */
+class LogWriter : public Thread
+{
+public:
+	static const int	BUFFER_SIZE = 512;		// number of lines, must be power of 2
+	static const int	LINE_SIZE = 2048;		// filename and text
+
+private:
+	struct LogSlot
+	{
+		volatile int	m_iSequence;
+		int				m_iFilenameLen;
+		int				m_iLineLen;
+		char			m_szData[LINE_SIZE];
+	};
+
+	LogSlot*			m_pSlots;
+	volatile int		m_iEnqueuePos;
+	unsigned int		m_iDequeuePos;
+	volatile int		m_iDropped;
+	Mutex				m_mutexWrite;
+
+	bool				Push(const char* szFilename, const char* szLine);
+
+protected:
+	virtual void		Run();
+
+public:
+						LogWriter();
+	virtual				~LogWriter();
+	void				Append(const char* szFilename, const char* szLine, bool bMayDrop);
+	int					Write();
+	int					TakeDropped() { return Atomic::Exchange(&m_iDropped, 0); }
+	static void			WriteLine(const char* szFilename, const char* szLine);
+};
+
 class Debuggable
 {
 protected:
@@ -98,19 +196,19 @@ public:
 
 private:
 	Mutex				m_mutexLog;
-	MessageList			m_Messages;
+	MessageRing			m_Messages;
 	Debuggables			m_Debuggables;
 	Mutex				m_mutexDebug;
 	char*				m_szLogFilename;
-	unsigned int		m_iIDGen;
 	time_t				m_tLastWritten;
+	LogWriter*			m_pWriter;
 #ifdef DEBUG
 	bool				m_bExtraDebug;
 #endif
 
 						Log();
 						~Log();
-	void				Filelog(const char* msg, ...);
+	void				Filelog(Message::EKind eKind, const char* msg, ...);
 	void				AddMessage(Message::EKind eKind, const char* szText);
 	void				RotateLog();
 
@@ -129,14 +227,17 @@ private:
 public:
 	static void			Init();
 	static void			Final();
-	MessageList*		LockMessages();
-	void				UnlockMessages();
+	void				GetMessages(MessageList* pMessages, int iIDFrom, int iLastCount);
 	void				Clear();
 	void				ResetLog();
 	void				InitOptions();
 	void				RegisterDebuggable(Debuggable* pDebuggable);
 	void				UnregisterDebuggable(Debuggable* pDebuggable);
 	void				LogDebugInfo();
+	void				StartWriter();
+	void				StopWriter();
+	void				AppendToFile(const char* szFilename, const char* szLine, Message::EKind eKind);
+	void				Flush();
 };
 
 #ifdef DEBUG
@@ -98,6 +98,135 @@ void Mutex::Unlock()
 }
 
 
+// Windows condition variables are not available on all supported versions,
+// a semaphore released once per waiting thread is used there instead.
+ConditionVar::ConditionVar()
+{
+#ifdef WIN32
+	m_pCondObj = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	m_iWaiters = 0;
+#else
+	m_pCondObj = (pthread_cond_t*)malloc(sizeof(pthread_cond_t));
+	pthread_cond_init((pthread_cond_t*)m_pCondObj, NULL);
+#endif
+}
+
+ConditionVar::~ConditionVar()
+{
+#ifdef WIN32
+	CloseHandle((HANDLE)m_pCondObj);
+#else
+	pthread_cond_destroy((pthread_cond_t*)m_pCondObj);
+	free(m_pCondObj);
+#endif
+}
+
+void ConditionVar::Wait(Mutex* pMutex)
+{
+#ifdef WIN32
+	m_iWaiters++;
+	pMutex->Unlock();
+	WaitForSingleObject((HANDLE)m_pCondObj, INFINITE);
+	pMutex->Lock();
+#else
+	pthread_cond_wait((pthread_cond_t*)m_pCondObj, (pthread_mutex_t*)pMutex->m_pMutexObj);
+#endif
+}
+
+void ConditionVar::Signal()
+{
+#ifdef WIN32
+	if (m_iWaiters > 0)
+	{
+		m_iWaiters--;
+		ReleaseSemaphore((HANDLE)m_pCondObj, 1, NULL);
+	}
+#else
+	pthread_cond_signal((pthread_cond_t*)m_pCondObj);
+#endif
+}
+
+void ConditionVar::Broadcast()
+{
+#ifdef WIN32
+	if (m_iWaiters > 0)
+	{
+		ReleaseSemaphore((HANDLE)m_pCondObj, m_iWaiters, NULL);
+		m_iWaiters = 0;
+	}
+#else
+	pthread_cond_broadcast((pthread_cond_t*)m_pCondObj);
+#endif
+}
+
+
+// On Windows slim reader/writer locks are not available on all supported
+// versions, a critical section is used there and readers are serialized.
+RWLock::RWLock()
+{
+#ifdef WIN32
+	m_pLockObj = (CRITICAL_SECTION*)malloc(sizeof(CRITICAL_SECTION));
+	InitializeCriticalSection((CRITICAL_SECTION*)m_pLockObj);
+#else
+	m_pLockObj = (pthread_rwlock_t*)malloc(sizeof(pthread_rwlock_t));
+	pthread_rwlockattr_t attr;
+	pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+	// default glibc lock prefers readers, constant reading would starve writers
+	pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+	pthread_rwlock_init((pthread_rwlock_t*)m_pLockObj, &attr);
+	pthread_rwlockattr_destroy(&attr);
+#endif
+}
+
+RWLock::~RWLock()
+{
+#ifdef WIN32
+	DeleteCriticalSection((CRITICAL_SECTION*)m_pLockObj);
+#else
+	pthread_rwlock_destroy((pthread_rwlock_t*)m_pLockObj);
+#endif
+	free(m_pLockObj);
+}
+
+void RWLock::Lock()
+{
+#ifdef WIN32
+	EnterCriticalSection((CRITICAL_SECTION*)m_pLockObj);
+#else
+	pthread_rwlock_wrlock((pthread_rwlock_t*)m_pLockObj);
+#endif
+}
+
+void RWLock::Unlock()
+{
+#ifdef WIN32
+	LeaveCriticalSection((CRITICAL_SECTION*)m_pLockObj);
+#else
+	pthread_rwlock_unlock((pthread_rwlock_t*)m_pLockObj);
+#endif
+}
+
+void RWLock::LockShared()
+{
+#ifdef WIN32
+	EnterCriticalSection((CRITICAL_SECTION*)m_pLockObj);
+#else
+	pthread_rwlock_rdlock((pthread_rwlock_t*)m_pLockObj);
+#endif
+}
+
+void RWLock::UnlockShared()
+{
+#ifdef WIN32
+	LeaveCriticalSection((CRITICAL_SECTION*)m_pLockObj);
+#else
+	pthread_rwlock_unlock((pthread_rwlock_t*)m_pLockObj);
+#endif
+}
+
+
 #ifdef HAVE_SPINLOCK
 SpinLock::SpinLock()
 {
@@ -139,6 +268,72 @@ void SpinLock::Unlock()
 }
 #endif
 
+/*
+ * Returns the new value.
+ */
+int Atomic::Add(volatile int* pValue, int iDelta)
+{
+#ifdef WIN32
+	return InterlockedExchangeAdd((volatile LONG*)pValue, iDelta) + iDelta;
+#else
+	return __sync_add_and_fetch(pValue, iDelta);
+#endif
+}
+
+/*
+ * Sets the value to iExchange if it equals iComparand, returns "true" on success.
+ */
+bool Atomic::CompareExchange(volatile int* pValue, int iComparand, int iExchange)
+{
+#ifdef WIN32
+	return InterlockedCompareExchange((volatile LONG*)pValue, iExchange, iComparand) == iComparand;
+#else
+	return __sync_bool_compare_and_swap(pValue, iComparand, iExchange);
+#endif
+}
+
+/*
+ * Returns the old value.
+ */
+int Atomic::Exchange(volatile int* pValue, int iExchange)
+{
+#ifdef WIN32
+	return InterlockedExchange((volatile LONG*)pValue, iExchange);
+#else
+	int iOldValue = *pValue;
+	while (!__sync_bool_compare_and_swap(pValue, iOldValue, iExchange))
+	{
+		iOldValue = *pValue;
+	}
+	return iOldValue;
+#endif
+}
+
+/*
+ * Returns the old value.
+ */
+void* Atomic::ExchangePtr(void* volatile* pValue, void* pExchange)
+{
+#ifdef WIN32
+	return InterlockedExchangePointer(pValue, pExchange);
+#else
+	void* pOldValue = *pValue;
+	while (!__sync_bool_compare_and_swap(pValue, pOldValue, pExchange))
+	{
+		pOldValue = *pValue;
+	}
+	return pOldValue;
+#endif
+}
+
+void* Atomic::GetPtr(void* volatile* pValue)
+{
+#ifdef WIN32
+	return InterlockedCompareExchangePointer(pValue, NULL, NULL);
+#else
+	return __sync_val_compare_and_swap(pValue, (void*)NULL, (void*)NULL);
+#endif
+}
 
 void Thread::Init()
 {
@@ -284,3 +479,109 @@ int Thread::GetThreadCount()
 	m_pMutexThread->Unlock();
 	return iThreadCount;
 }
+
+
+WorkerPool::WorkerPool(int iThreads)
+{
+	m_pJob = NULL;
+	m_iItems = 0;
+	m_iNextItem = 0;
+	m_iPendingItems = 0;
+	m_iThreads = 0;
+	m_bStopping = false;
+
+	for (int i = 0; i < iThreads; i++)
+	{
+		WorkerThread* pThread = new WorkerThread(this);
+		pThread->SetAutoDestroy(true);
+		pThread->Start();
+		if (!pThread->IsRunning())
+		{
+			delete pThread;
+			break;
+		}
+		m_mutexPool.Lock();
+		m_iThreads++;
+		m_mutexPool.Unlock();
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	m_mutexPool.Lock();
+	m_bStopping = true;
+	m_condWork.Broadcast();
+	while (m_iThreads > 0)
+	{
+		m_condDone.Wait(&m_mutexPool);
+	}
+	m_mutexPool.Unlock();
+}
+
+void WorkerPool::Execute(ParallelJob* pJob, int iItems)
+{
+	m_mutexPool.Lock();
+
+	m_pJob = pJob;
+	m_iItems = iItems;
+	m_iNextItem = 0;
+	m_iPendingItems = iItems;
+	m_condWork.Broadcast();
+
+	while (m_iNextItem < m_iItems)
+	{
+		ProcessNextItem();
+	}
+
+	while (m_iPendingItems > 0)
+	{
+		m_condDone.Wait(&m_mutexPool);
+	}
+
+	m_pJob = NULL;
+	m_iItems = 0;
+	m_iNextItem = 0;
+
+	m_mutexPool.Unlock();
+}
+
+void WorkerPool::Work()
+{
+	m_mutexPool.Lock();
+
+	while (!m_bStopping)
+	{
+		if (m_iNextItem < m_iItems)
+		{
+			ProcessNextItem();
+		}
+		else
+		{
+			m_condWork.Wait(&m_mutexPool);
+		}
+	}
+
+	m_iThreads--;
+	m_condDone.Broadcast();
+
+	m_mutexPool.Unlock();
+}
+
+/*
+ * Must be called with locked mutex, which is released while the item is processed.
+ */
+void WorkerPool::ProcessNextItem()
+{
+	int iItem = m_iNextItem++;
+	ParallelJob* pJob = m_pJob;
+
+	m_mutexPool.Unlock();
+	pJob->ProcessItem(iItem);
+	m_mutexPool.Lock();
+
+	m_iPendingItems--;
+	if (m_iPendingItems == 0)
+	{
+		m_condDone.Broadcast();
+	}
+}
@@ -37,6 +37,47 @@ public:
 							~Mutex();
 	void					Lock();
 	void					Unlock();
+
+	friend class ConditionVar;
+};
+
+/*
+ * Condition variable to wait for a state change protected by a mutex.
+ * The waiting thread must check its condition in a loop since wakeups can
+ * be spurious. Signal and Broadcast must be called with the mutex locked.
+ */
+class ConditionVar
+{
+private:
+	void*					m_pCondObj;
+#ifdef WIN32
+	int						m_iWaiters;
+#endif
+
+public:
+							ConditionVar();
+							~ConditionVar();
+	void					Wait(Mutex* pMutex);
+	void					Signal();
+	void					Broadcast();
+};
+
+/*
+ * Lock allowing many readers or one writer at a time.
+ * Waiting writers have priority over new readers where the platform supports it.
+ */
+class RWLock
+{
+private:
+	void*					m_pLockObj;
+
+public:
+							RWLock();
+							~RWLock();
+	void					Lock();
+	void					Unlock();
+	void					LockShared();
+	void					UnlockShared();
 };
 
 #ifdef HAVE_SPINLOCK
@@ -57,6 +98,20 @@ public:
 };
 #endif
 
+/*
+ * Atomic operations on integer values. All operations act as full memory barriers.
+ */
+class Atomic
+{
+public:
+	static int				Add(volatile int* pValue, int iDelta);
+	static bool				CompareExchange(volatile int* pValue, int iComparand, int iExchange);
+	static int				Exchange(volatile int* pValue, int iExchange);
+	static int				Get(volatile int* pValue) { return Add(pValue, 0); }
+	static void*			ExchangePtr(void* volatile* pValue, void* pExchange);
+	static void*			GetPtr(void* volatile* pValue);
+};
+
 class Thread
 {
 private:
@@ -95,4 +150,51 @@ protected:
 	virtual void 			Run() {}; // Virtual function - override in derivatives
 };
 
+class ParallelJob
+{
+public:
+	virtual					~ParallelJob() {}
+	virtual void			ProcessItem(int iItem) = 0;
+};
+
+/*
+ * Set of threads executing the numbered items of a ParallelJob.
+ * The calling thread works on the items too and returns from Execute when
+ * all items are done, so a pool with zero threads executes the job serially.
+ */
+class WorkerPool
+{
+private:
+	class WorkerThread : public Thread
+	{
+	private:
+		WorkerPool*			m_pOwner;
+	protected:
+		virtual void		Run() { m_pOwner->Work(); }
+	public:
+							WorkerThread(WorkerPool* pOwner) : m_pOwner(pOwner) {}
+	};
+
+	Mutex					m_mutexPool;
+	ConditionVar			m_condWork;
+	ConditionVar			m_condDone;
+	ParallelJob*			m_pJob;
+	int						m_iItems;
+	int						m_iNextItem;
+	int						m_iPendingItems;
+	int						m_iThreads;
+	bool					m_bStopping;
+
+	void					Work();
+	void					ProcessNextItem();
+
+	friend class WorkerThread;
+
+public:
+							WorkerPool(int iThreads);
+							~WorkerPool();
+	void					Execute(ParallelJob* pJob, int iItems);
+	int						GetThreadCount() { return m_iThreads; }
+};
+
 #endif
@@ -46,6 +46,9 @@
 #include <sys/statvfs.h>
 #include <pwd.h>
 #include <dirent.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #endif
 #ifdef HAVE_REGEX_H
 #include <regex.h>
@@ -281,6 +284,111 @@ void StringBuilder::Append(const char* szStr)
 	m_szBuffer[m_iUsedSize] = '\0';
 }
 
+MappedFile::MappedFile()
+{
+	m_pData = NULL;
+	m_lSize = 0;
+#ifdef WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* szFilename)
+{
+	Close();
+
+#ifdef WIN32
+	m_hFile = CreateFile(szFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_hFile, &size))
+	{
+		Close();
+		return false;
+	}
+	m_lSize = size.QuadPart;
+
+	if (m_lSize > 0)
+	{
+		m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		m_pData = m_hMapping ? (char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (!m_pData)
+		{
+			Close();
+			return false;
+		}
+	}
+#else
+	int fd = open(szFilename, O_RDONLY);
+	if (fd == -1)
+	{
+		return false;
+	}
+
+	struct stat buffer;
+	if (fstat(fd, &buffer))
+	{
+		close(fd);
+		return false;
+	}
+	m_lSize = buffer.st_size;
+
+	if (m_lSize > 0)
+	{
+		void* pData = mmap(NULL, (size_t)m_lSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (pData == MAP_FAILED)
+		{
+			close(fd);
+			m_lSize = 0;
+			return false;
+		}
+		m_pData = (char*)pData;
+	}
+
+	// the mapping remains valid after the descriptor is closed
+	close(fd);
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef WIN32
+	if (m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = NULL;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_pData)
+	{
+		munmap(m_pData, (size_t)m_lSize);
+	}
+#endif
+	m_pData = NULL;
+	m_lSize = 0;
+}
+
 
 char Util::VersionRevisionBuf[40];
 
@@ -546,6 +654,22 @@ bool Util::TruncateFile(const char* szFilename, int iSize)
 	return bOK;
 }
 
+/*
+ * Writes buffered data of the file and commits it to the storage device.
+ */
+bool Util::FlushFileBuffers(FILE* pFile)
+{
+	if (fflush(pFile))
+	{
+		return false;
+	}
+#ifdef WIN32
+	return _commit(_fileno(pFile)) == 0;
+#else
+	return fsync(fileno(pFile)) == 0;
+#endif
+}
+
 //replace bad chars in filename
 void Util::MakeValidFilename(char* szFilename, char cReplaceChar, bool bAllowSlashes)
 {
@@ -1310,6 +1434,17 @@ unsigned int Util::HashBJ96(const char* szBuffer, int iBufSize, unsigned int iIn
 	return (unsigned int)hash((ub1*)szBuffer, (ub4)iBufSize, (ub4)iInitValue);
 }
 
+unsigned long long Util::HashFNV64(const char* szBuffer, int iBufSize)
+{
+	unsigned long long lHash = 14695981039346656037ULL;
+	for (int i = 0; i < iBufSize; i++)
+	{
+		lHash ^= (unsigned char)szBuffer[i];
+		lHash *= 1099511628211ULL;
+	}
+	return lHash;
+}
+
 #ifdef WIN32
 bool Util::RegReadStr(HKEY hKey, const char* szKeyName, const char* szValueName, char* szBuffer, int* iBufLen)
 {
@@ -1561,6 +1696,30 @@ int Util::NumberOfCpuCores()
 	return -1;
 }
 
+long long Util::CurrentTicks()
+{
+#ifdef WIN32
+	static LARGE_INTEGER iFrequency = { 0 };
+	if (iFrequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&iFrequency);
+	}
+	LARGE_INTEGER iCounter;
+	QueryPerformanceCounter(&iCounter);
+	return (long long)(iCounter.QuadPart / iFrequency.QuadPart * 1000000 +
+		iCounter.QuadPart % iFrequency.QuadPart * 1000000 / iFrequency.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+	// monotonic clock isn't affected by adjustments of system time
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (long long)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
 
 unsigned int WebUtil::DecodeBase64(char* szInputBuffer, int iInputBufferLength, char* szOutputBuffer)
 {
@@ -2614,6 +2773,53 @@ unsigned int ZLib::GZip(const void* szInputBuffer, int iInputBufferLength, void*
 	return total_out;
 }
 
+bool ZLib::IsGZip(const void* szBuffer, int iBufferLength)
+{
+	return iBufferLength >= 2 && ((const unsigned char*)szBuffer)[0] == 0x1F &&
+		((const unsigned char*)szBuffer)[1] == 0x8B;
+}
+
+bool ZLib::GUnzip(const void* szInputBuffer, int iInputBufferLength, char** pOutputBuffer, int* pOutputBufferLength)
+{
+	GUnzipStream cGUnzipStream(64 * 1024);
+	cGUnzipStream.Write(szInputBuffer, iInputBufferLength);
+
+	int iBufSize = iInputBufferLength * 4 + 1;
+	char* szBuf = (char*)malloc(iBufSize);
+	int iBufLen = 0;
+
+	while (true)
+	{
+		const void* pOutBuf;
+		int iOutLen;
+		GUnzipStream::EStatus eStatus = cGUnzipStream.Read(&pOutBuf, &iOutLen);
+		if (eStatus == GUnzipStream::zlError || (eStatus == GUnzipStream::zlOK && iOutLen == 0))
+		{
+			// error or truncated data
+			free(szBuf);
+			return false;
+		}
+
+		if (iBufLen + iOutLen + 1 > iBufSize)
+		{
+			iBufSize = (iBufLen + iOutLen + 1) * 2;
+			szBuf = (char*)realloc(szBuf, iBufSize);
+		}
+		memcpy(szBuf + iBufLen, pOutBuf, iOutLen);
+		iBufLen += iOutLen;
+
+		if (eStatus == GUnzipStream::zlFinished)
+		{
+			break;
+		}
+	}
+
+	szBuf[iBufLen] = '\0';
+	*pOutputBuffer = szBuf;
+	*pOutputBufferLength = iBufLen;
+	return true;
+}
+
 GUnzipStream::GUnzipStream(int BufferSize)
 {
 	m_iBufferSize = BufferSize;
@@ -80,6 +80,29 @@ public:
 	void				Clear();
 };
 
+/*
+ * Read-only view of a file content. Uses memory mapping where possible,
+ * the pages are loaded by operating system on first access.
+ */
+class MappedFile
+{
+private:
+	char*				m_pData;
+	long long			m_lSize;
+#ifdef WIN32
+	HANDLE				m_hFile;
+	HANDLE				m_hMapping;
+#endif
+
+public:
+						MappedFile();
+						~MappedFile();
+	bool				Open(const char* szFilename);
+	void				Close();
+	const char*			GetData() { return m_pData; }
+	long long			GetSize() { return m_lSize; }
+};
+
 class Util
 {
 public:
@@ -89,6 +112,7 @@ public:
 	static bool SaveBufferIntoFile(const char* szFileName, const char* szBuffer, int iBufLen);
 	static bool CreateSparseFile(const char* szFilename, long long iSize);
 	static bool TruncateFile(const char* szFilename, int iSize);
+	static bool FlushFileBuffers(FILE* pFile);
 	static void MakeValidFilename(char* szFilename, char cReplaceChar, bool bAllowSlashes);
 	static bool MakeUniqueFilename(char* szDestBufFilename, int iDestBufSize, const char* szDestDir, const char* szBasename);
 	static bool MoveFile(const char* szSrcFilename, const char* szDstFilename);
@@ -145,6 +169,9 @@ public:
 	/* Calculate Hash using Bob Jenkins (1996) algorithm */
 	static unsigned int HashBJ96(const char* szBuffer, int iBufSize, unsigned int iInitValue);
 
+	/* Calculate 64-bit Hash using Fowler-Noll-Vo (FNV-1a) algorithm */
+	static unsigned long long HashFNV64(const char* szBuffer, int iBufSize);
+
 #ifdef WIN32
 	static bool RegReadStr(HKEY hKey, const char* szKeyName, const char* szValueName, char* szBuffer, int* iBufLen);
 #endif
@@ -172,6 +199,12 @@ public:
 	 * Returns number of available CPU cores or -1 if it could not be determined
 	 */
 	static int NumberOfCpuCores();
+
+	/*
+	 * Returns current time in microseconds. The value is only useful
+	 * for measuring of time intervals, it has no relation to calendar time.
+	 */
+	static long long CurrentTicks();
 };
 
 class WebUtil
@@ -332,6 +365,17 @@ public:
 	 * returns the size of bytes written to szOutputBuffer or 0 if the buffer is too small or an error occured.
 	 */
 	static unsigned int GZip(const void* szInputBuffer, int iInputBufferLength, void* szOutputBuffer, int iOutputBufferLength);
+
+	/*
+	 * checks if the buffer starts with gzip-header
+	 */
+	static bool IsGZip(const void* szBuffer, int iBufferLength);
+
+	/*
+	 * uncompresses gzip-data into a new buffer allocated with "malloc" and terminated with '\0'.
+	 * returns false if the data could not be uncompressed.
+	 */
+	static bool GUnzip(const void* szInputBuffer, int iInputBufferLength, char** pOutputBuffer, int* pOutputBufferLength);
 };
 
 class GUnzipStream
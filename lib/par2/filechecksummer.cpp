@@ -38,7 +38,16 @@ FileCheckSummer::FileCheckSummer(DiskFile   *_diskfile,
 , windowtable(_windowtable)
 , windowmask(_windowmask)
 {
-  buffer = new char[(size_t)blocksize*2];
+  // With multi-buffer MD5 the buffer holds enough data to hash several
+  // consecutive blocks at once, unless the blocks are very large
+  readahead = min(md5lanes(md5method), (u32)maxhashes);
+  while (readahead > 1 && blocksize * (readahead + 1) > 32 * 1024 * 1024)
+  {
+    readahead--;
+  }
+
+  buffer = new char[(size_t)blocksize*(readahead+1)];
+  bufferend = &buffer[(size_t)blocksize*(readahead+1)];
 
   filesize = diskfile->FileSize();
 
@@ -54,6 +63,8 @@ FileCheckSummer::~FileCheckSummer(void)
 bool FileCheckSummer::Start(void)
 {
   currentoffset = readoffset = 0;
+  hashoffset = ~(u64)0;
+  hashcount = 0;
 
   tailpointer = outpointer = buffer;
   inpointer = &buffer[blocksize];
@@ -100,43 +111,110 @@ bool FileCheckSummer::Jump(u64 distance)
 
   // Move past the data being discarded
   outpointer += distance;
+  inpointer += distance;
   assert(outpointer <= tailpointer);
 
+  // The data must be moved back to the start of the buffer if the new window
+  // is not completely in it or leaves no room to slide. When the blocks are hashed several at a time
+  // it is also done if fewer of them than possible are in the buffer and
+  // the hash of the window is not known yet.
+  if (inpointer >= bufferend ||
+      (readoffset < filesize &&
+       (inpointer > tailpointer ||
+        (readahead > 1 && !HashKnown() && &inpointer[(readahead-1)*blocksize] > tailpointer))))
+  {
+    if (!Compact())
+      return false;
+  }
+
+  // Compute the checksum for the block
+  checksum = ~0 ^ CRCUpdateBlock(~0, (size_t)blocksize, outpointer);
+
+  return true;
+}
+
+// Step forward until there may be a matching block at the current offset.
+// This is the same as calling Step() and testing the checksum repeatedly,
+// but the window slides within the buffer in a tight loop which only has to
+// fall back to Step() when the buffer needs to be refilled.
+bool FileCheckSummer::StepToCandidate(const VerificationHashTable &hashtable, u64 distance)
+{
+  while (distance > 0 && currentoffset < filesize)
+  {
+    // How far can the window slide without reaching the end of the buffer
+    // or the end of the file
+    u64 run = min(distance, (u64)(bufferend - inpointer - 1));
+    run = min(run, filesize - currentoffset - 1);
+
+    if (run == 0)
+    {
+      // Let Step() deal with it
+      if (!Step())
+        return false;
+      distance--;
+
+      if (currentoffset >= filesize || hashtable.MayContain(checksum))
+        return true;
+
+      continue;
+    }
+
+    const u8 *in = (const u8*)inpointer;
+    const u8 *out = (const u8*)outpointer;
+    const u8 *end = out + run;
+    u32 crc = windowmask ^ checksum;
+    bool found = false;
+
+    while (out < end)
+    {
+      crc = CRCSlideChar(crc, *in++, *out++, windowtable);
+      if (hashtable.MayContain(windowmask ^ crc))
+      {
+        found = true;
+        break;
+      }
+    }
+
+    size_t done = out - (const u8*)outpointer;
+    inpointer += done;
+    outpointer += done;
+    currentoffset += done;
+    distance -= done;
+    checksum = windowmask ^ crc;
+
+    if (found)
+      return true;
+  }
+
+  return true;
+}
+
+// Move the data which is still needed to the start of the buffer
+
+bool FileCheckSummer::Compact(void)
+{
   // Is there any data left in the buffer that we are keeping
-  size_t keep = tailpointer - outpointer;
+  size_t keep = tailpointer > outpointer ? tailpointer - outpointer : 0;
   if (keep > 0)
   {
     // Move it back to the start of the buffer
     memmove(buffer, outpointer, keep);
-    tailpointer = &buffer[keep];
-  }
-  else
-  {
-    tailpointer = buffer;
   }
 
+  tailpointer = &buffer[keep];
   outpointer = buffer;
   inpointer = &buffer[blocksize];
 
-  if (!Fill())
-    return false;
-
-  // Compute the checksum for the block
-  checksum = ~0 ^ CRCUpdateBlock(~0, (size_t)blocksize, buffer);
-
-  return true;
+  // Fill the rest of the buffer
+  return Fill();
 }
 
 // Fill the buffer from disk
 
 bool FileCheckSummer::Fill(void)
 {
-  // Have we already reached the end of the file
-  if (readoffset >= filesize)
-    return true;
-
   // How much data can we read into the buffer
-  size_t want = (size_t)min(filesize-readoffset, (u64)(&buffer[2*blocksize]-tailpointer));
+  size_t want = readoffset < filesize ? (size_t)min(filesize-readoffset, (u64)(bufferend-tailpointer)) : 0;
 
   if (want > 0)
   {
@@ -150,7 +228,7 @@ bool FileCheckSummer::Fill(void)
   }
 
   // Did we fill the buffer
-  want = &buffer[2*blocksize] - tailpointer;
+  want = bufferend - tailpointer;
   if (want > 0)
   {
     // Blank the rest of the buffer
@@ -214,13 +292,27 @@ void FileCheckSummer::GetFileHashes(MD5Hash &hashfull, MD5Hash &hash16k) const
 // Compute and return the current hash
 MD5Hash FileCheckSummer::Hash(void)
 {
-  MD5Context context;
-  context.Update(outpointer, (size_t)blocksize);
+  if (!HashKnown())
+  {
+    // Hash the window and the complete blocks following it in the buffer,
+    // which are tested next if the window is part of a sequence of matches
+    const void *buffers[maxhashes];
+    size_t lengths[maxhashes];
+    u32 count = 0;
+    do
+    {
+      buffers[count] = &outpointer[count*blocksize];
+      lengths[count] = (size_t)blocksize;
+      count++;
+    } while (count < readahead && &outpointer[(count+1)*blocksize] <= tailpointer);
 
-  MD5Hash hash;
-  context.Final(hash);
+    MD5MultiHash(md5method, count, buffers, lengths, hashes);
 
-  return hash;
+    hashoffset = currentoffset;
+    hashcount = count;
+  }
+
+  return hashes[(currentoffset - hashoffset) / blocksize];
 }
 
 u32 FileCheckSummer::ShortChecksum(u64 blocklength)
@@ -33,6 +33,8 @@
 // the object also computes the MD5 Hash of the whole file and of
 // the first 16k of the file for later tests.
 
+class VerificationHashTable;
+
 class FileCheckSummer
 {
 public:
@@ -51,10 +53,16 @@ public:
   // Step forward one byte
   bool Step(void);
 
+  // Step forward byte by byte (at most the specified distance) until the
+  // current checksum passes the crc filter of the hash table
+  bool StepToCandidate(const VerificationHashTable &hashtable, u64 distance);
+
   // Return the current checksum
   u32 Checksum(void) const;
 
-  // Compute and return the current hash
+  // Compute and return the current hash. The hashes of the following blocks
+  // are computed at the same time (if they are in the buffer and multi-buffer
+  // MD5 is available) and remembered until they are needed.
   MD5Hash Hash(void);
 
   // Compute short values of checksum and hash
@@ -84,6 +92,8 @@ protected:
 
   u64         currentoffset; // file offset for current window position
   char       *buffer;        // buffer for reading from the file
+  char       *bufferend;     // &buffer[blocksize*(readahead+1)]
+  u32         readahead;     // how many blocks the buffer holds in addition to the window
   char       *outpointer;    // position in buffer of scan window
   char       *inpointer;     // &outpointer[blocksize];
   char       *tailpointer;   // after last valid data in buffer
@@ -94,6 +104,12 @@ protected:
   // The current checksum
   u32         checksum;
 
+  // The hashes of the window at offset hashoffset and of the blocks following it
+  enum {maxhashes = 8};
+  MD5Hash     hashes[maxhashes];
+  u32         hashcount;
+  u64         hashoffset;
+
   // MD5 hash of whole file and of first 16k
   MD5Context  contextfull;
   MD5Context  context16k;
@@ -104,6 +120,12 @@ protected:
 
   //// Fill the buffers with more data from disk
   bool Fill(void);
+
+  // Move the data from the window onwards to the start of the buffer and fill it
+  bool Compact(void);
+
+  // Is the hash of the window at the current offset known already
+  bool HashKnown(void) const;
 };
 
 // Return the current checksum
@@ -113,6 +135,14 @@ inline u32 FileCheckSummer::Checksum(void) const
   return checksum;
 }
 
+// Return whether the hash of the current window has been computed
+inline bool FileCheckSummer::HashKnown(void) const
+{
+  return currentoffset >= hashoffset &&
+         currentoffset - hashoffset < hashcount * blocksize &&
+         (currentoffset - hashoffset) % blocksize == 0;
+}
+
 // Return the current block length
 
 inline u64 FileCheckSummer::BlockLength(void) const
@@ -159,19 +189,13 @@ inline bool FileCheckSummer::Step(void)
   checksum = windowmask ^ CRCSlideChar(windowmask ^ checksum, inch, outch, windowtable);
 
   // Can the window slide further
-  if (outpointer < &buffer[blocksize])
+  if (inpointer < bufferend)
     return true;
 
-  assert(outpointer == &buffer[blocksize]);
-
-  // Copy the data back to the beginning of the buffer
-  memmove(buffer, outpointer, (size_t)blocksize);
-  inpointer = outpointer;
-  outpointer = buffer;
-  tailpointer -= blocksize;
+  assert(inpointer == bufferend);
 
-  // Fill the rest of the buffer
-  return Fill();
+  // Copy the data back to the beginning of the buffer and fill the rest
+  return Compact();
 }
 
 
@@ -19,6 +19,21 @@
 
 #include "par2cmdline.h"
 
+// The SIMD kernels are compiled for their instruction sets via function
+// attributes and are only called if the CPU supports them.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+  ((defined(__clang__) && (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8))) || \
+  (!defined(__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#  define MD5_SIMD
+#  define MD5_TARGET(isa) __attribute__((target(isa)))
+#  include <immintrin.h>
+#elif defined(_MSC_VER) && _MSC_VER >= 1800 && (defined(_M_X64) || defined(_M_IX86))
+#  define MD5_SIMD
+#  define MD5_TARGET(isa)
+#  include <intrin.h>
+#  include <immintrin.h>
+#endif
+
 #ifdef _MSC_VER
 #ifdef _DEBUG
 #undef THIS_FILE
@@ -262,6 +277,14 @@ void MD5Context::Update(const void *buffer, size_t length)
   } 
 }
 
+// Continue from a saved state
+void MD5Context::SetState(const u32 (&_state)[4], u64 _bytes)
+{
+  memcpy(state, _state, sizeof(state));
+  used = 0;
+  bytes = _bytes;
+}
+
 // Finalise the computation and extract the Hash value
 void MD5Context::Final(MD5Hash &output)
 {
@@ -323,6 +346,314 @@ MD5Hash MD5Context::Hash(void) const
   return output;
 }
 
+#ifdef MD5_SIMD
+
+// All 64 steps of the MD5 block function, shared by the SIMD kernels
+// which apply them to vectors holding the same word of several buffers.
+#define MD5_ROUNDS(R, f1, f2, f3, f4) \
+  R(f1, a, b, c, d,  0,  7, 0xd76aa478); \
+  R(f1, d, a, b, c,  1, 12, 0xe8c7b756); \
+  R(f1, c, d, a, b, 2, 17, 0x242070db); \
+  R(f1, b, c, d, a,  3, 22, 0xc1bdceee); \
+ \
+  R(f1, a, b, c, d,  4,  7, 0xf57c0faf); \
+  R(f1, d, a, b, c,  5, 12, 0x4787c62a); \
+  R(f1, c, d, a, b,  6, 17, 0xa8304613); \
+  R(f1, b, c, d, a,  7, 22, 0xfd469501); \
+ \
+  R(f1, a, b, c, d,  8,  7, 0x698098d8); \
+  R(f1, d, a, b, c,  9, 12, 0x8b44f7af); \
+  R(f1, c, d, a, b, 10, 17, 0xffff5bb1); \
+  R(f1, b, c, d, a, 11, 22, 0x895cd7be); \
+ \
+  R(f1, a, b, c, d, 12,  7, 0x6b901122); \
+  R(f1, d, a, b, c, 13, 12, 0xfd987193); \
+  R(f1, c, d, a, b, 14, 17, 0xa679438e); \
+  R(f1, b, c, d, a, 15, 22, 0x49b40821); \
+ \
+  R(f2, a, b, c, d,  1,  5, 0xf61e2562); \
+  R(f2, d, a, b, c,  6,  9, 0xc040b340); \
+  R(f2, c, d, a, b, 11, 14, 0x265e5a51); \
+  R(f2, b, c, d, a,  0, 20, 0xe9b6c7aa); \
+ \
+  R(f2, a, b, c, d,  5,  5, 0xd62f105d); \
+  R(f2, d, a, b, c, 10,  9, 0x02441453); \
+  R(f2, c, d, a, b, 15, 14, 0xd8a1e681); \
+  R(f2, b, c, d, a,  4, 20, 0xe7d3fbc8); \
+ \
+  R(f2, a, b, c, d,  9,  5, 0x21e1cde6); \
+  R(f2, d, a, b, c, 14,  9, 0xc33707d6); \
+  R(f2, c, d, a, b,  3, 14, 0xf4d50d87); \
+  R(f2, b, c, d, a,  8, 20, 0x455a14ed); \
+ \
+  R(f2, a, b, c, d, 13,  5, 0xa9e3e905); \
+  R(f2, d, a, b, c,  2,  9, 0xfcefa3f8); \
+  R(f2, c, d, a, b,  7, 14, 0x676f02d9); \
+  R(f2, b, c, d, a, 12, 20, 0x8d2a4c8a); \
+ \
+  R(f3, a, b, c, d,  5,  4, 0xfffa3942); \
+  R(f3, d, a, b, c,  8, 11, 0x8771f681); \
+  R(f3, c, d, a, b, 11, 16, 0x6d9d6122); \
+  R(f3, b, c, d, a, 14, 23, 0xfde5380c); \
+ \
+  R(f3, a, b, c, d,  1,  4, 0xa4beea44); \
+  R(f3, d, a, b, c,  4, 11, 0x4bdecfa9); \
+  R(f3, c, d, a, b,  7, 16, 0xf6bb4b60); \
+  R(f3, b, c, d, a, 10, 23, 0xbebfbc70); \
+ \
+  R(f3, a, b, c, d, 13,  4, 0x289b7ec6); \
+  R(f3, d, a, b, c,  0, 11, 0xeaa127fa); \
+  R(f3, c, d, a, b,  3, 16, 0xd4ef3085); \
+  R(f3, b, c, d, a,  6, 23, 0x04881d05); \
+ \
+  R(f3, a, b, c, d,  9,  4, 0xd9d4d039); \
+  R(f3, d, a, b, c, 12, 11, 0xe6db99e5); \
+  R(f3, c, d, a, b, 15, 16, 0x1fa27cf8); \
+  R(f3, b, c, d, a,  2, 23, 0xc4ac5665); \
+ \
+  R(f4, a, b, c, d,  0,  6, 0xf4292244); \
+  R(f4, d, a, b, c,  7, 10, 0x432aff97); \
+  R(f4, c, d, a, b, 14, 15, 0xab9423a7); \
+  R(f4, b, c, d, a,  5, 21, 0xfc93a039); \
+ \
+  R(f4, a, b, c, d, 12,  6, 0x655b59c3); \
+  R(f4, d, a, b, c,  3, 10, 0x8f0ccc92); \
+  R(f4, c, d, a, b, 10, 15, 0xffeff47d); \
+  R(f4, b, c, d, a, 1, 21, 0x85845dd1); \
+ \
+  R(f4, a, b, c, d,  8,  6, 0x6fa87e4f); \
+  R(f4, d, a, b, c, 15, 10, 0xfe2ce6e0); \
+  R(f4, c, d, a, b,  6, 15, 0xa3014314); \
+  R(f4, b, c, d, a, 13, 21, 0x4e0811a1); \
+ \
+  R(f4, a, b, c, d,  4,  6, 0xf7537e82); \
+  R(f4, d, a, b, c, 11, 10, 0xbd3af235); \
+  R(f4, c, d, a, b,  2, 15, 0x2ad7d2bb); \
+  R(f4, b, c, d, a,  9, 21, 0xeb86d391);
+
+// Transpose the 64 byte blocks of four buffers so that block[k] holds
+// word k of each of them
+#define MD5_TRANSPOSE4(p0, p1, p2, p3, block) \
+  for (int q = 0; q < 4; q++) \
+  { \
+    __m128i r0 = _mm_loadu_si128((const __m128i*)(p0) + q); \
+    __m128i r1 = _mm_loadu_si128((const __m128i*)(p1) + q); \
+    __m128i r2 = _mm_loadu_si128((const __m128i*)(p2) + q); \
+    __m128i r3 = _mm_loadu_si128((const __m128i*)(p3) + q); \
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1); \
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3); \
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1); \
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3); \
+    block[4*q+0] = _mm_unpacklo_epi64(t0, t1); \
+    block[4*q+1] = _mm_unpackhi_epi64(t0, t1); \
+    block[4*q+2] = _mm_unpacklo_epi64(t2, t3); \
+    block[4*q+3] = _mm_unpackhi_epi64(t2, t3); \
+  }
+
+#define SSE2_ROL(x,s)        _mm_or_si128(_mm_slli_epi32(x, s), _mm_srli_epi32(x, 32-(s)))
+#define SSE2_F1(x,y,z)       _mm_xor_si128(z, _mm_and_si128(x, _mm_xor_si128(y, z)))
+#define SSE2_F2(x,y,z)       _mm_xor_si128(y, _mm_and_si128(z, _mm_xor_si128(x, y)))
+#define SSE2_F3(x,y,z)       _mm_xor_si128(_mm_xor_si128(x, y), z)
+#define SSE2_F4(x,y,z)       _mm_xor_si128(y, _mm_or_si128(x, _mm_xor_si128(z, ones)))
+#define SSE2_ROUND(f,w,x,y,z,k,s,ti) \
+  w = _mm_add_epi32(x, SSE2_ROL(_mm_add_epi32(_mm_add_epi32(w, f(x,y,z)), \
+                                              _mm_add_epi32(block[k], _mm_set1_epi32((int)ti))), s))
+
+// Process the given number of 64 byte blocks of four buffers. The state
+// holds word i of the state of lane j in state[i*4+j].
+MD5_TARGET("sse2")
+static void md5blockssse2(u32 *state, const u8 *const *data, size_t blocks)
+{
+  const __m128i ones = _mm_set1_epi32(-1);
+
+  __m128i a = _mm_loadu_si128((const __m128i*)&state[0]);
+  __m128i b = _mm_loadu_si128((const __m128i*)&state[4]);
+  __m128i c = _mm_loadu_si128((const __m128i*)&state[8]);
+  __m128i d = _mm_loadu_si128((const __m128i*)&state[12]);
+
+  for (size_t i = 0; i < blocks; i++)
+  {
+    __m128i block[16];
+    MD5_TRANSPOSE4(data[0] + i*64, data[1] + i*64, data[2] + i*64, data[3] + i*64, block);
+
+    __m128i aa = a;
+    __m128i bb = b;
+    __m128i cc = c;
+    __m128i dd = d;
+
+    MD5_ROUNDS(SSE2_ROUND, SSE2_F1, SSE2_F2, SSE2_F3, SSE2_F4);
+
+    a = _mm_add_epi32(a, aa);
+    b = _mm_add_epi32(b, bb);
+    c = _mm_add_epi32(c, cc);
+    d = _mm_add_epi32(d, dd);
+  }
+
+  _mm_storeu_si128((__m128i*)&state[0], a);
+  _mm_storeu_si128((__m128i*)&state[4], b);
+  _mm_storeu_si128((__m128i*)&state[8], c);
+  _mm_storeu_si128((__m128i*)&state[12], d);
+}
+
+#define AVX2_ROL(x,s)        _mm256_or_si256(_mm256_slli_epi32(x, s), _mm256_srli_epi32(x, 32-(s)))
+#define AVX2_F1(x,y,z)       _mm256_xor_si256(z, _mm256_and_si256(x, _mm256_xor_si256(y, z)))
+#define AVX2_F2(x,y,z)       _mm256_xor_si256(y, _mm256_and_si256(z, _mm256_xor_si256(x, y)))
+#define AVX2_F3(x,y,z)       _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+#define AVX2_F4(x,y,z)       _mm256_xor_si256(y, _mm256_or_si256(x, _mm256_xor_si256(z, ones)))
+#define AVX2_ROUND(f,w,x,y,z,k,s,ti) \
+  w = _mm256_add_epi32(x, AVX2_ROL(_mm256_add_epi32(_mm256_add_epi32(w, f(x,y,z)), \
+                                                    _mm256_add_epi32(block[k], _mm256_set1_epi32((int)ti))), s))
+
+// Same as md5blockssse2 for eight buffers, state[i*8+j] is word i of lane j
+MD5_TARGET("avx2")
+static void md5blocksavx2(u32 *state, const u8 *const *data, size_t blocks)
+{
+  const __m256i ones = _mm256_set1_epi32(-1);
+
+  __m256i a = _mm256_loadu_si256((const __m256i*)&state[0]);
+  __m256i b = _mm256_loadu_si256((const __m256i*)&state[8]);
+  __m256i c = _mm256_loadu_si256((const __m256i*)&state[16]);
+  __m256i d = _mm256_loadu_si256((const __m256i*)&state[24]);
+
+  for (size_t i = 0; i < blocks; i++)
+  {
+    __m128i lo[16];
+    __m128i hi[16];
+    MD5_TRANSPOSE4(data[0] + i*64, data[1] + i*64, data[2] + i*64, data[3] + i*64, lo);
+    MD5_TRANSPOSE4(data[4] + i*64, data[5] + i*64, data[6] + i*64, data[7] + i*64, hi);
+
+    __m256i block[16];
+    for (int k = 0; k < 16; k++)
+    {
+      block[k] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo[k]), hi[k], 1);
+    }
+
+    __m256i aa = a;
+    __m256i bb = b;
+    __m256i cc = c;
+    __m256i dd = d;
+
+    MD5_ROUNDS(AVX2_ROUND, AVX2_F1, AVX2_F2, AVX2_F3, AVX2_F4);
+
+    a = _mm256_add_epi32(a, aa);
+    b = _mm256_add_epi32(b, bb);
+    c = _mm256_add_epi32(c, cc);
+    d = _mm256_add_epi32(d, dd);
+  }
+
+  _mm256_storeu_si256((__m256i*)&state[0], a);
+  _mm256_storeu_si256((__m256i*)&state[8], b);
+  _mm256_storeu_si256((__m256i*)&state[16], c);
+  _mm256_storeu_si256((__m256i*)&state[24], d);
+}
+
+#endif // MD5_SIMD
+
+MD5Method md5bestmethod(void)
+{
+#if defined(MD5_SIMD) && defined(__GNUC__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return md5AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return md5SSE2;
+#elif defined(MD5_SIMD)
+  int info[4];
+  __cpuid(info, 0);
+  int maxleaf = info[0];
+  __cpuid(info, 1);
+  bool sse2 = (info[3] & (1 << 26)) != 0;
+  bool osavx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 &&
+               (_xgetbv(0) & 6) == 6;
+  if (osavx && maxleaf >= 7)
+  {
+    __cpuidex(info, 7, 0);
+    if (info[1] & (1 << 5))
+      return md5AVX2;
+  }
+  if (sse2)
+    return md5SSE2;
+#endif
+  return md5Scalar;
+}
+
+MD5Method md5method = md5bestmethod();
+
+u32 md5lanes(MD5Method method)
+{
+  switch (method)
+  {
+  case md5SSE2: return 4;
+  case md5AVX2: return 8;
+  default:      return 1;
+  }
+}
+
+void MD5MultiHash(MD5Method method, size_t count, const void *const *buffers, const size_t *lengths, MD5Hash *hashes)
+{
+  const size_t lanes = md5lanes(method);
+
+  size_t first = 0;
+  while (first < count)
+  {
+    size_t group = min(lanes, count - first);
+
+    // How many whole blocks do all buffers of the group have
+    size_t blocks = lengths[first] / 64;
+    for (size_t lane = 1; lane < group; lane++)
+    {
+      blocks = min(blocks, lengths[first + lane] / 64);
+    }
+
+    u32 state[4*8];
+    for (size_t lane = 0; lane < lanes; lane++)
+    {
+      state[0*lanes + lane] = 0x67452301;
+      state[1*lanes + lane] = 0xefcdab89;
+      state[2*lanes + lane] = 0x98badcfe;
+      state[3*lanes + lane] = 0x10325476;
+    }
+
+#ifdef MD5_SIMD
+    if (group > 1 && blocks > 0)
+    {
+      // Unused lanes process the data of the first buffer again
+      const u8 *data[8];
+      for (size_t lane = 0; lane < lanes; lane++)
+      {
+        data[lane] = (const u8*)buffers[first + (lane < group ? lane : 0)];
+      }
+
+      if (method == md5AVX2)
+        md5blocksavx2(state, data, blocks);
+      else
+        md5blockssse2(state, data, blocks);
+    }
+    else
+#endif
+    {
+      blocks = 0;
+    }
+
+    // Process the remaining data and the padding of each buffer separately
+    for (size_t lane = 0; lane < group; lane++)
+    {
+      u32 lanestate[4];
+      for (int i = 0; i < 4; i++)
+      {
+        lanestate[i] = state[i*lanes + lane];
+      }
+
+      MD5Context context;
+      context.SetState(lanestate, (u64)blocks * 64);
+      context.Update((const u8*)buffers[first + lane] + blocks * 64, lengths[first + lane] - blocks * 64);
+      context.Final(hashes[first + lane]);
+    }
+
+    first += group;
+  }
+}
+
 ostream& operator<<(ostream &result, const MD5Context &c)
 {
   char buffer[50];
@@ -93,6 +93,10 @@ public:
   // Process 0 bytes
   void Update(size_t length);
 
+  // Continue from a state reached after processing a whole number of
+  // 64 byte blocks
+  void SetState(const u32 (&_state)[4], u64 _bytes);
+
   // Compute the final hash value
   void Final(MD5Hash &output);
 
@@ -145,6 +149,31 @@ inline bool MD5Hash::operator<=(const MD5Hash &other) const
   return !other.operator<(*this);
 }
 
+// The methods which MD5MultiHash() can use to compute the hashes of
+// several independent buffers.
+
+typedef enum
+{
+  md5Scalar = 0,  // One buffer after the other
+  md5SSE2,        // Four buffers at once in the lanes of SSE2 registers
+  md5AVX2         // Eight buffers at once in the lanes of AVX2 registers
+} MD5Method;
+
+// The method used by default. It is initialised with the best method
+// the CPU supports and may be lowered (but not raised above that).
+extern MD5Method md5method;
+
+// Determine the best method supported by the CPU
+MD5Method md5bestmethod(void);
+
+// How many buffers the method processes at once
+u32 md5lanes(MD5Method method);
+
+// Compute the hash of each of the count buffers. The hashes are the same
+// as computed by MD5Context, all buffers are processed in parallel for as
+// many 64 byte blocks as the shortest one has.
+void MD5MultiHash(MD5Method method, size_t count, const void *const *buffers, const size_t *lengths, MD5Hash *hashes);
+
 #ifdef WIN32
 #pragma pack(pop)
 #endif
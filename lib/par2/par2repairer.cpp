@@ -46,6 +46,7 @@ Par2Repairer::Par2Repairer(void)
   damagedfilecount = 0;
   missingfilecount = 0;
 
+  inputbatchsize = 1;
   inputbuffer = 0;
   outputbuffer = 0;
 
@@ -1247,7 +1248,10 @@ bool Par2Repairer::VerifySourceFiles(void)
 
   sort(sortedfiles.begin(), sortedfiles.end(), SortSourceFilesByFileName);
 
-  // Start verifying the files
+  // The files which exist are verified after all of them have been found
+  vector<Par2RepairerVerifyJob> jobs;
+
+  // Start looking for the files
   sf = sortedfiles.begin();
   while (sf != sortedfiles.end())
   {
@@ -1286,15 +1290,11 @@ bool Par2Repairer::VerifySourceFiles(void)
       // Remember that we have processed this file
       bool success = diskFileMap.Insert(diskfile);
       assert(success); (void)success;
-      // Do the actual verification
-      if (!VerifyDataFile(diskfile, sourcefile))
-        finalresult = false;
 
-      // We have finished with the file for now
+      // The file is opened again when it is verified
       diskfile->Close();
 
-      // Find out how much data we have found
-      UpdateVerificationResults();
+      jobs.push_back(Par2RepairerVerifyJob(diskfile, sourcefile));
     }
     else
     {
@@ -1315,12 +1315,28 @@ bool Par2Repairer::VerifySourceFiles(void)
     ++sf;
   }
 
+  // Do the actual verification
+  VerifyDataFiles(jobs);
+
+  if (cancelled)
+  {
+    return false;
+  }
+
+  for (vector<Par2RepairerVerifyJob>::iterator job = jobs.begin(); job != jobs.end(); ++job)
+  {
+    if (!job->success)
+      finalresult = false;
+  }
+
   return finalresult;
 }
 
 // Scan any extra files specified on the command line
 bool Par2Repairer::VerifyExtraFiles(const list<CommandLine::ExtraFile> &extrafiles)
 {
+  vector<Par2RepairerVerifyJob> jobs;
+
   for (ExtraFileIterator i=extrafiles.begin(); 
        i!=extrafiles.end() && completefilecount<mainpacket->RecoverableFileCount(); 
        ++i)
@@ -1349,22 +1365,68 @@ bool Par2Repairer::VerifyExtraFiles(const list<CommandLine::ExtraFile> &extrafil
         bool success = diskFileMap.Insert(diskfile);
         assert(success); (void)success;
 
-        // Do the actual verification
-        VerifyDataFile(diskfile, 0);
-        // Ignore errors
-
-        // We have finished with the file for now
+        // The file is opened again when it is verified
         diskfile->Close();
 
-        // Find out how much data we have found
-        UpdateVerificationResults();
+        jobs.push_back(Par2RepairerVerifyJob(diskfile, 0));
       }
     }
   }
 
+  // Do the actual verification
+  VerifyDataFiles(jobs);
+  // Ignore errors
+
   return true;
 }
 
+void Par2Repairer::VerifyDataFiles(vector<Par2RepairerVerifyJob> &jobs)
+{
+  for (vector<Par2RepairerVerifyJob>::iterator job = jobs.begin(); job != jobs.end() && !cancelled; ++job)
+  {
+    VerifyDataFileJob(*job);
+  }
+}
+
+// Verify one of the files passed to VerifyDataFiles()
+void Par2Repairer::VerifyDataFileJob(Par2RepairerVerifyJob &job)
+{
+  if (cancelled)
+  {
+    job.success = false;
+    return;
+  }
+
+  // Extra files are only scanned until all target files are complete
+  if (job.sourcefile == 0)
+  {
+    LockVerification();
+    UpdateVerificationResults();
+    bool allcomplete = completefilecount >= mainpacket->RecoverableFileCount();
+    UnlockVerification();
+
+    if (allcomplete)
+      return;
+  }
+
+  if (!job.diskfile->Open())
+  {
+    job.success = false;
+    return;
+  }
+
+  // Do the actual verification
+  job.success = VerifyDataFile(job.diskfile, job.sourcefile);
+
+  // We have finished with the file for now
+  job.diskfile->Close();
+
+  // Find out how much data we have found
+  LockVerification();
+  UpdateVerificationResults();
+  UnlockVerification();
+}
+
 // Attempt to match the data in the DiskFile with the source file
 bool Par2Repairer::VerifyDataFile(DiskFile *diskfile, Par2RepairerSourceFile *sourcefile)
 {
@@ -1406,7 +1468,9 @@ bool Par2Repairer::VerifyDataFile(DiskFile *diskfile, Par2RepairerSourceFile *so
       {
         // We found a perfect match.
 
+        LockVerification();
         sourcefile->SetCompleteFile(diskfile);
+        UnlockVerification();
 
         // Return the match
         return true;
@@ -1484,6 +1548,8 @@ bool Par2Repairer::VerifyDataFile(DiskFile *diskfile, Par2RepairerSourceFile *so
 
     list<Par2RepairerSourceFile*>::iterator sf = unverifiablesourcefiles.begin();
 
+    LockVerification();
+
     // Compare the hash values of each source file for a match
     while (sf != unverifiablesourcefiles.end())
     {
@@ -1522,12 +1588,16 @@ bool Par2Repairer::VerifyDataFile(DiskFile *diskfile, Par2RepairerSourceFile *so
           }
         }
 
+        UnlockVerification();
+
         // Return the match
         return true;
       }
 
       ++sf;
     }
+
+    UnlockVerification();
   }
 
   return true;
@@ -1606,7 +1676,7 @@ bool Par2Repairer::ScanDataFile(DiskFile                *diskfile,    // [in]
       if (oldfraction != newfraction)
       {
         cout << "Scanning: \"" << shortname << "\": " << newfraction/10 << '.' << newfraction%10 << "%\r" << flush;
-	sig_progress(newfraction);
+	sig_scanprogress(diskfile, newfraction);
 
         if (cancelled)
         {
@@ -1617,10 +1687,33 @@ bool Par2Repairer::ScanDataFile(DiskFile                *diskfile,    // [in]
 
     // If we fail to find a match, it might be because it was a duplicate of a block
     // that we have already found.
-    bool duplicate;
+    bool duplicate = false;
+
+    const VerificationHashEntry *currententry = 0;
+
+    // Other files may be scanned at the same time, the lock is only needed
+    // to look for a match (and record it) if there could be one at all
+    bool crcmatch = verificationhashtable.MayContain(filechecksummer.Checksum()) &&
+                    verificationhashtable.Lookup(filechecksummer.Checksum()) != 0;
+    if (crcmatch || nextentry != 0)
+    {
+      // Compute the hash before locking, FindMatch reuses it
+      if (crcmatch)
+        filechecksummer.Hash();
+
+      LockVerification();
 
-    // Look for a match
-    const VerificationHashEntry *currententry = verificationhashtable.FindMatch(nextentry, sourcefile, filechecksummer, duplicate);
+      // Look for a match
+      currententry = verificationhashtable.FindMatch(nextentry, sourcefile, filechecksummer, duplicate);
+
+      if (currententry != 0 && blocksallocated)
+      {
+        // Record the match
+        currententry->SetBlock(diskfile, filechecksummer.Offset());
+      }
+
+      UnlockVerification();
+    }
 
     // Did we find a match
     if (currententry != 0)
@@ -1656,12 +1749,6 @@ bool Par2Repairer::ScanDataFile(DiskFile                *diskfile,    // [in]
         }
       }
 
-      if (blocksallocated)
-      {
-        // Record the match
-        currententry->SetBlock(diskfile, filechecksummer.Offset());
-      }
-
       // Update the number of matches found
       count++;
 
@@ -1694,8 +1781,9 @@ bool Par2Repairer::ScanDataFile(DiskFile                *diskfile,    // [in]
         // What entry do we expect next
         nextentry = 0;
 
-        // Advance 1 byte
-        if (!filechecksummer.Step())
+        // Advance to the next offset where the crc filter finds a possible
+        // match, but not further than one block to keep the progress updated
+        if (!filechecksummer.StepToCandidate(verificationhashtable, blocksize))
           return false;
       }
     }
@@ -1861,7 +1949,7 @@ bool Par2Repairer::ScanDataFile(DiskFile                *diskfile,    // [in]
     }
   }
   sig_done(name,count, sourcefile && sourcefile->GetVerificationPacket() ? sourcefile->GetVerificationPacket()->BlockCount() : 0);
-  sig_progress(1000);
+  sig_scanprogress(diskfile, 1000);
   return true;
 }
 
@@ -2243,11 +2331,18 @@ bool Par2Repairer::ComputeRSmatrix(void)
 // Allocate memory buffers for reading and writing data to disk.
 bool Par2Repairer::AllocateBuffers(size_t memorylimit)
 {
+  // There is no point in reading more blocks at once than there are
+  if (inputbatchsize > sourceblockcount)
+    inputbatchsize = max(sourceblockcount, (u32)1);
+
+  // The memory limit covers the output blocks and the additional input blocks
+  u32 buffercount = missingblockcount + inputbatchsize - 1;
+
   // Would single pass processing use too much memory
-  if (blocksize * missingblockcount > memorylimit)
+  if (blocksize * buffercount > memorylimit)
   {
     // Pick a size that is small enough
-    chunksize = ~3 & (memorylimit / missingblockcount);
+    chunksize = ~3 & (memorylimit / buffercount);
   }
   else
   {
@@ -2255,7 +2350,7 @@ bool Par2Repairer::AllocateBuffers(size_t memorylimit)
   }
 
   // Allocate the two buffers
-  inputbuffer = new u8[(size_t)chunksize];
+  inputbuffer = new u8[(size_t)chunksize * inputbatchsize];
   outputbuffer = new u8[(size_t)chunksize * missingblockcount];
 
   if (inputbuffer == NULL || outputbuffer == NULL)
@@ -2304,8 +2399,10 @@ bool Par2Repairer::ProcessData(u64 blockoffset, size_t blocklength)
         }
       }
 
-      // Read data from the current input block
-      if (!(*inputblock)->ReadData(blockoffset, blocklength, inputbuffer))
+      // Read data from the current input block into its place in the batch
+      u32 batchindex = inputindex % inputbatchsize;
+      void *inbuf = &((u8*)inputbuffer)[chunksize * batchindex];
+      if (!(*inputblock)->ReadData(blockoffset, blocklength, inbuf))
         return false;
 
       // Have we reached the last source data block
@@ -2317,7 +2414,7 @@ bool Par2Repairer::ProcessData(u64 blockoffset, size_t blocklength)
           size_t wrote;
 
           // Write the block back to disk in the new target file
-          if (!(*copyblock)->WriteData(blockoffset, blocklength, inputbuffer, wrote))
+          if (!(*copyblock)->WriteData(blockoffset, blocklength, inbuf, wrote))
             return false;
 
           totalwritten += wrote;
@@ -2325,8 +2422,17 @@ bool Par2Repairer::ProcessData(u64 blockoffset, size_t blocklength)
         ++copyblock;
       }
 
-      if (!RepairData(inputindex, blocklength))
+      // Process the batch when it is full or the last input block was read
+      u32 firstinput = inputindex - batchindex;
+      u32 inputcount = batchindex + 1;
+      if ((inputcount == inputbatchsize || inputblock + 1 == inputblocks.end()) &&
+          !RepairData(firstinput, inputcount, blocklength))
       {
+      // For each input block of the batch
+      for (u32 batchinput=0; batchinput<inputcount && !cancelled; batchinput++)
+      {
+      void *batchbuf = &((u8*)inputbuffer)[chunksize * batchinput];
+
       // For each output block
       for (u32 outputindex=0; outputindex<missingblockcount; outputindex++)
       {
@@ -2334,7 +2440,7 @@ bool Par2Repairer::ProcessData(u64 blockoffset, size_t blocklength)
         void *outbuf = &((u8*)outputbuffer)[chunksize * outputindex];
 
         // Process the data
-        rs.Process(blocklength, inputindex, inputbuffer, outputindex, outbuf);
+        rs.Process(blocklength, firstinput + batchinput, batchbuf, outputindex, outbuf);
 
         if (noiselevel > CommandLine::nlQuiet)
         {
@@ -2356,6 +2462,7 @@ bool Par2Repairer::ProcessData(u64 blockoffset, size_t blocklength)
         }
       }
       }
+      }
 
       if (cancelled)
       {
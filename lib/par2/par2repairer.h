@@ -22,6 +22,19 @@
 
 #include "parheaders.h"
 
+// A data file which is verified by Par2Repairer::VerifyDataFiles()
+class Par2RepairerVerifyJob
+{
+public:
+  Par2RepairerVerifyJob(DiskFile *_diskfile, Par2RepairerSourceFile *_sourcefile)
+    : diskfile(_diskfile), sourcefile(_sourcefile), success(true) {}
+
+public:
+  DiskFile               *diskfile;
+  Par2RepairerSourceFile *sourcefile; // 0 for extra files
+  bool                    success;
+};
+
 class Par2Repairer
 {
 public:
@@ -126,6 +139,7 @@ protected:
   // Signals
   virtual void sig_filename(std::string filename) {}
   virtual void sig_progress(int progress) {}
+  virtual void sig_scanprogress(DiskFile *diskfile, int progress) { sig_progress(progress); }
   virtual void sig_headers(ParHeaders* headers) {}
   virtual void sig_done(std::string filename, int available, int total) {}
 
@@ -135,8 +149,18 @@ protected:
   // Repair ended
   virtual void EndRepair() {}
 
-  // Repair chunk of data (returns "true" if repaired or "false" if default repair-routine should be used)
-  virtual bool RepairData(u32 inputindex, size_t blocklength) { return false; }
+  // Verify the data files one after another. Derived classes may override this to call
+  // VerifyDataFileJob() for several files concurrently; the access to the verification
+  // results shared by the files must then be serialised in LockVerification().
+  virtual void VerifyDataFiles(vector<Par2RepairerVerifyJob> &jobs);
+  void VerifyDataFileJob(Par2RepairerVerifyJob &job);
+  virtual void LockVerification(void) {}
+  virtual void UnlockVerification(void) {}
+
+  // Repair chunk of data using inputcount input blocks starting at inputindex, which are
+  // stored one after another in inputbuffer (returns "true" if repaired or "false" if
+  // default repair-routine should be used)
+  virtual bool RepairData(u32 inputindex, u32 inputcount, size_t blocklength) { return false; }
 
 protected:
   ParHeaders* headers;                                 // Headers
@@ -186,7 +210,8 @@ protected:
 
   ReedSolomon<Galois16>     rs;                      // The Reed Solomon matrix.
 
-  void                     *inputbuffer;             // Buffer for reading DataBlocks (chunksize)
+  u32                       inputbatchsize;          // How many DataBlocks are read before they are processed
+  void                     *inputbuffer;             // Buffer for reading DataBlocks (chunksize * inputbatchsize)
   void                     *outputbuffer;            // Buffer for writing DataBlocks (chunksize * missingblockcount)
 
   u64                       progress;                // How much data has been processed.
@@ -19,6 +19,22 @@
 
 #include "par2cmdline.h"
 
+// The SIMD kernels are compiled for their instruction sets via function
+// attributes and are only called if the CPU supports them, so the rest of
+// the program does not need any special compiler flags.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+  ((defined(__clang__) && (__clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8))) || \
+  (!defined(__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#  define GF16_SIMD
+#  define GF16_TARGET(isa) __attribute__((target(isa)))
+#  include <immintrin.h>
+#elif defined(_MSC_VER) && _MSC_VER >= 1800 && (defined(_M_X64) || defined(_M_IX86))
+#  define GF16_SIMD
+#  define GF16_TARGET(isa)
+#  include <intrin.h>
+#  include <immintrin.h>
+#endif
+
 #ifdef _MSC_VER
 #ifdef _DEBUG
 #undef THIS_FILE
@@ -267,6 +283,168 @@ template <> bool ReedSolomon<Galois16>::SetInput(u32 count)
   return true;
 }
 
+#ifdef GF16_SIMD
+
+// The product of a 16-bit value with the factor is the sum of the products
+// of each of its four nibbles with the factor. For every nibble position
+// there are two 16-entry tables holding the low and the high bytes of
+// these products, which PSHUFB can look up for 16 nibbles at once.
+
+static void gf16simdtables(Galois16 factor, u8 *tables)
+{
+  for (unsigned int i=0; i<4; i++)
+  {
+    for (unsigned int n=0; n<16; n++)
+    {
+      u16 product = factor * Galois16((u16)(n << (4*i)));
+      tables[(2*i+0)*16 + n] = (u8)(product & 0xff);
+      tables[(2*i+1)*16 + n] = (u8)(product >> 8);
+    }
+  }
+}
+
+GF16_TARGET("ssse3")
+static size_t gf16muladdssse3(const u8 *tables, size_t size, const u8 *src, u8 *dst)
+{
+  const __m128i *t = (const __m128i*)tables;
+  __m128i tl0 = _mm_loadu_si128(t+0);
+  __m128i th0 = _mm_loadu_si128(t+1);
+  __m128i tl1 = _mm_loadu_si128(t+2);
+  __m128i th1 = _mm_loadu_si128(t+3);
+  __m128i tl2 = _mm_loadu_si128(t+4);
+  __m128i th2 = _mm_loadu_si128(t+5);
+  __m128i tl3 = _mm_loadu_si128(t+6);
+  __m128i th3 = _mm_loadu_si128(t+7);
+
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  // Moves the low bytes of the eight 16-bit values to the first half
+  // of the register and the high bytes to the second half
+  const __m128i split = _mm_setr_epi8(0,2,4,6,8,10,12,14, 1,3,5,7,9,11,13,15);
+
+  size_t done = size & ~(size_t)31;
+
+  for (size_t i=0; i<done; i+=32)
+  {
+    __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[i]), split);
+    __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[i+16]), split);
+    __m128i lo = _mm_unpacklo_epi64(a, b);
+    __m128i hi = _mm_unpackhi_epi64(a, b);
+
+    __m128i n0 = _mm_and_si128(lo, mask);
+    __m128i n1 = _mm_and_si128(_mm_srli_epi16(lo, 4), mask);
+    __m128i n2 = _mm_and_si128(hi, mask);
+    __m128i n3 = _mm_and_si128(_mm_srli_epi16(hi, 4), mask);
+
+    __m128i rl = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(tl0, n0), _mm_shuffle_epi8(tl1, n1)),
+                               _mm_xor_si128(_mm_shuffle_epi8(tl2, n2), _mm_shuffle_epi8(tl3, n3)));
+    __m128i rh = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(th0, n0), _mm_shuffle_epi8(th1, n1)),
+                               _mm_xor_si128(_mm_shuffle_epi8(th2, n2), _mm_shuffle_epi8(th3, n3)));
+
+    // Interleave the low and high bytes again and add to the output
+    __m128i *d = (__m128i*)&dst[i];
+    _mm_storeu_si128(d+0, _mm_xor_si128(_mm_loadu_si128(d+0), _mm_unpacklo_epi8(rl, rh)));
+    _mm_storeu_si128(d+1, _mm_xor_si128(_mm_loadu_si128(d+1), _mm_unpackhi_epi8(rl, rh)));
+  }
+
+  return done;
+}
+
+// Same as the SSSE3 version. The AVX2 byte shuffles and unpacks work within
+// each 128-bit lane, so the tables are duplicated into both lanes and the
+// split/interleave steps produce the same byte order as above.
+GF16_TARGET("avx2")
+static size_t gf16muladdavx2(const u8 *tables, size_t size, const u8 *src, u8 *dst)
+{
+  const __m128i *t = (const __m128i*)tables;
+  __m256i tl0 = _mm256_broadcastsi128_si256(_mm_loadu_si128(t+0));
+  __m256i th0 = _mm256_broadcastsi128_si256(_mm_loadu_si128(t+1));
+  __m256i tl1 = _mm256_broadcastsi128_si256(_mm_loadu_si128(t+2));
+  __m256i th1 = _mm256_broadcastsi128_si256(_mm_loadu_si128(t+3));
+  __m256i tl2 = _mm256_broadcastsi128_si256(_mm_loadu_si128(t+4));
+  __m256i th2 = _mm256_broadcastsi128_si256(_mm_loadu_si128(t+5));
+  __m256i tl3 = _mm256_broadcastsi128_si256(_mm_loadu_si128(t+6));
+  __m256i th3 = _mm256_broadcastsi128_si256(_mm_loadu_si128(t+7));
+
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  const __m256i split = _mm256_setr_epi8(0,2,4,6,8,10,12,14, 1,3,5,7,9,11,13,15,
+                                         0,2,4,6,8,10,12,14, 1,3,5,7,9,11,13,15);
+
+  size_t done = size & ~(size_t)63;
+
+  for (size_t i=0; i<done; i+=64)
+  {
+    __m256i a = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)&src[i]), split);
+    __m256i b = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)&src[i+32]), split);
+    __m256i lo = _mm256_unpacklo_epi64(a, b);
+    __m256i hi = _mm256_unpackhi_epi64(a, b);
+
+    __m256i n0 = _mm256_and_si256(lo, mask);
+    __m256i n1 = _mm256_and_si256(_mm256_srli_epi16(lo, 4), mask);
+    __m256i n2 = _mm256_and_si256(hi, mask);
+    __m256i n3 = _mm256_and_si256(_mm256_srli_epi16(hi, 4), mask);
+
+    __m256i rl = _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi8(tl0, n0), _mm256_shuffle_epi8(tl1, n1)),
+                                  _mm256_xor_si256(_mm256_shuffle_epi8(tl2, n2), _mm256_shuffle_epi8(tl3, n3)));
+    __m256i rh = _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi8(th0, n0), _mm256_shuffle_epi8(th1, n1)),
+                                  _mm256_xor_si256(_mm256_shuffle_epi8(th2, n2), _mm256_shuffle_epi8(th3, n3)));
+
+    __m256i *d = (__m256i*)&dst[i];
+    _mm256_storeu_si256(d+0, _mm256_xor_si256(_mm256_loadu_si256(d+0), _mm256_unpacklo_epi8(rl, rh)));
+    _mm256_storeu_si256(d+1, _mm256_xor_si256(_mm256_loadu_si256(d+1), _mm256_unpackhi_epi8(rl, rh)));
+  }
+
+  return done;
+}
+
+#endif // GF16_SIMD
+
+GF16Method gf16bestmethod(void)
+{
+#if defined(GF16_SIMD) && defined(__GNUC__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return gf16AVX2;
+  if (__builtin_cpu_supports("ssse3"))
+    return gf16SSSE3;
+#elif defined(GF16_SIMD)
+  int info[4];
+  __cpuid(info, 0);
+  int maxleaf = info[0];
+  __cpuid(info, 1);
+  bool ssse3 = (info[2] & (1 << 9)) != 0;
+  bool osavx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 &&
+               (_xgetbv(0) & 6) == 6;
+  if (osavx && maxleaf >= 7)
+  {
+    __cpuidex(info, 7, 0);
+    if (info[1] & (1 << 5))
+      return gf16AVX2;
+  }
+  if (ssse3)
+    return gf16SSSE3;
+#endif
+  return gf16Scalar;
+}
+
+GF16Method gf16method = gf16bestmethod();
+
+size_t gf16muladd(GF16Method method, Galois16 factor, size_t size, const void *src, void *dst)
+{
+#ifdef GF16_SIMD
+  if (method == gf16Scalar || size < 32)
+    return 0;
+
+  u8 tables[8*16];
+  gf16simdtables(factor, tables);
+
+  if (method == gf16AVX2)
+    return gf16muladdavx2(tables, size, (const u8*)src, (u8*)dst);
+  return gf16muladdssse3(tables, size, (const u8*)src, (u8*)dst);
+#else
+  return 0;
+#endif
+}
+
 template <> bool ReedSolomon<Galois16>::Process(size_t size, u32 inputindex, const void *inputbuffer, u32 outputindex, void *outputbuffer)
 {
   // Look up the appropriate element in the RS matrix
@@ -276,6 +454,15 @@ template <> bool ReedSolomon<Galois16>::Process(size_t size, u32 inputindex, con
   if (factor == 0)
     return eSuccess;
 
+  // Use the SIMD kernels if available, they leave at most a few bytes
+  // at the end of the block to the code below
+  size_t done = gf16muladd(gf16method, factor, size, inputbuffer, outputbuffer);
+  if (done == size)
+    return eSuccess;
+  size -= done;
+  inputbuffer = &((const u8*)inputbuffer)[done];
+  outputbuffer = &((u8*)outputbuffer)[done];
+
 #ifdef LONGMULTIPLY
   // The 8-bit long multiplication tables
   Galois16 *table = glmt->tables;
@@ -104,6 +104,28 @@ protected:
 #endif
 };
 
+// The methods which ReedSolomon<Galois16>::Process() can use to multiply
+// a block of data by a factor and add the result to the output block.
+
+typedef enum
+{
+  gf16Scalar = 0,  // One or two table lookups per 16-bit value
+  gf16SSSE3,       // Split nibble tables with PSHUFB, 32 bytes at a time
+  gf16AVX2         // Split nibble tables with VPSHUFB, 64 bytes at a time
+} GF16Method;
+
+// The method used by Process(). It is initialised with the best method
+// the CPU supports and may be lowered (but not raised above that).
+extern GF16Method gf16method;
+
+// Determine the best method supported by the CPU
+GF16Method gf16bestmethod(void);
+
+// Multiply-accumulate with the given SIMD method: dst += src * factor.
+// Processes as many whole SIMD blocks as fit into size and returns the
+// number of bytes done; the caller must process the remaining bytes.
+size_t gf16muladd(GF16Method method, Galois16 factor, size_t size, const void *src, void *dst);
+
 template<class g>
 inline ReedSolomon<g>::ReedSolomon(void)
 {
@@ -31,6 +31,8 @@ VerificationHashTable::VerificationHashTable(void)
 {
   hashmask = 0;
   hashtable = 0;
+  crcfiltermask = 0;
+  crcfilter = 0;
 }
 
 VerificationHashTable::~VerificationHashTable(void)
@@ -45,6 +47,7 @@ VerificationHashTable::~VerificationHashTable(void)
   }
 
   delete [] hashtable;
+  delete [] crcfilter;
 }
 
 // Allocate the hash table with a reasonable size
@@ -62,6 +65,19 @@ void VerificationHashTable::SetLimit(u32 limit)
   memset(hashtable, 0, hashmask * sizeof(hashtable[0]));
 
   hashmask--;
+
+  // Use 32 bits per block for the crc filter, which keeps the rate of
+  // false positives below 1%
+  crcfiltermask = 32768;
+  while (crcfiltermask < limit * 32 && crcfiltermask < (1 << 20))
+  {
+    crcfiltermask <<= 1;
+  }
+
+  crcfilter = new u32[crcfiltermask / 32];
+  memset(crcfilter, 0, crcfiltermask / 32 * sizeof(crcfilter[0]));
+
+  crcfiltermask--;
 }
 
 // Load data from a verification packet
@@ -93,6 +109,13 @@ void VerificationHashTable::Load(Par2RepairerSourceFile *sourcefile, u64 blocksi
     // Insert the entry in the hash table
     entry->Insert(&hashtable[entry->Checksum() & hashmask]);
 
+    // Add the crc to the filter
+    u32 crc = entry->Checksum();
+    u32 bit1 = crc & crcfiltermask;
+    u32 bit2 = ((crc >> 16) | (crc << 16)) & crcfiltermask;
+    crcfilter[bit1 >> 5] |= (u32)1 << (bit1 & 31);
+    crcfilter[bit2 >> 5] |= (u32)1 << (bit2 & 31);
+
     // Make the previous entry point forwards to this one
     if (preventry)
     {
@@ -232,6 +232,10 @@ public:
                                          FileCheckSummer &checksummer,
                                          bool &duplicate) const;
 
+  // Quick test using the crc filter: if it returns false there is no
+  // block with the specified crc, if it returns true there may be one.
+  bool MayContain(u32 crc) const;
+
   // Look up based on the block crc
   const VerificationHashEntry* Lookup(u32 crc) const;
 
@@ -242,8 +246,28 @@ public:
 protected:
   VerificationHashEntry **hashtable;
   unsigned int hashmask;
+
+  // Bitmap filter with two bits set for the crc of every block. It is much
+  // smaller than the hash table so that testing the crc at every offset of
+  // a damaged file does not miss the cache.
+  u32 *crcfilter;
+  unsigned int crcfiltermask;
 };
 
+inline bool VerificationHashTable::MayContain(u32 crc) const
+{
+  if (crcfilter)
+  {
+    u32 bit1 = crc & crcfiltermask;
+    u32 bit2 = ((crc >> 16) | (crc << 16)) & crcfiltermask;
+
+    return (crcfilter[bit1 >> 5] & ((u32)1 << (bit1 & 31))) &&
+           (crcfilter[bit2 >> 5] & ((u32)1 << (bit2 & 31)));
+  }
+
+  return true;
+}
+
 // Search for an entry with the specified crc
 inline const VerificationHashEntry* VerificationHashTable::Lookup(u32 crc) const
 {
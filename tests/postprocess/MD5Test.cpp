@@ -0,0 +1,137 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#include "win32.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "catch.h"
+
+#include "par2cmdline.h"
+
+#include "nzbget.h"
+#include "Util.h"
+
+TEST_CASE("MD5: known hash", "[Par][MD5][Quick]")
+{
+	const char* szText = "The quick brown fox jumps over the lazy dog";
+	const void* pBuffers[1] = { szText };
+	size_t iLengths[1] = { strlen(szText) };
+
+	for (int iMethod = md5Scalar; iMethod <= md5bestmethod(); iMethod++)
+	{
+		MD5Hash hash;
+		MD5MultiHash((MD5Method)iMethod, 1, pBuffers, iLengths, &hash);
+
+		// MD5Hash::print() outputs the bytes in reverse order
+		REQUIRE(hash.print() == "D619A442351DD86B82B62B379D7D109E");
+	}
+}
+
+TEST_CASE("MD5: multi-buffer and single buffer hashes are equal", "[Par][MD5][Quick]")
+{
+	const int iCount = 21;
+	const int iMaxSize = 1000;
+	u8* pData = (u8*)malloc(iCount * iMaxSize);
+	const void* pBuffers[iCount];
+	size_t iLengths[iCount];
+	MD5Hash expected[iCount];
+	MD5Hash actual[iCount];
+
+	srand(49);
+	for (int i = 0; i < iCount * iMaxSize; i++)
+	{
+		pData[i] = (u8)(rand() & 0xFF);
+	}
+
+	for (int iTest = 0; iTest < 50; iTest++)
+	{
+		// equal lengths in the first tests as used for par2 blocks, random ones later
+		for (int i = 0; i < iCount; i++)
+		{
+			pBuffers[i] = pData + i * iMaxSize + (iTest % 3);
+			iLengths[i] = iTest < 10 ? iTest * 64 + 1 : rand() % (iMaxSize - 2);
+
+			MD5Context context;
+			context.Update(pBuffers[i], iLengths[i]);
+			context.Final(expected[i]);
+		}
+
+		for (int iMethod = md5Scalar; iMethod <= md5bestmethod(); iMethod++)
+		{
+			INFO("Method " << iMethod << ", test " << iTest);
+			MD5MultiHash((MD5Method)iMethod, iCount, pBuffers, iLengths, actual);
+			for (int i = 0; i < iCount; i++)
+			{
+				bool bEqual = expected[i] == actual[i];
+				REQUIRE(bEqual);
+			}
+		}
+	}
+
+	free(pData);
+}
+
+TEST_CASE("MD5: multi-buffer throughput", "[Par][MD5][Benchmark][.]")
+{
+	const int iCount = 64;
+	const int iSize = 1024 * 1024;
+	u8* pData = (u8*)malloc(iCount * iSize);
+	const void* pBuffers[iCount];
+	size_t iLengths[iCount];
+	MD5Hash hashes[iCount];
+
+	for (int i = 0; i < iCount * iSize; i++)
+	{
+		pData[i] = (u8)(rand() & 0xFF);
+	}
+	for (int i = 0; i < iCount; i++)
+	{
+		pBuffers[i] = pData + i * iSize;
+		iLengths[i] = iSize;
+	}
+
+	const char* szNames[] = { "Scalar", "SSE2", "AVX2" };
+	for (int iMethod = md5Scalar; iMethod <= md5bestmethod(); iMethod++)
+	{
+		long long tStart = Util::CurrentTicks();
+		MD5MultiHash((MD5Method)iMethod, iCount, pBuffers, iLengths, hashes);
+		double fTime = (Util::CurrentTicks() - tStart) / 1000000.0;
+		printf("%s: %i MB in %.3f sec (%.0f MB/s)\n", szNames[iMethod], iCount, fTime, iCount / fTime);
+	}
+
+	free(pData);
+}
@@ -44,25 +44,45 @@
 #include "nzbget.h"
 #include "Options.h"
 #include "ParChecker.h"
+#include "BlockHasher.h"
+#include "ArticleWriter.h"
+#include "Util.h"
 #include "TestUtil.h"
 
 class ParCheckerMock: public ParChecker
 {
 private:
+	FileInfo		m_HashedFileInfo;
+	BlockHasher*	m_pBlockHasher;
+	int				m_iHashedFiles;
+
 	unsigned long	CalcFileCrc(const char* szFilename);
 protected:
 	virtual bool	RequestMorePars(int iBlockNeeded, int* pBlockFound) { return false; }
 	virtual EFileStatus	FindFileCrc(const char* szFilename, unsigned long* lCrc, SegmentList* pSegments);
+	virtual bool	FindBlockHashes(const char* szFilename, BlockHasher* pBlockHasher);
 public:
 					ParCheckerMock();
+					~ParCheckerMock();
 	void			Execute();
 	void			CorruptFile(const char* szFilename, int iOffset);
+	void			InsertByte(const char* szFilename, int iOffset);
+	void			DownloadFile(const char* szFilename, long long lBlockSize, int iArticles,
+						const int* pArticleOffsets, int iFailedArticle);
+	int				GetHashedFiles() { return m_iHashedFiles; }
 };
 
 ParCheckerMock::ParCheckerMock()
 {
 	TestUtil::PrepareWorkingDir("parchecker");
 	SetDestDir(TestUtil::WorkingDir().c_str());
+	m_pBlockHasher = NULL;
+	m_iHashedFiles = 0;
+}
+
+ParCheckerMock::~ParCheckerMock()
+{
+	delete m_pBlockHasher;
 }
 
 void ParCheckerMock::Execute()
@@ -91,6 +111,25 @@ void ParCheckerMock::CorruptFile(const char* szFilename, int iOffset)
 	fclose(pFile);
 }
 
+void ParCheckerMock::InsertByte(const char* szFilename, int iOffset)
+{
+	std::string fullfilename(TestUtil::WorkingDir() + "/" + szFilename);
+
+	char* szBuffer;
+	int iSize;
+	REQUIRE(Util::LoadFileIntoBuffer(fullfilename.c_str(), &szBuffer, &iSize));
+	iSize--; // LoadFileIntoBuffer adds a trailing null character
+
+	FILE* pFile = fopen(fullfilename.c_str(), FOPEN_WB);
+	REQUIRE(pFile != NULL);
+	fwrite(szBuffer, 1, iOffset, pFile);
+	fputc(0, pFile);
+	fwrite(szBuffer + iOffset, 1, iSize - iOffset, pFile);
+	fclose(pFile);
+
+	free(szBuffer);
+}
+
 ParCheckerMock::EFileStatus ParCheckerMock::FindFileCrc(const char* szFilename, unsigned long* lCrc, SegmentList* pSegments)
 {
 	std::ifstream sm((TestUtil::WorkingDir() + "/crc.txt").c_str());
@@ -108,6 +147,82 @@ ParCheckerMock::EFileStatus ParCheckerMock::FindFileCrc(const char* szFilename,
 	return ParChecker::fsUnknown;
 }
 
+/*
+ * Simulates the download of a file: the file is split into articles, which are passed
+ * to the block hasher in reverse order. The data of the failed article is zeroed in the file.
+ */
+void ParCheckerMock::DownloadFile(const char* szFilename, long long lBlockSize, int iArticles,
+	const int* pArticleOffsets, int iFailedArticle)
+{
+	std::string fullfilename(TestUtil::WorkingDir() + "/" + szFilename);
+
+	char* szBuffer;
+	int iSize;
+	REQUIRE(Util::LoadFileIntoBuffer(fullfilename.c_str(), &szBuffer, &iSize));
+	iSize--; // LoadFileIntoBuffer adds a trailing null character
+
+	ArticleCache articleCache;
+	g_pArticleCache = &articleCache;
+	m_HashedFileInfo.SetFilename(szFilename);
+	m_pBlockHasher = new BlockHasher(&m_HashedFileInfo, lBlockSize);
+
+	for (int i = 0; i < iArticles; i++)
+	{
+		int iOffset = pArticleOffsets[i];
+		int iArticleSize = (i < iArticles - 1 ? pArticleOffsets[i + 1] : iSize) - iOffset;
+		char szArticleFilename[1024];
+		snprintf(szArticleFilename, 1024, "%s.%03i", fullfilename.c_str(), i + 1);
+
+		ArticleInfo* pArticleInfo = m_HashedFileInfo.GetArticlePool()->NewArticle();
+		pArticleInfo->SetResultFilename(szArticleFilename);
+		pArticleInfo->SetSegmentOffset(iOffset);
+		pArticleInfo->SetSegmentSize(iArticleSize);
+		m_HashedFileInfo.GetArticles()->push_back(pArticleInfo);
+
+		if (i == iFailedArticle)
+		{
+			memset(szBuffer + iOffset, 0, iArticleSize);
+		}
+		else
+		{
+			FILE* pFile = fopen(szArticleFilename, FOPEN_WB);
+			REQUIRE(pFile != NULL);
+			fwrite(szBuffer + iOffset, 1, iArticleSize, pFile);
+			fclose(pFile);
+		}
+	}
+
+	for (int i = iArticles - 1; i >= 0; i--)
+	{
+		m_pBlockHasher->ArticleCompleted(m_HashedFileInfo.GetArticles()->at(i), i != iFailedArticle);
+	}
+	REQUIRE(m_pBlockHasher->Finish(iSize));
+
+	g_pArticleCache = NULL;
+
+	FILE* pFile = fopen(fullfilename.c_str(), FOPEN_WB);
+	REQUIRE(pFile != NULL);
+	fwrite(szBuffer, 1, iSize, pFile);
+	fclose(pFile);
+
+	free(szBuffer);
+}
+
+bool ParCheckerMock::FindBlockHashes(const char* szFilename, BlockHasher* pBlockHasher)
+{
+	if (!m_pBlockHasher || strcmp(szFilename, m_HashedFileInfo.GetFilename()) ||
+		pBlockHasher->GetBlockSize() != m_pBlockHasher->GetBlockSize())
+	{
+		return false;
+	}
+
+	*pBlockHasher->GetBlockHashes() = *m_pBlockHasher->GetBlockHashes();
+	pBlockHasher->SetFileSize(m_pBlockHasher->GetFileSize());
+	memcpy(pBlockHasher->GetFileMd5(), m_pBlockHasher->GetFileMd5(), 16);
+	m_iHashedFiles++;
+	return true;
+}
+
 unsigned long ParCheckerMock::CalcFileCrc(const char* szFilename)
 {
 	FILE* infile = fopen(szFilename, FOPEN_RB);
@@ -174,6 +289,58 @@ TEST_CASE("Par-checker: repair successful", "[Par][ParChecker][Slow][TestData]")
 	REQUIRE(parChecker.GetParFull() == true);
 }
 
+TEST_CASE("Par-checker: repair of shifted data", "[Par][ParChecker][Slow][TestData]")
+{
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("ParRepair=yes");
+	cmdOpts.push_back("BrokenLog=no");
+	Options options(&cmdOpts, NULL);
+
+	// all blocks after the inserted byte must be found at unaligned offsets
+	ParCheckerMock parChecker;
+	parChecker.InsertByte("testfile.dat", 20000);
+	parChecker.Execute();
+
+	REQUIRE(parChecker.GetStatus() == ParChecker::psRepaired);
+	REQUIRE(parChecker.GetParFull() == true);
+}
+
+TEST_CASE("Par-checker: scanning of damaged file", "[Par][ParChecker][Benchmark][.]")
+{
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("ParRepair=no");
+	cmdOpts.push_back("BrokenLog=no");
+	cmdOpts.push_back("ParQuick=no");
+	Options options(&cmdOpts, NULL);
+
+	ParCheckerMock parChecker;
+
+	// replace the data file with random data, in which no blocks can be found
+	const int iSize = 256 * 1024 * 1024;
+	std::string fullfilename(TestUtil::WorkingDir() + "/testfile.dat");
+	FILE* pFile = fopen(fullfilename.c_str(), FOPEN_WB);
+	REQUIRE(pFile != NULL);
+	char* szBuffer = (char*)malloc(1024 * 1024);
+	srand(48);
+	for (int i = 0; i < iSize / (1024 * 1024); i++)
+	{
+		for (int j = 0; j < 1024 * 1024; j++)
+		{
+			szBuffer[j] = (char)rand();
+		}
+		fwrite(szBuffer, 1, 1024 * 1024, pFile);
+	}
+	free(szBuffer);
+	fclose(pFile);
+
+	long long tStart = Util::CurrentTicks();
+	parChecker.Execute();
+	double fTime = (Util::CurrentTicks() - tStart) / 1000000.0;
+	printf("Scanned %i MB in %.3f sec (%.0f MB/s)\n", iSize / 1024 / 1024, fTime, iSize / 1024 / 1024 / fTime);
+
+	REQUIRE(parChecker.GetStatus() == ParChecker::psFailed);
+}
+
 TEST_CASE("Par-checker: repair failed", "[Par][ParChecker][Slow][TestData]")
 {
 	Options::CmdOptList cmdOpts;
@@ -244,6 +411,44 @@ TEST_CASE("Par-checker: quick full verification repair successful", "[Par][ParCh
 	REQUIRE(parChecker.GetParFull() == true);
 }
 
+TEST_CASE("Par-checker: repair using block hashes computed during download", "[Par][ParChecker][Slow][TestData]")
+{
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("ParRepair=yes");
+	cmdOpts.push_back("BrokenLog=no");
+	Options options(&cmdOpts, NULL);
+
+	ParCheckerMock parChecker;
+	long long lBlockSize = BlockHasher::ReadParBlockSize((TestUtil::WorkingDir() + "/testfile.par2").c_str());
+	REQUIRE(lBlockSize == 636);
+
+	// the failed article damages two blocks, which the par-set can repair
+	const int iArticleOffsets[] = { 0, 20000, 20600, 70000 };
+	parChecker.DownloadFile("testfile.dat", lBlockSize, 4, iArticleOffsets, 1);
+	parChecker.SetParBlockHash(true);
+	parChecker.Execute();
+
+	REQUIRE(parChecker.GetStatus() == ParChecker::psRepaired);
+	REQUIRE(parChecker.GetHashedFiles() == 1);
+	REQUIRE(parChecker.GetParFull() == false);
+}
+
+TEST_CASE("Par-checker: verifying files in parallel", "[Par][ParChecker][Slow][TestData]")
+{
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("ParRepair=yes");
+	cmdOpts.push_back("BrokenLog=no");
+	cmdOpts.push_back("ParThreads=4");
+	Options options(&cmdOpts, NULL);
+
+	ParCheckerMock parChecker;
+	parChecker.CorruptFile("testfile.dat", 20000);
+	parChecker.CorruptFile("testfile.nfo", 100);
+	parChecker.Execute();
+
+	REQUIRE(parChecker.GetStatus() == ParChecker::psRepaired);
+}
+
 TEST_CASE("Par-checker: ignoring extensions", "[Par][ParChecker][Slow][TestData]")
 {
 	Options::CmdOptList cmdOpts;
@@ -0,0 +1,253 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#include "win32.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "catch.h"
+
+#include "par2cmdline.h"
+
+#include "nzbget.h"
+#include "Thread.h"
+#include "Util.h"
+
+static void FillRandom(u8* pBuffer, int iSize)
+{
+	for (int i = 0; i < iSize; i++)
+	{
+		pBuffer[i] = (u8)(rand() & 0xFF);
+	}
+}
+
+// reference implementation: one Galois multiplication per 16-bit value
+static void MulAddScalar(Galois16 factor, int iSize, const u8* pSrc, u8* pDst)
+{
+	for (int i = 0; i < iSize; i += 2)
+	{
+		Galois16 src = (u16)(pSrc[i] | (pSrc[i + 1] << 8));
+		Galois16 dst = (u16)(pDst[i] | (pDst[i + 1] << 8));
+		dst += src * factor;
+		pDst[i] = (u8)(dst.Value() & 0xFF);
+		pDst[i + 1] = (u8)(dst.Value() >> 8);
+	}
+}
+
+TEST_CASE("Reed-Solomon: SIMD multiply-accumulate", "[Par][ReedSolomon][Quick]")
+{
+	const int iMaxSize = 4096 + 62;
+	u8* pSrc = (u8*)malloc(iMaxSize);
+	u8* pExpected = (u8*)malloc(iMaxSize);
+	u8* pActual = (u8*)malloc(iMaxSize);
+
+	srand(45);
+	GF16Method eBest = gf16bestmethod();
+
+	for (int iMethod = gf16SSSE3; iMethod <= eBest; iMethod++)
+	{
+		INFO("Method " << iMethod);
+		for (int iTest = 0; iTest < 200; iTest++)
+		{
+			// mix of fixed corner cases and random factors and sizes
+			u16 iFactor = iTest == 0 ? 1 : iTest == 1 ? 0xFFFF : iTest == 2 ? 0x8000 : (u16)(rand() & 0xFFFF);
+			int iSize = (rand() % (iMaxSize / 2)) * 2;
+
+			FillRandom(pSrc, iSize);
+			FillRandom(pExpected, iSize);
+			memcpy(pActual, pExpected, iSize);
+
+			MulAddScalar(Galois16(iFactor), iSize, pSrc, pExpected);
+
+			size_t iDone = gf16muladd((GF16Method)iMethod, Galois16(iFactor), iSize, pSrc, pActual);
+			int iBlock = iMethod == gf16AVX2 ? 64 : 32;
+			bool bDoneValid = iDone == (size_t)(iSize / iBlock * iBlock);
+			REQUIRE(bDoneValid);
+
+			MulAddScalar(Galois16(iFactor), iSize - (int)iDone, pSrc + iDone, pActual + iDone);
+
+			bool bEqual = memcmp(pExpected, pActual, iSize) == 0;
+			REQUIRE(bEqual);
+		}
+	}
+
+	free(pSrc);
+	free(pExpected);
+	free(pActual);
+}
+
+TEST_CASE("Reed-Solomon: SIMD and table methods give same recovery data", "[Par][ReedSolomon][Quick]")
+{
+	const int iInputCount = 8;
+	const int iOutputCount = 3;
+	const int iBlockSize = 4096 + 36;
+
+	ReedSolomon<Galois16> rs;
+	REQUIRE(rs.SetInput(iInputCount));
+	REQUIRE(rs.SetOutput(false, 0, iOutputCount - 1));
+	REQUIRE(rs.Compute(CommandLine::nlSilent));
+
+	srand(46);
+	u8* pInput = (u8*)malloc(iInputCount * iBlockSize);
+	FillRandom(pInput, iInputCount * iBlockSize);
+
+	u8* pOutput[2];
+	GF16Method eBest = gf16method;
+	for (int k = 0; k < 2; k++)
+	{
+		gf16method = k == 0 ? gf16Scalar : eBest;
+		pOutput[k] = (u8*)malloc(iOutputCount * iBlockSize);
+		memset(pOutput[k], 0, iOutputCount * iBlockSize);
+		for (int iOut = 0; iOut < iOutputCount; iOut++)
+		{
+			for (int iIn = 0; iIn < iInputCount; iIn++)
+			{
+				rs.Process(iBlockSize, iIn, pInput + iIn * iBlockSize, iOut, pOutput[k] + iOut * iBlockSize);
+			}
+		}
+	}
+	gf16method = eBest;
+
+	bool bEqual = memcmp(pOutput[0], pOutput[1], iOutputCount * iBlockSize) == 0;
+	REQUIRE(bEqual);
+
+	free(pInput);
+	free(pOutput[0]);
+	free(pOutput[1]);
+}
+
+TEST_CASE("Reed-Solomon: multiply-accumulate throughput", "[Par][ReedSolomon][Benchmark][.]")
+{
+	const int iSize = 1024 * 1024;
+	const int iRounds = 500;
+	u8* pSrc = (u8*)malloc(iSize);
+	u8* pDst = (u8*)malloc(iSize);
+	FillRandom(pSrc, iSize);
+	memset(pDst, 0, iSize);
+
+	ReedSolomon<Galois16> rs;
+	rs.SetInput(1);
+	rs.SetOutput(false, 1);
+	rs.Compute(CommandLine::nlSilent);
+
+	const char* szNames[] = { "Tables", "SSSE3", "AVX2" };
+	GF16Method eBest = gf16method;
+	for (int iMethod = gf16Scalar; iMethod <= eBest; iMethod++)
+	{
+		gf16method = (GF16Method)iMethod;
+		long long tStart = Util::CurrentTicks();
+		for (int i = 0; i < iRounds; i++)
+		{
+			rs.Process(iSize, 0, pSrc, 0, pDst);
+		}
+		double fTime = (Util::CurrentTicks() - tStart) / 1000000.0;
+		printf("%s: %i MB in %.3f sec (%.0f MB/s)\n", szNames[iMethod], iRounds, fTime, iRounds / fTime);
+	}
+	gf16method = eBest;
+
+	free(pSrc);
+	free(pDst);
+}
+
+// Same partitioning as the par-repairer: one item is a tile of an output
+// block, to which the corresponding parts of all input blocks are added
+class RepairTilesJob : public ParallelJob
+{
+private:
+	ReedSolomon<Galois16>*	m_pRS;
+	u8*					m_pInput;
+	u8*					m_pOutput;
+	int					m_iInputCount;
+	int					m_iOutputCount;
+	int					m_iBlockSize;
+	int					m_iTileSize;
+
+public:
+						RepairTilesJob(ReedSolomon<Galois16>* pRS, u8* pInput, int iInputCount,
+							u8* pOutput, int iOutputCount, int iBlockSize, int iTileSize) :
+							m_pRS(pRS), m_pInput(pInput), m_pOutput(pOutput), m_iInputCount(iInputCount),
+							m_iOutputCount(iOutputCount), m_iBlockSize(iBlockSize), m_iTileSize(iTileSize) {}
+	virtual void		ProcessItem(int iItem);
+	int					GetItemCount() { return m_iOutputCount * (m_iBlockSize / m_iTileSize); }
+};
+
+void RepairTilesJob::ProcessItem(int iItem)
+{
+	int iOutput = iItem % m_iOutputCount;
+	int iOffset = iItem / m_iOutputCount * m_iTileSize;
+	for (int iInput = 0; iInput < m_iInputCount; iInput++)
+	{
+		m_pRS->Process(m_iTileSize, iInput, m_pInput + iInput * m_iBlockSize + iOffset,
+			iOutput, m_pOutput + iOutput * m_iBlockSize + iOffset);
+	}
+}
+
+TEST_CASE("Reed-Solomon: repair scaling with threads", "[Par][ReedSolomon][Benchmark][.]")
+{
+	const int iInputCount = 32;
+	const int iOutputCount = 8;
+	const int iBlockSize = 1024 * 1024;
+	const int iTileSize = 64 * 1024;
+
+	ReedSolomon<Galois16> rs;
+	rs.SetInput(iInputCount);
+	rs.SetOutput(false, 0, iOutputCount - 1);
+	rs.Compute(CommandLine::nlSilent);
+
+	u8* pInput = (u8*)malloc(iInputCount * iBlockSize);
+	u8* pOutput = (u8*)malloc(iOutputCount * iBlockSize);
+	FillRandom(pInput, iInputCount * iBlockSize);
+	memset(pOutput, 0, iOutputCount * iBlockSize);
+
+	RepairTilesJob job(&rs, pInput, iInputCount, pOutput, iOutputCount, iBlockSize, iTileSize);
+	double fData = (double)iInputCount * iOutputCount * iBlockSize / 1024 / 1024;
+
+	int iCores = Util::NumberOfCpuCores();
+	for (int iThreads = 1; iThreads <= (iCores > 0 ? iCores : 1); iThreads++)
+	{
+		WorkerPool pool(iThreads - 1);
+		long long tStart = Util::CurrentTicks();
+		for (int i = 0; i < 5; i++)
+		{
+			pool.Execute(&job, job.GetItemCount());
+		}
+		double fTime = (Util::CurrentTicks() - tStart) / 1000000.0;
+		printf("%i thread(s): %.0f MB in %.3f sec (%.0f MB/s)\n", iThreads, fData * 5, fTime, fData * 5 / fTime);
+	}
+
+	free(pInput);
+	free(pOutput);
+}
@@ -0,0 +1,175 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#include "win32.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "catch.h"
+
+#include "nzbget.h"
+#include "DownloadInfo.h"
+
+TEST_CASE("Article pool: allocating articles and strings", "[ArticlePool][Quick]")
+{
+	FileInfo fileInfo;
+	ArticlePool* pPool = fileInfo.GetArticlePool();
+	char szBuf[256];
+
+	for (int i = 0; i < 2000; i++)
+	{
+		ArticleInfo* pArticleInfo = pPool->NewArticle();
+		REQUIRE(pArticleInfo->GetStatus() == ArticleInfo::aiUndefined);
+		snprintf(szBuf, 256, "<part%i@test.example.com>", i + 1);
+		pArticleInfo->SetMessageID(pPool->AddString(szBuf));
+		pArticleInfo->SetPartNumber(i + 1);
+		pArticleInfo->SetCrc(0xFFFFFFFF - i);
+		pArticleInfo->SetStatus(ArticleInfo::aiFailed);
+		fileInfo.GetArticles()->push_back(pArticleInfo);
+	}
+
+	REQUIRE(pPool->GetArticleCount() == 2000);
+	REQUIRE(fileInfo.CalcArticleMemory() >= 2000 * (long long)(sizeof(ArticleInfo) + sizeof(ArticleInfo*)));
+
+	for (int i = 0; i < 2000; i++)
+	{
+		ArticleInfo* pArticleInfo = fileInfo.GetArticles()->at(i);
+		snprintf(szBuf, 256, "<part%i@test.example.com>", i + 1);
+		REQUIRE(!strcmp(pArticleInfo->GetMessageID(), szBuf));
+		REQUIRE(pArticleInfo->GetPartNumber() == i + 1);
+		REQUIRE(pArticleInfo->GetCrc() == 0xFFFFFFFF - i);
+		REQUIRE(pArticleInfo->GetStatus() == ArticleInfo::aiFailed);
+	}
+
+	const char szData[] = "first\0second";
+	const char* pData = pPool->AddData(szData, sizeof(szData));
+	REQUIRE(!strcmp(pData + 6, "second"));
+
+	fileInfo.ClearArticles();
+	REQUIRE(fileInfo.GetArticles()->empty());
+	REQUIRE(pPool->GetArticleCount() == 0);
+	REQUIRE(pPool->GetAllocated() == 0);
+}
+
+#ifdef __GLIBC__
+/*
+ * Memory footprint of the article representation used before article pools:
+ * each article and each message-id allocated separately on the heap.
+ */
+struct LegacyArticle
+{
+	int					m_iPartNumber;
+	char*				m_szMessageID;
+	int					m_iSize;
+	char*				m_pSegmentContent;
+	long long			m_iSegmentOffset;
+	int					m_iSegmentSize;
+	ArticleInfo::EStatus	m_eStatus;
+	char*				m_szResultFilename;
+	unsigned long		m_lCrc;
+};
+
+long long HeapUsage()
+{
+	struct mallinfo2 mi = mallinfo2();
+	return (long long)(mi.uordblks + mi.hblkhd);
+}
+
+TEST_CASE("Article pool: memory usage report", "[ArticlePool][Benchmark][.]")
+{
+	const int iFiles = 50;
+	const int iArticles = 40000;
+	char szBuf[256];
+
+	long long lStart = HeapUsage();
+	{
+		std::vector<std::vector<LegacyArticle*> > files(iFiles);
+		for (int i = 0; i < iFiles; i++)
+		{
+			for (int k = 0; k < iArticles; k++)
+			{
+				LegacyArticle* pArticle = new LegacyArticle();
+				snprintf(szBuf, 256, "<part%iof%i.file%i.AbCdEfGhIjKlMn@powerpost2000AA.local>", k + 1, iArticles, i);
+				pArticle->m_szMessageID = strdup(szBuf);
+				files[i].push_back(pArticle);
+			}
+		}
+
+		long long lLegacy = HeapUsage() - lStart;
+		printf("Separate allocations: %lli bytes for %i articles (%.1f bytes per article)\n",
+			lLegacy, iFiles * iArticles, (double)lLegacy / (iFiles * iArticles));
+
+		for (int i = 0; i < iFiles; i++)
+		{
+			for (int k = 0; k < iArticles; k++)
+			{
+				free(files[i][k]->m_szMessageID);
+				delete files[i][k];
+			}
+		}
+	}
+
+	lStart = HeapUsage();
+	{
+		std::vector<FileInfo*> files;
+		long long lReported = 0;
+		for (int i = 0; i < iFiles; i++)
+		{
+			FileInfo* pFileInfo = new FileInfo();
+			for (int k = 0; k < iArticles; k++)
+			{
+				ArticleInfo* pArticleInfo = pFileInfo->GetArticlePool()->NewArticle();
+				snprintf(szBuf, 256, "<part%iof%i.file%i.AbCdEfGhIjKlMn@powerpost2000AA.local>", k + 1, iArticles, i);
+				pArticleInfo->SetMessageID(pFileInfo->GetArticlePool()->AddString(szBuf));
+				pFileInfo->GetArticles()->push_back(pArticleInfo);
+			}
+			lReported += pFileInfo->CalcArticleMemory();
+			files.push_back(pFileInfo);
+		}
+
+		long long lPooled = HeapUsage() - lStart;
+		printf("Article pools: %lli bytes for %i articles (%.1f bytes per article), reported by queue: %lli bytes\n",
+			lPooled, iFiles * iArticles, (double)lPooled / (iFiles * iArticles), lReported);
+
+		for (std::vector<FileInfo*>::iterator it = files.begin(); it != files.end(); it++)
+		{
+			delete *it;
+		}
+	}
+}
+#endif
@@ -0,0 +1,342 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#include "win32.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "catch.h"
+
+#include "nzbget.h"
+#include "Options.h"
+#include "DiskState.h"
+#include "QueueCoordinator.h"
+#include "TestUtil.h"
+
+class DownloadQueueMock : public DownloadQueue
+{
+public:
+	virtual bool		EditEntry(int ID, EEditAction eAction, int iOffset, const char* szText) { return false; }
+	virtual bool		EditList(IDList* pIDList, NameList* pNameList, EMatchMode eMatchMode, EEditAction eAction, int iOffset, const char* szText) { return false; }
+	virtual void		Save() {}
+};
+
+class DiskStateTestHelper
+{
+private:
+	Options::CmdOptList	m_cmdOpts;
+	std::string			m_queueOpt;
+	Options*			m_pOptions;
+
+public:
+						DiskStateTestHelper();
+						~DiskStateTestHelper() { delete m_pOptions; }
+	void				CreateQueue(DiskState* pDiskState, DownloadQueue* pDownloadQueue, int iNZBs, int iFiles, int iArticles);
+	int					CountFiles(DownloadQueue* pDownloadQueue);
+};
+
+DiskStateTestHelper::DiskStateTestHelper()
+{
+	TestUtil::PrepareWorkingDir("diskstate");
+	std::string queueDir = TestUtil::WorkingDir() + "/queue/";
+	char szErrBuf[256];
+	REQUIRE(Util::ForceDirectories(queueDir.c_str(), szErrBuf, sizeof(szErrBuf)));
+
+	m_queueOpt = "QueueDir=" + queueDir;
+	m_cmdOpts.push_back(m_queueOpt.c_str());
+	m_cmdOpts.push_back("DetailTarget=none");
+	m_cmdOpts.push_back("InfoTarget=none");
+	m_cmdOpts.push_back("ContinuePartial=yes");
+	m_cmdOpts.push_back("FlushQueue=no");
+	m_pOptions = new Options(&m_cmdOpts, NULL);
+}
+
+void DiskStateTestHelper::CreateQueue(DiskState* pDiskState, DownloadQueue* pDownloadQueue, int iNZBs, int iFiles, int iArticles)
+{
+	char szBuf[256];
+	for (int i = 0; i < iNZBs; i++)
+	{
+		NZBInfo* pNZBInfo = new NZBInfo();
+		snprintf(szBuf, 256, "test%i.nzb", i);
+		pNZBInfo->SetFilename(szBuf);
+		snprintf(szBuf, 256, "test%i", i);
+		pNZBInfo->SetName(szBuf);
+
+		for (int j = 0; j < iFiles; j++)
+		{
+			FileInfo* pFileInfo = new FileInfo();
+			snprintf(szBuf, 256, "test%i.part%03i.rar", i, j);
+			pFileInfo->SetFilename(szBuf);
+			pFileInfo->SetSubject(szBuf);
+			pFileInfo->SetSize((long long)iArticles * 500000);
+			pFileInfo->SetTotalArticles(iArticles);
+			pFileInfo->GetGroups()->push_back(strdup("alt.binaries.test"));
+			for (int k = 0; k < iArticles; k++)
+			{
+				ArticleInfo* pArticleInfo = pFileInfo->GetArticlePool()->NewArticle();
+				snprintf(szBuf, 256, "part%i.file%i.nzb%i@test.example.com", k, j, i);
+				pArticleInfo->SetMessageID(pFileInfo->GetArticlePool()->AddString(szBuf));
+				pArticleInfo->SetPartNumber(k + 1);
+				pArticleInfo->SetSize(500000);
+				pFileInfo->GetArticles()->push_back(pArticleInfo);
+			}
+			pFileInfo->SetNZBInfo(pNZBInfo);
+			pNZBInfo->GetFileList()->push_back(pFileInfo);
+			pNZBInfo->SetSize(pNZBInfo->GetSize() + pFileInfo->GetSize());
+			pNZBInfo->SetTotalArticles(pNZBInfo->GetTotalArticles() + iArticles);
+			pNZBInfo->SetFileCount(pNZBInfo->GetFileCount() + 1);
+			pNZBInfo->SetRemainingSize(pNZBInfo->GetRemainingSize() + pFileInfo->GetSize());
+			REQUIRE(pDiskState->SaveFile(pFileInfo));
+			pFileInfo->ClearArticles();
+		}
+
+		pDownloadQueue->GetQueue()->push_back(pNZBInfo);
+	}
+
+	REQUIRE(pDiskState->SaveDownloadQueue(pDownloadQueue));
+}
+
+int DiskStateTestHelper::CountFiles(DownloadQueue* pDownloadQueue)
+{
+	int iCount = 0;
+	for (NZBList::iterator it = pDownloadQueue->GetQueue()->begin(); it != pDownloadQueue->GetQueue()->end(); it++)
+	{
+		iCount += (int)(*it)->GetFileList()->size();
+	}
+	return iCount;
+}
+
+TEST_CASE("Disk state: saving and loading queue", "[DiskState][Quick][TestData]")
+{
+	DiskStateTestHelper helper;
+	Servers servers;
+
+	{
+		DiskState diskState;
+		DownloadQueueMock downloadQueue;
+		helper.CreateQueue(&diskState, &downloadQueue, 3, 20, 10);
+
+		// download one article of a file and save its state into checkpoint file
+		FileInfo* pFileInfo = downloadQueue.GetQueue()->at(1)->GetFileList()->at(5);
+		REQUIRE(diskState.LoadArticles(pFileInfo));
+		pFileInfo->GetArticles()->at(2)->SetStatus(ArticleInfo::aiFinished);
+		pFileInfo->SetSuccessArticles(1);
+		pFileInfo->SetPartialChanged(true);
+		REQUIRE(diskState.SavePartialStates(&downloadQueue, false));
+
+		// change which is written into journal
+		downloadQueue.GetQueue()->at(2)->SetName("renamed");
+		REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+
+		// journal grows larger than the queue file and is merged into a new one
+		for (int i = 1; i <= 10; i++)
+		{
+			downloadQueue.GetQueue()->at(0)->SetPriority(i);
+			REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+		}
+	}
+
+	DiskState diskState;
+	DownloadQueueMock downloadQueue;
+	REQUIRE(diskState.LoadDownloadQueue(&downloadQueue, &servers));
+
+	REQUIRE(downloadQueue.GetQueue()->size() == 3);
+	REQUIRE(helper.CountFiles(&downloadQueue) == 60);
+	REQUIRE(strcmp(downloadQueue.GetQueue()->at(2)->GetName(), "renamed") == 0);
+	REQUIRE(downloadQueue.GetQueue()->at(0)->GetPriority() == 10);
+
+	FileInfo* pFileInfo = downloadQueue.GetQueue()->at(1)->GetFileList()->at(5);
+	REQUIRE(strcmp(pFileInfo->GetFilename(), "test1.part005.rar") == 0);
+	REQUIRE(pFileInfo->GetTotalArticles() == 10);
+	REQUIRE(pFileInfo->GetSuccessArticles() == 1);
+	REQUIRE(pFileInfo->GetCompletedArticles() == 1);
+
+	// article states are applied when the article list is loaded
+	REQUIRE(pFileInfo->GetArticles()->empty());
+	REQUIRE(diskState.LoadArticles(pFileInfo));
+	REQUIRE(pFileInfo->GetArticles()->size() == 10);
+	REQUIRE(pFileInfo->GetArticles()->at(2)->GetStatus() == ArticleInfo::aiFinished);
+	REQUIRE(pFileInfo->GetArticles()->at(3)->GetStatus() == ArticleInfo::aiUndefined);
+}
+
+TEST_CASE("Disk state: unloading and reloading article lists", "[DiskState][QueueCoordinator][Quick]")
+{
+	DiskStateTestHelper helper;
+	DiskState diskState;
+	DownloadQueueMock downloadQueue;
+	helper.CreateQueue(&diskState, &downloadQueue, 1, 10, 10);
+
+	FileList* pFileList = downloadQueue.GetQueue()->at(0)->GetFileList();
+	for (int i = 0; i < 10; i++)
+	{
+		FileInfo* pFileInfo = pFileList->at(i);
+		REQUIRE(diskState.LoadArticles(pFileInfo));
+		pFileInfo->SetLastUsed(i + 1);
+	}
+	long long lFileMemory = pFileList->at(0)->CalcArticleMemory();
+	long long lTotalMemory = lFileMemory * 10;
+
+	// the least recently used files are busy or have article states not saved yet
+	pFileList->at(0)->SetActiveDownloads(1);
+	pFileList->at(1)->SetCachedArticles(1);
+	pFileList->at(2)->SetCompletedArticles(1);
+	pFileList->at(3)->SetPartialChanged(true);
+	FileInfo* pCurrentFileInfo = pFileList->at(4);
+
+	long long lMemory = QueueCoordinator::UnloadArticleLists(&downloadQueue, pCurrentFileInfo, lTotalMemory - lFileMemory * 3);
+	REQUIRE(lMemory == lTotalMemory - lFileMemory * 3);
+	for (int i = 0; i < 10; i++)
+	{
+		INFO("file " << i);
+		REQUIRE(pFileList->at(i)->GetArticles()->empty() == (i >= 5 && i <= 7));
+	}
+
+	// unloaded list is loaded from disk again
+	FileInfo* pFileInfo = pFileList->at(6);
+	REQUIRE(diskState.LoadArticles(pFileInfo));
+	REQUIRE(pFileInfo->GetArticles()->size() == 10);
+	REQUIRE(pFileInfo->GetArticles()->at(2)->GetPartNumber() == 3);
+	REQUIRE(strcmp(pFileInfo->GetArticles()->at(2)->GetMessageID(), "part2.file6.nzb0@test.example.com") == 0);
+
+	// lists of busy and current files are never unloaded
+	lMemory = QueueCoordinator::UnloadArticleLists(&downloadQueue, pCurrentFileInfo, 0);
+	REQUIRE(lMemory == lFileMemory * 5);
+	for (int i = 0; i < 10; i++)
+	{
+		INFO("file " << i);
+		REQUIRE(pFileList->at(i)->GetArticles()->empty() == (i >= 5));
+	}
+
+	pFileList->at(0)->SetActiveDownloads(0);
+}
+
+TEST_CASE("Disk state: history archive", "[DiskState][Quick]")
+{
+	DiskStateTestHelper helper;
+	Servers servers;
+	DiskState diskState;
+
+	time_t tNow = time(NULL);
+	HistoryList history;
+	for (int i = 0; i < 3; i++)
+	{
+		char szName[100];
+		snprintf(szName, 100, "archived%i", i);
+		NZBInfo* pNZBInfo = new NZBInfo();
+		pNZBInfo->SetName(szName);
+		pNZBInfo->SetCategory("tv");
+		pNZBInfo->SetSize(1000 * (i + 1));
+		HistoryInfo* pHistoryInfo = new HistoryInfo(pNZBInfo);
+		pHistoryInfo->SetTime(tNow - (3 - i) * 60*60*24);
+		history.push_back(pHistoryInfo);
+	}
+
+	REQUIRE(diskState.ArchiveHistory(&history));
+
+	ArchiveIndex* pArchiveIndex = diskState.LockHistoryArchive();
+	REQUIRE(pArchiveIndex->size() == 3);
+	ArchiveEntry* pArchiveEntry = pArchiveIndex->at(1);
+	REQUIRE(pArchiveEntry->GetID() == history[1]->GetID());
+	REQUIRE(strcmp(pArchiveEntry->GetName(), "archived1") == 0);
+	REQUIRE(strcmp(pArchiveEntry->GetCategory(), "tv") == 0);
+	REQUIRE(pArchiveEntry->GetSize() == 2000);
+
+	// viewing archived items neither allocates ids nor changes the history
+	int iHistoryGeneration = DownloadQueue::GetHistoryGeneration();
+	int iNextID = NZBInfo::GenerateID();
+	HistoryInfo* pHistoryInfo = diskState.LoadArchivedHistoryInfo(pArchiveEntry, &servers);
+	REQUIRE(pHistoryInfo != NULL);
+	REQUIRE(pHistoryInfo->GetKind() == HistoryInfo::hkNzb);
+	REQUIRE(pHistoryInfo->GetID() == history[1]->GetID());
+	REQUIRE(strcmp(pHistoryInfo->GetNZBInfo()->GetName(), "archived1") == 0);
+	REQUIRE(pHistoryInfo->GetTime() == history[1]->GetTime());
+	delete pHistoryInfo;
+	REQUIRE(NZBInfo::GenerateID() == iNextID + 1);
+	REQUIRE(DownloadQueue::GetHistoryGeneration() == iHistoryGeneration);
+	diskState.UnlockHistoryArchive();
+
+	// items appended to an already loaded archive are added to the index
+	HistoryList more;
+	more.push_back(history[2]);
+	REQUIRE(diskState.ArchiveHistory(&more));
+	pArchiveIndex = diskState.LockHistoryArchive();
+	REQUIRE(pArchiveIndex->size() == 4);
+	diskState.UnlockHistoryArchive();
+
+	// items older than two days are removed
+	diskState.PruneHistoryArchive(tNow - 2 * 60*60*24 - 60);
+	pArchiveIndex = diskState.LockHistoryArchive();
+	REQUIRE(pArchiveIndex->size() == 3);
+	REQUIRE(strcmp(pArchiveIndex->at(0)->GetName(), "archived1") == 0);
+	pHistoryInfo = diskState.LoadArchivedHistoryInfo(pArchiveIndex->at(2), &servers);
+	REQUIRE(pHistoryInfo != NULL);
+	REQUIRE(strcmp(pHistoryInfo->GetNZBInfo()->GetName(), "archived2") == 0);
+	delete pHistoryInfo;
+	diskState.UnlockHistoryArchive();
+
+	for (HistoryList::iterator it = history.begin(); it != history.end(); it++)
+	{
+		delete *it;
+	}
+}
+
+TEST_CASE("Disk state: loading large queue", "[DiskState][Benchmark][TestData][.]")
+{
+	DiskStateTestHelper helper;
+	Servers servers;
+
+	const int iNZBs = 200;
+	const int iFiles = 100;
+	const int iArticles = 50;
+
+	{
+		DiskState diskState;
+		DownloadQueueMock downloadQueue;
+		helper.CreateQueue(&diskState, &downloadQueue, iNZBs, iFiles, iArticles);
+	}
+
+	DiskState diskState;
+	DownloadQueueMock downloadQueue;
+
+	long long tStart = Util::CurrentTicks();
+	REQUIRE(diskState.LoadDownloadQueue(&downloadQueue, &servers));
+	long long tEnd = Util::CurrentTicks();
+
+	REQUIRE(helper.CountFiles(&downloadQueue) == iNZBs * iFiles);
+	printf("Loaded queue with %i files (%i articles) in %.3f sec\n",
+		iNZBs * iFiles, iNZBs * iFiles * iArticles, (tEnd - tStart) / 1000000.0);
+}
@@ -0,0 +1,164 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#include "win32.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "catch.h"
+
+#include "nzbget.h"
+#include "DownloadInfo.h"
+#include "DupeCoordinator.h"
+#include "Util.h"
+
+class DupeDownloadQueueMock : public DownloadQueue
+{
+public:
+	virtual bool		EditEntry(int ID, EEditAction eAction, int iOffset, const char* szText) { return false; }
+	virtual bool		EditList(IDList* pIDList, NameList* pNameList, EMatchMode eMatchMode, EEditAction eAction, int iOffset, const char* szText) { return false; }
+	virtual void		Save() {}
+};
+
+static NZBInfo* CreateNZBInfo(const char* szName, const char* szDupeKey)
+{
+	NZBInfo* pNZBInfo = new NZBInfo();
+	pNZBInfo->SetName(szName);
+	pNZBInfo->SetDupeKey(szDupeKey);
+	return pNZBInfo;
+}
+
+static DupInfo* CreateDupInfo(const char* szName, const char* szDupeKey, DupInfo::EStatus eStatus)
+{
+	DupInfo* pDupInfo = new DupInfo();
+	pDupInfo->SetName(szName);
+	pDupInfo->SetDupeKey(szDupeKey);
+	pDupInfo->SetStatus(eStatus);
+	return pDupInfo;
+}
+
+TEST_CASE("Dupe coordinator: duplicate status", "[DupeCoordinator][Quick]")
+{
+	DupeDownloadQueueMock downloadQueue;
+	DupeCoordinator dupeCoordinator;
+
+	downloadQueue.GetQueue()->push_back(CreateNZBInfo("Queued.Show.S01E01", ""));
+	downloadQueue.GetQueue()->push_back(CreateNZBInfo("Other.Name", "show-s01e02"));
+
+	NZBInfo* pGoodNZBInfo = CreateNZBInfo("Good.Show.S01E03", "");
+	pGoodNZBInfo->SetMarkStatus(NZBInfo::ksGood);
+	downloadQueue.GetHistory()->push_back(new HistoryInfo(pGoodNZBInfo));
+
+	NZBInfo* pBadNZBInfo = CreateNZBInfo("Bad.Show.S01E04", "");
+	pBadNZBInfo->SetMarkStatus(NZBInfo::ksBad);
+	downloadQueue.GetHistory()->push_back(new HistoryInfo(pBadNZBInfo));
+
+	DupInfo* pDupInfo = CreateDupInfo("Dup.Show.S01E05", "", DupInfo::dsSuccess);
+	downloadQueue.GetHistory()->push_back(new HistoryInfo(pDupInfo));
+	downloadQueue.GetHistory()->push_back(new HistoryInfo(CreateDupInfo("Other.Dup", "show-s01e06", DupInfo::dsFailed)));
+
+	REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, "Queued.Show.S01E01", "") == DupeCoordinator::dsQueued);
+	REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, "queued.show.s01e01", "") == DupeCoordinator::dsNone);
+	REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, "Some.Name", "show-s01e02") == DupeCoordinator::dsQueued);
+	REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, "Good.Show.S01E03", "") == DupeCoordinator::dsSuccess);
+	REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, "Bad.Show.S01E04", "") == DupeCoordinator::dsFailure);
+	REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, "Dup.Show.S01E05", "") == DupeCoordinator::dsSuccess);
+	REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, "Some.Name", "show-s01e06") == DupeCoordinator::dsFailure);
+	REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, "Unknown.Show", "") == DupeCoordinator::dsNone);
+
+	// renaming must invalidate the index even if size of history doesn't change
+	pDupInfo->SetName("Renamed.Show.S01E05");
+	REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, "Dup.Show.S01E05", "") == DupeCoordinator::dsNone);
+	REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, "Renamed.Show.S01E05", "") == DupeCoordinator::dsSuccess);
+
+	downloadQueue.GetQueue()->push_back(CreateNZBInfo("Good.Show.S01E03", ""));
+	REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, "Good.Show.S01E03", "") ==
+		(DupeCoordinator::dsQueued | DupeCoordinator::dsSuccess));
+}
+
+TEST_CASE("Dupe coordinator: checking large history", "[DupeCoordinator][Benchmark][.]")
+{
+	DupeDownloadQueueMock downloadQueue;
+	DupeCoordinator dupeCoordinator;
+	char szName[256];
+	char szDupeKey[256];
+
+	const int iQueue = 1000;
+	const int iHistory = 100000;
+	const int iChecks = 10000;
+
+	for (int i = 0; i < iQueue; i++)
+	{
+		snprintf(szName, 256, "Queued.Show.%i.720p", i);
+		downloadQueue.GetQueue()->push_back(CreateNZBInfo(szName, ""));
+	}
+
+	for (int i = 0; i < iHistory; i++)
+	{
+		snprintf(szName, 256, "History.Show.%i.720p", i);
+		snprintf(szDupeKey, 256, "history-show-%i", i);
+		if (i % 2 == 0)
+		{
+			NZBInfo* pNZBInfo = CreateNZBInfo(szName, szDupeKey);
+			pNZBInfo->SetMarkStatus(NZBInfo::ksGood);
+			downloadQueue.GetHistory()->push_back(new HistoryInfo(pNZBInfo));
+		}
+		else
+		{
+			downloadQueue.GetHistory()->push_back(new HistoryInfo(CreateDupInfo(szName, szDupeKey, DupInfo::dsSuccess)));
+		}
+	}
+
+	long long tStart = Util::CurrentTicks();
+	for (int i = 0; i < iChecks; i++)
+	{
+		snprintf(szName, 256, "History.Show.%i.720p", i * 7);
+		REQUIRE(dupeCoordinator.GetDupeStatus(&downloadQueue, szName, "") == DupeCoordinator::dsSuccess);
+	}
+	long long tEnd = Util::CurrentTicks();
+	printf("Checked %i names against queue with %i and history with %i items in %.3f sec\n",
+		iChecks, iQueue, iHistory, (tEnd - tStart) / 1000000.0);
+
+	tStart = Util::CurrentTicks();
+	for (int i = 0; i < iChecks / 10; i++)
+	{
+		snprintf(szName, 256, "New.Show.%i.720p", i);
+		NZBInfo* pNZBInfo = CreateNZBInfo(szName, "");
+		dupeCoordinator.NZBFound(&downloadQueue, pNZBInfo);
+		REQUIRE(pNZBInfo->GetDeleteStatus() == NZBInfo::dsNone);
+		downloadQueue.GetQueue()->push_back(pNZBInfo);
+	}
+	tEnd = Util::CurrentTicks();
+	printf("Added %i new items to queue in %.3f sec\n", iChecks / 10, (tEnd - tStart) / 1000000.0);
+}
@@ -0,0 +1,351 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#include "win32.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "catch.h"
+
+#include "nzbget.h"
+#include "Options.h"
+#include "NZBFile.h"
+#include "Util.h"
+#include "TestUtil.h"
+class NZBFileTestHelper
+{
+private:
+	Options::CmdOptList	m_cmdOpts;
+	Options*			m_pOptions;
+
+public:
+						NZBFileTestHelper();
+						~NZBFileTestHelper() { delete m_pOptions; }
+	std::string			WriteFile(const char* szName, const char* szContent);
+};
+
+NZBFileTestHelper::NZBFileTestHelper()
+{
+	TestUtil::PrepareWorkingDir("nzbfile");
+	m_cmdOpts.push_back("DetailTarget=none");
+	m_cmdOpts.push_back("InfoTarget=none");
+	m_cmdOpts.push_back("WarningTarget=none");
+	m_cmdOpts.push_back("ErrorTarget=none");
+	m_pOptions = new Options(&m_cmdOpts, NULL);
+}
+
+std::string NZBFileTestHelper::WriteFile(const char* szName, const char* szContent)
+{
+	std::string filename = TestUtil::WorkingDir() + "/" + szName;
+	FILE* pFile = fopen(filename.c_str(), FOPEN_WB);
+	REQUIRE(pFile);
+	fputs(szContent, pFile);
+	fclose(pFile);
+	return filename;
+}
+
+/*
+ * Parses the file with both parsers and checks that the results are equal.
+ */
+NZBFile* ParseBoth(const char* szFilename)
+{
+	NZBFile* pFile = NZBFile::Create(szFilename, "", false);
+	NZBFile* pXmlFile = NZBFile::Create(szFilename, "", true);
+	REQUIRE(pFile);
+	REQUIRE(pXmlFile);
+
+	NZBInfo* pNZBInfo = pFile->GetNZBInfo();
+	NZBInfo* pXmlNZBInfo = pXmlFile->GetNZBInfo();
+	REQUIRE(pNZBInfo->GetFileList()->size() == pXmlNZBInfo->GetFileList()->size());
+	REQUIRE(pNZBInfo->GetSize() == pXmlNZBInfo->GetSize());
+	REQUIRE(pNZBInfo->GetFullContentHash() == pXmlNZBInfo->GetFullContentHash());
+	REQUIRE(pNZBInfo->GetFilteredContentHash() == pXmlNZBInfo->GetFilteredContentHash());
+	REQUIRE((pFile->GetPassword() != NULL) == (pXmlFile->GetPassword() != NULL));
+	if (pFile->GetPassword())
+	{
+		REQUIRE(!strcmp(pFile->GetPassword(), pXmlFile->GetPassword()));
+	}
+
+	for (unsigned int i = 0; i < pNZBInfo->GetFileList()->size(); i++)
+	{
+		FileInfo* pFileInfo = pNZBInfo->GetFileList()->at(i);
+		FileInfo* pXmlFileInfo = pXmlNZBInfo->GetFileList()->at(i);
+		REQUIRE(!strcmp(pFileInfo->GetSubject(), pXmlFileInfo->GetSubject()));
+		REQUIRE(!strcmp(pFileInfo->GetFilename(), pXmlFileInfo->GetFilename()));
+		REQUIRE(pFileInfo->GetTime() == pXmlFileInfo->GetTime());
+		REQUIRE(pFileInfo->GetSize() == pXmlFileInfo->GetSize());
+		REQUIRE(pFileInfo->GetMissedArticles() == pXmlFileInfo->GetMissedArticles());
+		REQUIRE(pFileInfo->GetGroups()->size() == pXmlFileInfo->GetGroups()->size());
+		for (unsigned int k = 0; k < pFileInfo->GetGroups()->size(); k++)
+		{
+			REQUIRE(!strcmp(pFileInfo->GetGroups()->at(k), pXmlFileInfo->GetGroups()->at(k)));
+		}
+		REQUIRE(pFileInfo->GetArticles()->size() == pXmlFileInfo->GetArticles()->size());
+		for (unsigned int k = 0; k < pFileInfo->GetArticles()->size(); k++)
+		{
+			ArticleInfo* pArticle = pFileInfo->GetArticles()->at(k);
+			ArticleInfo* pXmlArticle = pXmlFileInfo->GetArticles()->at(k);
+			REQUIRE(!strcmp(pArticle->GetMessageID(), pXmlArticle->GetMessageID()));
+			REQUIRE(pArticle->GetPartNumber() == pXmlArticle->GetPartNumber());
+			REQUIRE(pArticle->GetSize() == pXmlArticle->GetSize());
+		}
+	}
+
+	delete pXmlFile;
+	return pFile;
+}
+
+TEST_CASE("NZB file: streaming parser", "[NZBFile][Quick][TestData]")
+{
+	NZBFileTestHelper helper;
+
+	std::string filename = helper.WriteFile("test.nzb",
+		"\xEF\xBB\xBF<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<!DOCTYPE nzb PUBLIC \"-//newzBin//DTD NZB 1.1//EN\" \"http://www.newzbin.com/DTD/nzb/nzb-1.1.dtd\">\n"
+		"<!-- <file subject=\"commented out\"> -->\n"
+		"<nzb xmlns=\"http://www.newzbin.com/DTD/2003/nzb\">\n"
+		"<head>\n"
+		"  <meta type=\"password\">secret</meta>\n"
+		"</head>\n"
+		"<file poster=\"poster &lt;poster@example.com&gt;\" date=\"1420000000\"\n"
+		"\tsubject='Test &quot;test.part01.rar&quot; yEnc (1/3) &#xE9;&#8364;'>\n"
+		" <groups>\n"
+		"  <group>alt.binaries.test</group>\n"
+		"  <group>\n alt.binaries.test2 \n</group>\n"
+		" </groups>\n"
+		" <segments>\n"
+		"  <segment bytes=\"500000\" number=\"1\">part1of3.abc@example.com</segment>\n"
+		"  <segment number=\"3\" bytes=\"300000\"><![CDATA[part3of3.abc@example.com]]></segment>\n"
+		" </segments>\n"
+		"</file>\n"
+		"<file poster=\"poster\" date=\"1420000001\" subject=\"Test &quot;test.par2&quot; yEnc (1/1)\">\n"
+		" <groups><group>alt.binaries.test</group></groups>\n"
+		" <segments>\n"
+		"  <segment bytes=\"1000\" number=\"1\">par2.abc&amp;def@example.com</segment>\n"
+		"  <segment bytes=\"1000\" number=\"2\"/>\n"
+		" </segments>\n"
+		"</file>\n"
+		"<file poster=\"poster\" date=\"1420000002\" subject=\"empty file\">\n"
+		" <groups><group>alt.binaries.test</group></groups>\n"
+		" <segments></segments>\n"
+		"</file>\n"
+		"</nzb>\n");
+
+	NZBFile* pFile = ParseBoth(filename.c_str());
+	NZBInfo* pNZBInfo = pFile->GetNZBInfo();
+
+	REQUIRE(pNZBInfo->GetFileList()->size() == 2);
+	REQUIRE(!strcmp(pFile->GetPassword(), "secret"));
+
+	FileInfo* pFileInfo = pNZBInfo->GetFileList()->at(0);
+	REQUIRE(!strcmp(pFileInfo->GetSubject(), "Test \"test.part01.rar\" yEnc (1/3) \xC3\xA9\xE2\x82\xAC"));
+	REQUIRE(!strcmp(pFileInfo->GetFilename(), "test.part01.rar"));
+	REQUIRE(pFileInfo->GetTime() == 1420000000);
+	REQUIRE(pFileInfo->GetGroups()->size() == 2);
+	REQUIRE(!strcmp(pFileInfo->GetGroups()->at(1), "alt.binaries.test2"));
+	REQUIRE(pFileInfo->GetArticles()->size() == 2);
+	REQUIRE(pFileInfo->GetMissedArticles() == 1);
+	REQUIRE(pFileInfo->GetSize() == 1300000);
+	REQUIRE(!strcmp(pFileInfo->GetArticles()->at(1)->GetMessageID(), "<part3of3.abc@example.com>"));
+
+	pFileInfo = pNZBInfo->GetFileList()->at(1);
+	REQUIRE(pFileInfo->GetParFile());
+	REQUIRE(!strcmp(pFileInfo->GetArticles()->at(0)->GetMessageID(), "<par2.abc&def@example.com>"));
+
+	REQUIRE(pNZBInfo->GetFullContentHash() != 0);
+
+	delete pFile;
+}
+
+TEST_CASE("NZB file: fallback to XML parser", "[NZBFile][Quick][TestData]")
+{
+	NZBFileTestHelper helper;
+
+	// other encodings are converted by the XML parser
+	std::string filename = helper.WriteFile("latin1.nzb",
+		"<?xml version=\"1.0\" encoding=\"iso-8859-1\"?>\n"
+		"<nzb><file subject=\"caf\xE9.rar\" date=\"1\">"
+		"<groups><group>alt.binaries.test</group></groups>"
+		"<segments><segment bytes=\"10\" number=\"1\">a@b</segment></segments>"
+		"</file></nzb>\n");
+	NZBFile* pFile = ParseBoth(filename.c_str());
+	REQUIRE(!strcmp(pFile->GetNZBInfo()->GetFileList()->at(0)->GetSubject(), "caf\xC3\xA9.rar"));
+	delete pFile;
+
+	// malformed files are reported by the XML parser
+	filename = helper.WriteFile("malformed.nzb",
+		"<nzb><file subject=\"test.rar\" date=\"1\">"
+		"<groups><group>alt.binaries.test</group></groups>"
+		"<segments><segment bytes=\"10\" number=\"1\">a@b</segment></segments>"
+		"</nzb>\n");
+	REQUIRE(NZBFile::Create(filename.c_str(), "", false) == NULL);
+
+	filename = helper.WriteFile("truncated.nzb",
+		"<nzb><file subject=\"test.rar\" date=\"1\">"
+		"<groups><group>alt.binaries.test</group></groups>"
+		"<segments><segment bytes=\"10\" number=\"1\">a@b</segment></segments>"
+		"</file></nzb");
+	REQUIRE(NZBFile::Create(filename.c_str(), "", false) == NULL);
+}
+
+TEST_CASE("NZB file: parsing from memory", "[NZBFile][Quick][TestData]")
+{
+	NZBFileTestHelper helper;
+
+	const char* szContent =
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<nzb><head><meta type=\"password\">secret</meta></head>"
+		"<file subject=\"Test &quot;test.rar&quot; yEnc (1/2)\" date=\"1\">"
+		"<groups><group>alt.binaries.test</group></groups>"
+		"<segments><segment bytes=\"10\" number=\"1\">a@b</segment>"
+		"<segment bytes=\"20\" number=\"2\">c@d</segment></segments>"
+		"</file></nzb>\n";
+	std::string filename = helper.WriteFile("memory.nzb", szContent);
+
+	NZBFile* pFile = NZBFile::Create(filename.c_str(), "", false);
+	REQUIRE(pFile);
+
+	for (int i = 0; i < 2; i++)
+	{
+		bool bXmlParser = i == 1;
+		NZBFile* pMemFile = NZBFile::CreateFromBuffer(szContent, strlen(szContent), filename.c_str(), "", bXmlParser);
+		REQUIRE(pMemFile);
+		REQUIRE(!strcmp(pMemFile->GetNZBInfo()->GetName(), "memory"));
+		REQUIRE(!strcmp(pMemFile->GetPassword(), "secret"));
+		REQUIRE(pMemFile->GetNZBInfo()->GetFileList()->size() == 1);
+		REQUIRE(pMemFile->GetNZBInfo()->GetSize() == pFile->GetNZBInfo()->GetSize());
+		REQUIRE(pMemFile->GetNZBInfo()->GetFullContentHash() == pFile->GetNZBInfo()->GetFullContentHash());
+		delete pMemFile;
+	}
+
+	delete pFile;
+
+#ifndef DISABLE_GZIP
+	// compressed content
+	int iContentLen = strlen(szContent);
+	int iGZipSize = ZLib::GZipLen(iContentLen);
+	char* szGZipBuf = (char*)malloc(iGZipSize);
+	int iGZipLen = ZLib::GZip(szContent, iContentLen, szGZipBuf, iGZipSize);
+	REQUIRE(iGZipLen > 0);
+	REQUIRE(ZLib::IsGZip(szGZipBuf, iGZipLen));
+	REQUIRE_FALSE(ZLib::IsGZip(szContent, iContentLen));
+
+	char* szBuf = NULL;
+	int iBufLen = 0;
+	REQUIRE(ZLib::GUnzip(szGZipBuf, iGZipLen, &szBuf, &iBufLen));
+	REQUIRE(iBufLen == iContentLen);
+	REQUIRE(!strcmp(szBuf, szContent));
+	free(szBuf);
+
+	// truncated data
+	REQUIRE_FALSE(ZLib::GUnzip(szGZipBuf, iGZipLen / 2, &szBuf, &iBufLen));
+	free(szGZipBuf);
+#endif
+
+	// the content which the streaming parser can't handle is passed to XML parser from memory too
+	const char* szLatin1 =
+		"<?xml version=\"1.0\" encoding=\"iso-8859-1\"?>\n"
+		"<nzb><file subject=\"caf\xE9.rar\" date=\"1\">"
+		"<groups><group>alt.binaries.test</group></groups>"
+		"<segments><segment bytes=\"10\" number=\"1\">a@b</segment></segments>"
+		"</file></nzb>\n";
+	pFile = NZBFile::CreateFromBuffer(szLatin1, strlen(szLatin1), "latin1.nzb", "");
+	REQUIRE(pFile);
+	REQUIRE(!strcmp(pFile->GetNZBInfo()->GetFileList()->at(0)->GetSubject(), "caf\xC3\xA9.rar"));
+	delete pFile;
+
+	// UTF-8 byte order mark before xml declaration
+	std::string bom = std::string("\xEF\xBB\xBF") + szContent;
+	for (int i = 0; i < 2; i++)
+	{
+		pFile = NZBFile::CreateFromBuffer(bom.c_str(), (int)bom.length(), "bom.nzb", "", i == 1);
+		REQUIRE(pFile);
+		REQUIRE(pFile->GetNZBInfo()->GetFileList()->size() == 1);
+		delete pFile;
+	}
+
+	const char* szTruncated = "<nzb><file subject=\"test.rar\" date=\"1\">";
+	REQUIRE(NZBFile::CreateFromBuffer(szTruncated, strlen(szTruncated), "truncated.nzb", "") == NULL);
+}
+
+/*
+ * Generates a large nzb-file (about 150 MB) similar to nzb-files of indexers
+ * and compares the parsing time of the streaming and the XML parser.
+ */
+TEST_CASE("NZB file: parser benchmark", "[NZBFile][Benchmark][TestData][.]")
+{
+	NZBFileTestHelper helper;
+
+	const int iFiles = 200;
+	const int iArticles = 3000;
+
+	std::string filename = TestUtil::WorkingDir() + "/large.nzb";
+	FILE* pFile = fopen(filename.c_str(), FOPEN_WB);
+	REQUIRE(pFile);
+	fprintf(pFile, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<!DOCTYPE nzb PUBLIC \"-//newzBin//DTD NZB 1.1//EN\" \"http://www.newzbin.com/DTD/nzb/nzb-1.1.dtd\">\n"
+		"<nzb xmlns=\"http://www.newzbin.com/DTD/2003/nzb\">\n");
+	for (int i = 0; i < iFiles; i++)
+	{
+		fprintf(pFile, "<file poster=\"Poster &lt;poster@example.com&gt;\" date=\"1420000000\" "
+			"subject=\"[%i/%i] - &quot;large.part%03i.rar&quot; yEnc (1/%i)\">\n"
+			"<groups>\n<group>alt.binaries.test</group>\n<group>alt.binaries.example</group>\n</groups>\n<segments>\n",
+			i + 1, iFiles, i + 1, iArticles);
+		for (int k = 0; k < iArticles; k++)
+		{
+			fprintf(pFile, "<segment bytes=\"396288\" number=\"%i\">part%iof%i.AbCdEfGhIjKlMnOpQr%i@powerpost2000AA.local</segment>\n",
+				k + 1, k + 1, iArticles, i);
+		}
+		fprintf(pFile, "</segments>\n</file>\n");
+	}
+	fprintf(pFile, "</nzb>\n");
+	long long lSize = ftell(pFile);
+	fclose(pFile);
+
+	for (int iParser = 0; iParser < 4; iParser++)
+	{
+		bool bXmlParser = iParser % 2 == 1;
+		long long iStart = Util::CurrentTicks();
+		NZBFile* pNZBFile = NZBFile::Create(filename.c_str(), "", bXmlParser);
+		long long iElapsed = Util::CurrentTicks() - iStart;
+		REQUIRE(pNZBFile);
+		REQUIRE(pNZBFile->GetNZBInfo()->GetTotalArticles() == iFiles * iArticles);
+		printf("%s parser: %.2f sec for %.1f MB\n", bXmlParser ? "XML" : "Streaming",
+			iElapsed / 1000000.0, lSize / 1024.0 / 1024.0);
+		delete pNZBFile;
+	}
+}
@@ -0,0 +1,221 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#include "win32.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "catch.h"
+
+#include "nzbget.h"
+#include "Log.h"
+#include "Util.h"
+#include "TestUtil.h"
+
+class LogProducer : public Thread
+{
+private:
+	LogWriter*			m_pWriter;
+	const char*			m_szFilename;
+	int					m_iLines;
+	bool				m_bMayDrop;
+
+protected:
+	virtual void		Run();
+
+public:
+						LogProducer(LogWriter* pWriter, const char* szFilename, int iLines, bool bMayDrop) :
+							m_pWriter(pWriter), m_szFilename(szFilename), m_iLines(iLines), m_bMayDrop(bMayDrop) {}
+};
+
+void LogProducer::Run()
+{
+	char szLine[1024];
+	for (int i = 0; i < m_iLines; i++)
+	{
+		snprintf(szLine, 1024, "Fri Oct 16 12:00:00 2015\tDETAIL\tProcessing line %i of log producer%s", i, LINE_ENDING);
+		if (m_pWriter)
+		{
+			m_pWriter->Append(m_szFilename, szLine, m_bMayDrop);
+		}
+		else
+		{
+			LogWriter::WriteLine(m_szFilename, szLine);
+		}
+	}
+}
+
+static int CountLines(const char* szFilename)
+{
+	FILE* file = fopen(szFilename, FOPEN_RB);
+	if (!file)
+	{
+		return 0;
+	}
+
+	int iCount = 0;
+	char szLine[1024];
+	while (fgets(szLine, sizeof(szLine), file))
+	{
+		iCount++;
+	}
+	fclose(file);
+
+	return iCount;
+}
+
+static double RunProducers(LogWriter* pWriter, const char* szFilename, int iThreads, int iLines, bool bMayDrop)
+{
+	long long tStart = Util::CurrentTicks();
+
+	LogProducer** pProducers = new LogProducer*[iThreads];
+	for (int i = 0; i < iThreads; i++)
+	{
+		pProducers[i] = new LogProducer(pWriter, szFilename, iLines, bMayDrop);
+		pProducers[i]->Start();
+	}
+
+	for (int i = 0; i < iThreads; i++)
+	{
+		while (pProducers[i]->IsRunning())
+		{
+			usleep(1000);
+		}
+		delete pProducers[i];
+	}
+	delete[] pProducers;
+
+	if (pWriter)
+	{
+		pWriter->Write();
+	}
+
+	return (Util::CurrentTicks() - tStart) / 1000000.0;
+}
+
+TEST_CASE("Log writer: writing lines from many threads", "[Log][Quick][TestData]")
+{
+	TestUtil::PrepareWorkingDir("logwriter");
+	std::string filename1 = TestUtil::WorkingDir() + "/log1.txt";
+	std::string filename2 = TestUtil::WorkingDir() + "/log2.txt";
+
+	LogWriter writer;
+	writer.Start();
+
+	// more lines than fit into the buffer, nothing must be lost
+	LogProducer producer1(&writer, filename1.c_str(), 3000, false);
+	LogProducer producer2(&writer, filename2.c_str(), 2000, false);
+	LogProducer producer3(&writer, filename1.c_str(), 1000, false);
+	producer1.Start();
+	producer2.Start();
+	producer3.Start();
+	while (producer1.IsRunning() || producer2.IsRunning() || producer3.IsRunning())
+	{
+		usleep(1000);
+	}
+
+	writer.Stop();
+	while (writer.IsRunning())
+	{
+		usleep(1000);
+	}
+	writer.Write();
+
+	REQUIRE(CountLines(filename1.c_str()) == 4000);
+	REQUIRE(CountLines(filename2.c_str()) == 2000);
+	REQUIRE(writer.TakeDropped() == 0);
+}
+
+TEST_CASE("Log writer: dropping lines on overflow", "[Log][Quick][TestData]")
+{
+	TestUtil::PrepareWorkingDir("logwriter");
+	std::string filename = TestUtil::WorkingDir() + "/log.txt";
+
+	// writer thread is not started, the buffer gets full
+	LogWriter writer;
+	for (int i = 0; i < LogWriter::BUFFER_SIZE + 10; i++)
+	{
+		writer.Append(filename.c_str(), "detail line\n", true);
+	}
+	REQUIRE(writer.TakeDropped() == 10);
+	REQUIRE(writer.TakeDropped() == 0);
+
+	// other lines are written by the calling thread when the buffer is full
+	writer.Append(filename.c_str(), "error line\n", false);
+	REQUIRE(CountLines(filename.c_str()) == LogWriter::BUFFER_SIZE);
+
+	REQUIRE(writer.Write() == 1);
+	REQUIRE(CountLines(filename.c_str()) == LogWriter::BUFFER_SIZE + 1);
+}
+
+TEST_CASE("Log writer: logging throughput", "[Log][Benchmark][TestData][.]")
+{
+	TestUtil::PrepareWorkingDir("logwriter");
+	std::string syncFilename = TestUtil::WorkingDir() + "/sync.log";
+	std::string asyncFilename = TestUtil::WorkingDir() + "/async.log";
+
+	const int iThreads = 4;
+	const int iLines = 50000;
+
+	double fSyncTime = RunProducers(NULL, syncFilename.c_str(), iThreads, iLines, false);
+	REQUIRE(CountLines(syncFilename.c_str()) == iThreads * iLines);
+	printf("Direct writing: %i lines in %.3f sec (%.0f lines/sec)\n",
+		iThreads * iLines, fSyncTime, iThreads * iLines / fSyncTime);
+
+	LogWriter writer;
+	writer.Start();
+	double fAsyncTime = RunProducers(&writer, asyncFilename.c_str(), iThreads, iLines, false);
+	REQUIRE(CountLines(asyncFilename.c_str()) == iThreads * iLines);
+	printf("Log writer: %i lines in %.3f sec (%.0f lines/sec)\n",
+		iThreads * iLines, fAsyncTime, iThreads * iLines / fAsyncTime);
+
+	// detail messages may be dropped if the producers are faster than the disk
+	remove(asyncFilename.c_str());
+	double fDropTime = RunProducers(&writer, asyncFilename.c_str(), iThreads, iLines, true);
+	int iDropped = writer.TakeDropped();
+	int iWritten = CountLines(asyncFilename.c_str());
+	int iTotal = iWritten + iDropped;
+	REQUIRE(iTotal == iThreads * iLines);
+	printf("Log writer with dropping: %i lines in %.3f sec (%i dropped)\n",
+		iThreads * iLines, fDropTime, iDropped);
+
+	writer.Stop();
+	while (writer.IsRunning())
+	{
+		usleep(1000);
+	}
+}
@@ -0,0 +1,217 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#include "win32.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "catch.h"
+
+#include "nzbget.h"
+#include "Log.h"
+#include "Util.h"
+
+TEST_CASE("Message ring: add and read", "[Log][MessageRing][Quick]")
+{
+	MessageRing ring(100);
+
+	MessageList messages;
+	ring.Read(&messages, 0, 0);
+	REQUIRE(messages.empty());
+	REQUIRE(ring.GetCount() == 0);
+
+	char szText[100];
+	for (int i = 1; i <= 250; i++)
+	{
+		snprintf(szText, sizeof(szText), "message %i", i);
+		REQUIRE(ring.Add(Message::mkInfo, i, szText) == i);
+	}
+	REQUIRE(ring.GetCount() == 100);
+
+	// only the last messages are kept
+	ring.Read(&messages, 0, 0);
+	REQUIRE(messages.size() == 100);
+	REQUIRE(messages.front()->GetID() == 151);
+	REQUIRE(messages.back()->GetID() == 250);
+	REQUIRE(!strcmp(messages.front()->GetText(), "message 151"));
+	REQUIRE(messages.front()->GetTime() == 151);
+	messages.Clear();
+
+	// messages since ID
+	ring.Read(&messages, 245, 0);
+	REQUIRE(messages.size() == 6);
+	REQUIRE(messages.front()->GetID() == 245);
+	messages.Clear();
+
+	ring.Read(&messages, 10, 0);
+	REQUIRE(messages.size() == 100);
+	messages.Clear();
+
+	ring.Read(&messages, 251, 0);
+	REQUIRE(messages.empty());
+
+	// last N messages
+	ring.Read(&messages, 0, 3);
+	REQUIRE(messages.size() == 3);
+	REQUIRE(!strcmp(messages.back()->GetText(), "message 250"));
+	messages.Clear();
+
+	// IDs continue to increase after clearing
+	ring.Clear();
+	REQUIRE(ring.GetCount() == 0);
+	ring.Read(&messages, 0, 0);
+	REQUIRE(messages.empty());
+	REQUIRE(ring.Add(Message::mkError, 0, "after clear") == 251);
+
+	ring.Reset();
+	REQUIRE(ring.Add(Message::mkError, 0, "after reset") == 1);
+}
+
+TEST_CASE("Message ring: long texts", "[Log][MessageRing][Quick]")
+{
+	MessageRing ring(20);
+
+	char szLong[2000];
+	memset(szLong, 'x', sizeof(szLong) - 1);
+	szLong[sizeof(szLong) - 1] = '\0';
+
+	char szText[100];
+	for (int i = 1; i <= 100; i++)
+	{
+		if (i % 3 == 0)
+		{
+			ring.Add(Message::mkDetail, 0, szLong);
+		}
+		else
+		{
+			snprintf(szText, sizeof(szText), "message %i", i);
+			ring.Add(Message::mkDetail, 0, szText);
+		}
+	}
+
+	// long texts are truncated and take space of several short messages
+	MessageList messages;
+	ring.Read(&messages, 0, 0);
+	REQUIRE(!messages.empty());
+	REQUIRE(messages.size() <= 20);
+	REQUIRE(messages.back()->GetID() == 100);
+	REQUIRE(!strcmp(messages.back()->GetText(), "message 100"));
+
+	unsigned int iExpectedID = messages.front()->GetID();
+	for (MessageList::iterator it = messages.begin(); it != messages.end(); it++)
+	{
+		Message* pMessage = *it;
+		REQUIRE(pMessage->GetID() == iExpectedID++);
+		if (pMessage->GetID() % 3 == 0)
+		{
+			REQUIRE(strlen(pMessage->GetText()) == 1023);
+		}
+		else
+		{
+			snprintf(szText, sizeof(szText), "message %i", pMessage->GetID());
+			REQUIRE(!strcmp(pMessage->GetText(), szText));
+		}
+	}
+}
+
+class MessageReader : public Thread
+{
+private:
+	MessageRing*		m_pRing;
+	bool				m_bFailed;
+
+protected:
+	virtual void		Run();
+
+public:
+						MessageReader(MessageRing* pRing) : m_pRing(pRing), m_bFailed(false) {}
+	bool				GetFailed() { return m_bFailed; }
+};
+
+void MessageReader::Run()
+{
+	char szText[100];
+	while (!IsStopped())
+	{
+		MessageList messages;
+		m_pRing->Read(&messages, 0, 0);
+		unsigned int iLastID = 0;
+		for (MessageList::iterator it = messages.begin(); it != messages.end(); it++)
+		{
+			Message* pMessage = *it;
+			snprintf(szText, sizeof(szText), "message %i", pMessage->GetID());
+			if (pMessage->GetID() <= iLastID || strcmp(pMessage->GetText(), szText))
+			{
+				m_bFailed = true;
+			}
+			iLastID = pMessage->GetID();
+		}
+	}
+}
+
+TEST_CASE("Message ring: concurrent readers", "[Log][MessageRing][Quick]")
+{
+	MessageRing ring(1000);
+
+	MessageReader* readers[4];
+	for (int i = 0; i < 4; i++)
+	{
+		readers[i] = new MessageReader(&ring);
+		readers[i]->Start();
+	}
+
+	char szText[100];
+	for (int i = 1; i <= 200000; i++)
+	{
+		snprintf(szText, sizeof(szText), "message %i", i);
+		ring.Add(Message::mkInfo, 0, szText);
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		readers[i]->Stop();
+	}
+	for (int i = 0; i < 4; i++)
+	{
+		while (readers[i]->IsRunning())
+		{
+			usleep(10 * 1000);
+		}
+		REQUIRE_FALSE(readers[i]->GetFailed());
+		delete readers[i];
+	}
+}
@@ -0,0 +1,100 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef WIN32
+#include "win32.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "catch.h"
+
+#include "nzbget.h"
+#include "Thread.h"
+#include "Util.h"
+
+class CountingJob : public ParallelJob
+{
+private:
+	int					m_iItems;
+	volatile int*		m_pCounts;
+
+public:
+						CountingJob(int iItems);
+						~CountingJob() { free((void*)m_pCounts); }
+	virtual void		ProcessItem(int iItem) { Atomic::Add(&m_pCounts[iItem], 1); }
+	bool				AllOnce();
+};
+
+CountingJob::CountingJob(int iItems)
+{
+	m_iItems = iItems;
+	m_pCounts = (volatile int*)calloc(iItems, sizeof(int));
+}
+
+bool CountingJob::AllOnce()
+{
+	for (int i = 0; i < m_iItems; i++)
+	{
+		if (m_pCounts[i] != 1)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+TEST_CASE("Worker pool: processing each item once", "[WorkerPool][Quick]")
+{
+	int iThreadCounts[] = { 0, 1, 4 };
+	for (int t = 0; t < 3; t++)
+	{
+		WorkerPool pool(iThreadCounts[t]);
+		REQUIRE(pool.GetThreadCount() == iThreadCounts[t]);
+
+		// many small batches run back to back
+		for (int iBatch = 0; iBatch < 200; iBatch++)
+		{
+			int iItems = iBatch % 20;
+			CountingJob job(iItems);
+			pool.Execute(&job, iItems);
+			REQUIRE(job.AllOnce());
+		}
+
+		CountingJob bigJob(100000);
+		pool.Execute(&bigJob, 100000);
+		REQUIRE(bigJob.AllOnce());
+	}
+}
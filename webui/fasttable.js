@@ -35,7 +35,8 @@
  *   HTML tables with:
  *     1) very fast content updates;
  *     2) automatic pagination;
- *     3) search/filtering.
+ *     3) search/filtering;
+ *     4) optional pagination and filtering on server side (see "update" and "pageRequest").
  *
  * What makes it unique and fast?
  * The tables are designed to be updated very often (up to 10 times per second). This has two challenges:
@@ -129,7 +130,7 @@
 								if (data.content)
 								{
 									data.curPage = 1;
-									refresh(data);
+									pageChanged(data);
 								}
 								if (data.config.filterInputCallback)
 								{
@@ -152,7 +153,8 @@
 						data.config.filterInput.val('');
 						if (data.content)
 						{
-							refresh(data);
+							data.curPage = 1;
+							pageChanged(data);
 						}
 						if (data.config.filterClearCallback)
 						{
@@ -181,7 +183,7 @@
 						{
 							data.curPage = parseInt(pageNum);
 						}
-						refresh(data);
+						pageChanged(data);
 					});
 					
 					$this.data('fasttable', {
@@ -216,6 +218,8 @@
 		setPageSize : setPageSize,
 
 		setCurPage : setCurPage,
+
+		pageRequest : pageRequest,
 		
 		filteredContent : function()
 		{
@@ -257,16 +261,48 @@
 		return true;
 	}
 
-	function updateContent(content)
+	/*
+	 * If parameter "pageInfo" is passed the content is one page prepared by server
+	 * (see "pageRequest"). The object has fields "total" (number of all records),
+	 * "available" (records matching search phrase) and "filtered" (records matching
+	 * search phrase and filter callback; the page is a part of these records).
+	 */
+	function updateContent(content, pageInfo)
 	{
 		var data = $(this).data('fasttable');
 		if (content)
 		{
 			data.content = content;
+			data.pageInfo = pageInfo;
 		}
 		refresh(data);
 	}
 
+	function pageChanged(data)
+	{
+		if (data.pageInfo && data.config.pageChangeCallback)
+		{
+			// request the new page from server, the table is refreshed on next update
+			data.config.pageChangeCallback();
+		}
+		else
+		{
+			refresh(data);
+		}
+	}
+
+	// Returns parameters of the page which should be prepared by server.
+	function pageRequest()
+	{
+		var data = $(this).data('fasttable');
+		var filterInput = data.config.filterInput;
+		return {
+			offset: (Math.max(data.curPage, 1) - 1) * data.pageSize,
+			limit: data.pageSize,
+			filter: filterInput.length > 0 ? filterInput.val() : ''
+		};
+	}
+
 	function refresh(data)
 	{
 		refilter(data);
@@ -278,6 +314,14 @@
 
 	function refilter(data)
 	{
+		if (data.pageInfo)
+		{
+			// already filtered by server
+			data.availableContent = data.content;
+			data.filteredContent = data.content;
+			return;
+		}
+
 		var filterInput = data.config.filterInput;
 		var phrase = filterInput.length > 0 ? filterInput.val() : '';
 		var caseSensitive = data.config.filterCaseSensitive;
@@ -416,7 +460,9 @@
 
 	function updatePager(data)
 	{
-		data.pageCount = Math.ceil(data.filteredContent.length / data.pageSize);
+		var filteredCount = data.pageInfo ? data.pageInfo.filtered : data.filteredContent.length;
+		var requestedPage = data.curPage;
+		data.pageCount = Math.ceil(filteredCount / data.pageSize);
 		if (data.curPage < 1)
 		{
 			data.curPage = 1;
@@ -426,8 +472,20 @@
 			data.curPage = data.pageCount;
 		}
 
-		var startIndex = (data.curPage - 1) * data.pageSize;
-		data.pageContent = data.filteredContent.slice(startIndex, startIndex + data.pageSize);
+		if (data.pageInfo)
+		{
+			data.pageContent = data.content;
+			if (data.curPage > 0 && data.curPage !== Math.max(requestedPage, 1) && data.config.pageChangeCallback)
+			{
+				// the requested page doesn't exist anymore (records were deleted)
+				data.config.pageChangeCallback();
+			}
+		}
+		else
+		{
+			var startIndex = (data.curPage - 1) * data.pageSize;
+			data.pageContent = data.filteredContent.slice(startIndex, startIndex + data.pageSize);
+		}
 
 		var pagerObj = data.config.pagerContainer;
 		var pagerHtml = buildPagerHtml(data);
@@ -537,22 +595,26 @@
 	
 	function updateInfo(data)
 	{
-		if (data.content.length === 0)
+		var total = data.pageInfo ? data.pageInfo.total : data.content.length;
+		var available = data.pageInfo ? data.pageInfo.available : data.availableContent.length;
+		var filtered = data.pageInfo ? data.pageInfo.filtered : data.filteredContent.length;
+
+		if (total === 0)
 		{
 			var infoText = data.config.infoEmpty;
 		}
 		else if (data.curPage === 0)
 		{
-			var infoText = 'No matching records found (total ' + data.content.length + ')';
+			var infoText = 'No matching records found (total ' + total + ')';
 		}
 		else
 		{
 			var firstRecord = (data.curPage - 1) * data.pageSize + 1;
 			var lastRecord = firstRecord + data.pageContent.length - 1;
-			var infoText = 'Showing records ' + firstRecord + '-' + lastRecord + ' from ' + data.filteredContent.length;
-			if (data.filteredContent.length != data.content.length)
+			var infoText = 'Showing records ' + firstRecord + '-' + lastRecord + ' from ' + filtered;
+			if (filtered != total)
 			{
-				infoText += ' filtered (total ' + data.content.length + ')';
+				infoText += ' filtered (total ' + total + ')';
 			}
 		}
 		data.config.infoContainer.html(infoText);
@@ -560,9 +622,9 @@
 		if (data.config.updateInfoCallback)
 		{
 			data.config.updateInfoCallback({
-				total: data.content.length,
-				available: data.availableContent.length,
-				filtered: data.filteredContent.length,
+				total: total,
+				available: available,
+				filtered: filtered,
 				firstRecord: firstRecord,
 				lastRecord: lastRecord				
 			});
@@ -582,14 +644,14 @@
 		{
 			data.pageDots = pageDots;
 		}
-		refresh(data);
+		pageChanged(data);
 	}
 
 	function setCurPage(page)
 	{
 		var data = $(this).data('fasttable');
 		data.curPage = parseInt(page);
-		refresh(data);
+		pageChanged(data);
 	}
 	
 	function titleCheckRedraw(data)
@@ -791,6 +853,7 @@
 		filterClearCallback: undefined,
 		fillSearchCallback: undefined,
 		filterCallback: undefined,
+		pageChangeCallback: undefined,
 		headerCheck: '#table-header-check'
 	};
 
@@ -42,6 +42,8 @@ var History = (new function($)
 
 	// State
 	var history;
+	var pageInfo = null;
+	var serverPaging = true;
 	var notification = null;
 	var updateTabInfo;
 	var curFilter = 'ALL';
@@ -73,6 +75,7 @@ var History = (new function($)
 				pageDots: !UISettings.miniTheme,
 				fillFieldsCallback: fillFieldsCallback,
 				filterCallback: filterCallback,
+				pageChangeCallback: pageChanged,
 				renderCellCallback: renderCellCallback,
 				updateInfoCallback: updateInfo
 			});
@@ -110,12 +113,64 @@ var History = (new function($)
 			initFilterButtons();
 		}
 
-		RPC.call('history', [showDup], loaded);
+		if (serverPaging)
+		{
+			loadPage(RPC.next);
+		}
+		else
+		{
+			RPC.call('history', [showDup], loaded);
+		}
+	}
+
+	// Loads only the visible page, which is sorted and filtered by server.
+	function loadPage(completedCallback)
+	{
+		var request = $HistoryTable.fasttable('pageRequest');
+		RPC.call('historypage', [showDup, request.offset, request.limit, 'time', request.filter, false, curFilter],
+			function(page)
+			{
+				pageLoaded(page);
+				completedCallback();
+			},
+			function(res, result)
+			{
+				if (result && result.error && result.error.code === 1)
+				{
+					// older versions of NZBGet don't have method "historypage",
+					// loading the whole history and paging it in browser
+					serverPaging = false;
+					RPC.call('history', [showDup], loaded);
+				}
+				else
+				{
+					RPC.defaultFailureCallback(res, result);
+				}
+			});
+	}
+
+	function pageLoaded(page)
+	{
+		history = page.Items;
+		pageInfo =
+		{
+			total: page.UnfilteredCount,
+			available: page.SuccessCount + page.FailureCount + page.DeletedCount + page.DupeCount,
+			filtered: page.TotalCount,
+			counts: page
+		};
+		prepare();
+	}
+
+	function pageChanged()
+	{
+		loadPage(History.redraw);
 	}
 
 	function loaded(curHistory)
 	{
 		history = curHistory;
+		pageInfo = null;
 		prepare();
 		RPC.next();
 	}
@@ -191,10 +246,11 @@ var History = (new function($)
 			data.push(item);
 		}
 
-		$HistoryTable.fasttable('update', data);
+		$HistoryTable.fasttable('update', data, pageInfo);
 
-		Util.show($HistoryTabBadge, history.length > 0);
-		Util.show($HistoryTabBadgeEmpty, history.length === 0 && UISettings.miniTheme);
+		var total = pageInfo ? pageInfo.total : history.length;
+		Util.show($HistoryTabBadge, total > 0);
+		Util.show($HistoryTabBadgeEmpty, total === 0 && UISettings.miniTheme);
 	}
 
 	function fillFieldsCallback(item)
@@ -414,17 +470,27 @@ var History = (new function($)
 		var countDeleted = 0;
 		var countDupe = 0;
 
-		var data = $HistoryTable.fasttable('availableContent');
-
-		for (var i=0; i < data.length; i++)
+		if (pageInfo)
+		{
+			countSuccess = pageInfo.counts.SuccessCount;
+			countFailure = pageInfo.counts.FailureCount;
+			countDeleted = pageInfo.counts.DeletedCount;
+			countDupe = pageInfo.counts.DupeCount;
+		}
+		else
 		{
-			var hist = data[i].hist;
-			switch (hist.FilterKind)
+			var data = $HistoryTable.fasttable('availableContent');
+
+			for (var i=0; i < data.length; i++)
 			{
-				case 'SUCCESS': countSuccess++; break;
-				case 'FAILURE': countFailure++; break;
-				case 'DELETED': countDeleted++; break;
-				case 'DUPE': countDupe++; break;
+				var hist = data[i].hist;
+				switch (hist.FilterKind)
+				{
+					case 'SUCCESS': countSuccess++; break;
+					case 'FAILURE': countFailure++; break;
+					case 'DELETED': countDeleted++; break;
+					case 'DUPE': countDupe++; break;
+				}
 			}
 		}
 		$('#History_Badge_ALL,#History_Badge_ALL2').text(countSuccess + countFailure + countDeleted + countDupe);
@@ -442,7 +508,14 @@ var History = (new function($)
 	this.filter = function(type)
 	{
 		curFilter = type;
-		History.redraw();
+		if (pageInfo)
+		{
+			$HistoryTable.fasttable('setCurPage', 1);
+		}
+		else
+		{
+			History.redraw();
+		}
 	}
 
 	this.dupClick = function()